@@ -0,0 +1,1283 @@
+// Benchmarks for the stack walker and the capture pipeline
+//
+// The synthetic stages run the walker, batch and snapshot capture,
+// interning and export against deterministic frame pointer stacks held by
+// a memory target (see memory_target.h), so they measure the profiler's
+// own code without a kernel in the loop. The async stage rebuilds await
+// chains (linear, cyclic and truncated) from recorded memory and fails the
+// run if they differ from what was recorded. Each stack keeps a fixed depth;
+// between samples a share of the threads (the change rate) replace some of
+// their innermost frames, the rest stay where they were. The end-to-end
+// stage samples the test-target fixture through the real platform layer.
+//
+// Every stage reports ns/frame (ns/location for the pprof export),
+// ns/thread-sample, syscalls/sample (platform calls, which are kernel calls
+// against a real process) and allocations/sample, as a table and
+// optionally as JSON. A thread reused without a walk counts the frames of
+// its previous one. A JSON run can be
+// compared with a later one (--baseline) to catch regressions.
+
+#include "profiler.h"
+#include "memory_target.h"
+#include "stack_walker.h"
+#include "async_unwind.h"
+#include "stack_table.h"
+#include "recording.h"
+#include "pprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+extern char **environ;
+
+// Synthetic address space: code at CODE_BASE, one stack per thread above STACK_BASE
+#define CODE_BASE 0x400000ULL
+#define CODE_FUNCTION_COUNT 1024
+#define CODE_FUNCTION_SIZE 0x400
+#define STACK_BASE 0x7f0000000000ULL
+#define STACK_SPACING 0x1000000ULL
+
+// Recorded async memory: contexts at ASYNC_CONTEXT_BASE, the frame records
+// pointing at them at ASYNC_STACK_BASE; nothing is recorded at ASYNC_UNMAPPED
+#define ASYNC_CONTEXT_BASE 0x600000000000ULL
+#define ASYNC_STACK_BASE 0x610000000000ULL
+#define ASYNC_UNMAPPED 0x620000000000ULL
+
+// Signature bits stored above the address in every continuation, which the
+// unwinder must strip
+#define ASYNC_SIGNATURE (0xA5ULL << 56)
+
+// Largest locals area of a synthetic frame
+#define FRAME_MAX_LOCALS 80
+
+// Relative slowdown --baseline tolerates in counts, which do not jitter
+#define COUNT_TOLERANCE 0.01
+
+typedef struct
+{
+    const char *mode;  // "synthetic", "e2e" or "all"
+    uint32_t threads;
+    uint32_t depth;
+    double change_rate;
+    uint32_t iterations;
+    uint32_t window;
+    uint32_t workers;
+    uint64_t seed;
+    uint32_t seconds;
+    uint32_t interval_ms;
+    const char *target_path;
+    const char *json_path;
+    const char *baseline_path;
+    double threshold;
+} BenchConfig;
+
+typedef struct
+{
+    std::string stage;
+    uint64_t samples;
+    uint64_t frames;
+    uint64_t locations;    // pprof only, in place of frames
+    uint64_t ns;
+    uint64_t syscalls;
+    uint64_t allocations;
+    uint64_t pause_p50_ns; // End to end only (0 elsewhere)
+    uint64_t pause_p99_ns;
+} StageResult;
+
+// MARK: - Allocation counting
+
+// Every allocation of the process; glibc's allocator can be wrapped
+// directly, elsewhere only operator new is seen
+static std::atomic<uint64_t> g_allocations{0};
+
+#if defined(__GLIBC__)
+#define ALLOCATION_COUNTER "malloc"
+
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *pointer, size_t size);
+
+    void *malloc(size_t size)
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *pointer, size_t size)
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        return __libc_realloc(pointer, size);
+    }
+}
+#else
+#define ALLOCATION_COUNTER "operator_new"
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *pointer = malloc(size ? size : 1);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    free(pointer);
+}
+#endif
+
+// MARK: - Timing
+
+// Helper: Get current time in nanoseconds
+static uint64_t get_timestamp_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Helper: CPU time of the whole process (every thread) in nanoseconds
+static uint64_t get_process_cpu_ns(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((uint64_t)usage.ru_utime.tv_sec + (uint64_t)usage.ru_stime.tv_sec) * 1000000000ULL +
+           ((uint64_t)usage.ru_utime.tv_usec + (uint64_t)usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+// Accumulates the time, allocations and platform calls of timed sections
+typedef struct
+{
+    const MemoryTarget *memory;
+    uint64_t start_ns;
+    uint64_t start_allocations;
+    uint64_t start_calls;
+} Section;
+
+static void section_begin(Section *section, const MemoryTarget *memory)
+{
+    section->memory = memory;
+    section->start_calls = memory ? memory_target_call_count(memory) : 0;
+    section->start_allocations = g_allocations.load(std::memory_order_relaxed);
+    section->start_ns = get_timestamp_ns();
+}
+
+static void section_end(Section *section, StageResult *result)
+{
+    result->ns += get_timestamp_ns() - section->start_ns;
+    result->allocations += g_allocations.load(std::memory_order_relaxed) - section->start_allocations;
+    if (section->memory)
+        result->syscalls += memory_target_call_count(section->memory) - section->start_calls;
+}
+
+// MARK: - Synthetic stacks
+
+// Helper: Deterministic pseudo-random numbers (xorshift64*)
+static uint64_t next_random(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+typedef struct
+{
+    uint64_t base;                // Lowest mapped address of the stack
+    std::vector<uint8_t> memory;  // Backs [base, base + memory.size())
+    std::vector<uint64_t> records; // Frame record addresses, outermost first
+    PlatformRegisters regs;
+    thread_t handle;
+} SyntheticThread;
+
+typedef struct
+{
+    MemoryTarget *memory;
+    std::vector<SyntheticThread> threads;
+    std::vector<thread_t> handles;
+    uint64_t random;
+    uint32_t depth;
+    double change_rate;
+} Workload;
+
+// Helper: A return address somewhere inside one of the synthetic functions
+static uint64_t random_code_address(uint64_t *random)
+{
+    uint64_t function = next_random(random) % CODE_FUNCTION_COUNT;
+    uint64_t offset = 4 * (1 + next_random(random) % (CODE_FUNCTION_SIZE / 4 - 1));
+    return CODE_BASE + function * CODE_FUNCTION_SIZE + offset;
+}
+
+// Helper: Store a 64-bit value into a synthetic stack
+static void poke(SyntheticThread *thread, uint64_t address, uint64_t value)
+{
+    memcpy(thread->memory.data() + (address - thread->base), &value, sizeof(value));
+}
+
+// Helper: Push frames until the stack is depth deep and point the registers at the innermost
+// A frame is a record (saved FP, return address) and up to
+// FRAME_MAX_LOCALS bytes of locals below it.
+static void push_frames(Workload *workload, SyntheticThread *thread)
+{
+    uint64_t top = thread->base + thread->memory.size();
+    uint64_t next = thread->records.empty() ? top - 64 : thread->records.back();
+
+    while (thread->records.size() < workload->depth)
+    {
+        uint64_t locals = 16 * (next_random(&workload->random) % (FRAME_MAX_LOCALS / 16 + 1));
+        uint64_t record = next - 16 - locals;
+        uint64_t saved_fp = thread->records.empty() ? 0 : thread->records.back();
+        poke(thread, record, saved_fp);
+        poke(thread, record + 8, random_code_address(&workload->random));
+        thread->records.push_back(record);
+        next = record;
+    }
+
+    thread->regs.fp = thread->records.back();
+    thread->regs.sp = thread->regs.fp - 16 * (next_random(&workload->random) % 4);
+    thread->regs.pc = random_code_address(&workload->random);
+    thread->regs.lr = 0;
+}
+
+// Helper: Build every thread's stack and map it into a fresh memory target
+static bool workload_init(Workload *workload, const BenchConfig *config)
+{
+    workload->memory = memory_target_create();
+    if (!workload->memory)
+        return false;
+
+    workload->random = config->seed ? config->seed : 1;
+    workload->depth = config->depth;
+    workload->change_rate = config->change_rate;
+    workload->threads.resize(config->threads);
+    workload->handles.resize(config->threads);
+
+    size_t stack_size = ((size_t)config->depth * (16 + FRAME_MAX_LOCALS) + 2 * 4096 + 4095) & ~(size_t)4095;
+    for (uint32_t i = 0; i < config->threads; i++)
+    {
+        SyntheticThread *thread = &workload->threads[i];
+        thread->base = STACK_BASE + i * STACK_SPACING;
+        thread->memory.assign(stack_size, 0);
+        push_frames(workload, thread);
+
+        if (memory_target_map(workload->memory, thread->base, thread->memory.data(), stack_size) != 0)
+            return false;
+        thread->handle = memory_target_add_thread(workload->memory, &thread->regs);
+        workload->handles[i] = thread->handle;
+    }
+    return true;
+}
+
+static void workload_destroy(Workload *workload)
+{
+    memory_target_destroy(workload->memory);
+    workload->memory = NULL;
+    workload->threads.clear();
+    workload->handles.clear();
+}
+
+// Helper: Move the threads on to their next sample
+// Each thread changes with probability change_rate; a change replaces 1
+// to depth / 4 innermost frames.
+static void workload_advance(Workload *workload)
+{
+    for (SyntheticThread &thread : workload->threads)
+    {
+        double roll = (double)(next_random(&workload->random) >> 11) / (double)(1ULL << 53);
+        if (roll >= workload->change_rate)
+            continue;
+
+        uint32_t most = workload->depth / 4 > 0 ? workload->depth / 4 : 1;
+        uint32_t popped = 1 + (uint32_t)(next_random(&workload->random) % most);
+        if (popped >= thread.records.size())
+            popped = (uint32_t)thread.records.size() - 1;
+        thread.records.resize(thread.records.size() - popped);
+
+        push_frames(workload, &thread);
+        memory_target_set_registers(workload->memory, thread.handle, &thread.regs);
+    }
+}
+
+// Helper: Walker configuration for the synthetic stages, capturing from memory targets
+static void init_walker(const BenchConfig *config, bool optimistic)
+{
+    StackWalkerConfig sw_config;
+    sw_config.strategy = STACK_WALK_FRAME_POINTER;
+    sw_config.max_depth = MAX_STACK_DEPTH;
+    sw_config.capture_timestamps = true;
+    sw_config.validate_addresses = false;
+    sw_config.capture_thread_ids = false;
+    sw_config.stack_window_size = config->window;
+    sw_config.capture_workers = config->workers;
+    sw_config.track_async = false;
+    sw_config.cache_suffixes = true;
+    sw_config.optimistic_capture = optimistic;
+    stack_walker_init(&sw_config);
+    stack_walker_set_target_ops(memory_target_ops());
+}
+
+// Helper: Count the frames of a batch
+// A thread that did not move counts the depth of its previous walk, as
+// the sampler does, so stages that skip walks compare with the walk stage.
+static uint64_t count_frames(const StackTrace *traces, uint32_t count, std::vector<uint32_t> &depths)
+{
+    uint64_t frames = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!traces[i].unchanged)
+            depths[i] = traces[i].frame_count;
+        frames += depths[i];
+    }
+    return frames;
+}
+
+// Helper: Keep the registers of each thread's walk for the next batch
+static void update_hints(const StackTrace *traces, uint32_t count, StackWalkOrigin *hints)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (traces[i].frame_count > 0 || traces[i].unchanged)
+            hints[i] = traces[i].origin;
+    }
+}
+
+// MARK: - Synthetic stages
+
+// Serial single-thread captures; every thread is walked every time
+static bool bench_walk(const BenchConfig *config, StageResult *result)
+{
+    Workload workload;
+    if (!workload_init(&workload, config))
+        return false;
+    init_walker(config, false);
+
+    StackFrameArena arena;
+    stack_frame_arena_init(&arena, MAX_STACK_DEPTH);
+    StackTrace trace;
+
+    for (uint32_t iteration = 0; iteration < config->iterations; iteration++)
+    {
+        for (uint32_t i = 0; i < config->threads; i++)
+        {
+            stack_frame_arena_reset(&arena);
+            Section section;
+            section_begin(&section, workload.memory);
+            stack_walker_capture(memory_target_task(workload.memory), workload.handles[i], &arena, &trace);
+            section_end(&section, result);
+            result->frames += trace.frame_count;
+        }
+        result->samples += config->threads;
+        workload_advance(&workload);
+    }
+
+    stack_frame_arena_destroy(&arena);
+    workload_destroy(&workload);
+    return true;
+}
+
+// Batch (or snapshot) captures with the previous walks as hints, so threads
+// that did not change are not walked
+static bool bench_batch(const BenchConfig *config, bool optimistic, bool snapshot, StageResult *result)
+{
+    Workload workload;
+    if (!workload_init(&workload, config))
+        return false;
+    init_walker(config, optimistic);
+
+    StackFrameArena arena;
+    stack_frame_arena_init(&arena, MAX_STACK_DEPTH * config->threads);
+    std::vector<StackTrace> traces(config->threads);
+    std::vector<StackWalkOrigin> hints(config->threads);
+    std::vector<uint32_t> depths(config->threads, 0);
+    memset(hints.data(), 0, hints.size() * sizeof(StackWalkOrigin));
+    task_t task = memory_target_task(workload.memory);
+
+    for (uint32_t iteration = 0; iteration < config->iterations; iteration++)
+    {
+        stack_frame_arena_reset(&arena);
+        Section section;
+        section_begin(&section, workload.memory);
+        if (snapshot)
+        {
+            uint64_t pause_ns;
+            stack_walker_capture_snapshot(task, workload.handles.data(), config->threads, hints.data(),
+                                          &arena, traces.data(), &pause_ns);
+        }
+        else
+        {
+            stack_walker_capture_batch(task, workload.handles.data(), config->threads, hints.data(),
+                                       &arena, traces.data());
+        }
+        section_end(&section, result);
+
+        result->samples += config->threads;
+        result->frames += count_frames(traces.data(), config->threads, depths);
+        update_hints(traces.data(), config->threads, hints.data());
+        workload_advance(&workload);
+    }
+
+    stack_frame_arena_destroy(&arena);
+    workload_destroy(&workload);
+    return true;
+}
+
+// Await chains of the async stage, one per shape
+enum
+{
+    ASYNC_CHAIN_LINEAR,    // Ends at a context without a parent
+    ASYNC_CHAIN_CYCLIC,    // The outermost context links back into the chain
+    ASYNC_CHAIN_TRUNCATED, // Links to a context the snapshot does not hold
+    ASYNC_CHAIN_COUNT
+};
+
+typedef struct
+{
+    const AsyncContextLayout *layout;
+    std::vector<uint8_t> contexts; // Backs ASYNC_CONTEXT_BASE
+    std::vector<uint8_t> stack;    // Backs ASYNC_STACK_BASE
+    AsyncMemoryRange ranges[2];
+    AsyncMemorySnapshot snapshot;
+    uint64_t frame_pointers[ASYNC_CHAIN_COUNT];
+    uint64_t first_contexts[ASYNC_CHAIN_COUNT];
+    std::vector<uint64_t> links[ASYNC_CHAIN_COUNT];   // Parent of each context (by index in the chain)
+    std::vector<uint64_t> resumes[ASYNC_CHAIN_COUNT]; // Continuation of each context, unsigned
+    uint32_t expected[ASYNC_CHAIN_COUNT];            // Entries the chain yields (cyclic: at least)
+} AsyncChains;
+
+// Helper: Store a 64-bit value into recorded memory
+static void poke_recorded(std::vector<uint8_t> &memory, uint64_t base, uint64_t address, uint64_t value)
+{
+    memcpy(memory.data() + (address - base), &value, sizeof(value));
+}
+
+// Helper: Record depth contexts per chain and a frame record pointing at each chain
+static bool async_chains_init(AsyncChains *chains, const BenchConfig *config)
+{
+    chains->layout = async_layout_for_version(0);
+    if (!chains->layout)
+        return false;
+
+    const AsyncContextLayout *layout = chains->layout;
+    uint32_t depth = config->depth < 4 ? 4 : config->depth;
+    uint32_t highest = layout->parent_offset > layout->resume_offset ? layout->parent_offset : layout->resume_offset;
+    uint64_t context_size = (highest + sizeof(uint64_t) + 15) & ~15ULL;
+    chains->contexts.assign((size_t)(context_size * depth * ASYNC_CHAIN_COUNT), 0);
+    chains->stack.assign(4096, 0);
+
+    uint64_t random = config->seed ? config->seed : 1;
+    for (uint32_t chain = 0; chain < ASYNC_CHAIN_COUNT; chain++)
+    {
+        uint64_t first = ASYNC_CONTEXT_BASE + (uint64_t)chain * depth * context_size;
+        chains->first_contexts[chain] = first;
+        chains->links[chain].assign(depth, 0);
+        chains->resumes[chain].assign(depth, 0);
+
+        for (uint32_t k = 0; k < depth; k++)
+        {
+            uint64_t context = first + k * context_size;
+            uint64_t parent = first + (k + 1) * context_size;
+            if (k + 1 == depth)
+            {
+                if (chain == ASYNC_CHAIN_CYCLIC)
+                    parent = first + (depth / 4) * context_size;
+                else
+                    parent = 0;
+            }
+            if (chain == ASYNC_CHAIN_TRUNCATED && k + 1 == depth / 2)
+                parent = ASYNC_UNMAPPED;
+
+            uint64_t resume = random_code_address(&random);
+            chains->links[chain][k] = parent;
+            chains->resumes[chain][k] = resume;
+            poke_recorded(chains->contexts, ASYNC_CONTEXT_BASE, context + layout->parent_offset, parent);
+            poke_recorded(chains->contexts, ASYNC_CONTEXT_BASE, context + layout->resume_offset,
+                          resume | ASYNC_SIGNATURE);
+        }
+
+        // An async frame record with its context in the slot below
+        uint64_t frame_pointer = ASYNC_STACK_BASE + 64 + chain * 64;
+        chains->frame_pointers[chain] = frame_pointer;
+        poke_recorded(chains->stack, ASYNC_STACK_BASE, frame_pointer - layout->context_slot, first);
+    }
+
+    chains->expected[ASYNC_CHAIN_LINEAR] = depth;
+    chains->expected[ASYNC_CHAIN_CYCLIC] = depth;
+    chains->expected[ASYNC_CHAIN_TRUNCATED] = depth / 2;
+
+    chains->ranges[0].address = ASYNC_CONTEXT_BASE;
+    chains->ranges[0].size = chains->contexts.size();
+    chains->ranges[0].data = chains->contexts.data();
+    chains->ranges[1].address = ASYNC_STACK_BASE;
+    chains->ranges[1].size = chains->stack.size();
+    chains->ranges[1].data = chains->stack.data();
+    chains->snapshot.ranges = chains->ranges;
+    chains->snapshot.range_count = 2;
+    return true;
+}
+
+// Helper: Whether an unwound chain matches the recorded one
+// Entries must follow the links from the first context; a linear or
+// truncated chain must yield exactly its contexts, a cyclic one must stop
+// after going round at least once but well before max_frames.
+static bool async_chain_matches(const AsyncChains *chains, uint32_t chain, uint64_t context,
+                                const uint64_t *frames, uint32_t count, uint32_t max_frames)
+{
+    if (context != chains->first_contexts[chain])
+    {
+        fprintf(stderr, "Error: async chain %u: context 0x%llx, expected 0x%llx\n", chain,
+                (unsigned long long)context, (unsigned long long)chains->first_contexts[chain]);
+        return false;
+    }
+
+    uint32_t expected = chains->expected[chain];
+    bool cyclic = chain == ASYNC_CHAIN_CYCLIC;
+    if (cyclic ? (count < expected || count >= max_frames) : count != expected)
+    {
+        fprintf(stderr, "Error: async chain %u: %u entries, expected %s%u\n", chain, count,
+                cyclic ? "at least " : "", expected);
+        return false;
+    }
+
+    uint64_t first = chains->first_contexts[chain];
+    uint64_t context_size = chains->links[chain].size() > 1 ? chains->links[chain][0] - first : 0;
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (frames[i] != chains->resumes[chain][index] + 1)
+        {
+            fprintf(stderr, "Error: async chain %u: entry %u is 0x%llx, expected 0x%llx\n", chain, i,
+                    (unsigned long long)frames[i], (unsigned long long)(chains->resumes[chain][index] + 1));
+            return false;
+        }
+        index = (uint32_t)((chains->links[chain][index] - first) / context_size);
+    }
+    return true;
+}
+
+// Await chains rebuilt from recorded memory (async_snapshot_read); every
+// chain is checked against what was recorded before it is timed
+static bool bench_async(const BenchConfig *config, StageResult *result)
+{
+    AsyncChains chains;
+    if (!async_chains_init(&chains, config))
+        return false;
+
+    // Room for a cyclic chain to go round several times before it is caught
+    const AsyncContextLayout *layout = chains.layout;
+    uint32_t max_frames = 4 * (uint32_t)chains.links[ASYNC_CHAIN_LINEAR].size();
+    std::vector<uint64_t> frames(max_frames);
+    for (uint32_t chain = 0; chain < ASYNC_CHAIN_COUNT; chain++)
+    {
+        uint64_t context = async_frame_context(layout, async_snapshot_read, &chains.snapshot,
+                                               chains.frame_pointers[chain]);
+        uint32_t count = async_unwind_chain(layout, async_snapshot_read, &chains.snapshot, context,
+                                            frames.data(), max_frames);
+        if (!async_chain_matches(&chains, chain, context, frames.data(), count, max_frames))
+            return false;
+    }
+
+    for (uint32_t iteration = 0; iteration < config->iterations; iteration++)
+    {
+        Section section;
+        section_begin(&section, NULL);
+        for (uint32_t chain = 0; chain < ASYNC_CHAIN_COUNT; chain++)
+        {
+            uint64_t context = async_frame_context(layout, async_snapshot_read, &chains.snapshot,
+                                                   chains.frame_pointers[chain]);
+            result->frames += async_unwind_chain(layout, async_snapshot_read, &chains.snapshot, context,
+                                                 frames.data(), max_frames);
+        }
+        section_end(&section, result);
+        result->samples += ASYNC_CHAIN_COUNT;
+    }
+    return true;
+}
+
+// A sample kept for the export stages
+typedef struct
+{
+    uint64_t timestamp_ns;
+    uint32_t thread_number;
+    uint32_t stack_id;
+} KeptSample;
+
+// Interning of batch captures (the captures themselves are not timed);
+// unchanged threads reuse their previous stack ID like the sampler does,
+// so only the frames actually interned count
+static bool bench_intern(const BenchConfig *config, StackTable *table, std::vector<KeptSample> &kept, StageResult *result)
+{
+    Workload workload;
+    if (!workload_init(&workload, config))
+        return false;
+    init_walker(config, false);
+
+    StackFrameArena arena;
+    stack_frame_arena_init(&arena, MAX_STACK_DEPTH * config->threads);
+    std::vector<StackTrace> traces(config->threads);
+    std::vector<StackWalkOrigin> hints(config->threads);
+    std::vector<uint32_t> stack_ids(config->threads, STACK_ID_EMPTY);
+    memset(hints.data(), 0, hints.size() * sizeof(StackWalkOrigin));
+    task_t task = memory_target_task(workload.memory);
+
+    for (uint32_t iteration = 0; iteration < config->iterations; iteration++)
+    {
+        stack_frame_arena_reset(&arena);
+        stack_walker_capture_batch(task, workload.handles.data(), config->threads, hints.data(),
+                                   &arena, traces.data());
+
+        Section section;
+        section_begin(&section, NULL);
+        for (uint32_t i = 0; i < config->threads; i++)
+        {
+            if (traces[i].frame_count > 0)
+            {
+                stack_ids[i] = stack_table_intern(table, stack_trace_frames(&arena, &traces[i]),
+                                                  traces[i].frame_count);
+                result->frames += traces[i].frame_count;
+            }
+        }
+        section_end(&section, result);
+
+        for (uint32_t i = 0; i < config->threads; i++)
+        {
+            KeptSample sample;
+            sample.timestamp_ns = traces[i].timestamp_ns;
+            sample.thread_number = i + 1;
+            sample.stack_id = stack_ids[i];
+            kept.push_back(sample);
+        }
+        result->samples += config->threads;
+        update_hints(traces.data(), config->threads, hints.data());
+        workload_advance(&workload);
+    }
+
+    stack_frame_arena_destroy(&arena);
+    workload_destroy(&workload);
+    return true;
+}
+
+// Writing the interned samples to a recording
+static bool bench_record(const BenchConfig *config, const StackTable *table, const std::vector<KeptSample> &kept,
+                         const char *path, StageResult *result)
+{
+    std::vector<uint64_t> addresses(MAX_STACK_DEPTH);
+
+    Section section;
+    section_begin(&section, NULL);
+    RecordingWriter *writer = recording_writer_create(path, 0, 1000, NULL, NULL);
+    if (!writer)
+    {
+        fprintf(stderr, "Error: Could not create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    for (uint32_t i = 0; i < config->threads; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "synthetic-%u", i + 1);
+        recording_writer_define_thread(writer, i + 1, i + 1, name);
+    }
+
+    int error = 0;
+    for (const KeptSample &sample : kept)
+    {
+        if (!recording_writer_has_stack(writer, sample.stack_id))
+        {
+            uint32_t depth = stack_table_get(table, sample.stack_id, addresses.data(), MAX_STACK_DEPTH);
+            recording_writer_define_stack(writer, sample.stack_id, addresses.data(), depth);
+            result->frames += depth;
+        }
+        if (error == 0)
+        {
+            error = recording_writer_add_sample(writer, sample.timestamp_ns, sample.thread_number,
+                                                sample.stack_id, RECORDING_RUN_STATE_UNKNOWN, 0);
+        }
+    }
+
+    int close_error = recording_writer_close(writer);
+    section_end(&section, result);
+    result->samples = kept.size();
+
+    if (error != 0 || close_error != 0)
+    {
+        fprintf(stderr, "Error: Could not write %s: %s\n", path, strerror(error ? error : close_error));
+        return false;
+    }
+    return true;
+}
+
+// Converting that recording to pprof
+static bool bench_pprof(const char *recording_path, const char *output_path, StageResult *result)
+{
+    PprofExportStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    Section section;
+    section_begin(&section, NULL);
+    int error = pprof_export_recording(recording_path, output_path, NULL, &stats);
+    section_end(&section, result);
+
+    if (error != 0)
+    {
+        fprintf(stderr, "Error: pprof export failed: %d\n", error);
+        return false;
+    }
+    result->samples = stats.samples;
+    result->locations = stats.locations;
+    return true;
+}
+
+static bool run_synthetic(const BenchConfig *config, std::vector<StageResult> &results)
+{
+    StageResult result;
+
+    result = StageResult{"walk", 0, 0, 0, 0, 0, 0, 0, 0};
+    if (!bench_walk(config, &result))
+        return false;
+    results.push_back(result);
+
+    result = StageResult{"batch", 0, 0, 0, 0, 0, 0, 0, 0};
+    if (!bench_batch(config, false, false, &result))
+        return false;
+    results.push_back(result);
+
+    result = StageResult{"batch_optimistic", 0, 0, 0, 0, 0, 0, 0, 0};
+    if (!bench_batch(config, true, false, &result))
+        return false;
+    results.push_back(result);
+
+    result = StageResult{"snapshot", 0, 0, 0, 0, 0, 0, 0, 0};
+    if (!bench_batch(config, false, true, &result))
+        return false;
+    results.push_back(result);
+
+    result = StageResult{"async_chain", 0, 0, 0, 0, 0, 0, 0, 0};
+    if (!bench_async(config, &result))
+        return false;
+    results.push_back(result);
+
+    StackTable *table = stack_table_create();
+    if (!table)
+        return false;
+    std::vector<KeptSample> kept;
+    result = StageResult{"intern", 0, 0, 0, 0, 0, 0, 0, 0};
+    bool ok = bench_intern(config, table, kept, &result);
+    if (ok)
+        results.push_back(result);
+
+    const char *directory = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char recording_path[PATH_MAX];
+    char pprof_path[PATH_MAX];
+    snprintf(recording_path, sizeof(recording_path), "%s/profiler-bench-%d.prof", directory, (int)getpid());
+    snprintf(pprof_path, sizeof(pprof_path), "%s/profiler-bench-%d.pb.gz", directory, (int)getpid());
+
+    result = StageResult{"record", 0, 0, 0, 0, 0, 0, 0, 0};
+    ok = ok && bench_record(config, table, kept, recording_path, &result);
+    if (ok)
+        results.push_back(result);
+
+    result = StageResult{"pprof", 0, 0, 0, 0, 0, 0, 0, 0};
+    ok = ok && bench_pprof(recording_path, pprof_path, &result);
+    if (ok)
+        results.push_back(result);
+
+    unlink(recording_path);
+    unlink(pprof_path);
+    stack_table_destroy(table);
+    stack_walker_cleanup();
+    return ok;
+}
+
+// MARK: - End to end
+
+// Helper: Default fixture: test-target next to this executable
+static std::string default_target_path(const char *argv0)
+{
+    std::string path = argv0;
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? "test-target" : path.substr(0, slash + 1) + "test-target";
+}
+
+// Helper: Start the fixture with its output discarded
+static pid_t spawn_target(const char *path)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    char *argv[] = {(char *)path, NULL};
+    pid_t pid = 0;
+    int error = posix_spawn(&pid, path, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error != 0)
+    {
+        fprintf(stderr, "Error: Could not start %s: %s\n", path, strerror(error));
+        return 0;
+    }
+    return pid;
+}
+
+// Sampling the fixture through the real platform layer; times are the
+// CPU time of this process (mostly the sampler thread)
+static bool run_end_to_end(const BenchConfig *config, StageResult *result)
+{
+    pid_t pid = spawn_target(config->target_path);
+    if (pid == 0)
+        return false;
+
+    // Let its threads start
+    usleep(1000000);
+
+    ProfilerConfig profiler_config = profiler_default_config();
+    profiler_config.sample_interval_ms = config->interval_ms;
+    profiler_config.sample_buffer_size = PROFILER_RECORDING_BUFFER_SIZE;
+
+    ProfilerTarget target;
+    bool ok = profiler_attach(pid, &profiler_config, &target) == 0 &&
+              profiler_refresh_threads(&target) == 0;
+
+    if (ok)
+    {
+        std::vector<ProfilerSample> samples(PROFILER_RECORDING_BUFFER_SIZE);
+        uint64_t start_cpu = get_process_cpu_ns();
+        uint64_t start_allocations = g_allocations.load(std::memory_order_relaxed);
+        uint64_t end = get_timestamp_ns() + (uint64_t)config->seconds * 1000000000ULL;
+
+        ok = profiler_start_sampling(&target) == 0;
+        while (ok && get_timestamp_ns() < end)
+        {
+            usleep(50000);
+            uint32_t count = 0;
+            profiler_poll_samples(&target, samples.data(), (uint32_t)samples.size(), &count);
+        }
+        if (ok)
+            profiler_stop_sampling(&target);
+
+        result->ns = get_process_cpu_ns() - start_cpu;
+        result->allocations = g_allocations.load(std::memory_order_relaxed) - start_allocations;
+
+        ProfilerStats stats;
+        profiler_get_stats(&target, &stats);
+        result->samples = stats.total_samples;
+        result->frames = stats.total_frames;
+        result->syscalls = stats.kernel_calls;
+
+        HistogramSummary pause;
+        profiler_get_metric(&target, PROFILER_METRIC_PAUSE_NS, &pause);
+        result->pause_p50_ns = pause.p50;
+        result->pause_p99_ns = pause.p99;
+
+        profiler_detach(&target);
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return ok && result->samples > 0;
+}
+
+// MARK: - Reporting
+
+// Helper: value / count, 0 for no count
+static double per(uint64_t value, uint64_t count)
+{
+    return count > 0 ? (double)value / (double)count : 0.0;
+}
+
+static void print_table(const std::vector<StageResult> &results)
+{
+    printf("%-18s %10s %12s %10s %12s %16s %14s\n",
+           "stage", "samples", "frames", "ns/frame", "ns/sample", "syscalls/sample", "allocs/sample");
+    for (const StageResult &result : results)
+    {
+        if (result.locations > 0)
+        {
+            // Locations are not frames; they are listed below the table
+            printf("%-18s %10llu %12s %10s %12.1f %16.3f %14.3f\n",
+                   result.stage.c_str(),
+                   (unsigned long long)result.samples,
+                   "-", "-",
+                   per(result.ns, result.samples),
+                   per(result.syscalls, result.samples),
+                   per(result.allocations, result.samples));
+            continue;
+        }
+        printf("%-18s %10llu %12llu %10.1f %12.1f %16.3f %14.3f\n",
+               result.stage.c_str(),
+               (unsigned long long)result.samples,
+               (unsigned long long)result.frames,
+               per(result.ns, result.frames),
+               per(result.ns, result.samples),
+               per(result.syscalls, result.samples),
+               per(result.allocations, result.samples));
+    }
+    for (const StageResult &result : results)
+    {
+        if (result.locations > 0)
+        {
+            printf("%s: %llu locations, %.1f ns/location\n", result.stage.c_str(),
+                   (unsigned long long)result.locations, per(result.ns, result.locations));
+        }
+    }
+}
+
+// Results go one per line, which is what read_baseline expects
+static int write_json(const BenchConfig *config, const std::vector<StageResult> &results, const char *path)
+{
+    FILE *file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!file)
+        return errno;
+
+#if defined(__APPLE__)
+    const char *platform = "mach";
+#else
+    const char *platform = "linux";
+#endif
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"schema\": 1,\n");
+    fprintf(file, "  \"platform\": \"%s\",\n", platform);
+    fprintf(file, "  \"allocation_counter\": \"%s\",\n", ALLOCATION_COUNTER);
+    fprintf(file,
+            "  \"config\": {\"mode\": \"%s\", \"threads\": %u, \"depth\": %u, \"change_rate\": %.4f, "
+            "\"iterations\": %u, \"window\": %u, \"workers\": %u, \"seed\": %llu, \"seconds\": %u, "
+            "\"interval_ms\": %u},\n",
+            config->mode, config->threads, config->depth, config->change_rate, config->iterations,
+            config->window, config->workers, (unsigned long long)config->seed, config->seconds,
+            config->interval_ms);
+    fprintf(file, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const StageResult &result = results[i];
+        bool locations = result.locations > 0;
+        uint64_t items = locations ? result.locations : result.frames;
+        fprintf(file,
+                "    {\"stage\": \"%s\", \"samples\": %llu, \"%s\": %llu, \"ns\": %llu, "
+                "\"%s\": %.3f, \"ns_per_thread_sample\": %.3f, \"syscalls_per_sample\": %.4f, "
+                "\"allocations_per_sample\": %.4f",
+                result.stage.c_str(),
+                (unsigned long long)result.samples,
+                locations ? "locations" : "frames",
+                (unsigned long long)items,
+                (unsigned long long)result.ns,
+                locations ? "ns_per_location" : "ns_per_frame",
+                per(result.ns, items),
+                per(result.ns, result.samples),
+                per(result.syscalls, result.samples),
+                per(result.allocations, result.samples));
+        if (result.pause_p50_ns > 0)
+        {
+            fprintf(file, ", \"pause_p50_ns\": %llu, \"pause_p99_ns\": %llu",
+                    (unsigned long long)result.pause_p50_ns, (unsigned long long)result.pause_p99_ns);
+        }
+        fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    if (file != stdout && fclose(file) != 0)
+        return errno;
+    return 0;
+}
+
+// One stage of an earlier run
+typedef struct
+{
+    std::string stage;
+    double ns_per_thread_sample;
+    double syscalls_per_sample;
+    double allocations_per_sample;
+} BaselineEntry;
+
+// Helper: Number following "key": on a line (0 if absent)
+static double json_number(const char *line, const char *key)
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *found = strstr(line, pattern);
+    return found ? strtod(found + strlen(pattern), NULL) : 0.0;
+}
+
+// Helper: Read the results of a file written by write_json
+static bool read_baseline(const char *path, std::vector<BaselineEntry> &entries)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file))
+    {
+        const char *stage = strstr(line, "\"stage\": \"");
+        if (!stage)
+            continue;
+        stage += strlen("\"stage\": \"");
+        const char *end = strchr(stage, '"');
+        if (!end)
+            continue;
+
+        BaselineEntry entry;
+        entry.stage.assign(stage, end - stage);
+        entry.ns_per_thread_sample = json_number(line, "ns_per_thread_sample");
+        entry.syscalls_per_sample = json_number(line, "syscalls_per_sample");
+        entry.allocations_per_sample = json_number(line, "allocations_per_sample");
+        entries.push_back(entry);
+    }
+    fclose(file);
+    return true;
+}
+
+// Helper: Whether current is worse than baseline by more than tolerance
+static bool regressed(double baseline, double current, double tolerance)
+{
+    return current > baseline * (1.0 + tolerance) && current - baseline > 1e-9;
+}
+
+// Compare with an earlier run; time may vary by threshold percent, counts
+// by COUNT_TOLERANCE
+// Returns the number of stages that regressed.
+static int compare_baseline(const BenchConfig *config, const std::vector<StageResult> &results)
+{
+    std::vector<BaselineEntry> baseline;
+    if (!read_baseline(config->baseline_path, baseline))
+    {
+        fprintf(stderr, "Error: Could not read baseline %s\n", config->baseline_path);
+        return -1;
+    }
+
+    printf("\nAgainst %s (threshold %.1f%%):\n", config->baseline_path, config->threshold);
+    int regressions = 0;
+    for (const StageResult &result : results)
+    {
+        const BaselineEntry *entry = NULL;
+        for (const BaselineEntry &candidate : baseline)
+        {
+            if (candidate.stage == result.stage)
+                entry = &candidate;
+        }
+        if (!entry)
+        {
+            printf("  %-18s not in baseline\n", result.stage.c_str());
+            continue;
+        }
+
+        double ns = per(result.ns, result.samples);
+        double syscalls = per(result.syscalls, result.samples);
+        double allocations = per(result.allocations, result.samples);
+        bool slower = regressed(entry->ns_per_thread_sample, ns, config->threshold / 100.0);
+        bool more_calls = regressed(entry->syscalls_per_sample, syscalls, COUNT_TOLERANCE);
+        bool more_allocations = regressed(entry->allocations_per_sample, allocations, COUNT_TOLERANCE);
+
+        double change = entry->ns_per_thread_sample > 0 ? (ns / entry->ns_per_thread_sample - 1.0) * 100.0 : 0.0;
+        printf("  %-18s %10.1f -> %10.1f ns/sample (%+.1f%%)%s%s%s\n",
+               result.stage.c_str(), entry->ns_per_thread_sample, ns, change,
+               slower ? " SLOWER" : "",
+               more_calls ? " MORE-SYSCALLS" : "",
+               more_allocations ? " MORE-ALLOCATIONS" : "");
+        if (slower || more_calls || more_allocations)
+            regressions++;
+    }
+    return regressions;
+}
+
+// MARK: - Main
+
+static void print_usage(void)
+{
+    printf("Usage: profiler-bench [options]\n"
+           "\n"
+           "Options:\n"
+           "  --mode M            synthetic, e2e or all (default: synthetic)\n"
+           "  --threads N         Synthetic threads (default: 16)\n"
+           "  --depth N           Frames per synthetic stack (default: 64)\n"
+           "  --change-rate F     Share of threads whose stack changes between samples (default: 0.1)\n"
+           "  --iterations N      Samples per thread and stage (default: 2000)\n"
+           "  --window BYTES      Stack bytes copied from SP (default: %u)\n"
+           "  --workers N         Batch capture workers (default: %u)\n"
+           "  --seed N            Seed of the synthetic stacks (default: 1)\n"
+           "  --seconds N         End-to-end sampling time (default: 5)\n"
+           "  --interval MS       End-to-end sampling interval (default: 1)\n"
+           "  --target PATH       Fixture to sample end to end (default: test-target next to this binary)\n"
+           "  --json PATH         Write the results as JSON (- for stdout)\n"
+           "  --baseline PATH     Compare with an earlier --json file; exit 1 on a regression\n"
+           "  --threshold PCT     Slowdown tolerated by --baseline (default: 10)\n",
+           STACK_WINDOW_DEFAULT_SIZE, STACK_WALKER_DEFAULT_WORKERS);
+}
+
+int main(int argc, char **argv)
+{
+    std::string target_path = default_target_path(argv[0]);
+
+    BenchConfig config;
+    config.mode = "synthetic";
+    config.threads = 16;
+    config.depth = 64;
+    config.change_rate = 0.1;
+    config.iterations = 2000;
+    config.window = STACK_WINDOW_DEFAULT_SIZE;
+    config.workers = STACK_WALKER_DEFAULT_WORKERS;
+    config.seed = 1;
+    config.seconds = 5;
+    config.interval_ms = 1;
+    config.target_path = target_path.c_str();
+    config.json_path = NULL;
+    config.baseline_path = NULL;
+    config.threshold = 10.0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        bool takes_value = true;
+
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+        {
+            print_usage();
+            return 0;
+        }
+        else if (!value)
+        {
+            fprintf(stderr, "Error: Unknown option or missing value: %s\n", arg);
+            return 2;
+        }
+        else if (strcmp(arg, "--mode") == 0)
+            config.mode = value;
+        else if (strcmp(arg, "--threads") == 0)
+            config.threads = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--depth") == 0)
+            config.depth = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--change-rate") == 0)
+            config.change_rate = strtod(value, NULL);
+        else if (strcmp(arg, "--iterations") == 0)
+            config.iterations = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--window") == 0)
+            config.window = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--workers") == 0)
+            config.workers = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--seed") == 0)
+            config.seed = strtoull(value, NULL, 10);
+        else if (strcmp(arg, "--seconds") == 0)
+            config.seconds = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--interval") == 0)
+            config.interval_ms = (uint32_t)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--target") == 0)
+            config.target_path = value;
+        else if (strcmp(arg, "--json") == 0)
+            config.json_path = value;
+        else if (strcmp(arg, "--baseline") == 0)
+            config.baseline_path = value;
+        else if (strcmp(arg, "--threshold") == 0)
+            config.threshold = strtod(value, NULL);
+        else
+            takes_value = false;
+
+        if (!takes_value)
+        {
+            fprintf(stderr, "Error: Unknown option: %s\n", arg);
+            return 2;
+        }
+        i++;
+    }
+
+    bool synthetic = strcmp(config.mode, "synthetic") == 0 || strcmp(config.mode, "all") == 0;
+    bool end_to_end = strcmp(config.mode, "e2e") == 0 || strcmp(config.mode, "all") == 0;
+    if ((!synthetic && !end_to_end) || config.threads == 0 || config.depth == 0 ||
+        config.depth > MAX_STACK_DEPTH || config.iterations == 0 || config.interval_ms == 0)
+    {
+        fprintf(stderr, "Error: Invalid configuration (see --help)\n");
+        return 2;
+    }
+
+    std::vector<StageResult> results;
+    if (synthetic && !run_synthetic(&config, results))
+    {
+        fprintf(stderr, "Error: Synthetic benchmark failed\n");
+        return 1;
+    }
+
+    if (end_to_end)
+    {
+        StageResult result = StageResult{"end_to_end", 0, 0, 0, 0, 0, 0, 0, 0};
+        if (!run_end_to_end(&config, &result))
+        {
+            fprintf(stderr, "Error: End-to-end benchmark against %s failed\n", config.target_path);
+            return 1;
+        }
+        results.push_back(result);
+    }
+
+    bool json_to_stdout = config.json_path && strcmp(config.json_path, "-") == 0;
+    if (!json_to_stdout)
+        print_table(results);
+
+    if (config.json_path)
+    {
+        int error = write_json(&config, results, config.json_path);
+        if (error != 0)
+        {
+            fprintf(stderr, "Error: Could not write %s: %s\n", config.json_path, strerror(error));
+            return 1;
+        }
+    }
+
+    if (config.baseline_path)
+    {
+        int regressions = compare_baseline(&config, results);
+        if (regressions != 0)
+            return 1;
+    }
+    return 0;
+}
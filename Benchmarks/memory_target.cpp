@@ -0,0 +1,241 @@
+#include "memory_target.h"
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#define MEMORY_TARGET_MAX 64
+
+typedef struct
+{
+    uint64_t address;
+    uint64_t size;
+    const uint8_t *data;
+} MemoryRange;
+
+struct MemoryTarget
+{
+    uint32_t slot;
+    std::vector<MemoryRange> ranges;         // Sorted by address, not overlapping
+    std::vector<PlatformRegisters> threads;  // Thread handle = index + 1
+    std::atomic<uint64_t> calls;
+};
+
+// Live targets by slot; a slot is looked up without the lock, which only
+// guards creation and destruction
+static MemoryTarget *g_targets[MEMORY_TARGET_MAX];
+static pthread_mutex_t g_targets_lock = PTHREAD_MUTEX_INITIALIZER;
+
+MemoryTarget *memory_target_create(void)
+{
+    MemoryTarget *target = new (std::nothrow) MemoryTarget();
+    if (!target)
+        return NULL;
+    target->calls.store(0, std::memory_order_relaxed);
+
+    pthread_mutex_lock(&g_targets_lock);
+    uint32_t slot = 0;
+    while (slot < MEMORY_TARGET_MAX && g_targets[slot] != NULL)
+        slot++;
+    if (slot < MEMORY_TARGET_MAX)
+    {
+        target->slot = slot;
+        g_targets[slot] = target;
+    }
+    pthread_mutex_unlock(&g_targets_lock);
+
+    if (slot == MEMORY_TARGET_MAX)
+    {
+        delete target;
+        return NULL;
+    }
+    return target;
+}
+
+void memory_target_destroy(MemoryTarget *target)
+{
+    if (!target)
+        return;
+
+    pthread_mutex_lock(&g_targets_lock);
+    g_targets[target->slot] = NULL;
+    pthread_mutex_unlock(&g_targets_lock);
+    delete target;
+}
+
+task_t memory_target_task(const MemoryTarget *target)
+{
+    return target->slot + 1;
+}
+
+int memory_target_map(MemoryTarget *target, uint64_t address, const void *data, uint64_t size)
+{
+    if (size == 0 || address + size < address)
+        return EINVAL;
+
+    size_t index = 0;
+    while (index < target->ranges.size() && target->ranges[index].address < address)
+        index++;
+
+    if (index > 0)
+    {
+        const MemoryRange &before = target->ranges[index - 1];
+        if (before.address + before.size > address)
+            return EINVAL;
+    }
+    if (index < target->ranges.size() && target->ranges[index].address < address + size)
+        return EINVAL;
+
+    MemoryRange range;
+    range.address = address;
+    range.size = size;
+    range.data = (const uint8_t *)data;
+    target->ranges.insert(target->ranges.begin() + index, range);
+    return 0;
+}
+
+thread_t memory_target_add_thread(MemoryTarget *target, const PlatformRegisters *regs)
+{
+    target->threads.push_back(*regs);
+    return (thread_t)target->threads.size();
+}
+
+int memory_target_set_registers(MemoryTarget *target, thread_t thread, const PlatformRegisters *regs)
+{
+    if (thread == 0 || thread > target->threads.size())
+        return ESRCH;
+
+    target->threads[thread - 1] = *regs;
+    return 0;
+}
+
+uint64_t memory_target_call_count(const MemoryTarget *target)
+{
+    return target->calls.load(std::memory_order_relaxed);
+}
+
+// Helper: Target of a task handle, counting the call it serves
+static MemoryTarget *serve(task_t task)
+{
+    if (task == 0 || task > MEMORY_TARGET_MAX)
+        return NULL;
+
+    MemoryTarget *target = g_targets[task - 1];
+    if (target)
+        target->calls.fetch_add(1, std::memory_order_relaxed);
+    return target;
+}
+
+// Helper: Whether a target has a thread
+static bool has_thread(const MemoryTarget *target, thread_t thread)
+{
+    return thread != 0 && thread <= target->threads.size();
+}
+
+// Helper: Copy [address, address + size) if one range holds all of it
+static bool copy_range(const MemoryTarget *target, uint64_t address, void *buffer, size_t size)
+{
+    // Last range starting at or below address
+    size_t low = 0;
+    size_t high = target->ranges.size();
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (target->ranges[mid].address <= address)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == 0)
+        return false;
+
+    const MemoryRange *range = &target->ranges[low - 1];
+    uint64_t offset = address - range->address;
+    if (offset > range->size || size > range->size - offset)
+        return false;
+
+    memcpy(buffer, range->data + offset, size);
+    return true;
+}
+
+static int memory_target_thread_suspend(task_t task, thread_t thread)
+{
+    MemoryTarget *target = serve(task);
+    return target && has_thread(target, thread) ? 0 : ESRCH;
+}
+
+static int memory_target_thread_resume(task_t task, thread_t thread)
+{
+    return memory_target_thread_suspend(task, thread);
+}
+
+static int memory_target_task_suspend(task_t task, const thread_t *threads, mach_msg_type_number_t count, bool *stopped)
+{
+    MemoryTarget *target = serve(task);
+    if (!target)
+        return ESRCH;
+
+    for (mach_msg_type_number_t i = 0; i < count; i++)
+        stopped[i] = has_thread(target, threads[i]);
+    return 0;
+}
+
+static int memory_target_task_resume(task_t task, const thread_t *threads, mach_msg_type_number_t count,
+                                     const bool *stopped)
+{
+    (void)threads;
+    (void)count;
+    (void)stopped;
+    return serve(task) ? 0 : ESRCH;
+}
+
+static int memory_target_get_registers(task_t task, thread_t thread, PlatformRegisters *regs)
+{
+    MemoryTarget *target = serve(task);
+    if (!target || !has_thread(target, thread))
+        return ESRCH;
+
+    *regs = target->threads[thread - 1];
+    return 0;
+}
+
+static int memory_target_read(task_t task, uint64_t address, void *buffer, size_t size)
+{
+    MemoryTarget *target = serve(task);
+    if (!target)
+        return ESRCH;
+    return copy_range(target, address, buffer, size) ? 0 : EFAULT;
+}
+
+static size_t memory_target_read_batch(task_t task, const PlatformReadRequest *requests, size_t count)
+{
+    MemoryTarget *target = serve(task);
+    if (!target)
+        return 0;
+
+    // Like process_vm_readv: the first range that cannot be read ends the batch
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!copy_range(target, requests[i].address, requests[i].buffer, requests[i].size))
+            return i;
+    }
+    return count;
+}
+
+static const StackWalkerTargetOps g_memory_target_ops = {
+    memory_target_thread_suspend,
+    memory_target_thread_resume,
+    memory_target_task_suspend,
+    memory_target_task_resume,
+    memory_target_get_registers,
+    memory_target_get_registers, // Every thread is stopped; a peek reads the same registers
+    memory_target_read,
+    memory_target_read_batch,
+};
+
+const StackWalkerTargetOps *memory_target_ops(void)
+{
+    return &g_memory_target_ops;
+}
@@ -0,0 +1,79 @@
+#ifndef MEMORY_TARGET_H
+#define MEMORY_TARGET_H
+
+#include "stack_walker.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // In-memory target processes
+    //
+    // A memory target stands in for a process. Its target calls (see
+    // memory_target_ops) serve what the stack walker asks of its task
+    // (thread and task suspend and resume, registers and memory reads) from
+    // registers and buffers the caller set up in its own address space, so
+    // the walker and the capture pipeline run deterministically and without
+    // a kernel in the loop. Suspends and resumes only count; every call is
+    // counted as the kernel call it stands for.
+    //
+    // Set up threads and memory before capturing and change them only
+    // between captures: walker threads read them without locks.
+
+    typedef struct MemoryTarget MemoryTarget;
+
+    /**
+     * Create a target with no threads and no memory
+     * @return The target, or NULL if too many exist already
+     */
+    MemoryTarget *memory_target_create(void);
+
+    /**
+     * Destroy a target (its task handle becomes invalid)
+     */
+    void memory_target_destroy(MemoryTarget *target);
+
+    /**
+     * Task handle to capture from
+     */
+    task_t memory_target_task(const MemoryTarget *target);
+
+    /**
+     * Back [address, address + size) of the target with data
+     * The data is not copied: keep it alive while the target exists. A
+     * read must lie within one mapped range.
+     *
+     * @return 0 on success, EINVAL if the range is empty or overlaps a mapped one
+     */
+    int memory_target_map(MemoryTarget *target, uint64_t address, const void *data, uint64_t size);
+
+    /**
+     * Add a thread
+     * @return Its handle (also its thread ID), or 0 if it could not be added
+     */
+    thread_t memory_target_add_thread(MemoryTarget *target, const PlatformRegisters *regs);
+
+    /**
+     * Move a thread
+     * @return 0 on success, ESRCH if the target has no such thread
+     */
+    int memory_target_set_registers(MemoryTarget *target, thread_t thread, const PlatformRegisters *regs);
+
+    /**
+     * Platform calls served so far
+     */
+    uint64_t memory_target_call_count(const MemoryTarget *target);
+
+    /**
+     * Target calls that serve memory target tasks, for stack_walker_set_target_ops
+     * They serve no other task.
+     */
+    const StackWalkerTargetOps *memory_target_ops(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEMORY_TARGET_H
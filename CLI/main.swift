@@ -3,6 +3,8 @@ import SwiftBridge
 
 @main
 struct ProfilerCLI {
+    static let sampleIntervalMs: UInt32 = 10
+    
     static func main() {
         // Parse command line arguments
         guard CommandLine.arguments.count > 1 else {
@@ -10,6 +12,16 @@ struct ProfilerCLI {
             exit(1)
         }
         
+        // Offline commands work on files and need no process
+        if CommandLine.arguments[1] == "export" {
+            exportRecording()
+            return
+        }
+        if CommandLine.arguments[1] == "diff" {
+            diffRecordings()
+            return
+        }
+        
         guard let pid = Int32(CommandLine.arguments[1]) else {
             print("Error: Invalid PID")
             exit(1)
@@ -31,10 +43,13 @@ struct ProfilerCLI {
         do {
             // Configure profiler
             let config = Profiler.Config(
-                sampleIntervalMs: 10,
+                sampleIntervalMs: sampleIntervalMs,
                 maxStackDepth: 64,
-                trackAsync: false,
-                stackStrategy: .framePointer
+                trackAsync: CommandLine.arguments.contains("--async"),
+                stackStrategy: .framePointer,
+                snapshotMode: CommandLine.arguments.contains("--snapshot"),
+                samplingMode: CommandLine.arguments.contains("--cpu") ? .cpu : .wallClock,
+                optimisticCapture: CommandLine.arguments.contains("--optimistic")
             )
             
             // Attach
@@ -44,6 +59,7 @@ struct ProfilerCLI {
             // Get threads
             print("Discovering threads...")
             try profiler.refreshThreads()
+            print("Found \(profiler.threadCount) thread(s)")
             
             // Execute command
             try executeCommand(command, profiler: profiler)
@@ -77,6 +93,10 @@ struct ProfilerCLI {
             
             for (index, trace) in traces.enumerated() {
                 print("[\(index)] \(trace.description)")
+                if let info = profiler.threadInfo(number: trace.thread_number),
+                   !info.name.isEmpty || !info.queueLabel.isEmpty {
+                    print("  Name: \(info.name)\(info.queueLabel.isEmpty ? "" : " (queue: \(info.queueLabel))")")
+                }
                 profiler.printStackTrace(trace)
             }
             
@@ -96,22 +116,116 @@ struct ProfilerCLI {
             let trace = try profiler.captureStack(forThreadAt: threadIndex)
             profiler.printStackTrace(trace)
             
+        case "record":
+            // Sample for N seconds into a binary recording
+            guard let outputIndex = CommandLine.arguments.firstIndex(of: "-o"),
+                  outputIndex + 1 < CommandLine.arguments.count else {
+                print("Error: Please specify an output file")
+                print("Usage: profiler <pid> record [seconds] -o <file>")
+                exit(1)
+            }
+            let path = CommandLine.arguments[outputIndex + 1]
+            let seconds = CommandLine.arguments.count > 3 ? Double(CommandLine.arguments[3]) ?? 10 : 10
+            
+            print("\n=== Recording \(String(format: "%.0f", seconds))s @ \(sampleIntervalMs)ms to \(path) ===\n")
+            try profiler.startRecording(to: path)
+            
+            let end = Date().addingTimeInterval(seconds)
+            while Date() < end {
+                Thread.sleep(forTimeInterval: min(1.0, max(0, end.timeIntervalSinceNow)))
+                let stats = profiler.getStats()
+                print("  \(stats.recordedSamples) samples, \(stats.recordedBytes / 1024) KB")
+            }
+            try profiler.stopRecording()
+            
+            let stats = profiler.getStats()
+            let perMinute = Double(stats.recordedBytes) / max(seconds, 1) * 60 / (1024 * 1024)
+            print("  Wrote \(stats.recordedSamples) samples, \(stats.recordedBytes) bytes (\(String(format: "%.2f", perMinute)) MB/min)")
+            
         case "sample":
-            // Quick test: capture stacks multiple times
+            // Sample N ticks at the configured interval on the Core sampler thread
             let iterations = CommandLine.arguments.count > 3 ? Int(CommandLine.arguments[3]) ?? 5 : 5
+            let duration = Double(iterations) * Double(sampleIntervalMs) / 1000.0
+            
+            print("\n=== Sampling (x\(iterations) @ \(sampleIntervalMs)ms) ===\n")
+            
+            // Every thread seen by the initial refresh was reported as created;
+            // only what changes while sampling is of interest here
+            _ = try profiler.pollThreadEvents(maxEvents: 4096)
+            
+            var samples: [ProfilerSample] = []
+            let end = Date().addingTimeInterval(duration)
+            try profiler.startSampling()
+            while Date() < end {
+                // Drain regularly so the sample buffer never fills up
+                Thread.sleep(forTimeInterval: min(0.05, max(0, end.timeIntervalSinceNow)))
+                samples += try profiler.pollSamples()
+            }
+            try profiler.stopSampling()
+            
+            while true {
+                let batch = try profiler.pollSamples()
+                if batch.isEmpty { break }
+                samples += batch
+            }
             
-            print("\n=== Sampling (x\(iterations)) ===\n")
-            
-            for i in 1...iterations {
-                print("Sample \(i)/\(iterations)...")
-                let traces = try profiler.captureAllStacks()
-                
-                // Just show summary for each sample
-                let totalFrames = traces.reduce(0) { $0 + Int($1.frame_count) }
-                print("  Captured \(traces.count) threads, \(totalFrames) frames")
-                
-                if i < iterations {
-                    Thread.sleep(forTimeInterval: 0.01) // 10ms between samples
+            let events = try profiler.pollThreadEvents(maxEvents: 4096)
+            let created = events.filter { $0.type == 0 }.count
+            print("  Thread events: \(created) created, \(events.count - created) exited")
+            
+            let threads = Set(samples.map { $0.thread_id })
+            let stacks = Set(samples.map { $0.stack_id })
+            print("  Captured \(samples.count) samples from \(threads.count) threads, \(stacks.count) distinct stacks")
+            
+            let counts = Dictionary(grouping: samples, by: { $0.stack_id }).mapValues { $0.count }
+            if let hottest = counts.filter({ $0.key != 0 }).max(by: { $0.value < $1.value }) {
+                print("\n  Hottest stack (\(hottest.value) samples):")
+                let addresses = profiler.stackAddresses(for: hottest.key)
+                for (index, symbol) in profiler.symbolize(addresses, returnAddresses: true).enumerated() {
+                    print("    #\(index) \(symbol)")
+                }
+            }
+            
+            let states = Dictionary(grouping: samples, by: { $0.runState })
+            if states.count > 1 || states.keys.first != .running {
+                print("\n  Samples by thread state:")
+                for (state, group) in states.sorted(by: { $0.value.count > $1.value.count }) {
+                    print("    \(String(format: "%5.1f%%", Double(group.count) / Double(max(samples.count, 1)) * 100))  \(state)")
+                }
+            }
+            
+            // On-CPU and off-CPU time point at different problems, so rank them apart
+            let running = samples.filter { $0.runState == .running }
+            let waiting = samples.filter { $0.runState != .running }
+            let groups: [(String, [ProfilerSample])] = waiting.isEmpty || running.isEmpty
+                ? [("", samples)]
+                : [(" while running", running), (" while waiting", waiting)]
+            for (title, group) in groups {
+                guard let tree = CallTree() else { break }
+                try profiler.aggregate(group, into: tree)
+                let top = tree.topFunctions(10)
+                if !top.isEmpty {
+                    print("\n  Top functions\(title) by self time (self, total):")
+                    let total = Double(max(tree.totalWeight, 1))
+                    let symbols = profiler.symbolize(top.map { $0.frame })
+                    for (function, symbol) in zip(top, symbols) {
+                        let name = symbol.simplifiedName ?? symbol.description
+                        print("    \(String(format: "%5.1f%% %5.1f%%", Double(function.selfWeight) / total * 100, Double(function.totalWeight) / total * 100))  \(name)")
+                    }
+                }
+            }
+            
+            // A sample counts for the CPU time its thread used since the previous one
+            if samples.contains(where: { $0.cpu_time_ns > 0 }), let tree = CallTree() {
+                try profiler.aggregate(samples, into: tree, weight: .cpuTime)
+                let top = tree.topFunctions(10)
+                if !top.isEmpty {
+                    print("\n  Top functions by CPU time (self, total ms):")
+                    let symbols = profiler.symbolize(top.map { $0.frame })
+                    for (function, symbol) in zip(top, symbols) {
+                        let name = symbol.simplifiedName ?? symbol.description
+                        print("    \(String(format: "%8.2f %8.2f", Double(function.selfWeight) / 1e6, Double(function.totalWeight) / 1e6))  \(name)")
+                    }
                 }
             }
             
@@ -122,6 +236,104 @@ struct ProfilerCLI {
         }
     }
     
+    static func exportRecording() {
+        guard CommandLine.arguments.count > 2,
+              let outputIndex = CommandLine.arguments.firstIndex(of: "-o"),
+              outputIndex + 1 < CommandLine.arguments.count,
+              outputIndex != 2 else {
+            print("Error: Please specify a recording and an output file")
+            print("Usage: profiler export <recording> -o <file.pb.gz> [--no-threads] [--no-states]")
+            exit(1)
+        }
+        let recording = CommandLine.arguments[2]
+        let path = CommandLine.arguments[outputIndex + 1]
+        
+        print("Exporting \(recording) to \(path) (pprof)...")
+        let start = Date()
+        do {
+            let stats = try Profiler.exportPprof(
+                recording: recording,
+                to: path,
+                threadLabels: !CommandLine.arguments.contains("--no-threads"),
+                stateLabels: !CommandLine.arguments.contains("--no-states")
+            )
+            print("  \(stats.samples) samples as \(stats.stacks) stacks")
+            print("  \(stats.locations) locations, \(stats.functions) functions, \(stats.mappings) mappings")
+            print("  Wrote \(stats.bytes) bytes in \(String(format: "%.2f", Date().timeIntervalSince(start)))s")
+        } catch {
+            print("\nError: \(error)")
+            exit(1)
+        }
+    }
+    
+    static func diffRecordings() {
+        let arguments = CommandLine.arguments
+        guard arguments.count > 3 else {
+            print("Error: Please specify two recordings")
+            print("Usage: profiler diff <a.prof> <b.prof> [-o flame.svg] [--folded file] [--top N]")
+            exit(1)
+        }
+        let baseline = arguments[2]
+        let comparison = arguments[3]
+        func value(after flag: String) -> String? {
+            guard let index = arguments.firstIndex(of: flag), index + 1 < arguments.count else { return nil }
+            return arguments[index + 1]
+        }
+        let top = value(after: "--top").flatMap { Int($0) } ?? 15
+        
+        do {
+            let diff = try ProfileComparison(baseline: baseline, comparison: comparison)
+            let samplesA = Double(max(diff.baselineSamples, 1))
+            let samplesB = Double(max(diff.comparisonSamples, 1))
+            print("Comparing \(baseline) (\(diff.baselineSamples) samples) -> \(comparison) (\(diff.comparisonSamples) samples)")
+            
+            // Significant changes only; the table is sorted by self delta
+            let functions = diff.functions().filter { $0.significant }
+            let regressions = functions.filter { $0.selfDelta > 0 || ($0.selfDelta == 0 && $0.totalDelta > 0) }
+            let improvements = functions.filter { $0.selfDelta < 0 || ($0.selfDelta == 0 && $0.totalDelta < 0) }.reversed()
+            
+            func printTable(_ title: String, _ rows: [ProfileComparison.FunctionDelta]) {
+                print("\n\(title):")
+                guard !rows.isEmpty else {
+                    print("  (none)")
+                    return
+                }
+                print("    self A   self B    delta  total A  total B       z  function")
+                for row in rows.prefix(top) {
+                    print(String(format: "  %7.2f%% %7.2f%% %+7.2f%% %7.2f%% %7.2f%% %7.1f  ",
+                                 Double(row.baselineSelf) / samplesA * 100,
+                                 Double(row.comparisonSelf) / samplesB * 100,
+                                 row.selfDelta * 100,
+                                 Double(row.baselineTotal) / samplesA * 100,
+                                 Double(row.comparisonTotal) / samplesB * 100,
+                                 row.z) + row.name)
+                }
+            }
+            printTable("Regressions", Array(regressions))
+            printTable("Improvements", Array(improvements))
+            
+            let stacks = diff.stacks().filter { $0.significant }
+            if let worst = stacks.first, worst.delta > 0 {
+                print("\nLargest stack regression (\(String(format: "%+.2f%%", worst.delta * 100))):")
+                for (index, frame) in worst.frames.prefix(12).enumerated() {
+                    print("    #\(index) \(frame)")
+                }
+            }
+            
+            if let path = value(after: "-o") {
+                try diff.writeFlameGraph(to: path)
+                print("\nWrote differential flame graph to \(path)")
+            }
+            if let path = value(after: "--folded") {
+                try diff.writeFolded(to: path)
+                print("Wrote folded stacks to \(path)")
+            }
+        } catch {
+            print("\nError: \(error)")
+            exit(1)
+        }
+    }
+    
     static func printStats(_ stats: Profiler.Stats) {
         print("  Total samples: \(stats.totalSamples)")
         print("  Successful: \(stats.successfulSamples)")
@@ -130,24 +342,102 @@ struct ProfilerCLI {
         print("  Total frames: \(stats.totalFrames)")
         if stats.successfulSamples > 0 {
             print("  Avg frames/sample: \(String(format: "%.1f", stats.averageFramesPerSample))")
+            if stats.unchangedSamples > 0 {
+                print("  Unchanged threads: \(stats.unchangedSamples) (\(String(format: "%.1f%%", stats.unchangedRate * 100)) of samples reused the previous stack)")
+            }
+            if stats.cachedFrames > 0 {
+                print("  Cached frames: \(stats.cachedFrames) (\(String(format: "%.1f%%", stats.cachedFrameRate * 100)) copied from the previous walk)")
+            }
+            print("  Remote reads/sample: \(String(format: "%.2f", stats.averageRemoteReadsPerSample))")
+            print("  Kernel calls/sample: \(String(format: "%.2f", stats.averageKernelCallsPerSample))")
+            print("  Failed reads: \(stats.failedReads) (\(stats.rejectedReads) rejected by the region map, \(stats.regionScans) map scans)")
+            print("  Unique stacks: \(stats.uniqueStacks)")
+            print("  Unique addresses: \(stats.uniqueAddresses)")
+            print("  Capture skew: \(String(format: "%.1f", Double(stats.lastBatchSkewNs) / 1000.0)) us (max \(String(format: "%.1f", Double(stats.maxBatchSkewNs) / 1000.0)) us)")
+        }
+        if stats.sampledCpuTimeNs > 0 {
+            print("  Sampled CPU time: \(String(format: "%.1f", Double(stats.sampledCpuTimeNs) / 1e6)) ms")
+        }
+        if stats.skippedIdleThreads > 0 {
+            print("  Skipped idle threads: \(stats.skippedIdleThreads)")
+        }
+        if stats.missedDeadlines > 0 || stats.droppedSamples > 0 {
+            print("  Missed deadlines: \(stats.missedDeadlines)")
+            print("  Dropped samples: \(stats.droppedSamples)")
+        }
+        if stats.optimisticSamples > 0 || stats.discardedSamples > 0 {
+            print("  Unstopped samples: \(stats.optimisticSamples) (\(stats.optimisticRetries) retries, \(stats.discardedSamples) discarded, \(String(format: "%.1f%%", stats.discardRate * 100)))")
+            print("  Pause saved: ~\(String(format: "%.1f", stats.estimatedPauseSavedNs / 1e6)) ms (stopped threads: \(stats.stoppedCaptures), \(String(format: "%.1f", Double(stats.threadPauseNs) / 1e6)) ms)")
+        }
+        if stats.snapshotCount > 0 {
+            print("  Snapshots: \(stats.snapshotCount)")
+            print("  Avg pause: \(String(format: "%.1f", stats.averagePauseNs / 1000.0)) us (max \(String(format: "%.1f", Double(stats.maxPauseNs) / 1000.0)) us)")
+            for (bucket, count) in stats.pauseHistogram.enumerated() where count > 0 {
+                let label = bucket == 0 ? "< 1us" : ">= \(1 << (bucket - 1))us"
+                print("    \(label.padding(toLength: 10, withPad: " ", startingAt: 0)) \(count)")
+            }
+        }
+        let phases: [(String, Profiler.Distribution)] = [
+            ("suspend", stats.suspendTime),
+            ("registers", stats.registerTime),
+            ("reads", stats.readTime),
+            ("walk", stats.walkTime),
+            ("resume", stats.resumeTime),
+            ("thread pause", stats.threadPause),
+            ("bookkeeping", stats.bookkeepingTime),
+        ]
+        if phases.contains(where: { $0.1.count > 0 }) {
+            print("  Overhead (us, p50 / p99 / max):")
+            for (label, time) in phases where time.count > 0 {
+                let values = [time.p50, time.p99, time.max].map { String(format: "%.1f", Double($0) / 1000.0) }
+                print("    \(label.padding(toLength: 13, withPad: " ", startingAt: 0)) \(values.joined(separator: " / ")) (\(time.count))")
+            }
+        }
+        if stats.bytesPerSample.count > 0 {
+            let reads = stats.remoteReadsPerSample
+            let bytes = stats.bytesPerSample
+            print("  Per walked sample (p50 / p99 / max): \(reads.p50) / \(reads.p99) / \(reads.max) reads, \(bytes.p50) / \(bytes.p99) / \(bytes.max) bytes")
         }
     }
     
     static func printUsage() {
         print("""
         Usage: profiler <pid> [command] [options]
+               profiler export <recording> -o <file.pb.gz> [--no-threads] [--no-states]
+               profiler diff <a.prof> <b.prof> [-o flame.svg] [--folded file] [--top N]
         
         Commands:
           info              Show thread info (default)
           stacks            Capture and show all stack traces
           stack <N>         Capture stack for thread N
-          sample [N]        Capture N samples (default: 5)
+          sample [N]        Sample all threads N times at 10ms intervals (default: 5)
+          record [S] -o F   Record S seconds of samples to the binary file F (default: 10)
+        
+        Options:
+          --snapshot        Stop the whole process once per capture and unwind
+                            from copied stacks (shorter total pause)
+          --async           Follow Swift async frames to the callers awaiting
+                            them (shown after "awaited by")
+          --cpu             Sample only threads that are running or runnable
+                            (default: every thread, tagged with its state)
+          --optimistic      Walk threads without stopping them where possible
+                            and discard walks that raced the thread
+          --no-threads      export: merge all threads instead of labelling
+                            samples by thread
+          --no-states       export: merge thread states instead of labelling
+                            samples by state
         
         Examples:
           sudo profiler 1234
           sudo profiler 1234 stacks
           sudo profiler 1234 stack 0
           sudo profiler 1234 sample 10
+          sudo profiler 1234 sample 10 --snapshot
+          sudo profiler 1234 stacks --async
+          sudo profiler 1234 sample 100 --cpu
+          sudo profiler 1234 record 60 -o app.prof
+          profiler export app.prof -o app.pb.gz && go tool pprof -http=: app.pb.gz
+          profiler diff before.prof after.prof -o diff.svg
         
         Note: Requires sudo or task_for_pid entitlement
         """)
@@ -0,0 +1,128 @@
+#ifndef ASYNC_UNWIND_H
+#define ASYNC_UNWIND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Logical (await) stacks of Swift async functions
+    //
+    // An async function keeps its state in a heap-allocated AsyncContext
+    // instead of on the thread stack. While it runs, its frame record saves
+    // the caller's frame pointer with a flag bit set, and its context sits
+    // just below the frame pointer. Every context starts with a link to the
+    // context of the function awaiting it and the continuation ("resume
+    // partial function") that function will continue in, so following the
+    // links yields the chain of awaiting callers even after their frames have
+    // left the thread stack and the physical walk ends in the executor.
+    //
+    // Offsets and flag bits belong to the Swift runtime, so they are looked
+    // up by runtime version. Target memory is read through a callback, so a
+    // chain can be rebuilt from a recorded memory snapshot as well as from a
+    // live target.
+
+// Runtime version as compared by async_layout_for_version
+#define ASYNC_RUNTIME_VERSION(major, minor) (((uint32_t)(major) << 16) | ((uint32_t)(minor) << 8))
+
+    // Where the runtime keeps the pieces of an async frame
+    typedef struct
+    {
+        uint32_t min_version;   // First runtime version with this layout
+        uint64_t frame_flag;    // Set in a saved frame pointer when the frame is async
+        uint32_t context_slot;  // Bytes below the frame pointer where the context is saved
+        uint32_t parent_offset; // Offset of AsyncContext::Parent
+        uint32_t resume_offset; // Offset of AsyncContext::ResumeParent
+        uint64_t pointer_mask;  // Address bits of a stored pointer (drops pointer authentication)
+    } AsyncContextLayout;
+
+    /**
+     * Read target memory
+     * @return true if all size bytes were read
+     */
+    typedef bool (*AsyncMemoryReader)(void *context, uint64_t address, void *buffer, size_t size);
+
+    // A range of target memory captured earlier
+    typedef struct
+    {
+        uint64_t address;
+        uint64_t size;
+        const uint8_t *data;
+    } AsyncMemoryRange;
+
+    // Recorded target memory (ranges sorted by address, not overlapping);
+    // pass as the context of async_snapshot_read
+    typedef struct
+    {
+        const AsyncMemoryRange *ranges;
+        uint32_t range_count;
+    } AsyncMemorySnapshot;
+
+    /**
+     * Layout used by a runtime version
+     * Resolved once per version and cached.
+     *
+     * @param version ASYNC_RUNTIME_VERSION, or 0 if unknown (newest layout)
+     * @return The layout, or NULL if the version predates Swift concurrency
+     */
+    const AsyncContextLayout *async_layout_for_version(uint32_t version);
+
+    /**
+     * Runtime version from the path of the concurrency library
+     * Recognizes toolchain directories such as "swift-5.9.2-RELEASE".
+     *
+     * @return ASYNC_RUNTIME_VERSION, or 0 if the path does not say
+     */
+    uint32_t async_runtime_version(const char *path);
+
+    /**
+     * Whether a module path is the Swift concurrency runtime
+     */
+    bool async_is_runtime_module(const char *path);
+
+    /**
+     * AsyncMemoryReader over an AsyncMemorySnapshot
+     */
+    bool async_snapshot_read(void *snapshot, uint64_t address, void *buffer, size_t size);
+
+    /**
+     * Context of an async frame
+     *
+     * @param frame_pointer Frame pointer of the frame whose saved frame
+     *        pointer carries layout->frame_flag
+     * @return The context, or 0 if it cannot be read
+     */
+    uint64_t async_frame_context(
+        const AsyncContextLayout *layout,
+        AsyncMemoryReader read,
+        void *read_context,
+        uint64_t frame_pointer);
+
+    /**
+     * Rebuild the await chain of a context
+     * Each entry is the continuation of one awaiting function, outward from
+     * the direct caller, stored as its address + 1: like a return address,
+     * it is looked up at address - 1. Stops at the outermost context, at an
+     * unreadable context or at a cycle.
+     *
+     * @param frames Output, innermost first
+     * @param max_frames Capacity of frames
+     * @return Number of entries written
+     */
+    uint32_t async_unwind_chain(
+        const AsyncContextLayout *layout,
+        AsyncMemoryReader read,
+        void *read_context,
+        uint64_t context,
+        uint64_t *frames,
+        uint32_t max_frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ASYNC_UNWIND_H
@@ -0,0 +1,167 @@
+#ifndef CALL_TREE_H
+#define CALL_TREE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Incremental call-tree aggregation
+    //
+    // A call tree keeps three views of the stacks added to it, all updated
+    // as each stack arrives:
+    //   - top-down: rooted at the outermost frame, as the program calls
+    //   - bottom-up: rooted at the innermost frame and running out towards
+    //     the callers, so the first level answers "where is time spent"
+    //     and the levels below answer "who called it"
+    //   - flat: one entry per distinct frame, for "top N" queries
+    //
+    // Frames are opaque 64-bit keys chosen by the caller: return addresses
+    // for an instruction-level tree, or function start addresses (see
+    // profiler_aggregate_samples) for a function-level one. Nodes live in
+    // flat arrays with an open-addressed (parent, frame) index and
+    // first-child/next-sibling links; a parent always has a lower ID than
+    // its children, so a pass in ID order visits callers first. Not
+    // thread-safe; callers serialize access.
+
+// Node ID of the root of both trees; its total is the weight of every stack
+#define CALL_TREE_ROOT 0
+
+// No node (end of a child or sibling list)
+#define CALL_TREE_NONE UINT32_MAX
+
+    typedef enum
+    {
+        CALL_TREE_TOP_DOWN = 0,
+        CALL_TREE_BOTTOM_UP = 1
+    } CallTreeView;
+
+    typedef struct
+    {
+        uint64_t frame;
+        uint64_t self;         // Weight of stacks that end at this node
+        uint64_t total;        // Weight of stacks that pass through it
+        uint32_t parent;       // CALL_TREE_ROOT for the first level
+        uint32_t depth;        // Frames from the root (the root is 0)
+        uint32_t first_child;  // CALL_TREE_NONE if a leaf
+        uint32_t next_sibling; // CALL_TREE_NONE if the last child
+    } CallTreeNode;
+
+    // A frame's weight over the whole tree
+    typedef struct
+    {
+        uint64_t frame;
+        uint64_t self;  // Weight of stacks with this frame innermost
+        uint64_t total; // Weight of stacks containing it (once per stack, even if recursive)
+    } CallTreeFunction;
+
+    typedef struct CallTree CallTree;
+
+    /**
+     * Create an empty tree
+     * @return The tree, or NULL on allocation failure
+     */
+    CallTree *call_tree_create(void);
+
+    /**
+     * Destroy a tree and release its memory
+     */
+    void call_tree_destroy(CallTree *tree);
+
+    /**
+     * Remove every stack (keeps the allocations for reuse)
+     */
+    void call_tree_clear(CallTree *tree);
+
+    /**
+     * Add a stack to every view
+     * Costs one index probe per frame and view; a stack seen N times can
+     * be added once with weight N.
+     *
+     * @param frames Frames, innermost first (as produced by the walker)
+     * @param frame_count Number of frames (0 is ignored)
+     * @param weight Sample count, or time, to add
+     * @return 0 on success, -1 on allocation failure (the views may then
+     *         hold part of the stack)
+     */
+    int call_tree_add(
+        CallTree *tree,
+        const uint64_t *frames,
+        uint32_t frame_count,
+        uint64_t weight);
+
+    /**
+     * Add every stack of another tree (which is left unchanged)
+     * @return 0 on success, -1 on allocation failure
+     */
+    int call_tree_merge(CallTree *tree, const CallTree *other);
+
+    /**
+     * Drop every node whose total is below a threshold, with its subtree,
+     * and every flat entry whose total is below it
+     * Totals of the remaining nodes are unchanged, so a node's children
+     * may then add up to less than its total minus its self. Node IDs are
+     * renumbered (callers still come first); later stacks add as usual.
+     *
+     * @return Number of nodes removed
+     */
+    uint32_t call_tree_prune(CallTree *tree, uint64_t min_total);
+
+    /**
+     * Nodes of a view, indexed by node ID (node CALL_TREE_ROOT is the root)
+     * Valid until the next add, merge, prune or clear.
+     */
+    const CallTreeNode *call_tree_nodes(const CallTree *tree, CallTreeView view);
+
+    /**
+     * Number of nodes in a view, including the root
+     */
+    uint32_t call_tree_node_count(const CallTree *tree, CallTreeView view);
+
+    /**
+     * Child of a node for a frame
+     * @return The child's node ID, or CALL_TREE_NONE
+     */
+    uint32_t call_tree_find_child(
+        const CallTree *tree,
+        CallTreeView view,
+        uint32_t parent,
+        uint64_t frame);
+
+    /**
+     * The heaviest frames by self weight (ties broken by total)
+     * Selects over the flat view only, so the cost grows with the number of
+     * distinct frames, not with the number of nodes or stacks.
+     *
+     * @param functions Output, heaviest first
+     * @param max_functions Capacity of functions
+     * @return Number of entries written
+     */
+    uint32_t call_tree_top_functions(
+        const CallTree *tree,
+        CallTreeFunction *functions,
+        uint32_t max_functions);
+
+    /**
+     * Weight of every stack added (the roots' total)
+     */
+    uint64_t call_tree_total_weight(const CallTree *tree);
+
+    /**
+     * Number of distinct frames in the flat view
+     */
+    uint32_t call_tree_function_count(const CallTree *tree);
+
+    /**
+     * Bytes currently allocated by the tree
+     */
+    uint64_t call_tree_memory_usage(const CallTree *tree);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CALL_TREE_H
@@ -0,0 +1,78 @@
+#ifndef DEMANGLER_H
+#define DEMANGLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Memoizing demangler for Swift and C++ symbol names
+    //
+    // Swift names ($s..., $S..., _T0...) go through the Swift runtime's
+    // swift_demangle, C++ names (_Z...) through the C++ ABI library. Each
+    // distinct name is demangled once; the full and simplified forms live
+    // in an append-only string arena for the life of the demangler, so
+    // rendering the same profile again costs one hash lookup per name.
+    // Not thread-safe; callers serialize access.
+    typedef struct Demangler Demangler;
+
+    /**
+     * Create an empty demangler
+     * @return The demangler, or NULL on allocation failure
+     */
+    Demangler *demangler_create(void);
+
+    /**
+     * Destroy a demangler (invalidates every string it returned)
+     */
+    void demangler_destroy(Demangler *demangler);
+
+    /**
+     * Demangle a batch of names
+     * Names that are not mangled (or cannot be demangled) come back
+     * unchanged in both forms. Duplicates within and across batches are
+     * served from the memo table.
+     *
+     * @param demangler The demangler
+     * @param names Symbol names (NULL entries give NULL results)
+     * @param count Number of names
+     * @param full Output (may be NULL or names itself): e.g.
+     *        "Module.Type.method(x: Swift.Int) -> ()"
+     * @param simplified Output (may be NULL or names itself): e.g. "Module.Type.method"
+     * @return Number of names that were mangled and demangled
+     */
+    uint32_t demangler_demangle(
+        Demangler *demangler,
+        const char *const *names,
+        uint32_t count,
+        const char **full,
+        const char **simplified);
+
+    /**
+     * True for names in a Swift mangling scheme
+     */
+    bool demangler_is_swift_symbol(const char *name);
+
+    /**
+     * Whether the Swift runtime's demangler was found in this process
+     */
+    bool demangler_has_swift_runtime(const Demangler *demangler);
+
+    /**
+     * Distinct names memoized so far
+     */
+    uint64_t demangler_entry_count(const Demangler *demangler);
+
+    /**
+     * Bytes currently allocated by the demangler
+     */
+    uint64_t demangler_memory_usage(const Demangler *demangler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEMANGLER_H
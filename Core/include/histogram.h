@@ -0,0 +1,80 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Fixed-memory log-linear histograms (HDR style)
+    //
+    // Values below HISTOGRAM_SUB_BUCKETS get a bucket each. Every power of
+    // two above that is split into HISTOGRAM_SUB_BUCKETS equal buckets, so
+    // a bucket is never wider than 1/16 of the values it holds and any
+    // percentile is reported within 6.25% across the whole uint64_t range.
+    // Recording is a shift, a count-leading-zeros and an increment; a
+    // histogram never allocates, so one can sit on the capture path.
+
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS * (64 - HISTOGRAM_SUB_BUCKET_BITS + 1))
+
+    typedef struct
+    {
+        uint64_t count;
+        uint64_t total; // Sum of the recorded values
+        uint64_t min;   // Exact (0 while empty)
+        uint64_t max;
+        uint64_t buckets[HISTOGRAM_BUCKETS];
+    } Histogram;
+
+    // Digest of a histogram, small enough to copy around
+    typedef struct
+    {
+        uint64_t count;
+        uint64_t total;
+        uint64_t min;
+        uint64_t max;
+        uint64_t p50;
+        uint64_t p90;
+        uint64_t p99;
+        uint64_t p999;
+    } HistogramSummary;
+
+    /**
+     * Empty a histogram
+     */
+    void histogram_reset(Histogram *histogram);
+
+    /**
+     * Add one value
+     */
+    void histogram_record(Histogram *histogram, uint64_t value);
+
+    /**
+     * Add every value of another histogram
+     */
+    void histogram_merge(Histogram *into, const Histogram *from);
+
+    /**
+     * Value at or below which percentile percent of the values fall
+     * Reported as the largest value of its bucket, clamped to the exact
+     * minimum and maximum.
+     *
+     * @param percentile 0 to 100
+     * @return The value, or 0 if the histogram is empty
+     */
+    uint64_t histogram_percentile(const Histogram *histogram, double percentile);
+
+    /**
+     * Count, extremes and the usual percentiles
+     */
+    void histogram_summarize(const Histogram *histogram, HistogramSummary *summary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HISTOGRAM_H
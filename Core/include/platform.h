@@ -0,0 +1,332 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <sys/types.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/vm_param.h>
+#define PLATFORM_MACH 1
+#elif defined(__linux__)
+#define PLATFORM_LINUX 1
+#else
+#error "Unsupported platform"
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if defined(PLATFORM_LINUX)
+    // Linux has no Mach ports. Keep the Mach type names so ProfilerTarget,
+    // StackTrace and their Swift mirrors have the same layout everywhere:
+    // the task is the target pid and every thread is a kernel tid.
+    typedef uint32_t mach_port_t;
+    typedef mach_port_t task_t;
+    typedef mach_port_t thread_t;
+    typedef thread_t *thread_act_array_t;
+    typedef uint32_t mach_msg_type_number_t;
+#endif
+
+// Highest user-space address we will ever dereference in the target
+#if defined(__x86_64__)
+#define PLATFORM_USER_ADDRESS_MAX 0x800000000000ULL
+#elif (defined(__arm64__) || defined(__aarch64__)) && defined(PLATFORM_MACH)
+#define PLATFORM_USER_ADDRESS_MAX ((uint64_t)MACH_VM_MAX_ADDRESS)
+#elif defined(__arm64__) || defined(__aarch64__)
+#define PLATFORM_USER_ADDRESS_MAX 0x1000000000000ULL
+#else
+#error "Unsupported architecture"
+#endif
+
+    // Register values the stack walkers need
+    typedef struct
+    {
+        uint64_t pc;
+        uint64_t fp;
+        uint64_t sp;
+        uint64_t lr; // Link register (0 where the return address is on the stack)
+    } PlatformRegisters;
+
+    // One remote -> local copy in a batched read
+    typedef struct
+    {
+        uint64_t address; // Address in the target process
+        void *buffer;     // Local destination
+        size_t size;
+    } PlatformReadRequest;
+
+    // An executable image loaded in the target
+    typedef struct
+    {
+        uint64_t base;    // Load address (Mach-O header, or the ELF mapping of the lowest file offset)
+        uint64_t start;   // Lowest executable address
+        uint64_t end;     // One past the highest executable address
+        const char *path; // File the image was loaded from
+    } PlatformModule;
+
+    // Protection and role of a mapped region
+    typedef enum
+    {
+        PLATFORM_REGION_READ = 1 << 0,
+        PLATFORM_REGION_WRITE = 1 << 1,
+        PLATFORM_REGION_EXEC = 1 << 2,
+        PLATFORM_REGION_STACK = 1 << 3 // Known thread stack ([stack], VM_MEMORY_STACK)
+    } PlatformRegionFlags;
+
+    // A range of mapped memory in the target
+    typedef struct
+    {
+        uint64_t start;
+        uint64_t end;   // One past the last mapped byte
+        uint32_t flags; // PlatformRegionFlags
+    } PlatformRegion;
+
+    // Scheduler state of a thread
+    typedef enum
+    {
+        PLATFORM_THREAD_RUNNING,
+        PLATFORM_THREAD_STOPPED,
+        PLATFORM_THREAD_WAITING,
+        PLATFORM_THREAD_UNINTERRUPTIBLE,
+        PLATFORM_THREAD_HALTED,
+        PLATFORM_THREAD_UNKNOWN
+    } PlatformRunState;
+
+    typedef struct
+    {
+        PlatformRunState run_state;
+        uint64_t user_time_ns;
+        uint64_t system_time_ns;
+        uint64_t cpu_time_ns;   // User+system, at the finest resolution the platform has
+        bool cpu_time_precise;  // cpu_time_ns is finer than the scheduler tick
+    } PlatformThreadBasicInfo;
+
+#define PLATFORM_THREAD_NAME_MAX 64
+
+    // Properties of a thread that are looked up once, when it is first seen
+    typedef struct
+    {
+        uint64_t thread_id;                         // System-wide thread ID
+        uint32_t qos;                               // QOS_CLASS_* inferred from the base priority (0 on Linux)
+        int32_t priority;                           // Base scheduling priority (Linux: 20 - nice)
+        char name[PLATFORM_THREAD_NAME_MAX];        // Thread name ("" if unnamed)
+        char queue_label[PLATFORM_THREAD_NAME_MAX]; // Label of the dispatch queue being served ("" if none)
+    } PlatformThreadMetadata;
+
+    /**
+     * Open a handle to the target process
+     *
+     * @param pid Process ID
+     * @param task Output: task handle (Mach task port, or the pid on Linux)
+     * @return 0 on success, error code otherwise
+     */
+    int platform_task_attach(pid_t pid, task_t *task);
+
+    /**
+     * Release a handle obtained from platform_task_attach
+     */
+    void platform_task_release(task_t task);
+
+    /**
+     * List the threads of the target
+     * Release the list with platform_thread_list_release
+     *
+     * @param task The target task
+     * @param threads Output: thread array
+     * @param count Output: number of threads
+     * @return 0 on success, error code otherwise
+     */
+    int platform_task_threads(
+        task_t task,
+        thread_act_array_t *threads,
+        mach_msg_type_number_t *count);
+
+    /**
+     * Release a thread list returned by platform_task_threads
+     */
+    void platform_thread_list_release(
+        thread_act_array_t threads,
+        mach_msg_type_number_t count);
+
+    /**
+     * Keep a thread handle from a platform_task_threads list valid after
+     * the list is released (a no-op where handles are plain tids)
+     *
+     * @return 0 on success, error code if the thread is gone
+     */
+    int platform_thread_retain(thread_t thread);
+
+    /**
+     * Drop a handle kept with platform_thread_retain
+     */
+    void platform_thread_release(thread_t thread);
+
+    /**
+     * List the executable images loaded in the target
+     * Release the list with platform_module_list_release
+     *
+     * @param task The target task
+     * @param modules Output: module array, sorted by start address
+     * @param count Output: number of modules
+     * @return 0 on success, error code otherwise
+     */
+    int platform_task_modules(
+        task_t task,
+        PlatformModule **modules,
+        uint32_t *count);
+
+    /**
+     * Release a module list returned by platform_task_modules
+     */
+    void platform_module_list_release(PlatformModule *modules, uint32_t count);
+
+    /**
+     * List the mapped memory of the target
+     * Adjacent mappings with the same flags are merged.
+     * Release the list with platform_region_list_release
+     *
+     * @param task The target task
+     * @param regions Output: region array, sorted and non-overlapping
+     * @param count Output: number of regions
+     * @return 0 on success, error code otherwise
+     */
+    int platform_task_regions(
+        task_t task,
+        PlatformRegion **regions,
+        uint32_t *count);
+
+    /**
+     * Release a region list returned by platform_task_regions
+     */
+    void platform_region_list_release(PlatformRegion *regions, uint32_t count);
+
+    /**
+     * Read a counter that changes whenever the target loads or unloads an
+     * image (dyld's image list timestamp on Mach)
+     *
+     * @param generation Output: the current value
+     * @return 0 on success, ENOSYS / KERN_NOT_SUPPORTED where the platform
+     *         has no such counter
+     */
+    int platform_task_image_generation(task_t task, uint64_t *generation);
+
+    /**
+     * Stop a thread so its registers and stack can be read consistently
+     * Every successful suspend must be paired with platform_thread_resume
+     * from the same calling thread.
+     */
+    int platform_thread_suspend(task_t task, thread_t thread);
+
+    /**
+     * Resume a thread stopped by platform_thread_suspend
+     */
+    int platform_thread_resume(task_t task, thread_t thread);
+
+    /**
+     * Stop the whole target at once, for a consistent snapshot of every thread
+     * Mach suspends the task; Linux interrupts every listed thread before
+     * waiting for any of them, so they stop together rather than in turn.
+     *
+     * @param threads Threads of the task (used where there is no task-wide stop)
+     * @param count Number of threads
+     * @param stopped Output: per thread, whether it is now stopped
+     * @return 0 on success, error code if nothing could be stopped
+     */
+    int platform_task_suspend(
+        task_t task,
+        const thread_t *threads,
+        mach_msg_type_number_t count,
+        bool *stopped);
+
+    /**
+     * Resume a target stopped by platform_task_suspend
+     */
+    int platform_task_resume(
+        task_t task,
+        const thread_t *threads,
+        mach_msg_type_number_t count,
+        const bool *stopped);
+
+    /**
+     * Read PC, FP and SP of a suspended thread
+     */
+    int platform_thread_get_registers(
+        task_t task,
+        thread_t thread,
+        PlatformRegisters *regs);
+
+    /**
+     * Read PC and SP (and FP where available, 0 otherwise) of a thread
+     * without stopping it
+     * A running thread's registers are stale as soon as they are read.
+     * Mach reads any thread (the kernel holds a running one only for the
+     * copy); Linux reads only blocked threads and never has FP.
+     *
+     * @return 0 on success, EBUSY if the thread is running and cannot be read, otherwise an error code
+     */
+    int platform_thread_peek_registers(
+        task_t task,
+        thread_t thread,
+        PlatformRegisters *regs);
+
+    /**
+     * Get the system-wide thread ID
+     *
+     * @param thread_id Output: thread ID (falls back to the thread handle)
+     * @return 0 on success, error code otherwise
+     */
+    int platform_thread_get_id(task_t task, thread_t thread, uint64_t *thread_id);
+
+    /**
+     * Get the ID, name, dispatch queue label and priority of a thread
+     * Several kernel calls; meant to be cached by the caller, not issued
+     * per sample. Only the thread ID is required to succeed.
+     *
+     * @return 0 on success, error code otherwise
+     */
+    int platform_thread_get_metadata(
+        task_t task,
+        thread_t thread,
+        PlatformThreadMetadata *metadata);
+
+    /**
+     * Get scheduler state and CPU time of a thread
+     */
+    int platform_thread_get_basic_info(
+        task_t task,
+        thread_t thread,
+        PlatformThreadBasicInfo *info);
+
+    /**
+     * Copy memory out of the target
+     *
+     * @return 0 on success, error code otherwise
+     */
+    int platform_read_memory(
+        task_t task,
+        uint64_t address,
+        void *buffer,
+        size_t size);
+
+    /**
+     * Copy several ranges out of the target with as few syscalls as possible
+     * (a single process_vm_readv on Linux). Requests are satisfied in order;
+     * the first one that cannot be read completely stops the batch.
+     *
+     * @return Number of leading requests that were read completely
+     */
+    size_t platform_read_memory_batch(
+        task_t task,
+        const PlatformReadRequest *requests,
+        size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLATFORM_H
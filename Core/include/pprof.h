@@ -0,0 +1,70 @@
+#ifndef PPROF_H
+#define PPROF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // pprof export of recordings
+    //
+    // Converts a recording (see recording.h) into a profile.proto message
+    // that loads in `go tool pprof`, speedscope and other pprof tools. The
+    // protobuf encoder and gzip compressor are built in, so there are no
+    // dependencies. The recording is read in one pass: each chunk's stacks
+    // are merged into a global stack trie, identical stacks are aggregated,
+    // and strings, functions and locations are written the first time they
+    // are seen. Memory grows with the number of distinct stacks, not with
+    // the number of samples.
+    //
+    // Every sample has two values, samples/count and time/nanoseconds
+    // (count * sampling period), and a third, cpu/nanoseconds (the summed
+    // CPU time weights), when the recording has them; pprof shows the last
+    // one by default. Samples with an empty stack are skipped.
+
+    typedef struct
+    {
+        bool thread_labels; // Keep threads apart, labelled "thread" and "thread_number" (default: true)
+        bool compress;      // gzip the output, as pprof tools expect (default: true)
+        bool state_labels;  // Keep run states apart, labelled "thread_state" (default: true)
+    } PprofOptions;
+
+    typedef struct
+    {
+        uint64_t samples;   // Samples exported
+        uint64_t bytes;     // Size of the output file
+        uint32_t stacks;    // Distinct pprof samples (stack, and thread and state if labelled)
+        uint32_t locations;
+        uint32_t functions;
+        uint32_t mappings;
+    } PprofExportStats;
+
+    /**
+     * Get default export options
+     */
+    PprofOptions pprof_default_options(void);
+
+    /**
+     * Convert a recording to a pprof profile
+     *
+     * @param recording_path Recording to read
+     * @param output_path Profile to create (replaced if it exists)
+     * @param options Options (NULL for defaults)
+     * @param stats Output: what was written (may be NULL)
+     * @return 0 on success, -1 if the recording cannot be read, otherwise
+     *         the errno of the failed write
+     */
+    int pprof_export_recording(
+        const char *recording_path,
+        const char *output_path,
+        const PprofOptions *options,
+        PprofExportStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PPROF_H
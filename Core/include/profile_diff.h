@@ -0,0 +1,150 @@
+#ifndef PROFILE_DIFF_H
+#define PROFILE_DIFF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Differential comparison of two recordings
+    //
+    // Both recordings (see recording.h) are aggregated into call trees
+    // whose frames are keyed by symbol name rather than address, so the
+    // same code lines up even when ASLR loaded it elsewhere. Frames without
+    // a symbol are keyed by module file name and offset ("libfoo.so+0x1a2b").
+    //
+    // Weights are compared as fractions of each profile's sample count, so
+    // recordings of different length compare directly. A change is
+    // significant when a two-proportion z-test on the sample counts gives
+    // |z| >= min_z; samples taken close together are correlated, so treat
+    // z as a ranking of confidence rather than an exact p-value.
+    //
+    // Side 0 is the baseline ("A"), side 1 the comparison ("B"); deltas are
+    // B - A, so a positive delta is a regression.
+
+    typedef struct
+    {
+        double min_z; // Threshold for "significant" (default: 3.29, two-sided p < 0.001)
+    } ProfileDiffOptions;
+
+    // One function in either profile
+    typedef struct
+    {
+        const char *name;    // Display name (demangled); valid until destroy
+        uint64_t self[2];    // Samples with the function innermost
+        uint64_t total[2];   // Samples containing it
+        double self_delta;   // Change in self fraction (B - A)
+        double total_delta;  // Change in total fraction (B - A)
+        double z;            // z score of the self change (total change if it has no self samples)
+        bool significant;
+    } ProfileDiffFunction;
+
+    // One distinct stack of the merged top-down tree
+    typedef struct
+    {
+        uint32_t node;     // Innermost frame's node (see profile_diff_stack_frames)
+        uint32_t depth;
+        uint64_t count[2]; // Samples with exactly this stack
+        double delta;      // Change in fraction (B - A)
+        double z;
+        bool significant;
+    } ProfileDiffStack;
+
+    typedef struct ProfileDiff ProfileDiff;
+
+    /**
+     * Get default options
+     */
+    ProfileDiffOptions profile_diff_default_options(void);
+
+    /**
+     * Load and compare two recordings
+     *
+     * @param baseline_path Recording A
+     * @param comparison_path Recording B
+     * @param options Options (NULL for defaults)
+     * @return The comparison, or NULL if a recording cannot be read
+     */
+    ProfileDiff *profile_diff_create(
+        const char *baseline_path,
+        const char *comparison_path,
+        const ProfileDiffOptions *options);
+
+    /**
+     * Destroy a comparison (invalidates every name it returned)
+     */
+    void profile_diff_destroy(ProfileDiff *diff);
+
+    /**
+     * Samples with a non-empty stack in one side (0 = A, 1 = B)
+     */
+    uint64_t profile_diff_sample_count(const ProfileDiff *diff, int side);
+
+    /**
+     * Functions, sorted by self delta from the largest regression to the
+     * largest improvement
+     *
+     * @param functions Output
+     * @param max_functions Capacity of functions
+     * @return Number of entries written (profile_diff_function_count if it fits)
+     */
+    uint32_t profile_diff_functions(
+        const ProfileDiff *diff,
+        ProfileDiffFunction *functions,
+        uint32_t max_functions);
+
+    /**
+     * Number of distinct functions across both sides
+     */
+    uint32_t profile_diff_function_count(const ProfileDiff *diff);
+
+    /**
+     * Stacks, sorted by delta like profile_diff_functions
+     */
+    uint32_t profile_diff_stacks(
+        const ProfileDiff *diff,
+        ProfileDiffStack *stacks,
+        uint32_t max_stacks);
+
+    /**
+     * Number of distinct stacks across both sides
+     */
+    uint32_t profile_diff_stack_count(const ProfileDiff *diff);
+
+    /**
+     * Display names of a stack's frames, innermost first
+     * @return Number of names written
+     */
+    uint32_t profile_diff_stack_frames(
+        const ProfileDiff *diff,
+        uint32_t node,
+        const char **names,
+        uint32_t max_names);
+
+    /**
+     * Write a differential flame graph as a standalone SVG
+     * Frames are sized by profile B and colored by the change in their
+     * total fraction: red grew, blue shrank, more saturated for larger
+     * changes. The title of each frame (its tooltip) has the numbers.
+     *
+     * @return 0 on success, otherwise errno
+     */
+    int profile_diff_write_flame_graph(const ProfileDiff *diff, const char *path);
+
+    /**
+     * Write the stacks in two-column folded form ("a;b;c countA countB"),
+     * as read by flamegraph.pl and similar tools. Counts of A are scaled to
+     * B's sample count, so the columns compare directly.
+     *
+     * @return 0 on success, otherwise errno
+     */
+    int profile_diff_write_folded(const ProfileDiff *diff, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_DIFF_H
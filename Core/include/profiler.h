@@ -1,20 +1,39 @@
 #ifndef PROFILER_H
 #define PROFILER_H
 
-#include <mach/mach.h>
+#include "platform.h"
 #include <sys/types.h>
 #include <stdbool.h>
 #include "stack_walker.h"
+#include "stack_table.h"
+#include "symbolizer.h"
+#include "demangler.h"
+#include "thread_registry.h"
+#include "recording.h"
+#include "call_tree.h"
+#include "histogram.h"
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+// Buckets of the snapshot pause histogram: bucket 0 counts pauses under
+// 1us, bucket i pauses in [2^(i-1), 2^i) us; the last bucket is open-ended
+#define PROFILER_PAUSE_HISTOGRAM_BUCKETS 16
+
+// Thread lifecycle events buffered between polls
+#define PROFILER_THREAD_EVENT_BUFFER_SIZE 256
+
+// Minimum sample buffer while recording, so writing a chunk never stalls
+// the sampler
+#define PROFILER_RECORDING_BUFFER_SIZE 16384
+
     // Forward declarations
     typedef struct ProfilerTarget ProfilerTarget;
     typedef struct ProfilerConfig ProfilerConfig;
     typedef struct ProfilerStats ProfilerStats;
+    typedef struct ProfilerSample ProfilerSample;
 
     // Profiler state
     typedef enum
@@ -25,6 +44,38 @@ extern "C"
         PROFILER_STATE_ERROR
     } ProfilerState;
 
+    // What the continuous sampler walks
+    typedef enum
+    {
+        PROFILER_SAMPLING_WALL_CLOCK = 0, // Every thread; samples carry the thread's run state
+        PROFILER_SAMPLING_CPU = 1         // Only threads that are running or runnable
+    } ProfilerSamplingMode;
+
+    // What a sample adds to an aggregated call tree
+    typedef enum
+    {
+        PROFILER_WEIGHT_SAMPLES = 0, // 1 per sample
+        PROFILER_WEIGHT_CPU_TIME = 1 // ProfilerSample.cpu_time_ns
+    } ProfilerSampleWeight;
+
+    // Overhead measured on every capture, kept as histograms since attach
+    // The first five follow StackWalkPhase; a phase is counted for the
+    // captures that went through it.
+    typedef enum
+    {
+        PROFILER_METRIC_SUSPEND_NS = 0, // Stopping a thread (or a snapshot's whole task)
+        PROFILER_METRIC_REGISTERS_NS,   // Reading or peeking a thread's registers
+        PROFILER_METRIC_READ_NS,        // Reads of target memory, per walked sample
+        PROFILER_METRIC_WALK_NS,        // Unwinding without its reads, per walked sample
+        PROFILER_METRIC_RESUME_NS,      // Restarting a stopped thread (or task)
+        PROFILER_METRIC_PAUSE_NS,       // How long a stop kept threads from running (once per snapshot)
+        PROFILER_METRIC_BOOKKEEPING_NS, // Profiler work around the walker per capture call or sampler tick:
+                                        // thread and region refreshes, interning, buffering, stats
+        PROFILER_METRIC_REMOTE_READS,   // Reads issued per walked sample
+        PROFILER_METRIC_BYTES_READ,     // Bytes copied from the target per walked sample
+        PROFILER_METRIC_COUNT
+    } ProfilerMetric;
+
     // Main profiler target structure
     struct ProfilerTarget
     {
@@ -41,9 +92,17 @@ extern "C"
     {
         uint32_t sample_interval_ms; // Sampling interval (default: 10ms)
         uint32_t max_stack_depth;    // Max frames per stack (default: 512)
-        bool track_async;            // Track async/await (default: false)
-        bool track_threads;          // Track thread lifecycle (default: true)
+        bool track_async;            // Append the await chain of Swift async frames (default: false)
+        bool track_threads;          // Refresh threads while sampling and report lifecycle events (default: true)
         StackWalkStrategy stack_strategy;
+        uint32_t stack_window_size;  // Stack bytes copied per thread (default: 32KB)
+        uint32_t sample_buffer_size; // Samples buffered between polls (default: 1024)
+        uint32_t capture_workers;    // Threads walking a snapshot in parallel (default: 4)
+        bool snapshot_mode;          // Stop the whole task once per capture (default: false)
+        ProfilerSamplingMode sampling_mode; // Default: PROFILER_SAMPLING_WALL_CLOCK
+        bool optimistic_capture;     // Walk threads without stopping them where possible, discarding
+                                     // walks that raced the thread (default: false; ignored in
+                                     // snapshot_mode; see stack_walker_capture)
     };
 
     // Statistics
@@ -52,8 +111,61 @@ extern "C"
         uint64_t total_samples;
         uint64_t successful_samples;
         uint64_t failed_samples;
-        uint64_t total_frames;
-        uint64_t unique_addresses;
+        uint64_t total_frames;     // Frames of successful samples (an unchanged one counts the stack it reused)
+        uint64_t unique_addresses; // Distinct frame addresses across all interned stacks
+        uint64_t unique_stacks;    // Distinct interned stacks
+        uint64_t remote_reads; // Target memory reads issued while walking
+        uint64_t failed_reads;   // Of those, reads that came back short or faulted
+        uint64_t rejected_reads; // Reads and addresses the region map ruled out without a syscall
+        uint64_t region_scans;   // Scans of the target's memory map (see region_map.h)
+        uint64_t kernel_calls;   // Kernel calls made by captures (see StackTrace.kernel_calls)
+        uint64_t threads_created;       // Lifecycle events reported (track_threads only)
+        uint64_t threads_exited;
+        uint64_t dropped_thread_events; // Events lost because the event buffer was full
+        uint64_t missed_deadlines; // Sampling ticks skipped because a capture overran
+        uint64_t dropped_samples;  // Samples lost because the sample buffer was full
+        uint64_t recorded_samples; // Samples written to the recording (see profiler_start_recording)
+        uint64_t recorded_bytes;   // Size of the recording so far
+        uint64_t last_batch_skew_ns; // Spread of timestamp_ns within the last all-thread capture
+        uint64_t max_batch_skew_ns;  // Largest such spread so far
+        uint64_t snapshot_count;     // Whole-task pauses taken in snapshot mode
+        uint64_t total_pause_ns;     // Time the target spent stopped by them
+        uint64_t max_pause_ns;
+        uint64_t pause_histogram[PROFILER_PAUSE_HISTOGRAM_BUCKETS];
+        uint64_t skipped_idle_threads; // Threads not walked by CPU-mode ticks because they were not running
+        uint64_t sampled_cpu_time_ns;  // Sum of ProfilerSample.cpu_time_ns over successful samples
+        uint64_t unchanged_samples;    // Successful samples that reused the stack of a thread that had not moved
+        uint64_t cached_frames;        // Of total_frames, frames copied from a thread's previous walk instead of read
+        uint64_t stopped_captures;     // Captures that stopped a single thread (not snapshots)
+        uint64_t thread_pause_ns;      // Time threads spent stopped by those captures
+        uint64_t optimistic_samples;   // Samples walked without stopping the thread (optimistic_capture)
+        uint64_t optimistic_retries;   // Unstopped walks repeated because the thread moved during the walk
+        uint64_t discarded_samples;    // Of failed_samples, samples dropped because every unstopped walk was torn
+    };
+
+    // One sample from the continuous sampler
+    // The frames live once in the target's stack table; expand them with
+    // profiler_get_stack.
+    // cpu_time_ns weights the sample by the CPU time its thread used since
+    // the sampler last walked it, so a thread that ran for most of an
+    // interval outweighs one that ran briefly. Summed, the weights are the
+    // CPU time of the sampled threads. Weights exclude the profiler's own
+    // stops: stopping a waiting thread makes it run briefly, and that
+    // runtime is left out, so a thread that stays parked weighs 0. A
+    // thread's first sample is 0 unless the thread appeared while sampling
+    // (then it is all the thread's CPU time), and so is any sample whose
+    // CPU time could not be read. Times
+    // are nanoseconds from schedstat on Linux and microseconds on macOS;
+    // only on Linux kernels without schedstat do they fall back to clock
+    // ticks, where single weights are multiples of the tick.
+    struct ProfilerSample
+    {
+        uint32_t stack_id;
+        uint32_t thread_number; // Stable number of the sampled thread (see ThreadRecord)
+        uint64_t thread_id;
+        uint64_t timestamp_ns;
+        uint32_t run_state; // PlatformRunState when sampled (PLATFORM_THREAD_UNKNOWN if unreadable)
+        uint64_t cpu_time_ns; // User+system CPU time of the thread since its previous sample (see above)
     };
 
     /**
@@ -76,7 +188,10 @@ extern "C"
 
     /**
      * Get list of threads in the target process
-     * This refreshes the thread list
+     * This refreshes the thread list by diffing it against the previous
+     * one: threads that are still alive keep their position (new threads
+     * are appended, exited ones removed) and their stable thread_number.
+     * target->threads stays valid until the next refresh or detach.
      *
      * @param target The profiler target
      * @return 0 on success, error code otherwise
@@ -85,6 +200,8 @@ extern "C"
 
     /**
      * Capture stack trace for a specific thread
+     * Frames go to the target's frame arena; read them with
+     * profiler_trace_frames before the next capture call.
      *
      * @param target The profiler target
      * @param thread_index Index into the threads array
@@ -99,6 +216,8 @@ extern "C"
     /**
      * Capture stacks for ALL threads
      * This is more efficient than calling profiler_capture_thread_stack repeatedly
+     * Frames of all traces share the target's frame arena; read them with
+     * profiler_trace_frames before the next capture call.
      *
      * @param target The profiler target
      * @param traces Output array (must be pre-allocated with thread_count size)
@@ -110,6 +229,224 @@ extern "C"
         StackTrace *traces,
         uint32_t *trace_count);
 
+    /**
+     * Frames of a trace from the last one-shot capture (no copy)
+     *
+     * @param target The profiler target
+     * @param trace A trace returned by the last capture call
+     * @return trace->frame_count frames, innermost first; NULL if there are
+     *         none. Valid until the next capture call or detach.
+     */
+    const StackFrame *profiler_trace_frames(
+        const ProfilerTarget *target,
+        const StackTrace *trace);
+
+    /**
+     * Resolve frame addresses to symbols
+     * Symbol tables are loaded on first use, from the on-disk symbol cache
+     * when the module was seen before (see symbolizer.h). Safe to call
+     * while sampling.
+     *
+     * @param target The profiler target
+     * @param addresses Addresses to resolve (return addresses: pass address - 1)
+     * @param count Number of addresses
+     * @param symbols Output, one per address; strings are valid until the
+     *        next profiler_refresh_threads or detach
+     * @return 0 on success, error code otherwise
+     */
+    int profiler_symbolize(
+        ProfilerTarget *target,
+        const uint64_t *addresses,
+        uint32_t count,
+        SymbolInfo *symbols);
+
+    /**
+     * Demangle symbol names (Swift and C++)
+     * Each distinct name is demangled once per attach; repeated names are
+     * served from a memo table. Safe to call while sampling.
+     *
+     * @param target The profiler target
+     * @param names Names from profiler_symbolize (NULL entries give NULL results)
+     * @param count Number of names
+     * @param full Output (may be NULL): full demangled form
+     * @param simplified Output (may be NULL): "Module.Type.method" form
+     * @return 0 on success, error code otherwise; strings are valid until detach
+     */
+    int profiler_demangle(
+        ProfilerTarget *target,
+        const char *const *names,
+        uint32_t count,
+        const char **full,
+        const char **simplified);
+
+    /**
+     * Find the module whose code contains an address
+     * Safe to call while sampling.
+     *
+     * @param target The profiler target
+     * @param address Code address in the target
+     * @param path Output (may be NULL): the module's file, truncated to path_size
+     * @param path_size Size of path
+     * @param offset Output (may be NULL): address relative to the module's load address
+     * @return 0 on success, -1 if no loaded module contains address
+     */
+    int profiler_resolve_module(
+        ProfilerTarget *target,
+        uint64_t address,
+        char *path,
+        size_t path_size,
+        uint64_t *offset);
+
+    /**
+     * Print a trace from the last one-shot capture with symbols (for debugging)
+     *
+     * @param target The profiler target
+     * @param trace A trace returned by the last capture call
+     */
+    void profiler_print_trace(
+        const ProfilerTarget *target,
+        const StackTrace *trace);
+
+    /**
+     * Start continuous sampling on a background thread
+     * Every sample_interval_ms (on a fixed deadline grid, so capture cost
+     * does not make the rate drift) the sampler captures all threads and
+     * pushes one StackTrace per thread into the sample buffer. The target
+     * is in PROFILER_STATE_SAMPLING until profiler_stop_sampling; the
+     * one-shot capture and refresh calls are rejected meanwhile.
+     * Each sample is interned and buffered as a ProfilerSample.
+     *
+     * @param target The profiler target
+     * @return 0 on success, error code otherwise
+     */
+    int profiler_start_sampling(ProfilerTarget *target);
+
+    /**
+     * Drain captured samples (call from a single consumer thread)
+     *
+     * @param target The profiler target
+     * @param samples Output array with room for max_samples samples
+     * @param max_samples Capacity of samples
+     * @param sample_count Output: number of samples written
+     * @return 0 on success, error code otherwise
+     */
+    int profiler_poll_samples(
+        ProfilerTarget *target,
+        ProfilerSample *samples,
+        uint32_t max_samples,
+        uint32_t *sample_count);
+
+    /**
+     * Drain thread lifecycle events (call from a single consumer thread)
+     * With config.track_threads set, every refresh (profiler_refresh_threads,
+     * and the sampler's periodic one while sampling) reports the threads
+     * created and exited since the previous one. The first refresh reports
+     * every thread as created.
+     *
+     * @param target The profiler target
+     * @param events Output array with room for max_events events
+     * @param max_events Capacity of events
+     * @param event_count Output: number of events written
+     * @return 0 on success, error code otherwise
+     */
+    int profiler_poll_thread_events(
+        ProfilerTarget *target,
+        ThreadEvent *events,
+        uint32_t max_events,
+        uint32_t *event_count);
+
+    /**
+     * Look up the cached metadata of a live thread
+     * ID, name, dispatch queue label and priority are read once, when the
+     * thread is first seen, and dropped when it exits. Safe to call from
+     * any thread, also while sampling.
+     *
+     * @param target The profiler target
+     * @param thread_number Stable number from a trace, sample or event
+     * @param record Output: the thread's record
+     * @return 0 on success, -1 if no live thread has that number
+     */
+    int profiler_get_thread_info(
+        ProfilerTarget *target,
+        uint32_t thread_number,
+        ThreadRecord *record);
+
+    /**
+     * Stop the sampler thread and return to PROFILER_STATE_ATTACHED
+     * Samples still buffered can be drained with profiler_poll_samples
+     * (when recording, they are written to the file instead and the file
+     * is closed, as with profiler_stop_recording).
+     *
+     * @param target The profiler target
+     * @return 0 on success, error code otherwise
+     */
+    int profiler_stop_sampling(ProfilerTarget *target);
+
+    /**
+     * Start sampling into a recording file (see recording.h)
+     * Samples like profiler_start_sampling, but a background writer thread
+     * drains the sample buffer (at least PROFILER_RECORDING_BUFFER_SIZE
+     * samples), names threads and symbolizes frames off the sampling path,
+     * and appends a chunk to the file every few seconds.
+     * profiler_poll_samples is unavailable until profiler_stop_recording.
+     *
+     * @param target The profiler target (attached, not sampling)
+     * @param path File to create (replaced if it exists)
+     * @return 0 on success, error code otherwise
+     */
+    int profiler_start_recording(ProfilerTarget *target, const char *path);
+
+    /**
+     * Stop sampling, write the buffered samples and close the file
+     *
+     * @return 0 on success, otherwise the first write error
+     */
+    int profiler_stop_recording(ProfilerTarget *target);
+
+    /**
+     * Expand an interned stack ID into its frame addresses
+     * Safe to call while sampling.
+     *
+     * @param target The profiler target
+     * @param stack_id Stack ID from a ProfilerSample or StackTrace
+     * @param addresses Output, innermost frame first
+     * @param max_addresses Capacity of addresses
+     * @param address_count Output: number of addresses written
+     * @return 0 on success, error code otherwise
+     */
+    int profiler_get_stack(
+        ProfilerTarget *target,
+        uint32_t stack_id,
+        uint64_t *addresses,
+        uint32_t max_addresses,
+        uint32_t *address_count);
+
+    /**
+     * Add polled samples to a call tree
+     * Samples that share a stack are added once, weighted by their count,
+     * so keeping a live tree costs one pass per poll rather than a replay
+     * of every sample. Safe to call while sampling.
+     *
+     * @param target The profiler target
+     * @param samples Samples from profiler_poll_samples
+     * @param sample_count Number of samples
+     * @param tree Tree to update (empty stacks are skipped)
+     * @param by_function Key frames by the start address of their function
+     *        (each address is symbolized once, then memoized until the next
+     *        profiler_refresh_threads) instead of by address; addresses
+     *        without a symbol keep their own key
+     * @param weight What each sample adds: 1, or its CPU time in
+     *        nanoseconds (stacks that used none are skipped)
+     * @return 0 on success, error code otherwise
+     */
+    int profiler_aggregate_samples(
+        ProfilerTarget *target,
+        const ProfilerSample *samples,
+        uint32_t sample_count,
+        CallTree *tree,
+        bool by_function,
+        ProfilerSampleWeight weight);
+
     /**
      * Get profiler statistics
      *
@@ -120,6 +457,30 @@ extern "C"
         const ProfilerTarget *target,
         ProfilerStats *stats);
 
+    /**
+     * Get the distribution of an overhead metric
+     *
+     * @param target The profiler target
+     * @param metric Which one
+     * @param summary Output: count, total, extremes and percentiles
+     * @return 0 on success, -1 if the target is not set up or metric is unknown
+     */
+    int profiler_get_metric(
+        const ProfilerTarget *target,
+        ProfilerMetric metric,
+        HistogramSummary *summary);
+
+    /**
+     * Copy the full histogram of an overhead metric, e.g. to merge the
+     * histograms of several targets
+     *
+     * @return 0 on success, -1 if the target is not set up or metric is unknown
+     */
+    int profiler_get_metric_histogram(
+        const ProfilerTarget *target,
+        ProfilerMetric metric,
+        Histogram *histogram);
+
     /**
      * Print basic thread information (for debugging)
      *
@@ -0,0 +1,369 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Streaming binary profile recordings
+    //
+    // A recording is a file header followed by self-contained chunks, each
+    // covering a stretch of time. A chunk carries its own dictionaries (the
+    // threads, code locations and stacks its samples use, and the strings
+    // those refer to), so chunks can be read in any order, a file that was
+    // cut short still has every complete chunk, and a reader that maps the
+    // file only touches the chunks it needs.
+    //
+    // Chunk layout (native endianness, sections 8-byte aligned, offsets
+    // relative to the chunk header):
+    //   RecordingChunkHeader
+    //   char strings[strings_size]              NUL-terminated, referenced by offset
+    //   RecordingThread threads[thread_count]
+    //   RecordingLocation locations[location_count]
+    //   RecordingNode nodes[node_count]         stack trie, node 0 is the root
+    //   RecordingIndexEntry index[index_count]  every RECORDING_INDEX_INTERVAL samples
+    //   uint8_t samples[samples_size]           varint-encoded, see below
+    //
+    // Each sample is three LEB128 varints: the zigzag delta of its timestamp
+    // from the previous sample's, the zigzag delta of its thread number from
+    // the previous sample's, and its stack node; chunks flagged
+    // RECORDING_CHUNK_RUN_STATES add the thread's run state, then chunks
+    // flagged RECORDING_CHUNK_CPU_TIMES add the sample's CPU time in
+    // nanoseconds. The sample an index entry points at is encoded against
+    // the entry's timestamp (its own) and thread number 0, so decoding can
+    // start there.
+    //
+    // Version 1 and 2 files (no chunk flags, or run states only) are still
+    // read.
+
+#define RECORDING_MAGIC "SAPREC"
+#define RECORDING_VERSION 3
+#define RECORDING_CHUNK_MAGIC 0x4b4e4843 // "CHNK"
+
+// Samples between two time index entries
+#define RECORDING_INDEX_INTERVAL 256
+
+// A chunk is closed when it holds this many samples or spans this long
+#define RECORDING_CHUNK_MAX_SAMPLES (256u * 1024u)
+#define RECORDING_CHUNK_MAX_NS (10ULL * 1000000000ULL)
+
+// String offset meaning "none"
+#define RECORDING_NO_STRING UINT32_MAX
+
+// Location flag: the address was seen below the innermost frame, so it is
+// a return address (symbolized at address - 1)
+#define RECORDING_LOCATION_CALLER 1u
+
+// Chunk flag: every sample carries its thread's run state
+#define RECORDING_CHUNK_RUN_STATES 1u
+
+// Chunk flag: every sample carries its CPU time weight
+#define RECORDING_CHUNK_CPU_TIMES 2u
+
+// Run state of a sample that has none (PLATFORM_THREAD_UNKNOWN)
+#define RECORDING_RUN_STATE_UNKNOWN 5u
+
+    typedef struct
+    {
+        char magic[8];               // RECORDING_MAGIC
+        uint32_t version;            // RECORDING_VERSION
+        uint32_t header_size;        // sizeof(RecordingFileHeader); chunks start here
+        int32_t pid;                 // Recorded process
+        uint32_t sample_interval_us; // Sampling period
+        uint64_t start_ns;           // Sample clock (CLOCK_MONOTONIC_RAW) when recording started
+        uint64_t start_wall_ns;      // Wall clock (ns since the epoch) at the same moment
+    } RecordingFileHeader;
+
+    typedef struct
+    {
+        uint32_t magic;       // RECORDING_CHUNK_MAGIC
+        uint32_t header_size; // sizeof(RecordingChunkHeader)
+        uint64_t chunk_size;  // Bytes from this header to the next chunk
+        uint64_t start_ns;    // Earliest and latest sample timestamp
+        uint64_t end_ns;
+        uint32_t sample_count;
+        uint32_t thread_count;
+        uint32_t location_count;
+        uint32_t node_count;
+        uint32_t index_count;
+        uint32_t flags; // RECORDING_CHUNK_*
+        uint64_t strings_offset;
+        uint64_t strings_size;
+        uint64_t threads_offset;
+        uint64_t locations_offset;
+        uint64_t nodes_offset;
+        uint64_t index_offset;
+        uint64_t samples_offset;
+        uint64_t samples_size;
+    } RecordingChunkHeader;
+
+    // A thread that has samples in the chunk
+    typedef struct
+    {
+        uint32_t thread_number; // Stable number (see ThreadRecord)
+        uint32_t name;          // String offset
+        uint64_t thread_id;
+    } RecordingThread;
+
+    // A distinct frame address, symbolized when the chunk was written
+    typedef struct
+    {
+        uint64_t address;
+        uint64_t module_base;    // Load address of the module (0 if outside every module)
+        uint64_t symbol_address; // Start of the function (0 if unknown)
+        uint32_t function;       // String offset: symbol name as stored in the binary
+        uint32_t module;         // String offset: module path
+        uint32_t flags;          // RECORDING_LOCATION_*
+        uint32_t reserved;
+    } RecordingLocation;
+
+    // One frame of the stack trie: a location under its caller's node
+    typedef struct
+    {
+        uint32_t parent;   // Caller node (0 = root)
+        uint32_t location; // Index into locations
+    } RecordingNode;
+
+    // Where to start decoding to reach a point in time
+    typedef struct
+    {
+        uint64_t timestamp_ns; // Timestamp of the entry's first sample
+        uint32_t sample;       // Ordinal of the entry's first sample
+        uint32_t offset;       // Its byte offset in the sample stream
+    } RecordingIndexEntry;
+
+    // A decoded sample
+    typedef struct
+    {
+        uint64_t timestamp_ns;
+        uint32_t thread_number;
+        uint32_t node;      // Stack node (innermost frame), 0 for an empty stack
+        uint32_t run_state; // PlatformRunState of the thread, RECORDING_RUN_STATE_UNKNOWN if not recorded
+        uint64_t cpu_time_ns; // CPU time weight (see ProfilerSample), 0 if not recorded
+    } RecordingSample;
+
+    // Symbol of a location, supplied by the writer's owner
+    typedef struct
+    {
+        const char *function; // NULL if unknown
+        const char *module;   // NULL if outside every module
+        uint64_t symbol_address;
+        uint64_t module_base;
+    } RecordingSymbol;
+
+    /**
+     * Resolve a chunk's locations when it is written
+     * The strings only need to live until the callback returns.
+     *
+     * @param addresses Addresses to look up (return addresses already - 1)
+     * @param count Number of addresses
+     * @param symbols Output, one per address (zeroed on entry)
+     */
+    typedef void (*RecordingSymbolizeCallback)(
+        const uint64_t *addresses,
+        uint32_t count,
+        RecordingSymbol *symbols,
+        void *context);
+
+    // Encodes samples into chunks and appends them to a file
+    // Not thread-safe; one thread feeds it.
+    typedef struct RecordingWriter RecordingWriter;
+
+    /**
+     * Create the file and write its header
+     *
+     * @param path File to create (replaced if it exists)
+     * @param pid Recorded process
+     * @param sample_interval_us Sampling period
+     * @param symbolize Resolves locations when a chunk is written (may be NULL)
+     * @param context Passed to symbolize
+     * @return The writer, or NULL on error (errno is set)
+     */
+    RecordingWriter *recording_writer_create(
+        const char *path,
+        int32_t pid,
+        uint32_t sample_interval_us,
+        RecordingSymbolizeCallback symbolize,
+        void *context);
+
+    /**
+     * Write the open chunk, close the file and destroy the writer
+     * @return 0 if every write succeeded, otherwise the first errno
+     */
+    int recording_writer_close(RecordingWriter *writer);
+
+    /**
+     * Whether a stack ID can be used by the open chunk
+     * Stacks are defined per chunk; after a chunk is written, every ID must
+     * be defined again before its next use.
+     */
+    bool recording_writer_has_stack(const RecordingWriter *writer, uint32_t stack_id);
+
+    /**
+     * Define a stack ID for the open chunk
+     *
+     * @param stack_id Caller's ID for the stack (e.g. from the stack table)
+     * @param addresses Frames, innermost first
+     * @param count Number of frames
+     * @return 0 on success, error code otherwise
+     */
+    int recording_writer_define_stack(
+        RecordingWriter *writer,
+        uint32_t stack_id,
+        const uint64_t *addresses,
+        uint32_t count);
+
+    /**
+     * Name a thread (kept across chunks; only the threads a chunk samples
+     * are written to it)
+     */
+    int recording_writer_define_thread(
+        RecordingWriter *writer,
+        uint32_t thread_number,
+        uint64_t thread_id,
+        const char *name);
+
+    /**
+     * Whether a thread number was defined
+     */
+    bool recording_writer_has_thread(const RecordingWriter *writer, uint32_t thread_number);
+
+    /**
+     * Append a sample; its stack must be defined in the open chunk
+     * Writes the chunk out once it is full.
+     *
+     * @param run_state PlatformRunState of the thread (RECORDING_RUN_STATE_UNKNOWN if not known)
+     * @param cpu_time_ns CPU time the sample stands for (0 if not known)
+     * @return 0 on success, error code otherwise
+     */
+    int recording_writer_add_sample(
+        RecordingWriter *writer,
+        uint64_t timestamp_ns,
+        uint32_t thread_number,
+        uint32_t stack_id,
+        uint32_t run_state,
+        uint64_t cpu_time_ns);
+
+    /**
+     * Write the open chunk now (no-op if it is empty)
+     * @return 0 on success, error code otherwise
+     */
+    int recording_writer_flush(RecordingWriter *writer);
+
+    /**
+     * Bytes written to the file so far
+     */
+    uint64_t recording_writer_bytes(const RecordingWriter *writer);
+
+    // A chunk of a mapped recording; pointers into the mapping
+    typedef struct
+    {
+        const RecordingChunkHeader *header;
+        const char *strings;
+        const RecordingThread *threads;
+        const RecordingLocation *locations;
+        const RecordingNode *nodes;
+        const RecordingIndexEntry *index;
+        const uint8_t *samples;
+    } RecordingChunk;
+
+    // Position in a chunk's sample stream
+    typedef struct
+    {
+        const uint8_t *position;
+        const uint8_t *end;
+        const RecordingIndexEntry *index;
+        uint32_t index_count;
+        uint32_t sample;       // Ordinal of the next sample
+        uint32_t sample_count;
+        uint32_t node_count;
+        uint32_t flags;         // Of the chunk
+        uint32_t thread_number; // Of the previous sample
+        uint64_t timestamp_ns;  // Of the previous sample
+    } RecordingCursor;
+
+    // A recording mapped for reading
+    typedef struct RecordingReader RecordingReader;
+
+    /**
+     * Map a recording and list its chunks
+     * A trailing chunk that was not completely written is ignored.
+     *
+     * @return The reader, or NULL if the file cannot be read or is not a recording
+     */
+    RecordingReader *recording_open(const char *path);
+
+    /**
+     * Unmap a recording (invalidates every chunk and string)
+     */
+    void recording_close(RecordingReader *reader);
+
+    /**
+     * The file header
+     */
+    const RecordingFileHeader *recording_header(const RecordingReader *reader);
+
+    /**
+     * Number of complete chunks
+     */
+    uint32_t recording_chunk_count(const RecordingReader *reader);
+
+    /**
+     * Total samples across all chunks
+     */
+    uint64_t recording_sample_count(const RecordingReader *reader);
+
+    /**
+     * Get a chunk by position (chunks are in recording order)
+     * @return 0 on success, -1 if index is out of range
+     */
+    int recording_get_chunk(const RecordingReader *reader, uint32_t index, RecordingChunk *chunk);
+
+    /**
+     * String at an offset of the chunk's string table (NULL for RECORDING_NO_STRING)
+     */
+    const char *recording_chunk_string(const RecordingChunk *chunk, uint32_t offset);
+
+    /**
+     * Lowercase name of a run state ("running", "waiting", ...)
+     * @return The name, or NULL for RECORDING_RUN_STATE_UNKNOWN and unknown values
+     */
+    const char *recording_run_state_name(uint32_t run_state);
+
+    /**
+     * Expand a stack node into location indexes, innermost first
+     *
+     * @return Number of locations written (at most max_locations)
+     */
+    uint32_t recording_chunk_stack(
+        const RecordingChunk *chunk,
+        uint32_t node,
+        uint32_t *locations,
+        uint32_t max_locations);
+
+    /**
+     * Position a cursor at the first sample at or after a timestamp
+     * Uses the time index, so only the samples after the nearest entry
+     * before from_ns are decoded. Pass 0 to start at the beginning.
+     */
+    void recording_cursor_init(
+        const RecordingChunk *chunk,
+        uint64_t from_ns,
+        RecordingCursor *cursor);
+
+    /**
+     * Decode the next sample
+     * @return false at the end of the chunk or on malformed data
+     */
+    bool recording_cursor_next(RecordingCursor *cursor, RecordingSample *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RECORDING_H
@@ -0,0 +1,98 @@
+#ifndef REGION_MAP_H
+#define REGION_MAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "platform.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Mapped regions and loaded modules of a target, for address validation
+    //
+    // Both lists are sorted arrays searched in O(log n). The map is rescanned
+    // only when the target's image list changes (dyld's change timestamp on
+    // Mach) or when a walk reports an address the map does not cover (new
+    // thread stacks, fresh mmaps; rate limited). Lookups may run
+    // concurrently with each other and with region_map_note_unknown;
+    // refresh, update and destroy may not overlap them.
+    typedef struct RegionMap RegionMap;
+
+    /**
+     * Scan the regions and modules of the target
+     *
+     * @param task The target task
+     * @return The map, or NULL on allocation failure
+     */
+    RegionMap *region_map_create(task_t task);
+
+    /**
+     * Destroy a map and release its memory
+     */
+    void region_map_destroy(RegionMap *map);
+
+    /**
+     * Rescan regions and modules unconditionally
+     *
+     * @return 0 on success, error code otherwise (the map keeps its old contents)
+     */
+    int region_map_refresh(RegionMap *map);
+
+    /**
+     * Rescan if the target's images changed, or if a walk hit an unknown
+     * address and the last rescan is old enough. Cheap when nothing changed
+     * (one task_info and one small read on Mach, nothing on Linux).
+     *
+     * @param images_changed Output: whether the modules were rescanned too
+     * @return true if the map was rescanned
+     */
+    bool region_map_update(RegionMap *map, bool *images_changed);
+
+    /**
+     * Find the region containing address
+     *
+     * @return The region (valid until the next rescan), or NULL for unmapped memory
+     */
+    const PlatformRegion *region_map_find(const RegionMap *map, uint64_t address);
+
+    /**
+     * Find the module whose code contains address
+     *
+     * @param module Output: the module (valid until the next rescan)
+     * @param offset Output (may be NULL): address - module base
+     * @return true if address is inside a module's code
+     */
+    bool region_map_find_module(
+        const RegionMap *map,
+        uint64_t address,
+        const PlatformModule **module,
+        uint64_t *offset);
+
+    /**
+     * Report an address the map did not cover; the next update rescans
+     * Safe to call from any walker thread.
+     */
+    void region_map_note_unknown(const RegionMap *map);
+
+    /**
+     * Number of regions in the map
+     */
+    uint32_t region_map_region_count(const RegionMap *map);
+
+    /**
+     * Number of modules in the map
+     */
+    uint32_t region_map_module_count(const RegionMap *map);
+
+    /**
+     * Number of rescans since the map was created (including the first)
+     */
+    uint64_t region_map_scan_count(const RegionMap *map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REGION_MAP_H
@@ -0,0 +1,88 @@
+#ifndef STACK_TABLE_H
+#define STACK_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stack_walker.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Stack ID of the empty stack (also "not interned")
+#define STACK_ID_EMPTY 0
+
+    // Interning table for call stacks
+    //
+    // Stacks are hash-consed into a prefix trie rooted at the outermost
+    // frame: each node is (parent node, return address) and a stack ID is the
+    // node of its innermost frame. Stacks that share callers share nodes, so
+    // memory grows with the number of distinct call paths, not with the
+    // number of samples. Not thread-safe; callers serialize access.
+    typedef struct StackTable StackTable;
+
+    /**
+     * Create an empty table
+     * @return The table, or NULL on allocation failure
+     */
+    StackTable *stack_table_create(void);
+
+    /**
+     * Destroy a table and release its memory
+     */
+    void stack_table_destroy(StackTable *table);
+
+    /**
+     * Intern a stack
+     *
+     * @param table The table
+     * @param frames Frames, innermost first (as produced by the walker)
+     * @param frame_count Number of frames
+     * @return Stack ID (STACK_ID_EMPTY for an empty stack or on allocation failure)
+     */
+    uint32_t stack_table_intern(
+        StackTable *table,
+        const StackFrame *frames,
+        uint32_t frame_count);
+
+    /**
+     * Number of frames in an interned stack
+     */
+    uint32_t stack_table_depth(const StackTable *table, uint32_t stack_id);
+
+    /**
+     * Expand a stack ID back into its return addresses
+     *
+     * @param table The table
+     * @param stack_id Stack ID returned by stack_table_intern
+     * @param addresses Output, innermost first
+     * @param max_addresses Capacity of addresses
+     * @return Number of addresses written
+     */
+    uint32_t stack_table_get(
+        const StackTable *table,
+        uint32_t stack_id,
+        uint64_t *addresses,
+        uint32_t max_addresses);
+
+    /**
+     * Number of distinct stacks interned so far
+     */
+    uint64_t stack_table_stack_count(const StackTable *table);
+
+    /**
+     * Number of distinct frame addresses seen so far
+     */
+    uint64_t stack_table_unique_addresses(const StackTable *table);
+
+    /**
+     * Bytes currently allocated by the table
+     */
+    uint64_t stack_table_memory_usage(const StackTable *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STACK_TABLE_H
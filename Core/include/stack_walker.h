@@ -1,7 +1,10 @@
 #ifndef STACK_WALKER_H
 #define STACK_WALKER_H
 
-#include <mach/mach.h>
+#include "platform.h"
+#include "unwind_table.h"
+#include "region_map.h"
+#include "async_unwind.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -13,6 +16,21 @@ extern "C"
 // Maximum stack depth we'll capture
 #define MAX_STACK_DEPTH 512
 
+// Default and maximum number of stack bytes copied from SP in one go
+#define STACK_WINDOW_DEFAULT_SIZE (32 * 1024)
+#define STACK_WINDOW_MAX_SIZE (1024 * 1024)
+
+// Default and maximum number of threads walking a batch in parallel
+#define STACK_WALKER_DEFAULT_WORKERS 4
+#define STACK_WALKER_MAX_WORKERS 16
+
+// Address of the frame that separates a physical stack from the await
+// chain spliced in by track_async. The frames after it are the callers
+// awaiting the innermost async function (innermost first), each stored as
+// its continuation's address + 1 so the usual return address lookup at
+// address - 1 lands on it; the physical frames of the executor follow.
+#define STACK_FRAME_ASYNC_MARKER 1ULL
+
     // Structure to hold a single stack frame
     typedef struct
     {
@@ -20,22 +38,72 @@ extern "C"
         uint64_t frame_pointer; // Frame pointer (for debugging)
     } StackFrame;
 
-    // Structure to hold a complete stack trace
+    // Growable buffer that holds the frames of many traces back to back
+    // One arena is reused across captures (reset, not freed), so a
+    // snapshot of N threads costs N small headers plus the frames that were
+    // actually walked.
     typedef struct
     {
-        StackFrame frames[MAX_STACK_DEPTH];
+        StackFrame *frames;
+        uint32_t capacity; // Frames allocated
+        uint32_t used;     // Frames handed out since the last reset
+    } StackFrameArena;
+
+    // Registers a walk starts from
+    // Kept per thread so that a thread which has not moved since its
+    // previous walk is recognized before any of its memory is read (see
+    // StackTrace.unchanged). An origin with pc 0 matches nothing.
+    typedef struct
+    {
+        uint64_t pc;
+        uint64_t sp;
+        uint64_t fp;
+    } StackWalkOrigin;
+
+    // Parts of a capture timed into StackTrace.phase_ns
+    typedef enum
+    {
+        STACK_PHASE_SUSPEND = 0, // Stopping the thread (a snapshot charges the whole-task stop to its first thread)
+        STACK_PHASE_REGISTERS,   // Reading or peeking its registers
+        STACK_PHASE_READ,        // Reads of target memory: the window copy and any reads past it
+        STACK_PHASE_WALK,        // Unwinding, not counting its reads
+        STACK_PHASE_RESUME,      // Letting the thread run again (the whole-task restart, for a snapshot)
+        STACK_PHASE_COUNT
+    } StackWalkPhase;
+
+    // Header of a captured stack trace
+    // Frames live in a StackFrameArena at [frame_offset, frame_offset + frame_count);
+    // they are addressed by offset so the arena can grow without invalidating
+    // traces. Use stack_trace_frames to get a pointer to them.
+    typedef struct
+    {
+        uint32_t frame_offset; // Index of the first frame in the arena
         uint32_t frame_count;
         thread_t thread;
+        uint32_t thread_number;  // Stable number from the thread registry, 0 if unknown
         uint64_t thread_id;
-        uint64_t timestamp_ns; // When this was captured (nanoseconds)
+        uint64_t timestamp_ns;   // When this was captured (nanoseconds)
+        uint32_t remote_reads;   // Reads of target memory issued for this trace
+        uint32_t failed_reads;   // Of those, reads that came back short or faulted
+        uint32_t rejected_reads; // Reads and addresses the region map ruled out without a syscall
+        uint32_t kernel_calls;   // Calls into the kernel for this trace: stop, registers, reads, resume, ID
+        uint32_t stack_id;       // Interned stack (see stack_table.h), 0 if not interned
+        StackWalkOrigin origin;  // Registers the walk started from (pc 0 if they could not be read)
+        bool unchanged;          // Registers matched the caller's hint; nothing was walked
+        uint32_t cached_frames;  // Frames copied from the thread's previous walk instead of read
+        uint64_t pause_ns;       // Time the thread was stopped for this trace (0 if it was not)
+        uint32_t optimistic_attempts; // Walks made without stopping the thread (0 if it was stopped)
+        bool torn;               // Every such walk raced the thread; the trace was discarded (no frames)
+        uint64_t phase_ns[STACK_PHASE_COUNT]; // Time spent in each phase of this capture
+        uint64_t bytes_read;     // Target memory copied by the reads that succeeded
     } StackTrace;
 
     // Stack walking strategies
     typedef enum
     {
         STACK_WALK_FRAME_POINTER, // Use frame pointer chain (fastest)
-        STACK_WALK_LIBUNWIND,     // Use libunwind (more reliable)
-        STACK_WALK_HYBRID         // Try FP first, fallback to libunwind
+        STACK_WALK_LIBUNWIND,     // Use CFI unwind tables (handles frameless code)
+        STACK_WALK_HYBRID         // CFI where the tables cover the PC, frame pointers elsewhere
     } StackWalkStrategy;
 
     // Configuration for stack walker
@@ -45,49 +113,152 @@ extern "C"
         uint32_t max_depth;      // Max frames to capture
         bool capture_timestamps; // Include timestamps
         bool validate_addresses; // Extra validation (slower)
+        bool capture_thread_ids; // Look up thread_id on every capture (off if the caller caches IDs)
+        uint32_t stack_window_size; // Bytes copied from SP up front (0 = read per frame)
+        uint32_t capture_workers;   // Threads walking a batch in parallel (1 = serial)
+        bool track_async;           // Splice in the await chains of Swift async frames (needs a layout)
+        bool cache_suffixes;        // Reuse the outer frames of a thread's previous frame pointer walk
+                                    // where its frame records are unchanged
+        bool optimistic_capture;    // Walk threads without stopping them where their registers can be
+                                    // read (see stack_walker_capture)
     } StackWalkerConfig;
 
+    // Calls the walker makes on its target
+    // The platform.h functions of the same names serve a live process;
+    // a caller can install its own to capture from something else.
+    typedef struct
+    {
+        int (*thread_suspend)(task_t task, thread_t thread);
+        int (*thread_resume)(task_t task, thread_t thread);
+        int (*task_suspend)(task_t task, const thread_t *threads, mach_msg_type_number_t count, bool *stopped);
+        int (*task_resume)(task_t task, const thread_t *threads, mach_msg_type_number_t count, const bool *stopped);
+        int (*thread_get_registers)(task_t task, thread_t thread, PlatformRegisters *regs);
+        int (*thread_peek_registers)(task_t task, thread_t thread, PlatformRegisters *regs);
+        int (*read_memory)(task_t task, uint64_t address, void *buffer, size_t size);
+        size_t (*read_memory_batch)(task_t task, const PlatformReadRequest *requests, size_t count);
+    } StackWalkerTargetOps;
+
     /**
      * Initialize stack walker with configuration
      * @param config Configuration (NULL for defaults)
      */
     void stack_walker_init(const StackWalkerConfig *config);
 
+    /**
+     * Allocate an arena with room for initial_capacity frames
+     * @return 0 on success, error code otherwise
+     */
+    int stack_frame_arena_init(StackFrameArena *arena, uint32_t initial_capacity);
+
+    /**
+     * Forget all frames (keeps the memory for the next capture)
+     */
+    void stack_frame_arena_reset(StackFrameArena *arena);
+
+    /**
+     * Release the arena's memory
+     */
+    void stack_frame_arena_destroy(StackFrameArena *arena);
+
+    /**
+     * Frames of a trace captured into arena
+     * Valid until the arena grows, is reset or is destroyed.
+     */
+    const StackFrame *stack_trace_frames(
+        const StackFrameArena *arena,
+        const StackTrace *trace);
+
     /**
      * Capture the stack trace for a given thread
      *
+     * With optimistic_capture the thread is not stopped if its registers
+     * can be read while it runs (any thread on Mach; blocked threads on
+     * Linux, whose FP is then found by searching the stack window for a
+     * frame record). The walk is kept only if the thread's PC and SP did not
+     * change during it; a walk that raced the thread is retried a few times
+     * and then discarded (trace->torn). Other threads are stopped as usual.
+     *
      * @param task The task port of the target process
      * @param thread The thread to capture
+     * @param arena Arena that receives the frames (grown if needed)
      * @param trace Output structure to fill with stack data
      * @return 0 on success, error code otherwise
      */
     int stack_walker_capture(
         task_t task,
         thread_t thread,
+        StackFrameArena *arena,
         StackTrace *trace);
 
     /**
      * Capture stacks for multiple threads (batch operation)
-     * More efficient than calling stack_walker_capture multiple times
+     * More efficient than calling stack_walker_capture multiple times:
+     * the threads are spread over capture_workers threads, each with its own
+     * scratch, so the batch finishes in a fraction of the time and its
+     * timestamps are closer together. traces[i] always belongs to
+     * threads[i] and frames land in arena in thread order.
+     *
+     * A thread whose registers equal its hint is not walked: its trace is
+     * marked unchanged, has no frames and costs no memory reads, and the
+     * caller reuses what it walked last time. Its registers are peeked
+     * without stopping it where the platform allows, so such a thread is
+     * usually not stopped at all. Only pass a hint when the thread cannot
+     * have run since (its CPU time did not move); equal registers alone do
+     * not prove the stack is the same.
      *
      * @param task The task port
      * @param threads Array of threads
      * @param thread_count Number of threads
+     * @param hints Origin of each thread's previous walk (NULL to walk every thread)
+     * @param arena Arena that receives the frames (grown if needed)
      * @param traces Output array (must be pre-allocated)
-     * @return Number of successful captures
+     * @return Number of successful captures, unchanged threads included
      */
     int stack_walker_capture_batch(
         task_t task,
-        thread_t *threads,
+        const thread_t *threads,
         uint32_t thread_count,
+        const StackWalkOrigin *hints,
+        StackFrameArena *arena,
         StackTrace *traces);
 
+    /**
+     * Capture every thread from a single whole-task pause
+     * The task is stopped once, just long enough to read each thread's
+     * registers and copy the top stack_window_size bytes of its stack; the
+     * target is then resumed and the stacks are unwound from the copies.
+     * All traces share one timestamp. Frames beyond the copied window are
+     * not followed, so size the window for the deepest stacks of interest.
+     * Hints work as in stack_walker_capture_batch; unchanged threads are
+     * found before the pause and their windows are not copied, which
+     * shortens it (and skips it when no thread moved). If the task cannot
+     * be stopped, the threads that moved are captured one at a time instead.
+     *
+     * @param task The task port
+     * @param threads Array of threads
+     * @param thread_count Number of threads
+     * @param hints Origin of each thread's previous walk (NULL to walk every thread)
+     * @param arena Arena that receives the frames (grown if needed)
+     * @param traces Output array (must be pre-allocated)
+     * @param pause_ns Output: how long the target was stopped
+     * @return Number of successful captures, unchanged threads included
+     */
+    int stack_walker_capture_snapshot(
+        task_t task,
+        const thread_t *threads,
+        uint32_t thread_count,
+        const StackWalkOrigin *hints,
+        StackFrameArena *arena,
+        StackTrace *traces,
+        uint64_t *pause_ns);
+
     /**
      * Print a stack trace to stdout (for debugging)
      *
+     * @param arena Arena the trace was captured into
      * @param trace The stack trace to print
      */
-    void stack_walker_print(const StackTrace *trace);
+    void stack_walker_print(const StackFrameArena *arena, const StackTrace *trace);
 
     /**
      * Get thread ID for display purposes
@@ -98,6 +269,32 @@ extern "C"
      */
     int stack_walker_get_thread_id(thread_t thread, uint64_t *thread_id);
 
+    /**
+     * Set the unwind table used by STACK_WALK_LIBUNWIND and STACK_WALK_HYBRID
+     * The table must outlive every capture that uses it; pass NULL to clear.
+     */
+    void stack_walker_set_unwind_table(const UnwindTable *table);
+
+    /**
+     * Set the region map used to validate stack reads and code addresses
+     * Without one, addresses are only checked against the user address
+     * range. The map must outlive every capture that uses it; pass NULL to clear.
+     */
+    void stack_walker_set_region_map(const RegionMap *map);
+
+    /**
+     * Set the async context layout of the target's Swift runtime, used when
+     * track_async is set (see async_unwind.h); pass NULL to clear
+     */
+    void stack_walker_set_async_layout(const AsyncContextLayout *layout);
+
+    /**
+     * Set the calls used to reach the target of every capture
+     * The table must outlive every capture that uses it; pass NULL to go
+     * back to the platform layer.
+     */
+    void stack_walker_set_target_ops(const StackWalkerTargetOps *ops);
+
     /**
      * Cleanup and release resources
      */
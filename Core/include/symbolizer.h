@@ -0,0 +1,89 @@
+#ifndef SYMBOLIZER_H
+#define SYMBOLIZER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "platform.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Environment variable overriding the symbol cache directory (empty disables the cache)
+#define SYMBOLIZER_CACHE_ENV "SWIFT_ASYNC_PROFILER_SYMBOL_CACHE"
+
+    // Result of resolving one address
+    typedef struct
+    {
+        const char *name;        // Symbol name as stored in the binary (NULL if none covers the address)
+        const char *module;      // Path of the containing module (NULL if outside every module)
+        uint64_t symbol_address; // Runtime start of the symbol (0 if name is NULL)
+        uint64_t module_base;    // Runtime load address of the module (0 if module is NULL)
+    } SymbolInfo;
+
+    // Address -> symbol resolver for every module loaded in a target
+    //
+    // A module's symbol table (.symtab/.dynsym on ELF, LC_SYMTAB on Mach-O)
+    // is parsed the first time an address inside it is resolved, into a
+    // sorted index laid out in Eytzinger (BFS) order over an interned string
+    // pool. The index is written to an mmap-able cache file named after the
+    // module's build ID (ELF NT_GNU_BUILD_ID, Mach-O LC_UUID), so later
+    // sessions against the same binary map it instead of parsing again.
+    // Not thread-safe; callers serialize access.
+    typedef struct Symbolizer Symbolizer;
+
+    /**
+     * Create a symbolizer for the modules currently loaded in the target
+     *
+     * @param task The target task
+     * @param cache_dir Directory for cache files (NULL for the default,
+     *        see SYMBOLIZER_CACHE_ENV; "" disables the cache)
+     * @return The symbolizer, or NULL on allocation failure
+     */
+    Symbolizer *symbolizer_create(task_t task, const char *cache_dir);
+
+    /**
+     * Pick up modules loaded or unloaded since the last refresh
+     * Modules that are still loaded keep their index. Names returned
+     * before the refresh for modules that went away become invalid.
+     *
+     * @return 0 on success, error code otherwise (the symbolizer stays usable)
+     */
+    int symbolizer_refresh(Symbolizer *symbolizer);
+
+    /**
+     * Destroy a symbolizer (invalidates every name it returned)
+     */
+    void symbolizer_destroy(Symbolizer *symbolizer);
+
+    /**
+     * Resolve a batch of addresses
+     * For return addresses, pass address - 1 so a call at the very end of a
+     * function resolves to the caller rather than the next symbol.
+     *
+     * @param symbolizer The symbolizer
+     * @param addresses Addresses to resolve
+     * @param count Number of addresses
+     * @param symbols Output, one per address; strings stay valid until
+     *        the module is unloaded (see symbolizer_refresh) or destroy
+     * @return Number of addresses that resolved to a symbol
+     */
+    uint32_t symbolizer_resolve(
+        Symbolizer *symbolizer,
+        const uint64_t *addresses,
+        uint32_t count,
+        SymbolInfo *symbols);
+
+    /**
+     * Modules whose index came from the cache / was parsed (and written)
+     * this session
+     */
+    uint32_t symbolizer_cache_hits(const Symbolizer *symbolizer);
+    uint32_t symbolizer_modules_parsed(const Symbolizer *symbolizer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SYMBOLIZER_H
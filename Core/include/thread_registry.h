@@ -0,0 +1,135 @@
+#ifndef THREAD_REGISTRY_H
+#define THREAD_REGISTRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "platform.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Kind of a thread lifecycle event
+    typedef enum
+    {
+        THREAD_EVENT_CREATED = 0,
+        THREAD_EVENT_EXITED = 1
+    } ThreadEventType;
+
+    // A thread that appeared or disappeared between two refreshes
+    typedef struct
+    {
+        uint32_t type;          // ThreadEventType
+        uint32_t thread_number; // Stable number of the thread (see ThreadRecord)
+        uint64_t thread_id;     // System-wide thread ID
+        uint64_t timestamp_ns;  // When the refresh noticed it (same clock as StackTrace)
+    } ThreadEvent;
+
+    // A live thread of the target
+    // Everything but the handle is looked up once, when the thread is first
+    // seen, so sampling never asks the kernel for it again. The name and
+    // queue label are those current at that moment.
+    typedef struct
+    {
+        thread_t thread;                            // Handle (Mach port or tid), owned by the registry
+        uint32_t thread_number;                     // 1, 2, 3... in order of discovery; never reused
+        uint64_t thread_id;                         // System-wide thread ID
+        uint64_t created_ns;                        // When the thread was first seen
+        uint32_t qos;                               // See PlatformThreadMetadata
+        int32_t priority;                           // See PlatformThreadMetadata
+        char name[PLATFORM_THREAD_NAME_MAX];        // Thread name ("" if unnamed)
+        char queue_label[PLATFORM_THREAD_NAME_MAX]; // Dispatch queue label ("" if none)
+    } ThreadRecord;
+
+// CPU time baseline of a thread not sampled yet
+#define THREAD_REGISTRY_NO_CPU_TIME UINT64_MAX
+
+    // What the sampler saw of a thread at its previous sample
+    typedef struct
+    {
+        uint64_t cpu_time_ns; // User+system CPU time (THREAD_REGISTRY_NO_CPU_TIME before the first sample)
+        uint64_t pc;          // Registers the previous walk started from (pc 0 if none)
+        uint64_t sp;
+        uint64_t fp;
+        uint32_t stack_id;    // Stack that walk produced (0 if none)
+    } ThreadSampleState;
+
+    // Called once per lifecycle event during a refresh
+    typedef void (*ThreadEventCallback)(const ThreadEvent *event, void *context);
+
+    // The target's thread list, kept up to date by diffing
+    //
+    // Each refresh lists the target's threads once and compares the result
+    // with the previous list: surviving threads keep their handle, record
+    // and position, exited threads are dropped and new ones are appended.
+    // Not thread-safe; callers serialize access.
+    typedef struct ThreadRegistry ThreadRegistry;
+
+    /**
+     * Create an empty registry for a target (call refresh to fill it)
+     * @return The registry, or NULL on allocation failure
+     */
+    ThreadRegistry *thread_registry_create(task_t task);
+
+    /**
+     * Destroy a registry and release every thread handle it holds
+     */
+    void thread_registry_destroy(ThreadRegistry *registry);
+
+    /**
+     * Bring the list up to date with the target
+     *
+     * @param registry The registry
+     * @param callback Called for every created and exited thread (may be NULL)
+     * @param context Passed to callback
+     * @return 0 on success, error code otherwise (the list is unchanged)
+     */
+    int thread_registry_refresh(
+        ThreadRegistry *registry,
+        ThreadEventCallback callback,
+        void *context);
+
+    /**
+     * Number of live threads
+     */
+    uint32_t thread_registry_count(const ThreadRegistry *registry);
+
+    /**
+     * Handles of the live threads, in registry order
+     * Valid until the next refresh.
+     */
+    const thread_t *thread_registry_threads(const ThreadRegistry *registry);
+
+    /**
+     * Records of the live threads, parallel to thread_registry_threads
+     * Valid until the next refresh.
+     */
+    const ThreadRecord *thread_registry_records(const ThreadRegistry *registry);
+
+    /**
+     * Sampler state of the live threads, parallel to thread_registry_threads
+     * Entries follow their thread across refreshes; new threads start with
+     * no CPU time, registers or stack. Valid until the next refresh; only
+     * the refreshing thread may use them.
+     */
+    ThreadSampleState *thread_registry_sample_states(ThreadRegistry *registry);
+
+    /**
+     * Forget what the sampler saw of every thread
+     */
+    void thread_registry_reset_sample_states(ThreadRegistry *registry);
+
+    /**
+     * Record of the live thread with a given number
+     * Valid until the next refresh.
+     *
+     * @return The record, or NULL if no live thread has that number
+     */
+    const ThreadRecord *thread_registry_find(const ThreadRegistry *registry, uint32_t thread_number);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // THREAD_REGISTRY_H
@@ -0,0 +1,102 @@
+#ifndef UNWIND_TABLE_H
+#define UNWIND_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "platform.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Where the canonical frame address (the caller's SP) is computed from
+    typedef enum
+    {
+        UNWIND_CFA_UNDEFINED = 0, // No usable rule (e.g. a DWARF expression)
+        UNWIND_CFA_SP = 1,
+        UNWIND_CFA_FP = 2
+    } UnwindCfaBase;
+
+    // How the caller's value of a register is recovered
+    typedef enum
+    {
+        UNWIND_REG_SAME = 0,      // Unchanged (for the return address: still in LR)
+        UNWIND_REG_AT_CFA = 1,    // Saved at CFA + offset
+        UNWIND_REG_UNDEFINED = 2  // Not recoverable (for the return address: outermost frame)
+    } UnwindRegRule;
+
+    // Unwind rule for one PC range, compiled from .eh_frame / __unwind_info
+    // A row covers [offset, offset of the next row) relative to its
+    // module's start. 16 bytes, so four rows share a cache line.
+    typedef struct
+    {
+        uint32_t offset;    // Start of the range, relative to the module start
+        uint8_t cfa_base;   // UnwindCfaBase
+        uint8_t ra_rule;    // UnwindRegRule for the return address
+        uint8_t fp_rule;    // UnwindRegRule for the frame pointer
+        uint8_t reserved;
+        int32_t cfa_offset; // CFA = base register + cfa_offset
+        int16_t ra_offset;  // From the CFA, when ra_rule is UNWIND_REG_AT_CFA
+        int16_t fp_offset;  // From the CFA, when fp_rule is UNWIND_REG_AT_CFA
+    } UnwindRow;
+
+    // Precompiled unwind rules for every module loaded in a target
+    //
+    // Each module's unwind sections are parsed once, when the module is
+    // first seen, into a flat array of UnwindRows sorted by PC. A lookup is
+    // two binary searches (module, then row) over contiguous memory.
+    // Lookups may run concurrently; refresh and destroy may not overlap them.
+    typedef struct UnwindTable UnwindTable;
+
+    /**
+     * Build the table for every module currently loaded in the target
+     *
+     * @param task The target task
+     * @return The table, or NULL on allocation failure
+     */
+    UnwindTable *unwind_table_create(task_t task);
+
+    /**
+     * Pick up modules loaded or unloaded since the last refresh
+     * Modules that are still loaded keep their compiled rows.
+     *
+     * @return 0 on success, error code otherwise (the table stays usable)
+     */
+    int unwind_table_refresh(UnwindTable *table);
+
+    /**
+     * Destroy a table and release its memory
+     */
+    void unwind_table_destroy(UnwindTable *table);
+
+    /**
+     * Find the unwind rule covering pc
+     *
+     * @param table The table
+     * @param pc Address inside a function (use return address - 1 for callers)
+     * @param row Output: the rule
+     * @return true if some module has a rule for pc
+     */
+    bool unwind_table_find(const UnwindTable *table, uint64_t pc, UnwindRow *row);
+
+    /**
+     * Number of modules with unwind rules
+     */
+    uint32_t unwind_table_module_count(const UnwindTable *table);
+
+    /**
+     * Number of compiled rows across all modules
+     */
+    uint64_t unwind_table_row_count(const UnwindTable *table);
+
+    /**
+     * Bytes currently allocated by the table
+     */
+    uint64_t unwind_table_memory_usage(const UnwindTable *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UNWIND_TABLE_H
@@ -0,0 +1,137 @@
+#include "profiler.h"
+#include "profiler_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Helper: Replace frame addresses with the start of their function
+// Every frame but a stack's first is a return address, looked up at
+// address - 1 so a call at the very end of a function stays inside it.
+static int map_to_functions(
+    ProfilerInternalData *internal,
+    task_t task,
+    std::vector<uint64_t> &frames,
+    const std::vector<uint32_t> &offsets)
+{
+    std::vector<uint64_t> lookups(frames.size());
+    for (size_t s = 0; s + 1 < offsets.size(); s++)
+    {
+        for (uint32_t i = offsets[s]; i < offsets[s + 1]; i++)
+            lookups[i] = i == offsets[s] ? frames[i] : frames[i] - 1;
+    }
+
+    // Only addresses never seen before go to the symbolizer, in one batch
+    std::vector<uint64_t> misses;
+    pthread_mutex_lock(&internal->symbolizer_lock);
+    for (uint64_t lookup : lookups)
+    {
+        if (internal->function_starts.find(lookup) == internal->function_starts.end())
+            misses.push_back(lookup);
+    }
+    pthread_mutex_unlock(&internal->symbolizer_lock);
+
+    if (!misses.empty())
+    {
+        std::sort(misses.begin(), misses.end());
+        misses.erase(std::unique(misses.begin(), misses.end()), misses.end());
+
+        SymbolInfo *symbols = (SymbolInfo *)calloc(misses.size(), sizeof(SymbolInfo));
+        if (!symbols)
+            return -1;
+        int result = profiler_symbolize_addresses(internal, task, misses.data(), (uint32_t)misses.size(), symbols);
+        if (result != 0)
+        {
+            free(symbols);
+            return result;
+        }
+
+        pthread_mutex_lock(&internal->symbolizer_lock);
+        for (size_t i = 0; i < misses.size(); i++)
+        {
+            uint64_t start = symbols[i].name ? symbols[i].symbol_address : misses[i];
+            internal->function_starts[misses[i]] = start;
+        }
+        pthread_mutex_unlock(&internal->symbolizer_lock);
+        free(symbols);
+    }
+
+    pthread_mutex_lock(&internal->symbolizer_lock);
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        if (frames[i] == STACK_FRAME_ASYNC_MARKER)
+            continue;
+        auto it = internal->function_starts.find(lookups[i]);
+        frames[i] = it != internal->function_starts.end() ? it->second : lookups[i];
+    }
+    pthread_mutex_unlock(&internal->symbolizer_lock);
+    return 0;
+}
+
+int profiler_aggregate_samples(
+    ProfilerTarget *target,
+    const ProfilerSample *samples,
+    uint32_t sample_count,
+    CallTree *tree,
+    bool by_function,
+    ProfilerSampleWeight weight)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (!internal || !internal->stacks || target->state == PROFILER_STATE_DETACHED)
+    {
+        return -1;
+    }
+
+    // Group the batch by stack so each distinct stack is expanded and
+    // added once
+    std::vector<std::pair<uint32_t, uint64_t>> ids(sample_count);
+    for (uint32_t i = 0; i < sample_count; i++)
+    {
+        ids[i].first = samples[i].stack_id;
+        ids[i].second = weight == PROFILER_WEIGHT_CPU_TIME ? samples[i].cpu_time_ns : 1;
+    }
+    std::sort(ids.begin(), ids.end(),
+              [](const std::pair<uint32_t, uint64_t> &a, const std::pair<uint32_t, uint64_t> &b)
+              { return a.first < b.first; });
+
+    std::vector<uint64_t> frames;
+    std::vector<uint32_t> offsets(1, 0);
+    std::vector<uint64_t> weights;
+
+    pthread_mutex_lock(&internal->stacks_lock);
+    for (uint32_t i = 0; i < sample_count;)
+    {
+        uint32_t id = ids[i].first;
+        uint64_t total = 0;
+        uint32_t run = i;
+        for (; run < sample_count && ids[run].first == id; run++)
+            total += ids[run].second;
+
+        uint32_t depth = id == STACK_ID_EMPTY || total == 0 ? 0 : stack_table_depth(internal->stacks, id);
+        if (depth > 0)
+        {
+            size_t offset = frames.size();
+            frames.resize(offset + depth);
+            uint32_t count = stack_table_get(internal->stacks, id, frames.data() + offset, depth);
+            frames.resize(offset + count);
+            offsets.push_back((uint32_t)frames.size());
+            weights.push_back(total);
+        }
+        i = run;
+    }
+    pthread_mutex_unlock(&internal->stacks_lock);
+
+    if (by_function)
+    {
+        int result = map_to_functions(internal, target->task, frames, offsets);
+        if (result != 0)
+            return result;
+    }
+
+    for (size_t s = 0; s < weights.size(); s++)
+    {
+        if (call_tree_add(tree, frames.data() + offsets[s], offsets[s + 1] - offsets[s], weights[s]) != 0)
+            return -1;
+    }
+    return 0;
+}
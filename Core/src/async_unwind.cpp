@@ -0,0 +1,235 @@
+#include "async_unwind.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+// Address bits of a pointer stored in the target; arm64e signs code and
+// context pointers in the bits above the 47-bit address space
+#if (defined(__arm64__) || defined(__aarch64__)) && defined(PLATFORM_MACH)
+#define ASYNC_POINTER_MASK 0x00007FFFFFFFFFFFULL
+#else
+#define ASYNC_POINTER_MASK 0x0000FFFFFFFFFFFFULL
+#endif
+
+// Known layouts, oldest first
+static const AsyncContextLayout g_layouts[] = {
+    // Swift 5.5: AsyncContext starts with Parent and ResumeParent; async
+    // frames set bit 60 of the saved frame pointer and keep the context in
+    // the slot below it (swift_async_extendedFramePointerFlags)
+    {ASYNC_RUNTIME_VERSION(5, 5), 1ULL << 60, 8, 0, 8, ASYNC_POINTER_MASK},
+};
+
+#define ASYNC_LAYOUT_COUNT (sizeof(g_layouts) / sizeof(g_layouts[0]))
+
+// Largest span of a context read as one block
+#define ASYNC_COMBINED_READ_SIZE 32
+
+// Versions resolved so far; a process only ever loads one or two runtimes
+#define ASYNC_LAYOUT_CACHE_SIZE 8
+
+typedef struct
+{
+    uint32_t version;
+    const AsyncContextLayout *layout;
+} AsyncLayoutCacheEntry;
+
+static AsyncLayoutCacheEntry g_layout_cache[ASYNC_LAYOUT_CACHE_SIZE];
+static uint32_t g_layout_cache_count = 0;
+static pthread_mutex_t g_layout_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Helper: Newest layout no newer than version
+static const AsyncContextLayout *resolve_layout(uint32_t version)
+{
+    if (version == 0)
+        return &g_layouts[ASYNC_LAYOUT_COUNT - 1];
+
+    const AsyncContextLayout *layout = NULL;
+    for (size_t i = 0; i < ASYNC_LAYOUT_COUNT; i++)
+    {
+        if (g_layouts[i].min_version <= version)
+            layout = &g_layouts[i];
+    }
+    return layout;
+}
+
+const AsyncContextLayout *async_layout_for_version(uint32_t version)
+{
+    pthread_mutex_lock(&g_layout_cache_lock);
+    for (uint32_t i = 0; i < g_layout_cache_count; i++)
+    {
+        if (g_layout_cache[i].version == version)
+        {
+            const AsyncContextLayout *layout = g_layout_cache[i].layout;
+            pthread_mutex_unlock(&g_layout_cache_lock);
+            return layout;
+        }
+    }
+
+    const AsyncContextLayout *layout = resolve_layout(version);
+    if (g_layout_cache_count < ASYNC_LAYOUT_CACHE_SIZE)
+    {
+        g_layout_cache[g_layout_cache_count].version = version;
+        g_layout_cache[g_layout_cache_count].layout = layout;
+        g_layout_cache_count++;
+    }
+    pthread_mutex_unlock(&g_layout_cache_lock);
+    return layout;
+}
+
+uint32_t async_runtime_version(const char *path)
+{
+    if (!path)
+        return 0;
+
+    for (const char *p = strstr(path, "swift-"); p; p = strstr(p + 1, "swift-"))
+    {
+        const char *digits = p + strlen("swift-");
+        if (!isdigit((unsigned char)digits[0]))
+            continue;
+
+        char *end;
+        unsigned long major = strtoul(digits, &end, 10);
+        if (*end != '.' || !isdigit((unsigned char)end[1]))
+            continue;
+        unsigned long minor = strtoul(end + 1, &end, 10);
+        if (major == 0 || major > 255 || minor > 255)
+            continue;
+
+        return ASYNC_RUNTIME_VERSION(major, minor);
+    }
+    return 0;
+}
+
+bool async_is_runtime_module(const char *path)
+{
+    if (!path)
+        return false;
+
+    const char *slash = strrchr(path, '/');
+    const char *name = slash ? slash + 1 : path;
+    return strncmp(name, "libswift_Concurrency.", strlen("libswift_Concurrency.")) == 0;
+}
+
+bool async_snapshot_read(void *snapshot, uint64_t address, void *buffer, size_t size)
+{
+    const AsyncMemorySnapshot *memory = (const AsyncMemorySnapshot *)snapshot;
+
+    // Last range starting at or below address
+    uint32_t low = 0;
+    uint32_t high = memory->range_count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (memory->ranges[mid].address <= address)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == 0)
+        return false;
+
+    const AsyncMemoryRange *range = &memory->ranges[low - 1];
+    if (address - range->address > range->size || size > range->size - (address - range->address))
+        return false;
+
+    memcpy(buffer, range->data + (address - range->address), size);
+    return true;
+}
+
+// Helper: Read one pointer and strip its signature
+static bool read_pointer(
+    const AsyncContextLayout *layout,
+    AsyncMemoryReader read,
+    void *read_context,
+    uint64_t address,
+    uint64_t *value)
+{
+    uint64_t raw;
+    if (!read(read_context, address, &raw, sizeof(raw)))
+        return false;
+
+    *value = raw & layout->pointer_mask;
+    return true;
+}
+
+uint64_t async_frame_context(
+    const AsyncContextLayout *layout,
+    AsyncMemoryReader read,
+    void *read_context,
+    uint64_t frame_pointer)
+{
+    uint64_t context;
+    if (frame_pointer < layout->context_slot ||
+        !read_pointer(layout, read, read_context, frame_pointer - layout->context_slot, &context))
+    {
+        return 0;
+    }
+
+    // Contexts are at least pointer aligned
+    return context & 7 ? 0 : context;
+}
+
+uint32_t async_unwind_chain(
+    const AsyncContextLayout *layout,
+    AsyncMemoryReader read,
+    void *read_context,
+    uint64_t context,
+    uint64_t *frames,
+    uint32_t max_frames)
+{
+    uint32_t count = 0;
+
+    // A corrupt chain may loop; compare against a context saved at
+    // power-of-two steps, which catches any cycle within twice its length
+    uint64_t saved = 0;
+    uint32_t steps = 0;
+    uint32_t limit = 1;
+
+    // Both links are read in one go when they are close together (they
+    // are adjacent in every known layout)
+    uint32_t first = layout->parent_offset < layout->resume_offset ? layout->parent_offset : layout->resume_offset;
+    uint32_t last = layout->parent_offset < layout->resume_offset ? layout->resume_offset : layout->parent_offset;
+    bool combined = last - first + sizeof(uint64_t) <= ASYNC_COMBINED_READ_SIZE;
+
+    while (count < max_frames && context != 0 && (context & 7) == 0)
+    {
+        uint64_t parent;
+        uint64_t resume;
+        if (combined)
+        {
+            uint8_t block[ASYNC_COMBINED_READ_SIZE];
+            if (!read(read_context, context + first, block, last - first + sizeof(uint64_t)))
+                break;
+            memcpy(&parent, block + (layout->parent_offset - first), sizeof(parent));
+            memcpy(&resume, block + (layout->resume_offset - first), sizeof(resume));
+            parent &= layout->pointer_mask;
+            resume &= layout->pointer_mask;
+        }
+        else if (!read_pointer(layout, read, read_context, context + layout->parent_offset, &parent) ||
+                 !read_pointer(layout, read, read_context, context + layout->resume_offset, &resume))
+        {
+            break;
+        }
+
+        if (resume == 0)
+            break;
+
+        frames[count++] = resume + 1;
+
+        // The outermost context has no parent; its continuation finishes the task
+        if (parent == 0 || parent == saved)
+            break;
+
+        if (++steps == limit)
+        {
+            saved = context;
+            steps = 0;
+            limit *= 2;
+        }
+        context = parent;
+    }
+
+    return count;
+}
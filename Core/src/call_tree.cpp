@@ -0,0 +1,519 @@
+#include "call_tree.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#define INITIAL_NODE_CAPACITY 1024
+#define INITIAL_INDEX_SIZE 2048
+#define INITIAL_FUNCTION_CAPACITY 256
+#define INITIAL_FUNCTION_INDEX_SIZE 512
+
+// One tree: nodes plus the (parent, frame) -> node index
+typedef struct
+{
+    CallTreeNode *nodes; // Node 0 is the root
+    uint32_t node_count;
+    uint32_t node_capacity;
+    uint32_t *index; // Open-addressed; 0 marks a free slot (the root is never indexed)
+    uint32_t index_mask;
+} TreeView;
+
+typedef struct
+{
+    CallTreeFunction function;
+    uint64_t last_stack; // Serial of the last stack that counted towards total
+} FlatEntry;
+
+struct CallTree
+{
+    TreeView views[2];
+
+    // Flat view: frame -> entry (open-addressed, entry + 1; 0 marks a free slot)
+    FlatEntry *functions;
+    uint32_t function_count;
+    uint32_t function_capacity;
+    uint32_t *function_index;
+    uint32_t function_index_mask;
+
+    uint64_t stack_serial;
+};
+
+// Helper: 64-bit finalizer (splitmix64)
+static inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint64_t node_hash(uint32_t parent, uint64_t frame)
+{
+    return mix64(frame ^ ((uint64_t)parent * 0x9e3779b97f4a7c15ULL));
+}
+
+static void reset_root(TreeView *view)
+{
+    CallTreeNode *root = &view->nodes[CALL_TREE_ROOT];
+    memset(root, 0, sizeof(CallTreeNode));
+    root->parent = CALL_TREE_NONE;
+    root->first_child = CALL_TREE_NONE;
+    root->next_sibling = CALL_TREE_NONE;
+    view->node_count = 1;
+}
+
+static bool view_init(TreeView *view)
+{
+    view->nodes = (CallTreeNode *)malloc(INITIAL_NODE_CAPACITY * sizeof(CallTreeNode));
+    view->index = (uint32_t *)calloc(INITIAL_INDEX_SIZE, sizeof(uint32_t));
+    if (!view->nodes || !view->index)
+        return false;
+
+    view->node_capacity = INITIAL_NODE_CAPACITY;
+    view->index_mask = INITIAL_INDEX_SIZE - 1;
+    reset_root(view);
+    return true;
+}
+
+// Helper: Put a node into the index (it must not be there yet)
+static inline void index_node(TreeView *view, uint32_t id)
+{
+    const CallTreeNode *node = &view->nodes[id];
+    uint32_t slot = (uint32_t)node_hash(node->parent, node->frame) & view->index_mask;
+    while (view->index[slot] != 0)
+        slot = (slot + 1) & view->index_mask;
+    view->index[slot] = id;
+}
+
+// Helper: Double the node index and re-insert every node
+static bool grow_index(TreeView *view)
+{
+    uint32_t new_size = (view->index_mask + 1) * 2;
+    uint32_t *index = (uint32_t *)calloc(new_size, sizeof(uint32_t));
+    if (!index)
+        return false;
+
+    free(view->index);
+    view->index = index;
+    view->index_mask = new_size - 1;
+    for (uint32_t id = 1; id < view->node_count; id++)
+        index_node(view, id);
+    return true;
+}
+
+static uint32_t find_child(const TreeView *view, uint32_t parent, uint64_t frame)
+{
+    uint32_t slot = (uint32_t)node_hash(parent, frame) & view->index_mask;
+    while (view->index[slot] != 0)
+    {
+        const CallTreeNode *node = &view->nodes[view->index[slot]];
+        if (node->parent == parent && node->frame == frame)
+            return view->index[slot];
+        slot = (slot + 1) & view->index_mask;
+    }
+    return CALL_TREE_NONE;
+}
+
+// Helper: Find or create the child of parent for frame
+static uint32_t intern_child(TreeView *view, uint32_t parent, uint64_t frame)
+{
+    uint32_t slot = (uint32_t)node_hash(parent, frame) & view->index_mask;
+    while (view->index[slot] != 0)
+    {
+        const CallTreeNode *node = &view->nodes[view->index[slot]];
+        if (node->parent == parent && node->frame == frame)
+            return view->index[slot];
+        slot = (slot + 1) & view->index_mask;
+    }
+
+    // New node
+    if (view->node_count == CALL_TREE_NONE)
+        return CALL_TREE_NONE;
+
+    if (view->node_count == view->node_capacity)
+    {
+        uint32_t capacity = view->node_capacity * 2;
+        CallTreeNode *nodes = (CallTreeNode *)realloc(view->nodes, capacity * sizeof(CallTreeNode));
+        if (!nodes)
+            return CALL_TREE_NONE;
+        view->nodes = nodes;
+        view->node_capacity = capacity;
+    }
+
+    uint32_t id = view->node_count++;
+    CallTreeNode *node = &view->nodes[id];
+    CallTreeNode *parent_node = &view->nodes[parent];
+    node->frame = frame;
+    node->self = 0;
+    node->total = 0;
+    node->parent = parent;
+    node->depth = parent_node->depth + 1;
+    node->first_child = CALL_TREE_NONE;
+    node->next_sibling = parent_node->first_child;
+    parent_node->first_child = id;
+    view->index[slot] = id;
+
+    // Keep the index at most half full
+    if ((uint64_t)view->node_count * 2 > (uint64_t)view->index_mask + 1)
+    {
+        grow_index(view);
+    }
+
+    return id;
+}
+
+// Helper: Double the flat index and re-insert every entry
+static bool grow_function_index(CallTree *tree)
+{
+    uint32_t new_size = (tree->function_index_mask + 1) * 2;
+    uint32_t *index = (uint32_t *)calloc(new_size, sizeof(uint32_t));
+    if (!index)
+        return false;
+
+    uint32_t mask = new_size - 1;
+    for (uint32_t i = 0; i < tree->function_count; i++)
+    {
+        uint32_t slot = (uint32_t)mix64(tree->functions[i].function.frame) & mask;
+        while (index[slot] != 0)
+            slot = (slot + 1) & mask;
+        index[slot] = i + 1;
+    }
+
+    free(tree->function_index);
+    tree->function_index = index;
+    tree->function_index_mask = mask;
+    return true;
+}
+
+// Helper: Find or create the flat entry for frame
+static FlatEntry *intern_function(CallTree *tree, uint64_t frame)
+{
+    uint32_t slot = (uint32_t)mix64(frame) & tree->function_index_mask;
+    while (tree->function_index[slot] != 0)
+    {
+        FlatEntry *entry = &tree->functions[tree->function_index[slot] - 1];
+        if (entry->function.frame == frame)
+            return entry;
+        slot = (slot + 1) & tree->function_index_mask;
+    }
+
+    if (tree->function_count == tree->function_capacity)
+    {
+        uint32_t capacity = tree->function_capacity * 2;
+        FlatEntry *functions = (FlatEntry *)realloc(tree->functions, capacity * sizeof(FlatEntry));
+        if (!functions)
+            return NULL;
+        tree->functions = functions;
+        tree->function_capacity = capacity;
+    }
+
+    FlatEntry *entry = &tree->functions[tree->function_count++];
+    memset(entry, 0, sizeof(FlatEntry));
+    entry->function.frame = frame;
+    tree->function_index[slot] = tree->function_count;
+
+    if ((uint64_t)tree->function_count * 2 > (uint64_t)tree->function_index_mask + 1)
+    {
+        grow_function_index(tree);
+        entry = &tree->functions[tree->function_count - 1];
+    }
+    return entry;
+}
+
+CallTree *call_tree_create(void)
+{
+    CallTree *tree = (CallTree *)calloc(1, sizeof(CallTree));
+    if (!tree)
+        return NULL;
+
+    bool ok = view_init(&tree->views[CALL_TREE_TOP_DOWN]) && view_init(&tree->views[CALL_TREE_BOTTOM_UP]);
+    tree->functions = (FlatEntry *)malloc(INITIAL_FUNCTION_CAPACITY * sizeof(FlatEntry));
+    tree->function_index = (uint32_t *)calloc(INITIAL_FUNCTION_INDEX_SIZE, sizeof(uint32_t));
+    if (!ok || !tree->functions || !tree->function_index)
+    {
+        call_tree_destroy(tree);
+        return NULL;
+    }
+
+    tree->function_capacity = INITIAL_FUNCTION_CAPACITY;
+    tree->function_index_mask = INITIAL_FUNCTION_INDEX_SIZE - 1;
+    return tree;
+}
+
+void call_tree_destroy(CallTree *tree)
+{
+    if (!tree)
+        return;
+
+    for (int v = 0; v < 2; v++)
+    {
+        free(tree->views[v].nodes);
+        free(tree->views[v].index);
+    }
+    free(tree->functions);
+    free(tree->function_index);
+    free(tree);
+}
+
+void call_tree_clear(CallTree *tree)
+{
+    for (int v = 0; v < 2; v++)
+    {
+        TreeView *view = &tree->views[v];
+        memset(view->index, 0, ((size_t)view->index_mask + 1) * sizeof(uint32_t));
+        reset_root(view);
+    }
+    memset(tree->function_index, 0, ((size_t)tree->function_index_mask + 1) * sizeof(uint32_t));
+    tree->function_count = 0;
+}
+
+int call_tree_add(
+    CallTree *tree,
+    const uint64_t *frames,
+    uint32_t frame_count,
+    uint64_t weight)
+{
+    if (frame_count == 0)
+        return 0;
+
+    // Top-down: outermost frame first
+    TreeView *view = &tree->views[CALL_TREE_TOP_DOWN];
+    view->nodes[CALL_TREE_ROOT].total += weight;
+    uint32_t node = CALL_TREE_ROOT;
+    for (uint32_t i = frame_count; i > 0; i--)
+    {
+        node = intern_child(view, node, frames[i - 1]);
+        if (node == CALL_TREE_NONE)
+            return -1;
+        view->nodes[node].total += weight;
+    }
+    view->nodes[node].self += weight;
+
+    // Bottom-up: innermost frame first
+    view = &tree->views[CALL_TREE_BOTTOM_UP];
+    view->nodes[CALL_TREE_ROOT].total += weight;
+    node = CALL_TREE_ROOT;
+    for (uint32_t i = 0; i < frame_count; i++)
+    {
+        node = intern_child(view, node, frames[i]);
+        if (node == CALL_TREE_NONE)
+            return -1;
+        view->nodes[node].total += weight;
+    }
+    view->nodes[node].self += weight;
+
+    // Flat: recursive frames count towards total once per stack
+    uint64_t serial = ++tree->stack_serial;
+    for (uint32_t i = 0; i < frame_count; i++)
+    {
+        FlatEntry *entry = intern_function(tree, frames[i]);
+        if (!entry)
+            return -1;
+        if (i == 0)
+            entry->function.self += weight;
+        if (entry->last_stack != serial)
+        {
+            entry->last_stack = serial;
+            entry->function.total += weight;
+        }
+    }
+    return 0;
+}
+
+int call_tree_merge(CallTree *tree, const CallTree *other)
+{
+    uint32_t capacity = std::max(other->views[0].node_count, other->views[1].node_count);
+    uint32_t *mapping = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+    if (!mapping)
+        return -1;
+
+    // Parents come before their children, so one pass maps every node
+    for (int v = 0; v < 2; v++)
+    {
+        TreeView *view = &tree->views[v];
+        const TreeView *source = &other->views[v];
+        view->nodes[CALL_TREE_ROOT].total += source->nodes[CALL_TREE_ROOT].total;
+        mapping[CALL_TREE_ROOT] = CALL_TREE_ROOT;
+        for (uint32_t id = 1; id < source->node_count; id++)
+        {
+            const CallTreeNode *node = &source->nodes[id];
+            uint32_t target = intern_child(view, mapping[node->parent], node->frame);
+            if (target == CALL_TREE_NONE)
+            {
+                free(mapping);
+                return -1;
+            }
+            view->nodes[target].self += node->self;
+            view->nodes[target].total += node->total;
+            mapping[id] = target;
+        }
+    }
+    free(mapping);
+
+    for (uint32_t i = 0; i < other->function_count; i++)
+    {
+        const CallTreeFunction *function = &other->functions[i].function;
+        FlatEntry *entry = intern_function(tree, function->frame);
+        if (!entry)
+            return -1;
+        entry->function.self += function->self;
+        entry->function.total += function->total;
+    }
+    return 0;
+}
+
+// Helper: Compact one view in place and rebuild its links and index
+static uint32_t prune_view(TreeView *view, uint64_t min_total, uint32_t *mapping)
+{
+    // New IDs keep the old order, so a node never moves up past its
+    // parent and the copy can run in place
+    uint32_t count = 1;
+    mapping[CALL_TREE_ROOT] = CALL_TREE_ROOT;
+    for (uint32_t id = 1; id < view->node_count; id++)
+    {
+        CallTreeNode node = view->nodes[id];
+        uint32_t parent = mapping[node.parent];
+        if (parent == CALL_TREE_NONE || node.total < min_total)
+        {
+            mapping[id] = CALL_TREE_NONE;
+            continue;
+        }
+
+        mapping[id] = count;
+        node.parent = parent;
+        view->nodes[count++] = node;
+    }
+
+    uint32_t removed = view->node_count - count;
+    view->node_count = count;
+
+    // Linking in reverse keeps each child list in ID order
+    for (uint32_t id = 0; id < count; id++)
+        view->nodes[id].first_child = CALL_TREE_NONE;
+    for (uint32_t id = count - 1; id > 0; id--)
+    {
+        CallTreeNode *parent = &view->nodes[view->nodes[id].parent];
+        view->nodes[id].next_sibling = parent->first_child;
+        parent->first_child = id;
+    }
+
+    memset(view->index, 0, ((size_t)view->index_mask + 1) * sizeof(uint32_t));
+    for (uint32_t id = 1; id < count; id++)
+        index_node(view, id);
+    return removed;
+}
+
+uint32_t call_tree_prune(CallTree *tree, uint64_t min_total)
+{
+    uint32_t capacity = std::max(tree->views[0].node_count, tree->views[1].node_count);
+    uint32_t *mapping = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+    if (!mapping)
+        return 0;
+
+    uint32_t removed = 0;
+    for (int v = 0; v < 2; v++)
+        removed += prune_view(&tree->views[v], min_total, mapping);
+    free(mapping);
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < tree->function_count; i++)
+    {
+        if (tree->functions[i].function.total >= min_total)
+            tree->functions[count++] = tree->functions[i];
+    }
+    tree->function_count = count;
+
+    memset(tree->function_index, 0, ((size_t)tree->function_index_mask + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t slot = (uint32_t)mix64(tree->functions[i].function.frame) & tree->function_index_mask;
+        while (tree->function_index[slot] != 0)
+            slot = (slot + 1) & tree->function_index_mask;
+        tree->function_index[slot] = i + 1;
+    }
+    return removed;
+}
+
+const CallTreeNode *call_tree_nodes(const CallTree *tree, CallTreeView view)
+{
+    return tree->views[view].nodes;
+}
+
+uint32_t call_tree_node_count(const CallTree *tree, CallTreeView view)
+{
+    return tree->views[view].node_count;
+}
+
+uint32_t call_tree_find_child(
+    const CallTree *tree,
+    CallTreeView view,
+    uint32_t parent,
+    uint64_t frame)
+{
+    return find_child(&tree->views[view], parent, frame);
+}
+
+// Helper: Order for the top-N selection (heavier first)
+static inline bool heavier(const CallTreeFunction &a, const CallTreeFunction &b)
+{
+    if (a.self != b.self)
+        return a.self > b.self;
+    if (a.total != b.total)
+        return a.total > b.total;
+    return a.frame < b.frame;
+}
+
+uint32_t call_tree_top_functions(
+    const CallTree *tree,
+    CallTreeFunction *functions,
+    uint32_t max_functions)
+{
+    if (max_functions == 0)
+        return 0;
+
+    // Bounded heap with the lightest kept entry on top, so one pass over
+    // the flat view selects without allocating
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < tree->function_count; i++)
+    {
+        const CallTreeFunction &function = tree->functions[i].function;
+        if (count < max_functions)
+        {
+            functions[count++] = function;
+            std::push_heap(functions, functions + count, heavier);
+        }
+        else if (heavier(function, functions[0]))
+        {
+            std::pop_heap(functions, functions + count, heavier);
+            functions[count - 1] = function;
+            std::push_heap(functions, functions + count, heavier);
+        }
+    }
+    std::sort_heap(functions, functions + count, heavier);
+    return count;
+}
+
+uint64_t call_tree_total_weight(const CallTree *tree)
+{
+    return tree->views[CALL_TREE_TOP_DOWN].nodes[CALL_TREE_ROOT].total;
+}
+
+uint32_t call_tree_function_count(const CallTree *tree)
+{
+    return tree->function_count;
+}
+
+uint64_t call_tree_memory_usage(const CallTree *tree)
+{
+    uint64_t bytes = sizeof(CallTree) +
+                     (uint64_t)tree->function_capacity * sizeof(FlatEntry) +
+                     ((uint64_t)tree->function_index_mask + 1) * sizeof(uint32_t);
+    for (int v = 0; v < 2; v++)
+    {
+        bytes += (uint64_t)tree->views[v].node_capacity * sizeof(CallTreeNode) +
+                 ((uint64_t)tree->views[v].index_mask + 1) * sizeof(uint32_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,575 @@
+#include "demangler.h"
+#include "platform.h"
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+
+// swift_demangle from the Swift runtime (swift/Demangling/Demangle.h):
+// returns a malloc'd string when output_buffer is NULL, NULL on failure
+typedef char *(*SwiftDemangleFunction)(
+    const char *mangled_name,
+    size_t mangled_name_length,
+    char *output_buffer,
+    size_t *output_buffer_size,
+    uint32_t flags);
+
+// Block of the string arena; strings never move once stored
+typedef struct DemangleChunk
+{
+    struct DemangleChunk *next;
+    size_t used;
+    size_t capacity;
+} DemangleChunk;
+
+// Memoized result for one name; name == NULL marks a free slot
+typedef struct
+{
+    uint64_t hash;
+    const char *name;
+    const char *full;
+    const char *simplified;
+    bool demangled;
+} DemangleEntry;
+
+struct Demangler
+{
+    SwiftDemangleFunction swift_demangle;
+    void *swift_runtime; // dlopen handle, NULL if the runtime was already loaded
+
+    DemangleEntry *entries;
+    uint64_t entry_mask;
+    uint64_t entry_count;
+
+    DemangleChunk *chunks; // Newest first
+    uint64_t arena_bytes;
+};
+
+#define DEMANGLE_CHUNK_SIZE (64 * 1024)
+#define INITIAL_ENTRY_TABLE_SIZE 1024
+
+// Helper: Find swift_demangle in this process, loading the runtime if needed
+static SwiftDemangleFunction find_swift_demangle(void **handle)
+{
+    *handle = NULL;
+
+    // Swift executables (the CLI included) already have the runtime loaded
+    void *symbol = dlsym(RTLD_DEFAULT, "swift_demangle");
+    if (symbol)
+        return (SwiftDemangleFunction)symbol;
+
+#if defined(PLATFORM_MACH)
+    const char *runtime = "/usr/lib/swift/libswiftCore.dylib";
+#else
+    const char *runtime = "libswiftCore.so";
+#endif
+    void *library = dlopen(runtime, RTLD_LAZY | RTLD_LOCAL);
+    if (!library)
+        return NULL;
+
+    symbol = dlsym(library, "swift_demangle");
+    if (!symbol)
+    {
+        dlclose(library);
+        return NULL;
+    }
+
+    *handle = library;
+    return (SwiftDemangleFunction)symbol;
+}
+
+// Helper: FNV-1a over a name
+static inline uint64_t hash_name(const char *name)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *p = name; *p; p++)
+    {
+        hash ^= (uint8_t)*p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Helper: Copy a string into the arena
+static const char *store_string(Demangler *demangler, const char *text, size_t length)
+{
+    DemangleChunk *chunk = demangler->chunks;
+    if (!chunk || chunk->capacity - chunk->used < length + 1)
+    {
+        size_t capacity = length + 1 > DEMANGLE_CHUNK_SIZE ? length + 1 : DEMANGLE_CHUNK_SIZE;
+        chunk = (DemangleChunk *)malloc(sizeof(DemangleChunk) + capacity);
+        if (!chunk)
+            return NULL;
+
+        chunk->next = demangler->chunks;
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        demangler->chunks = chunk;
+        demangler->arena_bytes += sizeof(DemangleChunk) + capacity;
+    }
+
+    char *stored = (char *)(chunk + 1) + chunk->used;
+    memcpy(stored, text, length);
+    stored[length] = '\0';
+    chunk->used += length + 1;
+    return stored;
+}
+
+// Helper: Double the memo table and re-insert every entry
+static bool grow_entries(Demangler *demangler)
+{
+    uint64_t new_size = demangler->entries ? (demangler->entry_mask + 1) * 2 : INITIAL_ENTRY_TABLE_SIZE;
+    DemangleEntry *entries = (DemangleEntry *)calloc(new_size, sizeof(DemangleEntry));
+    if (!entries)
+        return false;
+
+    uint64_t mask = new_size - 1;
+    if (demangler->entries)
+    {
+        for (uint64_t i = 0; i <= demangler->entry_mask; i++)
+        {
+            const DemangleEntry *entry = &demangler->entries[i];
+            if (!entry->name)
+                continue;
+
+            uint64_t slot = entry->hash & mask;
+            while (entries[slot].name)
+                slot = (slot + 1) & mask;
+            entries[slot] = *entry;
+        }
+    }
+
+    free(demangler->entries);
+    demangler->entries = entries;
+    demangler->entry_mask = mask;
+    return true;
+}
+
+static inline bool is_open_bracket(char c)
+{
+    return c == '(' || c == '<' || c == '[' || c == '{';
+}
+
+static inline bool is_close_bracket(char c)
+{
+    return c == ')' || c == '>' || c == ']' || c == '}';
+}
+
+// Helper: Whether the first length bytes of out end with suffix
+static bool ends_with(const char *out, size_t length, const char *suffix)
+{
+    size_t suffix_length = strlen(suffix);
+    return length >= suffix_length && memcmp(out + length - suffix_length, suffix, suffix_length) == 0;
+}
+
+// Helper: Whether out ends with the keyword "operator" (not a longer identifier)
+static bool ends_with_operator(const char *out, size_t length)
+{
+    if (!ends_with(out, length, "operator"))
+        return false;
+    if (length == 8)
+        return true;
+
+    char before = out[length - 9];
+    return before == ':' || before == ' ';
+}
+
+// Helper: Length of the C++ operator symbol at p ("()", "[]", "<<=", "->*"...)
+static size_t operator_symbol_length(const char *p)
+{
+    if ((p[0] == '(' && p[1] == ')') || (p[0] == '[' && p[1] == ']'))
+        return 2;
+
+    size_t length = 0;
+    while (p[length] && strchr("+-*/%^&|~!=<>,", p[length]))
+        length++;
+    return length;
+}
+
+// Helper: Start of the qualified name in a C++ name, past a return type
+// ("void foo::bar" -> "foo::bar"); the name is the last space-separated
+// word at group depth 0, or the one holding "operator" (whose conversion
+// type may have spaces)
+static size_t cplusplus_name_start(const char *out, size_t length)
+{
+    size_t start = 0;
+    int depth = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = out[i];
+        if (c == '(' || c == '{')
+            depth++;
+        else if ((c == ')' || c == '}') && depth > 0)
+            depth--;
+        else if (depth > 0)
+            continue;
+        else if (c == ' ')
+            start = i + 1;
+        else if (c == 'o' && strncmp(out + i, "operator", 8) == 0 &&
+                 (i == 0 || out[i - 1] == ':' || out[i - 1] == ' '))
+            break;
+    }
+    return start;
+}
+
+// Helper: Reduce a demangled name to its qualified function name
+// "generic specialization <Swift.Int> of Module.Type.method<A>(x: A) -> Swift.Int"
+// becomes "Module.Type.method": bracketed groups (parameters, generic
+// arguments, extension contexts) are dropped, as are return and property
+// types (" -> T", " : T") up to the next " in ", effects (async, throws),
+// conformances of witness thunks, and everything before the last " of " /
+// " for " (specializations, thunks, async partial functions).
+// C++ names (cplusplus) also lose a leading return type and trailing cv/ref
+// qualifiers, keep operator symbols and "(anonymous namespace)", and keep
+// local entities as their kind: "main::{lambda()#1}::operator() const"
+// becomes "main::{lambda}::operator()".
+static size_t simplify_name(const char *full, char *out, bool cplusplus)
+{
+    size_t length = 0;
+    int depth = 0;
+    bool skipping_type = false;
+
+    for (const char *p = full; *p; p++)
+    {
+        char c = *p;
+
+        if (cplusplus && depth == 0)
+        {
+            size_t symbol_length = ends_with_operator(out, length) ? operator_symbol_length(p) : 0;
+            if (symbol_length == 0 && c == '[' && p[1] == ']' &&
+                (ends_with(out, length, "operator new") || ends_with(out, length, "operator delete")))
+                symbol_length = 2;
+            if (symbol_length > 0)
+            {
+                memcpy(out + length, p, symbol_length);
+                length += symbol_length;
+                p += symbol_length - 1;
+                continue;
+            }
+
+            if (strncmp(p, "(anonymous namespace)", 21) == 0)
+            {
+                memcpy(out + length, p, 21);
+                length += 21;
+                p += 20;
+                continue;
+            }
+
+            // "{lambda(int)#2}" -> "{lambda}", "{unnamed type#1}" -> "{unnamed type}"
+            if (c == '{')
+            {
+                out[length++] = *p++;
+                while (*p && *p != '(' && *p != '#' && *p != '}')
+                    out[length++] = *p++;
+                if (!*p)
+                    break;
+                out[length++] = '}';
+
+                int braces = 1;
+                for (; *p; p++)
+                {
+                    if (*p == '{')
+                        braces++;
+                    else if (*p == '}' && --braces == 0)
+                        break;
+                }
+                if (!*p)
+                    break;
+                continue;
+            }
+        }
+
+        // An arrow is not a closing bracket
+        if (c == '-' && p[1] == '>')
+        {
+            if (depth == 0 && p > full && p[-1] == ' ')
+                skipping_type = true;
+            p++;
+            continue;
+        }
+
+        if (is_open_bracket(c))
+        {
+            // Keep the call operator's own parentheses ("operator()")
+            if (depth == 0 && !skipping_type && c == '(' && p[1] == ')' &&
+                length >= 8 && memcmp(out + length - 8, "operator", 8) == 0)
+            {
+                out[length++] = '(';
+                out[length++] = ')';
+                p++;
+                continue;
+            }
+            depth++;
+            continue;
+        }
+        if (is_close_bracket(c))
+        {
+            if (depth > 0)
+                depth--;
+            continue;
+        }
+        if (depth > 0)
+            continue;
+
+        if (skipping_type)
+        {
+            if (strncmp(p, " in ", 4) != 0)
+                continue;
+            skipping_type = false;
+        }
+        else if (strncmp(p, " : ", 3) == 0)
+        {
+            skipping_type = true;
+            continue;
+        }
+
+        // Collapse the spaces left behind by dropped groups
+        if (c == ' ' && (length == 0 || out[length - 1] == ' '))
+            continue;
+        out[length++] = c;
+    }
+    while (length > 0 && out[length - 1] == ' ')
+        length--;
+
+    // Qualifiers of member functions follow their parameters
+    static const char *const qualifiers[] = {" const", " volatile", " &&", " &", " noexcept"};
+    for (bool stripped = cplusplus; stripped;)
+    {
+        stripped = false;
+        for (const char *qualifier : qualifiers)
+        {
+            if (ends_with(out, length, qualifier))
+            {
+                length -= strlen(qualifier);
+                stripped = true;
+            }
+        }
+    }
+    out[length] = '\0';
+
+    // Effects of the function type are not part of its name
+    static const char *const effects[] = {" async", " throws", " rethrows"};
+    for (const char *effect : effects)
+    {
+        size_t effect_length = strlen(effect);
+        char *found = out;
+        while ((found = strstr(found, effect)) != NULL)
+        {
+            char next = found[effect_length];
+            if (next != ' ' && next != '\0')
+            {
+                found += effect_length;
+                continue;
+            }
+            memmove(found, found + effect_length, length - (found - out) - effect_length + 1);
+            length -= effect_length;
+        }
+    }
+
+    // Witness thunks name the conformance after the requirement
+    char *conformance = strstr(out, " in conformance ");
+    if (conformance)
+    {
+        length = conformance - out;
+        out[length] = '\0';
+    }
+
+    // Keep what follows the last " of " / " for "
+    size_t start = 0;
+    for (size_t i = 0; i + 4 <= length; i++)
+    {
+        if (memcmp(out + i, " of ", 4) == 0)
+            start = i + 4;
+        else if (i + 5 <= length && memcmp(out + i, " for ", 5) == 0)
+            start = i + 5;
+    }
+    if (length - start > 7 && memcmp(out + start, "merged ", 7) == 0)
+        start += 7;
+    while (start < length && (out[start] == ':' || out[start] == ' '))
+        start++;
+    if (cplusplus)
+        start += cplusplus_name_start(out + start, length - start);
+
+    if (start == length)
+        return 0; // Nothing left; the caller keeps the full form
+
+    memmove(out, out + start, length - start + 1);
+    return length - start;
+}
+
+bool demangler_is_swift_symbol(const char *name)
+{
+    if (!name)
+        return false;
+    if (name[0] == '_' && name[1] == '$')
+        name++;
+
+    return strncmp(name, "$s", 2) == 0 || strncmp(name, "$S", 2) == 0 ||
+           strncmp(name, "$e", 2) == 0 || strncmp(name, "_T0", 3) == 0;
+}
+
+// Helper: Demangle one name; returns a malloc'd string or NULL
+static char *demangle_name(const Demangler *demangler, const char *name)
+{
+    if (demangler_is_swift_symbol(name))
+    {
+        if (!demangler->swift_demangle)
+            return NULL;
+        return demangler->swift_demangle(name, strlen(name), NULL, NULL, 0);
+    }
+
+    if (strncmp(name, "_Z", 2) == 0)
+    {
+        int status = 0;
+        char *demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+        if (status != 0)
+        {
+            free(demangled);
+            return NULL;
+        }
+        return demangled;
+    }
+
+    return NULL;
+}
+
+// Helper: Demangle a name that is not memoized yet and record it
+static const DemangleEntry *add_entry(Demangler *demangler, uint64_t slot, uint64_t hash, const char *name)
+{
+    DemangleEntry entry;
+    entry.hash = hash;
+    entry.name = store_string(demangler, name, strlen(name));
+    entry.full = entry.name;
+    entry.simplified = entry.name;
+    entry.demangled = false;
+    if (!entry.name)
+        return NULL;
+
+    char *demangled = demangle_name(demangler, name);
+    if (demangled)
+    {
+        size_t length = strlen(demangled);
+        char *simplified = (char *)malloc(length + 1);
+        size_t simplified_length = simplified ? simplify_name(demangled, simplified, strncmp(name, "_Z", 2) == 0) : 0;
+
+        const char *full = store_string(demangler, demangled, length);
+        if (full)
+        {
+            entry.full = full;
+            entry.simplified = full;
+            entry.demangled = true;
+            if (simplified_length > 0 && simplified_length < length)
+            {
+                const char *stored = store_string(demangler, simplified, simplified_length);
+                if (stored)
+                    entry.simplified = stored;
+            }
+        }
+        free(simplified);
+        free(demangled);
+    }
+
+    demangler->entries[slot] = entry;
+    demangler->entry_count++;
+    return &demangler->entries[slot];
+}
+
+Demangler *demangler_create(void)
+{
+    Demangler *demangler = (Demangler *)calloc(1, sizeof(Demangler));
+    if (!demangler)
+        return NULL;
+
+    if (!grow_entries(demangler))
+    {
+        free(demangler);
+        return NULL;
+    }
+
+    demangler->swift_demangle = find_swift_demangle(&demangler->swift_runtime);
+    return demangler;
+}
+
+void demangler_destroy(Demangler *demangler)
+{
+    if (!demangler)
+        return;
+
+    DemangleChunk *chunk = demangler->chunks;
+    while (chunk)
+    {
+        DemangleChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(demangler->entries);
+    if (demangler->swift_runtime)
+        dlclose(demangler->swift_runtime);
+    free(demangler);
+}
+
+uint32_t demangler_demangle(
+    Demangler *demangler,
+    const char *const *names,
+    uint32_t count,
+    const char **full,
+    const char **simplified)
+{
+    uint32_t demangled = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const char *name = names[i];
+        const DemangleEntry *entry = NULL;
+
+        // Without room to memoize (allocation failure), names pass through
+        bool room = (demangler->entry_count + 1) * 2 <= demangler->entry_mask + 1 ||
+                    grow_entries(demangler) ||
+                    demangler->entry_count < demangler->entry_mask;
+        if (name && room)
+        {
+            uint64_t hash = hash_name(name);
+            uint64_t slot = hash & demangler->entry_mask;
+            while (demangler->entries[slot].name)
+            {
+                const DemangleEntry *candidate = &demangler->entries[slot];
+                if (candidate->hash == hash && strcmp(candidate->name, name) == 0)
+                {
+                    entry = candidate;
+                    break;
+                }
+                slot = (slot + 1) & demangler->entry_mask;
+            }
+
+            // The table always keeps a free slot, so slot is free here
+            if (!entry)
+                entry = add_entry(demangler, slot, hash, name);
+        }
+
+        if (full)
+            full[i] = entry ? entry->full : name;
+        if (simplified)
+            simplified[i] = entry ? entry->simplified : name;
+        if (entry && entry->demangled)
+            demangled++;
+    }
+
+    return demangled;
+}
+
+bool demangler_has_swift_runtime(const Demangler *demangler)
+{
+    return demangler->swift_demangle != NULL;
+}
+
+uint64_t demangler_entry_count(const Demangler *demangler)
+{
+    return demangler->entry_count;
+}
+
+uint64_t demangler_memory_usage(const Demangler *demangler)
+{
+    return sizeof(Demangler) +
+           (demangler->entry_mask + 1) * sizeof(DemangleEntry) +
+           demangler->arena_bytes;
+}
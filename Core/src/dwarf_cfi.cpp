@@ -0,0 +1,642 @@
+#include "unwind_internal.h"
+#include <string.h>
+#include <unordered_map>
+
+// DWARF numbers of the registers the unwinder tracks
+#if defined(__x86_64__)
+#define DWARF_REG_FP 6 // rbp
+#define DWARF_REG_SP 7 // rsp
+#elif defined(__arm64__) || defined(__aarch64__)
+#define DWARF_REG_FP 29 // x29
+#define DWARF_REG_SP 31 // sp
+#else
+#error "Unsupported architecture"
+#endif
+
+// Call frame instructions (DWARF 5, section 6.4.2, plus GNU extensions)
+#define DW_CFA_advance_loc 0x40
+#define DW_CFA_offset 0x80
+#define DW_CFA_restore 0xc0
+#define DW_CFA_nop 0x00
+#define DW_CFA_set_loc 0x01
+#define DW_CFA_advance_loc1 0x02
+#define DW_CFA_advance_loc2 0x03
+#define DW_CFA_advance_loc4 0x04
+#define DW_CFA_offset_extended 0x05
+#define DW_CFA_restore_extended 0x06
+#define DW_CFA_undefined 0x07
+#define DW_CFA_same_value 0x08
+#define DW_CFA_register 0x09
+#define DW_CFA_remember_state 0x0a
+#define DW_CFA_restore_state 0x0b
+#define DW_CFA_def_cfa 0x0c
+#define DW_CFA_def_cfa_register 0x0d
+#define DW_CFA_def_cfa_offset 0x0e
+#define DW_CFA_def_cfa_expression 0x0f
+#define DW_CFA_expression 0x10
+#define DW_CFA_offset_extended_sf 0x11
+#define DW_CFA_def_cfa_sf 0x12
+#define DW_CFA_def_cfa_offset_sf 0x13
+#define DW_CFA_val_offset 0x14
+#define DW_CFA_val_offset_sf 0x15
+#define DW_CFA_val_expression 0x16
+#define DW_CFA_AARCH64_negate_ra_state 0x2d
+#define DW_CFA_GNU_args_size 0x2e
+#define DW_CFA_GNU_negative_offset_extended 0x2f
+
+// Pointer encodings (LSB Core, .eh_frame)
+#define DW_EH_PE_omit 0xff
+#define DW_EH_PE_absptr 0x00
+#define DW_EH_PE_uleb128 0x01
+#define DW_EH_PE_udata2 0x02
+#define DW_EH_PE_udata4 0x03
+#define DW_EH_PE_udata8 0x04
+#define DW_EH_PE_sleb128 0x09
+#define DW_EH_PE_sdata2 0x0a
+#define DW_EH_PE_sdata4 0x0b
+#define DW_EH_PE_sdata8 0x0c
+#define DW_EH_PE_pcrel 0x10
+
+// Nesting limit for DW_CFA_remember_state
+#define CFI_STATE_STACK_DEPTH 16
+
+// Bounds-checked reader over the section
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    bool ok;
+} Cursor;
+
+// Rules for the registers we track, while a CFA program runs
+typedef struct
+{
+    uint64_t cfa_register;
+    int64_t cfa_offset;
+    bool cfa_expression; // CFA is a DWARF expression we do not evaluate
+    uint8_t ra_rule;
+    int64_t ra_offset;
+    uint8_t fp_rule;
+    int64_t fp_offset;
+} CfiState;
+
+typedef struct
+{
+    uint64_t code_align;
+    int64_t data_align;
+    uint64_t ra_register;
+    uint8_t fde_encoding;
+    bool has_augmentation_data;
+    CfiState initial; // State after the CIE's initial instructions
+} Cie;
+
+// Where compiled rows go while an FDE runs
+typedef struct
+{
+    UnwindRowBuffer *out;
+    int64_t bias;
+    uint64_t end; // One past the FDE's last address (link-time)
+} RowSink;
+
+static uint64_t read_fixed(Cursor *c, size_t size)
+{
+    if (!c->ok || size > c->size - c->pos)
+    {
+        c->ok = false;
+        return 0;
+    }
+
+    // Both supported architectures are little-endian
+    uint64_t value = 0;
+    memcpy(&value, c->data + c->pos, size);
+    c->pos += size;
+    return value;
+}
+
+static uint8_t read_u8(Cursor *c)
+{
+    return (uint8_t)read_fixed(c, 1);
+}
+
+static uint64_t read_uleb(Cursor *c)
+{
+    uint64_t value = 0;
+    unsigned shift = 0;
+    for (;;)
+    {
+        uint8_t byte = read_u8(c);
+        if (!c->ok)
+            return 0;
+        if (shift < 64)
+            value |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+}
+
+static int64_t read_sleb(Cursor *c)
+{
+    int64_t value = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do
+    {
+        byte = read_u8(c);
+        if (!c->ok)
+            return 0;
+        if (shift < 64)
+            value |= (int64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    if (shift < 64 && (byte & 0x40))
+        value |= -((int64_t)1 << shift);
+    return value;
+}
+
+// Read a pointer in one of the .eh_frame encodings. Only pc-relative
+// application is resolved; the other kinds are never used for code
+// addresses in .eh_frame and are returned as-is.
+static uint64_t read_encoded(Cursor *c, uint8_t encoding, uint64_t section_address)
+{
+    if (encoding == DW_EH_PE_omit)
+        return 0;
+
+    uint64_t field_address = section_address + c->pos;
+    uint64_t value;
+    switch (encoding & 0x0f)
+    {
+    case DW_EH_PE_absptr:
+    case DW_EH_PE_udata8:
+    case DW_EH_PE_sdata8:
+        value = read_fixed(c, 8);
+        break;
+    case DW_EH_PE_uleb128:
+        value = read_uleb(c);
+        break;
+    case DW_EH_PE_udata2:
+        value = read_fixed(c, 2);
+        break;
+    case DW_EH_PE_udata4:
+        value = read_fixed(c, 4);
+        break;
+    case DW_EH_PE_sleb128:
+        value = (uint64_t)read_sleb(c);
+        break;
+    case DW_EH_PE_sdata2:
+        value = (uint64_t)(int64_t)(int16_t)read_fixed(c, 2);
+        break;
+    case DW_EH_PE_sdata4:
+        value = (uint64_t)(int64_t)(int32_t)read_fixed(c, 4);
+        break;
+    default:
+        c->ok = false;
+        return 0;
+    }
+
+    if ((encoding & 0x70) == DW_EH_PE_pcrel)
+        value += field_address;
+    return value;
+}
+
+// Helper: Read an entry header; false at the end of the section
+static bool read_entry_header(Cursor *c, size_t *entry_end, uint64_t *id, size_t *id_pos)
+{
+    uint64_t length = read_fixed(c, 4);
+    if (!c->ok || length == 0)
+        return false; // Zero terminator
+
+    bool is_64 = length == 0xffffffff;
+    if (is_64)
+        length = read_fixed(c, 8);
+
+    *id_pos = c->pos;
+    if (!c->ok || length > c->size - c->pos)
+        return false;
+
+    *entry_end = c->pos + length;
+    *id = read_fixed(c, is_64 ? 8 : 4);
+    return c->ok;
+}
+
+static void initial_state(CfiState *state)
+{
+    state->cfa_register = DWARF_REG_SP;
+    state->cfa_offset = 0;
+    state->cfa_expression = true; // Undefined until a def_cfa
+    state->ra_rule = UNWIND_REG_SAME;
+    state->ra_offset = 0;
+    state->fp_rule = UNWIND_REG_SAME;
+    state->fp_offset = 0;
+}
+
+static void set_rule(CfiState *state, const Cie *cie, uint64_t reg, uint8_t rule, int64_t offset)
+{
+    if (reg == cie->ra_register)
+    {
+        state->ra_rule = rule;
+        state->ra_offset = offset;
+    }
+    else if (reg == DWARF_REG_FP)
+    {
+        state->fp_rule = rule;
+        state->fp_offset = offset;
+    }
+}
+
+static void restore_rule(CfiState *state, const Cie *cie, const CfiState *initial, uint64_t reg)
+{
+    if (reg == cie->ra_register)
+    {
+        state->ra_rule = initial->ra_rule;
+        state->ra_offset = initial->ra_offset;
+    }
+    else if (reg == DWARF_REG_FP)
+    {
+        state->fp_rule = initial->fp_rule;
+        state->fp_offset = initial->fp_offset;
+    }
+}
+
+// Helper: Flatten the tracked state into a row at loc
+static void emit_row(RowSink *sink, uint64_t loc, const CfiState *state)
+{
+    if (sink == NULL || loc >= sink->end)
+        return;
+
+    UnwindRow row;
+    memset(&row, 0, sizeof(row));
+
+    if (!state->cfa_expression &&
+        (state->cfa_register == DWARF_REG_SP || state->cfa_register == DWARF_REG_FP) &&
+        state->cfa_offset >= INT32_MIN && state->cfa_offset <= INT32_MAX)
+    {
+        row.cfa_base = state->cfa_register == DWARF_REG_SP ? UNWIND_CFA_SP : UNWIND_CFA_FP;
+        row.cfa_offset = (int32_t)state->cfa_offset;
+    }
+    else
+    {
+        row.cfa_base = UNWIND_CFA_UNDEFINED;
+    }
+
+    row.ra_rule = state->ra_rule;
+    row.ra_offset = (int16_t)state->ra_offset;
+    if (state->ra_rule == UNWIND_REG_AT_CFA && row.ra_offset != state->ra_offset)
+        row.ra_rule = UNWIND_REG_UNDEFINED;
+
+    row.fp_rule = state->fp_rule;
+    row.fp_offset = (int16_t)state->fp_offset;
+    if (state->fp_rule == UNWIND_REG_AT_CFA && row.fp_offset != state->fp_offset)
+        row.fp_rule = UNWIND_REG_UNDEFINED;
+
+    unwind_row_buffer_push(sink->out, loc + sink->bias, &row, false);
+}
+
+// Run a CIE or FDE instruction stream over [c->pos, end)
+// sink is NULL for CIE initial instructions, which produce no rows.
+static void run_program(
+    Cursor *c,
+    size_t end,
+    const Cie *cie,
+    const CfiState *initial,
+    CfiState *state,
+    uint64_t *loc,
+    uint64_t section_address,
+    RowSink *sink)
+{
+    CfiState stack[CFI_STATE_STACK_DEPTH];
+    uint32_t depth = 0;
+
+    while (c->ok && c->pos < end)
+    {
+        uint8_t op = read_u8(c);
+        uint8_t operand = op & 0x3f;
+        uint64_t reg;
+        uint64_t delta = 0;
+        bool advance = false;
+
+        switch (op & 0xc0)
+        {
+        case DW_CFA_advance_loc:
+            delta = operand * cie->code_align;
+            advance = true;
+            break;
+
+        case DW_CFA_offset:
+            set_rule(state, cie, operand, UNWIND_REG_AT_CFA,
+                     (int64_t)read_uleb(c) * cie->data_align);
+            break;
+
+        case DW_CFA_restore:
+            restore_rule(state, cie, initial, operand);
+            break;
+
+        default:
+            switch (op)
+            {
+            case DW_CFA_nop:
+            case DW_CFA_AARCH64_negate_ra_state:
+                break;
+
+            case DW_CFA_set_loc:
+            {
+                uint64_t target = read_encoded(c, cie->fde_encoding, section_address);
+                if (target > *loc)
+                {
+                    delta = target - *loc;
+                    advance = true;
+                }
+                break;
+            }
+
+            case DW_CFA_advance_loc1:
+                delta = read_fixed(c, 1) * cie->code_align;
+                advance = true;
+                break;
+
+            case DW_CFA_advance_loc2:
+                delta = read_fixed(c, 2) * cie->code_align;
+                advance = true;
+                break;
+
+            case DW_CFA_advance_loc4:
+                delta = read_fixed(c, 4) * cie->code_align;
+                advance = true;
+                break;
+
+            case DW_CFA_offset_extended:
+                reg = read_uleb(c);
+                set_rule(state, cie, reg, UNWIND_REG_AT_CFA,
+                         (int64_t)read_uleb(c) * cie->data_align);
+                break;
+
+            case DW_CFA_offset_extended_sf:
+                reg = read_uleb(c);
+                set_rule(state, cie, reg, UNWIND_REG_AT_CFA, read_sleb(c) * cie->data_align);
+                break;
+
+            case DW_CFA_GNU_negative_offset_extended:
+                reg = read_uleb(c);
+                set_rule(state, cie, reg, UNWIND_REG_AT_CFA,
+                         -(int64_t)read_uleb(c) * cie->data_align);
+                break;
+
+            case DW_CFA_restore_extended:
+                restore_rule(state, cie, initial, read_uleb(c));
+                break;
+
+            case DW_CFA_undefined:
+                set_rule(state, cie, read_uleb(c), UNWIND_REG_UNDEFINED, 0);
+                break;
+
+            case DW_CFA_same_value:
+                set_rule(state, cie, read_uleb(c), UNWIND_REG_SAME, 0);
+                break;
+
+            case DW_CFA_register:
+                // The value moved to another register, which we do not track
+                reg = read_uleb(c);
+                read_uleb(c);
+                set_rule(state, cie, reg, UNWIND_REG_UNDEFINED, 0);
+                break;
+
+            case DW_CFA_val_offset:
+            case DW_CFA_val_offset_sf:
+                // The caller's value is an address, not a saved slot
+                reg = read_uleb(c);
+                if (op == DW_CFA_val_offset)
+                    read_uleb(c);
+                else
+                    read_sleb(c);
+                set_rule(state, cie, reg, UNWIND_REG_UNDEFINED, 0);
+                break;
+
+            case DW_CFA_expression:
+            case DW_CFA_val_expression:
+                reg = read_uleb(c);
+                c->pos += read_uleb(c);
+                set_rule(state, cie, reg, UNWIND_REG_UNDEFINED, 0);
+                break;
+
+            case DW_CFA_remember_state:
+                if (depth == CFI_STATE_STACK_DEPTH)
+                {
+                    c->ok = false;
+                    break;
+                }
+                stack[depth++] = *state;
+                break;
+
+            case DW_CFA_restore_state:
+                if (depth == 0)
+                {
+                    c->ok = false;
+                    break;
+                }
+                // Restores the CFA rule too, as libgcc and libunwind do
+                *state = stack[--depth];
+                break;
+
+            case DW_CFA_def_cfa:
+                state->cfa_register = read_uleb(c);
+                state->cfa_offset = (int64_t)read_uleb(c);
+                state->cfa_expression = false;
+                break;
+
+            case DW_CFA_def_cfa_sf:
+                state->cfa_register = read_uleb(c);
+                state->cfa_offset = read_sleb(c) * cie->data_align;
+                state->cfa_expression = false;
+                break;
+
+            case DW_CFA_def_cfa_register:
+                state->cfa_register = read_uleb(c);
+                state->cfa_expression = false;
+                break;
+
+            case DW_CFA_def_cfa_offset:
+                state->cfa_offset = (int64_t)read_uleb(c);
+                break;
+
+            case DW_CFA_def_cfa_offset_sf:
+                state->cfa_offset = read_sleb(c) * cie->data_align;
+                break;
+
+            case DW_CFA_def_cfa_expression:
+                c->pos += read_uleb(c);
+                state->cfa_expression = true;
+                break;
+
+            case DW_CFA_GNU_args_size:
+                read_uleb(c);
+                break;
+
+            default:
+                // Unknown opcode: its operand size is unknown, so stop here
+                c->ok = false;
+                break;
+            }
+        }
+
+        if (c->pos > end)
+            c->ok = false;
+
+        if (advance && c->ok)
+        {
+            emit_row(sink, *loc, state);
+            *loc += delta;
+        }
+    }
+}
+
+// Helper: Parse the CIE at offset
+static bool parse_cie(
+    const uint8_t *data,
+    size_t size,
+    size_t offset,
+    uint64_t section_address,
+    Cie *cie)
+{
+    Cursor c = {data, size, offset, true};
+    size_t entry_end;
+    uint64_t id;
+    size_t id_pos;
+    if (!read_entry_header(&c, &entry_end, &id, &id_pos) || id != 0)
+        return false;
+
+    uint8_t version = read_u8(&c);
+    if (version != 1 && version != 3)
+        return false;
+
+    const char *augmentation = (const char *)data + c.pos;
+    size_t augmentation_length = strnlen(augmentation, entry_end - c.pos);
+    if (augmentation_length == entry_end - c.pos)
+        return false;
+    c.pos += augmentation_length + 1;
+
+    if (strstr(augmentation, "eh") != NULL)
+        c.pos += sizeof(uint64_t); // Ancient GCC: EH data pointer
+
+    cie->code_align = read_uleb(&c);
+    cie->data_align = read_sleb(&c);
+    cie->ra_register = version == 1 ? read_u8(&c) : read_uleb(&c);
+    cie->fde_encoding = DW_EH_PE_absptr;
+    cie->has_augmentation_data = augmentation[0] == 'z';
+
+    if (cie->has_augmentation_data)
+    {
+        uint64_t length = read_uleb(&c);
+        size_t augmentation_end = c.pos + length;
+
+        for (const char *p = augmentation + 1; *p != '\0' && c.ok; p++)
+        {
+            if (*p == 'R')
+                cie->fde_encoding = read_u8(&c);
+            else if (*p == 'L')
+                read_u8(&c);
+            else if (*p == 'P')
+                read_encoded(&c, read_u8(&c), section_address);
+            else if (*p != 'S' && *p != 'B' && *p != 'G')
+                break; // Unknown; the length lets us skip the rest
+        }
+        c.pos = augmentation_end;
+    }
+    else if (augmentation[0] != '\0' && strcmp(augmentation, "eh") != 0)
+    {
+        return false;
+    }
+
+    if (!c.ok || c.pos > entry_end)
+        return false;
+
+    initial_state(&cie->initial);
+    uint64_t loc = 0;
+    run_program(&c, entry_end, cie, &cie->initial, &cie->initial, &loc, section_address, NULL);
+    return c.ok;
+}
+
+size_t dwarf_cfi_parse_eh_frame(
+    const uint8_t *data,
+    size_t size,
+    uint64_t section_address,
+    int64_t bias,
+    UnwindRowBuffer *out)
+{
+    std::unordered_map<size_t, Cie> cies;
+    std::unordered_map<size_t, bool> bad_cies;
+    size_t fde_count = 0;
+
+    Cursor c = {data, size, 0, true};
+    while (c.pos < size)
+    {
+        size_t entry_end;
+        uint64_t id;
+        size_t id_pos;
+        if (!read_entry_header(&c, &entry_end, &id, &id_pos))
+            break;
+
+        if (id == 0 || id > id_pos)
+        {
+            // A CIE (parsed when an FDE refers to it), or a corrupt pointer
+            c.pos = entry_end;
+            continue;
+        }
+
+        // In .eh_frame the CIE pointer is relative to the field itself
+        size_t cie_offset = id_pos - id;
+        auto found = cies.find(cie_offset);
+        if (found == cies.end())
+        {
+            if (bad_cies.count(cie_offset))
+            {
+                c.pos = entry_end;
+                continue;
+            }
+
+            Cie cie;
+            if (!parse_cie(data, size, cie_offset, section_address, &cie))
+            {
+                bad_cies[cie_offset] = true;
+                c.pos = entry_end;
+                continue;
+            }
+            found = cies.emplace(cie_offset, cie).first;
+        }
+        const Cie *cie = &found->second;
+
+        uint64_t pc_begin = read_encoded(&c, cie->fde_encoding, section_address);
+        uint64_t pc_range = read_encoded(&c, cie->fde_encoding & 0x0f, 0);
+        if (cie->has_augmentation_data)
+        {
+            uint64_t length = read_uleb(&c);
+            c.pos += length;
+        }
+
+        // pc_begin 0 marks an FDE of a function the linker discarded
+        if (!c.ok || c.pos > entry_end || pc_begin == 0 || pc_range == 0)
+        {
+            c.ok = true;
+            c.pos = entry_end;
+            continue;
+        }
+
+        RowSink sink = {out, bias, pc_begin + pc_range};
+        CfiState state = cie->initial;
+        uint64_t loc = pc_begin;
+        run_program(&c, entry_end, cie, &cie->initial, &state, &loc, section_address, &sink);
+
+        // Whatever was decoded before a malformed instruction still holds
+        emit_row(&sink, loc, &state);
+        UnwindRow none;
+        memset(&none, 0, sizeof(none));
+        unwind_row_buffer_push(out, pc_begin + pc_range + bias, &none, true);
+        fde_count++;
+
+        c.ok = true;
+        c.pos = entry_end;
+    }
+
+    return fde_count;
+}
@@ -0,0 +1,184 @@
+#include "elf_image.h"
+
+#if defined(PLATFORM_LINUX)
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Helper: Open a module file as the target sees it, falling back to the plain path
+static int open_module_file(task_t task, const char *path)
+{
+    char rooted[PATH_MAX + 32];
+    snprintf(rooted, sizeof(rooted), "/proc/%u/root%s", task, path);
+
+    int fd = open(rooted, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+    return fd;
+}
+
+int elf_image_open(task_t task, const char *path, ElfImage *image)
+{
+    memset(image, 0, sizeof(*image));
+
+    int fd = open_module_file(task, path);
+    if (fd < 0)
+        return errno;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Elf64_Ehdr))
+    {
+        close(fd);
+        return EINVAL;
+    }
+
+    size_t size = (size_t)info.st_size;
+    const uint8_t *file = (const uint8_t *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED)
+        return errno;
+
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)file;
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+        ehdr->e_phentsize != sizeof(Elf64_Phdr) ||
+        ehdr->e_phoff > size ||
+        (size - ehdr->e_phoff) / sizeof(Elf64_Phdr) < ehdr->e_phnum)
+    {
+        munmap((void *)file, size);
+        return EINVAL;
+    }
+
+    // The lowest PT_LOAD is mapped at the module base; everything else
+    // keeps its distance from it
+    const Elf64_Phdr *phdrs = (const Elf64_Phdr *)(file + ehdr->e_phoff);
+    uint64_t page_mask = (uint64_t)sysconf(_SC_PAGESIZE) - 1;
+    uint64_t link_base = UINT64_MAX;
+    for (uint16_t i = 0; i < ehdr->e_phnum; i++)
+    {
+        if (phdrs[i].p_type == PT_LOAD && (phdrs[i].p_vaddr & ~page_mask) < link_base)
+            link_base = phdrs[i].p_vaddr & ~page_mask;
+    }
+    if (link_base == UINT64_MAX)
+    {
+        munmap((void *)file, size);
+        return EINVAL;
+    }
+
+    image->data = file;
+    image->size = size;
+    image->ehdr = ehdr;
+    image->phdrs = phdrs;
+    image->link_base = link_base;
+
+    // Section headers are optional (stripped files may drop them)
+    if (ehdr->e_shoff != 0 && ehdr->e_shentsize == sizeof(Elf64_Shdr) &&
+        ehdr->e_shoff <= size &&
+        (size - ehdr->e_shoff) / sizeof(Elf64_Shdr) >= ehdr->e_shnum &&
+        ehdr->e_shstrndx < ehdr->e_shnum)
+    {
+        const Elf64_Shdr *shdrs = (const Elf64_Shdr *)(file + ehdr->e_shoff);
+        const Elf64_Shdr *names = &shdrs[ehdr->e_shstrndx];
+        if (names->sh_offset <= size && names->sh_size <= size - names->sh_offset)
+        {
+            image->shdrs = shdrs;
+            image->section_names = (const char *)file + names->sh_offset;
+            image->section_names_size = names->sh_size;
+        }
+    }
+
+    return 0;
+}
+
+void elf_image_close(ElfImage *image)
+{
+    if (image->data)
+        munmap((void *)image->data, image->size);
+    memset(image, 0, sizeof(*image));
+}
+
+const Elf64_Shdr *elf_image_section(const ElfImage *image, const char *name, uint32_t type)
+{
+    if (!image->shdrs)
+        return NULL;
+
+    for (uint16_t i = 0; i < image->ehdr->e_shnum; i++)
+    {
+        const Elf64_Shdr *shdr = &image->shdrs[i];
+        if (shdr->sh_type != type || shdr->sh_name >= image->section_names_size)
+            continue;
+
+        const char *section = image->section_names + shdr->sh_name;
+        size_t room = image->section_names_size - shdr->sh_name;
+        if (strncmp(section, name, room) == 0 &&
+            shdr->sh_offset <= image->size && shdr->sh_size <= image->size - shdr->sh_offset)
+        {
+            return shdr;
+        }
+    }
+    return NULL;
+}
+
+bool elf_image_vaddr_to_offset(
+    const ElfImage *image,
+    uint64_t vaddr,
+    uint64_t *offset,
+    uint64_t *available)
+{
+    for (uint16_t i = 0; i < image->ehdr->e_phnum; i++)
+    {
+        const Elf64_Phdr *phdr = &image->phdrs[i];
+        if (phdr->p_type == PT_LOAD &&
+            vaddr >= phdr->p_vaddr && vaddr < phdr->p_vaddr + phdr->p_filesz)
+        {
+            *offset = phdr->p_offset + (vaddr - phdr->p_vaddr);
+            *available = phdr->p_filesz - (vaddr - phdr->p_vaddr);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t elf_image_build_id(const ElfImage *image, uint8_t *id, size_t max_size)
+{
+    for (uint16_t i = 0; i < image->ehdr->e_phnum; i++)
+    {
+        const Elf64_Phdr *phdr = &image->phdrs[i];
+        if (phdr->p_type != PT_NOTE || phdr->p_offset > image->size ||
+            phdr->p_filesz > image->size - phdr->p_offset)
+            continue;
+
+        // Notes: namesz, descsz, type, name and desc each padded to 4 bytes
+        const uint8_t *note = image->data + phdr->p_offset;
+        const uint8_t *end = note + phdr->p_filesz;
+        while (end - note >= (ptrdiff_t)sizeof(Elf64_Nhdr))
+        {
+            Elf64_Nhdr header;
+            memcpy(&header, note, sizeof(header));
+            size_t name_size = (header.n_namesz + 3) & ~(size_t)3;
+            size_t desc_size = (header.n_descsz + 3) & ~(size_t)3;
+            const uint8_t *name = note + sizeof(header);
+            if ((size_t)(end - name) < name_size + desc_size)
+                break;
+
+            if (header.n_type == NT_GNU_BUILD_ID && header.n_namesz == 4 &&
+                memcmp(name, "GNU", 4) == 0)
+            {
+                if (header.n_descsz == 0 || header.n_descsz > max_size)
+                    return 0;
+                memcpy(id, name + name_size, header.n_descsz);
+                return header.n_descsz;
+            }
+            note = name + name_size + desc_size;
+        }
+    }
+    return 0;
+}
+
+#endif // PLATFORM_LINUX
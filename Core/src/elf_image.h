@@ -0,0 +1,60 @@
+#ifndef ELF_IMAGE_H
+#define ELF_IMAGE_H
+
+#include "platform.h"
+
+#if defined(PLATFORM_LINUX)
+
+#include <elf.h>
+
+// A module's ELF file, mapped read-only
+// Headers are validated against the file size when it is opened; every
+// pointer below stays inside [data, data + size).
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    const Elf64_Ehdr *ehdr;
+    const Elf64_Phdr *phdrs;
+    const Elf64_Shdr *shdrs; // NULL when the file has no usable section headers
+    const char *section_names;
+    size_t section_names_size;
+    uint64_t link_base; // Page-aligned vaddr of the lowest PT_LOAD (mapped at the module base)
+} ElfImage;
+
+/**
+ * Map a module's file as the target sees it (through /proc/<pid>/root, so
+ * containers and chroots resolve), falling back to the plain path
+ *
+ * @return 0 on success, error code otherwise
+ */
+int elf_image_open(task_t task, const char *path, ElfImage *image);
+
+void elf_image_close(ElfImage *image);
+
+/**
+ * Find a section by name and type; NULL if missing or out of bounds
+ */
+const Elf64_Shdr *elf_image_section(const ElfImage *image, const char *name, uint32_t type);
+
+/**
+ * File offset of a link-time address, via the PT_LOAD holding it
+ *
+ * @param available Output: file bytes from offset to the end of that segment
+ */
+bool elf_image_vaddr_to_offset(
+    const ElfImage *image,
+    uint64_t vaddr,
+    uint64_t *offset,
+    uint64_t *available);
+
+/**
+ * Copy the NT_GNU_BUILD_ID note
+ *
+ * @return Size of the build ID (0 if the file has none or it exceeds max_size)
+ */
+size_t elf_image_build_id(const ElfImage *image, uint8_t *id, size_t max_size);
+
+#endif // PLATFORM_LINUX
+
+#endif // ELF_IMAGE_H
@@ -0,0 +1,353 @@
+#include "gzip_writer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <new>
+
+#define GZIP_WINDOW_SIZE 32768
+#define GZIP_BLOCK_SIZE 65536
+#define GZIP_BUFFER_SIZE (GZIP_WINDOW_SIZE + GZIP_BLOCK_SIZE)
+#define GZIP_HASH_BITS 15
+#define GZIP_HASH_SIZE (1u << GZIP_HASH_BITS)
+#define GZIP_MAX_CHAIN 64
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+#define GZIP_OUTPUT_SIZE 65536
+#define GZIP_END_OF_BLOCK 256
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Lookup tables shared by every writer, built on first use
+typedef struct
+{
+    uint32_t crc[256];
+    uint16_t literal_code[288]; // Fixed Huffman codes, bit-reversed for LSB-first output
+    uint8_t literal_bits[288];
+    uint8_t distance_code[30];
+    uint8_t length_symbol[GZIP_MAX_MATCH + 1]; // Length -> index into length_base
+} GzipTables;
+
+struct GzipWriter
+{
+    FILE *file;
+    int error; // First failed write (0 = none)
+    const GzipTables *tables;
+
+    // History (up to GZIP_WINDOW_SIZE bytes) followed by pending input
+    uint8_t buffer[GZIP_BUFFER_SIZE];
+    uint32_t length;
+    uint32_t pending; // First byte not yet compressed
+    int32_t head[GZIP_HASH_SIZE];
+    int32_t chain[GZIP_BUFFER_SIZE]; // Previous position with the same hash
+
+    uint64_t bits;
+    uint32_t bit_count;
+    uint8_t output[GZIP_OUTPUT_SIZE];
+    uint32_t output_length;
+
+    uint32_t crc;
+    uint32_t input_size; // Modulo 2^32, as the trailer wants
+};
+
+// Helper: Reverse the low count bits (Huffman codes go out MSB first)
+static uint32_t reverse_bits(uint32_t value, uint32_t count)
+{
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        result = (result << 1) | (value & 1);
+        value >>= 1;
+    }
+    return result;
+}
+
+static GzipTables build_tables(void)
+{
+    GzipTables tables;
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        tables.crc[i] = c;
+    }
+
+    // RFC 1951 3.2.6
+    for (uint32_t symbol = 0; symbol < 288; symbol++)
+    {
+        uint32_t code, bits;
+        if (symbol < 144)
+        {
+            code = 0x30 + symbol;
+            bits = 8;
+        }
+        else if (symbol < 256)
+        {
+            code = 0x190 + (symbol - 144);
+            bits = 9;
+        }
+        else if (symbol < 280)
+        {
+            code = symbol - 256;
+            bits = 7;
+        }
+        else
+        {
+            code = 0xC0 + (symbol - 280);
+            bits = 8;
+        }
+        tables.literal_code[symbol] = (uint16_t)reverse_bits(code, bits);
+        tables.literal_bits[symbol] = (uint8_t)bits;
+    }
+
+    for (uint32_t symbol = 0; symbol < 30; symbol++)
+        tables.distance_code[symbol] = (uint8_t)reverse_bits(symbol, 5);
+
+    uint32_t index = 0;
+    for (uint32_t length = GZIP_MIN_MATCH; length <= GZIP_MAX_MATCH; length++)
+    {
+        while (index + 1 < 29 && length_base[index + 1] <= length)
+            index++;
+        tables.length_symbol[length] = (uint8_t)index;
+    }
+    return tables;
+}
+
+static const GzipTables *shared_tables(void)
+{
+    static const GzipTables tables = build_tables();
+    return &tables;
+}
+
+static void flush_output(GzipWriter *writer)
+{
+    if (writer->output_length == 0)
+        return;
+    if (writer->error == 0 && fwrite(writer->output, 1, writer->output_length, writer->file) != writer->output_length)
+        writer->error = errno ? errno : EIO;
+    writer->output_length = 0;
+}
+
+static inline void put_byte(GzipWriter *writer, uint8_t byte)
+{
+    if (writer->output_length == GZIP_OUTPUT_SIZE)
+        flush_output(writer);
+    writer->output[writer->output_length++] = byte;
+}
+
+// Helper: Append bits, least significant first (at most 32 at a time)
+static inline void put_bits(GzipWriter *writer, uint32_t value, uint32_t count)
+{
+    writer->bits |= (uint64_t)value << writer->bit_count;
+    writer->bit_count += count;
+    while (writer->bit_count >= 8)
+    {
+        put_byte(writer, (uint8_t)writer->bits);
+        writer->bits >>= 8;
+        writer->bit_count -= 8;
+    }
+}
+
+static inline void put_literal(GzipWriter *writer, uint32_t symbol)
+{
+    put_bits(writer, writer->tables->literal_code[symbol], writer->tables->literal_bits[symbol]);
+}
+
+static void put_match(GzipWriter *writer, uint32_t length, uint32_t distance)
+{
+    uint32_t l = writer->tables->length_symbol[length];
+    put_literal(writer, 257 + l);
+    put_bits(writer, length - length_base[l], length_extra[l]);
+
+    uint32_t d = 0;
+    while (d + 1 < 30 && distance_base[d + 1] <= distance)
+        d++;
+    put_bits(writer, writer->tables->distance_code[d], 5);
+    put_bits(writer, distance - distance_base[d], distance_extra[d]);
+}
+
+static inline uint32_t hash_at(const uint8_t *p)
+{
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    return (v * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+// Helper: Insert a position into the hash chains
+static inline void insert_position(GzipWriter *writer, uint32_t position)
+{
+    if (position + GZIP_MIN_MATCH > writer->length)
+        return;
+    uint32_t h = hash_at(writer->buffer + position);
+    writer->chain[position] = writer->head[h];
+    writer->head[h] = (int32_t)position;
+}
+
+// Helper: Longest earlier match for the bytes at a position
+static uint32_t find_match(GzipWriter *writer, uint32_t position, uint32_t *distance)
+{
+    uint32_t limit = writer->length - position;
+    if (limit > GZIP_MAX_MATCH)
+        limit = GZIP_MAX_MATCH;
+    if (limit < GZIP_MIN_MATCH)
+        return 0;
+
+    const uint8_t *current = writer->buffer + position;
+    uint32_t best = 0;
+    int32_t candidate = writer->head[hash_at(current)];
+    for (uint32_t steps = 0; candidate >= 0 && steps < GZIP_MAX_CHAIN; steps++)
+    {
+        if (position - (uint32_t)candidate > GZIP_WINDOW_SIZE)
+            break;
+
+        const uint8_t *match = writer->buffer + candidate;
+        if (match[best] == current[best])
+        {
+            uint32_t length = 0;
+            while (length < limit && match[length] == current[length])
+                length++;
+            if (length > best)
+            {
+                best = length;
+                *distance = position - (uint32_t)candidate;
+                if (best == limit)
+                    break;
+            }
+        }
+        candidate = writer->chain[candidate];
+    }
+    return best >= GZIP_MIN_MATCH ? best : 0;
+}
+
+// Helper: Keep only the last window of history, rebasing the hash chains
+static void slide_window(GzipWriter *writer)
+{
+    if (writer->length <= GZIP_WINDOW_SIZE)
+        return;
+
+    uint32_t shift = writer->length - GZIP_WINDOW_SIZE;
+    memmove(writer->buffer, writer->buffer + shift, GZIP_WINDOW_SIZE);
+    for (uint32_t i = 0; i < GZIP_WINDOW_SIZE; i++)
+    {
+        int32_t previous = writer->chain[i + shift];
+        writer->chain[i] = previous >= (int32_t)shift ? previous - (int32_t)shift : -1;
+    }
+    for (uint32_t i = 0; i < GZIP_HASH_SIZE; i++)
+    {
+        writer->head[i] = writer->head[i] >= (int32_t)shift ? writer->head[i] - (int32_t)shift : -1;
+    }
+    writer->length = GZIP_WINDOW_SIZE;
+    writer->pending = GZIP_WINDOW_SIZE;
+}
+
+// Helper: Emit the pending input as one fixed-Huffman block
+static void compress_block(GzipWriter *writer, bool final)
+{
+    put_bits(writer, final ? 1 : 0, 1);
+    put_bits(writer, 1, 2); // BTYPE 01: fixed codes
+
+    uint32_t position = writer->pending;
+    while (position < writer->length)
+    {
+        uint32_t distance = 0;
+        uint32_t length = find_match(writer, position, &distance);
+        insert_position(writer, position);
+        if (length == 0)
+        {
+            put_literal(writer, writer->buffer[position]);
+            position++;
+            continue;
+        }
+
+        put_match(writer, length, distance);
+        for (uint32_t i = 1; i < length; i++)
+            insert_position(writer, position + i);
+        position += length;
+    }
+    put_literal(writer, GZIP_END_OF_BLOCK);
+
+    writer->pending = writer->length;
+    slide_window(writer);
+}
+
+GzipWriter *gzip_writer_open(FILE *file)
+{
+    GzipWriter *writer = new (std::nothrow) GzipWriter;
+    if (!writer)
+        return NULL;
+
+    writer->file = file;
+    writer->error = 0;
+    writer->tables = shared_tables();
+    writer->length = 0;
+    writer->pending = 0;
+    memset(writer->head, 0xff, sizeof(writer->head));
+    writer->bits = 0;
+    writer->bit_count = 0;
+    writer->output_length = 0;
+    writer->crc = 0xFFFFFFFFu;
+    writer->input_size = 0;
+
+    // RFC 1952: deflate, no flags, no mtime, no extra flags, unknown OS
+    static const uint8_t header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+    for (uint32_t i = 0; i < sizeof(header); i++)
+        put_byte(writer, header[i]);
+
+    return writer;
+}
+
+int gzip_writer_write(GzipWriter *writer, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    const uint32_t *crc_table = writer->tables->crc;
+
+    while (size > 0)
+    {
+        uint32_t space = GZIP_BUFFER_SIZE - writer->length;
+        uint32_t count = size < space ? (uint32_t)size : space;
+
+        uint32_t crc = writer->crc;
+        for (uint32_t i = 0; i < count; i++)
+            crc = crc_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+        writer->crc = crc;
+        writer->input_size += count;
+
+        memcpy(writer->buffer + writer->length, bytes, count);
+        writer->length += count;
+        bytes += count;
+        size -= count;
+
+        if (writer->length == GZIP_BUFFER_SIZE)
+            compress_block(writer, false);
+    }
+    return writer->error;
+}
+
+int gzip_writer_close(GzipWriter *writer)
+{
+    compress_block(writer, true);
+    if (writer->bit_count > 0)
+        put_bits(writer, 0, 8 - writer->bit_count);
+
+    uint32_t crc = writer->crc ^ 0xFFFFFFFFu;
+    for (int i = 0; i < 4; i++)
+        put_byte(writer, (uint8_t)(crc >> (8 * i)));
+    for (int i = 0; i < 4; i++)
+        put_byte(writer, (uint8_t)(writer->input_size >> (8 * i)));
+    flush_output(writer);
+
+    int error = writer->error;
+    delete writer;
+    return error;
+}
@@ -0,0 +1,36 @@
+#ifndef GZIP_WRITER_H
+#define GZIP_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Streaming gzip compressor with a bundled minimal deflate
+//
+// LZ77 over a 32KB window (hash chains, greedy matching) coded with the
+// fixed Huffman tables, one block per 64KB of input. That gets most of
+// the gain on repetitive data such as protobuf at a fraction of zlib's
+// code; memory use is constant.
+typedef struct GzipWriter GzipWriter;
+
+/**
+ * Start a gzip stream on an open file (writes the gzip header)
+ * @return The writer, or NULL on allocation failure
+ */
+GzipWriter *gzip_writer_open(FILE *file);
+
+/**
+ * Compress bytes into the stream
+ * @return 0 on success, otherwise the first errno
+ */
+int gzip_writer_write(GzipWriter *writer, const void *data, size_t size);
+
+/**
+ * Finish the stream (final block and trailer) and destroy the writer;
+ * the file stays open
+ *
+ * @return 0 if every write succeeded, otherwise the first errno
+ */
+int gzip_writer_close(GzipWriter *writer);
+
+#endif // GZIP_WRITER_H
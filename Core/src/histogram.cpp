@@ -0,0 +1,105 @@
+#include "histogram.h"
+#include <string.h>
+#include <math.h>
+
+// Helper: Bucket holding a value
+// Values from 2^e up (e >= HISTOGRAM_SUB_BUCKET_BITS) keep their top
+// HISTOGRAM_SUB_BUCKET_BITS + 1 bits, which lie in [SUB_BUCKETS, 2 * SUB_BUCKETS).
+static uint32_t bucket_index(uint64_t value)
+{
+    if (value < HISTOGRAM_SUB_BUCKETS)
+        return (uint32_t)value;
+
+    uint32_t shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BUCKET_BITS;
+    return shift * HISTOGRAM_SUB_BUCKETS + (uint32_t)(value >> shift);
+}
+
+// Helper: Largest value that lands in a bucket
+static uint64_t bucket_upper_bound(uint32_t index)
+{
+    if (index < HISTOGRAM_SUB_BUCKETS)
+        return index;
+
+    uint32_t shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t top = index - shift * HISTOGRAM_SUB_BUCKETS;
+
+    // Wraps to UINT64_MAX for the last bucket
+    return ((top + 1) << shift) - 1;
+}
+
+void histogram_reset(Histogram *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+void histogram_record(Histogram *histogram, uint64_t value)
+{
+    if (histogram->count == 0 || value < histogram->min)
+        histogram->min = value;
+    if (value > histogram->max)
+        histogram->max = value;
+    histogram->count++;
+    histogram->total += value;
+    histogram->buckets[bucket_index(value)]++;
+}
+
+void histogram_merge(Histogram *into, const Histogram *from)
+{
+    if (from->count == 0)
+        return;
+
+    if (into->count == 0 || from->min < into->min)
+        into->min = from->min;
+    if (from->max > into->max)
+        into->max = from->max;
+    into->count += from->count;
+    into->total += from->total;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+        into->buckets[i] += from->buckets[i];
+}
+
+uint64_t histogram_percentile(const Histogram *histogram, double percentile)
+{
+    if (histogram->count == 0)
+        return 0;
+
+    if (percentile < 0)
+        percentile = 0;
+    if (percentile > 100)
+        percentile = 100;
+
+    // Rank of the value asked for, 1-based
+    uint64_t rank = (uint64_t)ceil(percentile / 100.0 * (double)histogram->count);
+    if (rank == 0)
+        rank = 1;
+    if (rank > histogram->count)
+        rank = histogram->count;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += histogram->buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t value = bucket_upper_bound(i);
+            if (value < histogram->min)
+                value = histogram->min;
+            if (value > histogram->max)
+                value = histogram->max;
+            return value;
+        }
+    }
+    return histogram->max;
+}
+
+void histogram_summarize(const Histogram *histogram, HistogramSummary *summary)
+{
+    summary->count = histogram->count;
+    summary->total = histogram->total;
+    summary->min = histogram->min;
+    summary->max = histogram->max;
+    summary->p50 = histogram_percentile(histogram, 50);
+    summary->p90 = histogram_percentile(histogram, 90);
+    summary->p99 = histogram_percentile(histogram, 99);
+    summary->p999 = histogram_percentile(histogram, 99.9);
+}
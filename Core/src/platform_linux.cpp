@@ -0,0 +1,728 @@
+#include "platform.h"
+
+#if defined(PLATFORM_LINUX)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <elf.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+#include <mutex>
+#include <unordered_map>
+
+// Architecture detection
+#if defined(__x86_64__)
+#define GET_PC(regs) ((regs).rip)
+#define GET_FP(regs) ((regs).rbp)
+#define GET_SP(regs) ((regs).rsp)
+#define GET_LR(regs) (0)
+#elif defined(__aarch64__)
+#define GET_PC(regs) ((regs).pc)
+#define GET_FP(regs) ((regs).regs[29])
+#define GET_SP(regs) ((regs).sp)
+#define GET_LR(regs) ((regs).regs[30])
+#else
+#error "Unsupported architecture"
+#endif
+
+// Signals that arrived while we had a thread stopped. They are handed back
+// to the thread when it is resumed so the target never loses a signal.
+static std::mutex g_pending_lock;
+static std::unordered_map<thread_t, int> g_pending_signals;
+
+int platform_task_attach(pid_t pid, task_t *task)
+{
+    if (kill(pid, 0) != 0)
+        return errno;
+
+    *task = (task_t)pid;
+    return 0;
+}
+
+void platform_task_release(task_t task)
+{
+    // Nothing is held open for the pid itself
+    (void)task;
+}
+
+int platform_task_threads(
+    task_t task,
+    thread_act_array_t *threads,
+    mach_msg_type_number_t *count)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/task", task);
+
+    DIR *dir = opendir(path);
+    if (!dir)
+        return errno;
+
+    mach_msg_type_number_t capacity = 16;
+    mach_msg_type_number_t found = 0;
+    thread_t *list = (thread_t *)malloc(capacity * sizeof(thread_t));
+    if (!list)
+    {
+        closedir(dir);
+        return ENOMEM;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        char *end;
+        unsigned long tid = strtoul(entry->d_name, &end, 10);
+        if (end == entry->d_name || *end != '\0')
+            continue; // "." and ".."
+
+        if (found == capacity)
+        {
+            capacity *= 2;
+            thread_t *grown = (thread_t *)realloc(list, capacity * sizeof(thread_t));
+            if (!grown)
+            {
+                free(list);
+                closedir(dir);
+                return ENOMEM;
+            }
+            list = grown;
+        }
+        list[found++] = (thread_t)tid;
+    }
+    closedir(dir);
+
+    *threads = list;
+    *count = found;
+    return 0;
+}
+
+void platform_thread_list_release(
+    thread_act_array_t threads,
+    mach_msg_type_number_t count)
+{
+    (void)count;
+    free(threads);
+}
+
+int platform_thread_retain(thread_t thread)
+{
+    // A tid is just a number; there is no reference to hold
+    (void)thread;
+    return 0;
+}
+
+void platform_thread_release(thread_t thread)
+{
+    (void)thread;
+}
+
+// Helper: Order modules by start address
+static int compare_modules(const void *a, const void *b)
+{
+    const PlatformModule *left = (const PlatformModule *)a;
+    const PlatformModule *right = (const PlatformModule *)b;
+    if (left->start != right->start)
+        return left->start < right->start ? -1 : 1;
+    return 0;
+}
+
+int platform_task_modules(
+    task_t task,
+    PlatformModule **modules,
+    uint32_t *count)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/maps", task);
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return errno;
+
+    uint32_t capacity = 64;
+    uint32_t found = 0;
+    PlatformModule *list = (PlatformModule *)malloc(capacity * sizeof(PlatformModule));
+    if (!list)
+    {
+        fclose(file);
+        return ENOMEM;
+    }
+
+    // Consecutive mappings of the same file form one module:
+    // "start-end perms offset dev inode path"
+    PlatformModule current = {0, 0, 0, NULL};
+    bool has_code = false;
+    unsigned long current_inode = 0;
+    char line[PATH_MAX + 128];
+
+    for (;;)
+    {
+        bool more = fgets(line, sizeof(line), file) != NULL;
+
+        unsigned long long start = 0, end = 0;
+        unsigned long inode = 0;
+        char perms[8] = {0};
+        int name_at = 0;
+        const char *name = "";
+        if (more && sscanf(line, "%llx-%llx %7s %*s %*s %lu %n",
+                           &start, &end, perms, &inode, &name_at) >= 4)
+        {
+            name = line + name_at;
+            line[strcspn(line, "\n")] = '\0';
+        }
+
+        bool same = current.path != NULL && inode == current_inode &&
+                    strcmp(name, current.path) == 0;
+        if (!same && current.path != NULL)
+        {
+            // Close the previous module; keep it only if it has code
+            if (has_code && found == capacity)
+            {
+                capacity *= 2;
+                PlatformModule *grown = (PlatformModule *)realloc(list, capacity * sizeof(PlatformModule));
+                if (!grown)
+                {
+                    free((void *)current.path);
+                    platform_module_list_release(list, found);
+                    fclose(file);
+                    return ENOMEM;
+                }
+                list = grown;
+            }
+
+            if (has_code)
+                list[found++] = current;
+            else
+                free((void *)current.path);
+            current.path = NULL;
+        }
+
+        if (!more)
+            break;
+
+        // Only file-backed mappings are modules ([vdso], [heap], anonymous
+        // memory and deleted files are not)
+        if (name[0] != '/' || inode == 0)
+            continue;
+
+        if (current.path == NULL)
+        {
+            current.path = strdup(name);
+            if (!current.path)
+                continue;
+            current.base = start; // maps is sorted; the first mapping holds the headers
+            current.start = 0;
+            current.end = 0;
+            current_inode = inode;
+            has_code = false;
+        }
+
+        if (perms[2] == 'x')
+        {
+            if (!has_code || start < current.start)
+                current.start = start;
+            if (end > current.end)
+                current.end = end;
+            has_code = true;
+        }
+    }
+    fclose(file);
+
+    qsort(list, found, sizeof(PlatformModule), compare_modules);
+    *modules = list;
+    *count = found;
+    return 0;
+}
+
+void platform_module_list_release(PlatformModule *modules, uint32_t count)
+{
+    if (modules == NULL)
+        return;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        free((void *)modules[i].path);
+    }
+    free(modules);
+}
+
+int platform_task_regions(
+    task_t task,
+    PlatformRegion **regions,
+    uint32_t *count)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/maps", task);
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return errno;
+
+    uint32_t capacity = 256;
+    uint32_t found = 0;
+    PlatformRegion *list = (PlatformRegion *)malloc(capacity * sizeof(PlatformRegion));
+    if (!list)
+    {
+        fclose(file);
+        return ENOMEM;
+    }
+
+    char line[PATH_MAX + 128];
+    while (fgets(line, sizeof(line), file))
+    {
+        unsigned long long start = 0, end = 0;
+        char perms[8] = {0};
+        int name_at = 0;
+        if (sscanf(line, "%llx-%llx %7s %*s %*s %*s %n", &start, &end, perms, &name_at) < 3)
+            continue;
+
+        uint32_t flags = 0;
+        if (perms[0] == 'r')
+            flags |= PLATFORM_REGION_READ;
+        if (perms[1] == 'w')
+            flags |= PLATFORM_REGION_WRITE;
+        if (perms[2] == 'x')
+            flags |= PLATFORM_REGION_EXEC;
+        if (name_at > 0 && strncmp(line + name_at, "[stack]", 7) == 0)
+            flags |= PLATFORM_REGION_STACK;
+
+        // Many files are mapped as several same-protection pieces
+        if (found > 0 && list[found - 1].end == start && list[found - 1].flags == flags)
+        {
+            list[found - 1].end = end;
+            continue;
+        }
+
+        if (found == capacity)
+        {
+            capacity *= 2;
+            PlatformRegion *grown = (PlatformRegion *)realloc(list, capacity * sizeof(PlatformRegion));
+            if (!grown)
+            {
+                free(list);
+                fclose(file);
+                return ENOMEM;
+            }
+            list = grown;
+        }
+
+        list[found].start = start;
+        list[found].end = end;
+        list[found].flags = flags;
+        found++;
+    }
+    fclose(file);
+
+    // maps is already sorted by address
+    *regions = list;
+    *count = found;
+    return 0;
+}
+
+void platform_region_list_release(PlatformRegion *regions, uint32_t count)
+{
+    (void)count;
+    free(regions);
+}
+
+int platform_task_image_generation(task_t task, uint64_t *generation)
+{
+    // Nothing in /proc changes when (only) the images do; callers rescan
+    // maps when a walk runs into memory they have not seen
+    (void)task;
+    *generation = 0;
+    return ENOSYS;
+}
+
+// Helper: Attach to a thread and ask it to stop
+static int interrupt_thread(thread_t thread)
+{
+    // SEIZE does not stop the thread by itself; INTERRUPT does, and unlike
+    // SIGSTOP it is invisible to the rest of the process.
+    if (ptrace(PTRACE_SEIZE, thread, NULL, NULL) != 0)
+        return errno;
+
+    if (ptrace(PTRACE_INTERRUPT, thread, NULL, NULL) != 0)
+    {
+        int err = errno;
+        ptrace(PTRACE_DETACH, thread, NULL, NULL);
+        return err;
+    }
+    return 0;
+}
+
+// Helper: Wait until an interrupted thread has actually stopped
+static int wait_for_stop(thread_t thread)
+{
+    int status;
+    if (waitpid(thread, &status, __WALL) != (pid_t)thread)
+    {
+        int err = errno;
+        ptrace(PTRACE_DETACH, thread, NULL, NULL);
+        return err;
+    }
+
+    if (!WIFSTOPPED(status))
+        return ESRCH; // Thread exited while we were stopping it
+
+    // Anything other than our own interrupt is a real signal that the
+    // thread was about to receive
+    if ((status >> 16) != PTRACE_EVENT_STOP)
+    {
+        std::lock_guard<std::mutex> lock(g_pending_lock);
+        g_pending_signals[thread] = WSTOPSIG(status);
+    }
+
+    return 0;
+}
+
+int platform_thread_suspend(task_t task, thread_t thread)
+{
+    (void)task;
+
+    int err = interrupt_thread(thread);
+    if (err != 0)
+        return err;
+    return wait_for_stop(thread);
+}
+
+int platform_task_suspend(
+    task_t task,
+    const thread_t *threads,
+    mach_msg_type_number_t count,
+    bool *stopped)
+{
+    (void)task;
+
+    // Interrupt everything before waiting on anything, so the stops overlap
+    for (mach_msg_type_number_t i = 0; i < count; i++)
+    {
+        stopped[i] = interrupt_thread(threads[i]) == 0;
+    }
+
+    bool any = false;
+    for (mach_msg_type_number_t i = 0; i < count; i++)
+    {
+        if (stopped[i])
+            stopped[i] = wait_for_stop(threads[i]) == 0;
+        any = any || stopped[i];
+    }
+
+    return (any || count == 0) ? 0 : ESRCH;
+}
+
+int platform_task_resume(
+    task_t task,
+    const thread_t *threads,
+    mach_msg_type_number_t count,
+    const bool *stopped)
+{
+    int result = 0;
+    for (mach_msg_type_number_t i = 0; i < count; i++)
+    {
+        if (!stopped[i])
+            continue;
+
+        int err = platform_thread_resume(task, threads[i]);
+        if (err != 0)
+            result = err;
+    }
+    return result;
+}
+
+int platform_thread_resume(task_t task, thread_t thread)
+{
+    (void)task;
+
+    long signal = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_pending_lock);
+        auto it = g_pending_signals.find(thread);
+        if (it != g_pending_signals.end())
+        {
+            signal = it->second;
+            g_pending_signals.erase(it);
+        }
+    }
+
+    if (ptrace(PTRACE_DETACH, thread, NULL, (void *)signal) != 0)
+        return errno;
+    return 0;
+}
+
+int platform_thread_get_registers(
+    task_t task,
+    thread_t thread,
+    PlatformRegisters *regs)
+{
+    (void)task;
+
+    struct user_regs_struct state;
+    struct iovec iov;
+    iov.iov_base = &state;
+    iov.iov_len = sizeof(state);
+
+    if (ptrace(PTRACE_GETREGSET, thread, (void *)NT_PRSTATUS, &iov) != 0)
+        return errno;
+
+    regs->pc = GET_PC(state);
+    regs->fp = GET_FP(state);
+    regs->sp = GET_SP(state);
+    regs->lr = GET_LR(state);
+    return 0;
+}
+
+int platform_thread_peek_registers(
+    task_t task,
+    thread_t thread,
+    PlatformRegisters *regs)
+{
+    // A blocked thread's user SP and PC as of its last kernel entry:
+    // "nr arg1 ... arg6 sp pc", "-1 sp pc" outside a syscall, or "running"
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/task/%u/syscall", task, thread);
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return errno;
+
+    char buffer[256];
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+    fclose(file);
+    buffer[length] = '\0';
+
+    if (strncmp(buffer, "running", strlen("running")) == 0)
+        return EBUSY;
+
+    // SP and PC are the last two fields
+    char *pc_field = strrchr(buffer, ' ');
+    if (!pc_field || pc_field == buffer)
+        return EINVAL;
+    *pc_field = '\0';
+    char *sp_field = strrchr(buffer, ' ');
+    if (!sp_field)
+        return EINVAL;
+
+    regs->sp = strtoull(sp_field + 1, NULL, 16);
+    regs->pc = strtoull(pc_field + 1, NULL, 16);
+    regs->fp = 0;
+    regs->lr = 0;
+    return regs->pc != 0 ? 0 : EINVAL;
+}
+
+int platform_thread_get_id(task_t task, thread_t thread, uint64_t *thread_id)
+{
+    (void)task;
+
+    // The tid already is the system-wide thread ID
+    *thread_id = thread;
+    return 0;
+}
+
+int platform_thread_get_metadata(
+    task_t task,
+    thread_t thread,
+    PlatformThreadMetadata *metadata)
+{
+    memset(metadata, 0, sizeof(*metadata));
+    metadata->thread_id = thread;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/task/%u/stat", task, thread);
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return errno;
+
+    char buffer[512];
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+    fclose(file);
+    buffer[length] = '\0';
+
+    // "tid (comm) state ..." where comm is the (truncated) thread name
+    const char *open = strchr(buffer, '(');
+    const char *close = strrchr(buffer, ')');
+    if (!open || !close || close < open)
+        return EINVAL;
+
+    size_t name_length = (size_t)(close - open - 1);
+    if (name_length >= sizeof(metadata->name))
+        name_length = sizeof(metadata->name) - 1;
+    memcpy(metadata->name, open + 1, name_length);
+    metadata->name[name_length] = '\0';
+
+    // Linux has no QoS classes or dispatch queues; report niceness so that
+    // larger still means more important
+    int nice = 0;
+    if (sscanf(close + 1,
+               " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %d",
+               &nice) == 1)
+        metadata->priority = 20 - nice;
+    return 0;
+}
+
+// Helper: Nanoseconds a thread has run, from its schedstat (first field)
+// Absent on kernels built without CONFIG_SCHED_INFO.
+static bool read_thread_runtime(task_t task, thread_t thread, uint64_t *runtime_ns)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/task/%u/schedstat", task, thread);
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    unsigned long long runtime = 0;
+    bool parsed = fscanf(file, "%llu", &runtime) == 1;
+    fclose(file);
+
+    *runtime_ns = runtime;
+    return parsed;
+}
+
+int platform_thread_get_basic_info(
+    task_t task,
+    thread_t thread,
+    PlatformThreadBasicInfo *info)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/task/%u/stat", task, thread);
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return errno;
+
+    char buffer[512];
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+    fclose(file);
+    buffer[length] = '\0';
+
+    // The command name may contain spaces and parentheses; fields resume
+    // after the last ')'
+    const char *fields = strrchr(buffer, ')');
+    if (!fields)
+        return EINVAL;
+
+    char state;
+    unsigned long utime = 0;
+    unsigned long stime = 0;
+    int parsed = sscanf(
+        fields + 1,
+        " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+        &state, &utime, &stime);
+
+    if (parsed != 3)
+        return EINVAL;
+
+    switch (state)
+    {
+    case 'R':
+        info->run_state = PLATFORM_THREAD_RUNNING;
+        break;
+    case 'T':
+    case 't':
+        info->run_state = PLATFORM_THREAD_STOPPED;
+        break;
+    case 'S':
+    case 'I':
+        info->run_state = PLATFORM_THREAD_WAITING;
+        break;
+    case 'D':
+        info->run_state = PLATFORM_THREAD_UNINTERRUPTIBLE;
+        break;
+    case 'Z':
+    case 'X':
+        info->run_state = PLATFORM_THREAD_HALTED;
+        break;
+    default:
+        info->run_state = PLATFORM_THREAD_UNKNOWN;
+    }
+
+    uint64_t ns_per_tick = 1000000000ULL / (uint64_t)sysconf(_SC_CLK_TCK);
+    info->user_time_ns = utime * ns_per_tick;
+    info->system_time_ns = stime * ns_per_tick;
+
+    // utime and stime count clock ticks (10 ms at the usual 100 Hz)
+    info->cpu_time_precise = read_thread_runtime(task, thread, &info->cpu_time_ns);
+    if (!info->cpu_time_precise)
+        info->cpu_time_ns = info->user_time_ns + info->system_time_ns;
+    return 0;
+}
+
+int platform_read_memory(
+    task_t task,
+    uint64_t address,
+    void *buffer,
+    size_t size)
+{
+    struct iovec local;
+    struct iovec remote;
+    local.iov_base = buffer;
+    local.iov_len = size;
+    remote.iov_base = (void *)address;
+    remote.iov_len = size;
+
+    ssize_t read = process_vm_readv((pid_t)task, &local, 1, &remote, 1, 0);
+    if (read < 0)
+        return errno;
+    if ((size_t)read != size)
+        return EFAULT;
+    return 0;
+}
+
+size_t platform_read_memory_batch(
+    task_t task,
+    const PlatformReadRequest *requests,
+    size_t count)
+{
+    struct iovec local[64];
+    struct iovec remote[64];
+    size_t completed = 0;
+
+    // process_vm_readv stops at the first remote range it cannot read, so
+    // partial results always cover a prefix of the batch
+    while (completed < count)
+    {
+        size_t chunk = count - completed;
+        if (chunk > sizeof(local) / sizeof(local[0]))
+            chunk = sizeof(local) / sizeof(local[0]);
+
+        size_t wanted = 0;
+        for (size_t i = 0; i < chunk; i++)
+        {
+            const PlatformReadRequest *request = &requests[completed + i];
+            local[i].iov_base = request->buffer;
+            local[i].iov_len = request->size;
+            remote[i].iov_base = (void *)request->address;
+            remote[i].iov_len = request->size;
+            wanted += request->size;
+        }
+
+        ssize_t read = process_vm_readv(
+            (pid_t)task, local, chunk, remote, chunk, 0);
+        if (read <= 0)
+            return completed;
+
+        size_t remaining = (size_t)read;
+        for (size_t i = 0; i < chunk; i++)
+        {
+            if (remaining < requests[completed].size)
+                return completed;
+            remaining -= requests[completed].size;
+            completed++;
+        }
+
+        if ((size_t)read != wanted)
+            return completed;
+    }
+
+    return completed;
+}
+
+#endif // PLATFORM_LINUX
@@ -0,0 +1,646 @@
+#include "platform.h"
+
+#if defined(PLATFORM_MACH)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dlfcn.h>
+#include <sys/qos.h>
+#include <mach/mach.h>
+#include <mach/thread_info.h>
+#include <mach/mach_vm.h>
+#include <mach-o/dyld_images.h>
+#include <mach-o/loader.h>
+
+// Architecture detection
+#if defined(__x86_64__)
+#include <mach/i386/thread_status.h>
+#define THREAD_STATE_FLAVOR x86_THREAD_STATE64
+#define THREAD_STATE_COUNT x86_THREAD_STATE64_COUNT
+typedef x86_thread_state64_t cpu_state_t;
+#define GET_PC(state) ((state).__rip)
+#define GET_FP(state) ((state).__rbp)
+#define GET_SP(state) ((state).__rsp)
+#define GET_LR(state) (0)
+#elif defined(__arm64__) || defined(__aarch64__)
+#include <mach/arm/thread_status.h>
+#define THREAD_STATE_FLAVOR ARM_THREAD_STATE64
+#define THREAD_STATE_COUNT ARM_THREAD_STATE64_COUNT
+typedef arm_thread_state64_t cpu_state_t;
+#define GET_PC(state) ((state).__pc)
+#define GET_FP(state) ((state).__fp)
+#define GET_SP(state) ((state).__sp)
+#define GET_LR(state) ((state).__lr)
+#else
+#error "Unsupported architecture"
+#endif
+
+int platform_task_attach(pid_t pid, task_t *task)
+{
+    return task_for_pid(mach_task_self(), pid, task);
+}
+
+void platform_task_release(task_t task)
+{
+    if (task != 0)
+    {
+        mach_port_deallocate(mach_task_self(), task);
+    }
+}
+
+int platform_task_threads(
+    task_t task,
+    thread_act_array_t *threads,
+    mach_msg_type_number_t *count)
+{
+    return task_threads(task, threads, count);
+}
+
+void platform_thread_list_release(
+    thread_act_array_t threads,
+    mach_msg_type_number_t count)
+{
+    if (threads == NULL)
+        return;
+
+    for (mach_msg_type_number_t i = 0; i < count; i++)
+    {
+        mach_port_deallocate(mach_task_self(), threads[i]);
+    }
+    vm_deallocate(
+        mach_task_self(),
+        (vm_address_t)threads,
+        count * sizeof(thread_t));
+}
+
+int platform_thread_retain(thread_t thread)
+{
+    return mach_port_mod_refs(mach_task_self(), thread, MACH_PORT_RIGHT_SEND, 1);
+}
+
+void platform_thread_release(thread_t thread)
+{
+    mach_port_deallocate(mach_task_self(), thread);
+}
+
+// Helper: Read a NUL-terminated string out of the target
+static char *read_remote_string(task_t task, uint64_t address)
+{
+    char buffer[PATH_MAX];
+    size_t length = 0;
+
+    // Read in small pieces so a string near the end of a mapping still works
+    while (length < sizeof(buffer) - 1)
+    {
+        size_t chunk = 64;
+        if (chunk > sizeof(buffer) - 1 - length)
+            chunk = sizeof(buffer) - 1 - length;
+        if (platform_read_memory(task, address + length, buffer + length, chunk) != 0)
+            break;
+
+        void *nul = memchr(buffer + length, '\0', chunk);
+        if (nul)
+            return strdup(buffer);
+        length += chunk;
+    }
+
+    buffer[length] = '\0';
+    return length > 0 ? strdup(buffer) : NULL;
+}
+
+// Helper: Find the extent of an image's __TEXT segment from its load commands
+static bool read_image_text_range(task_t task, uint64_t header_address,
+                                  uint64_t *start, uint64_t *end)
+{
+    struct mach_header_64 header;
+    if (platform_read_memory(task, header_address, &header, sizeof(header)) != 0 ||
+        header.magic != MH_MAGIC_64)
+        return false;
+
+    uint8_t *commands = (uint8_t *)malloc(header.sizeofcmds);
+    if (!commands)
+        return false;
+
+    bool found = false;
+    if (platform_read_memory(task, header_address + sizeof(header),
+                             commands, header.sizeofcmds) == 0)
+    {
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < header.ncmds && offset + sizeof(struct load_command) <= header.sizeofcmds; i++)
+        {
+            const struct load_command *command = (const struct load_command *)(commands + offset);
+            if (command->cmdsize == 0)
+                break;
+
+            if (command->cmd == LC_SEGMENT_64 &&
+                offset + sizeof(struct segment_command_64) <= header.sizeofcmds)
+            {
+                const struct segment_command_64 *segment = (const struct segment_command_64 *)command;
+                if (strncmp(segment->segname, SEG_TEXT, sizeof(segment->segname)) == 0)
+                {
+                    // The header is the start of __TEXT, so the slide falls out
+                    *start = header_address;
+                    *end = header_address + segment->vmsize;
+                    found = true;
+                    break;
+                }
+            }
+            offset += command->cmdsize;
+        }
+    }
+
+    free(commands);
+    return found;
+}
+
+// Helper: Order modules by start address
+static int compare_modules(const void *a, const void *b)
+{
+    const PlatformModule *left = (const PlatformModule *)a;
+    const PlatformModule *right = (const PlatformModule *)b;
+    if (left->start != right->start)
+        return left->start < right->start ? -1 : 1;
+    return 0;
+}
+
+// Helper: Copy dyld's image list header out of the target
+// Fields newer than the target's dyld are left zeroed.
+static kern_return_t read_all_image_infos(task_t task, struct dyld_all_image_infos *infos)
+{
+    struct task_dyld_info dyld_info;
+    mach_msg_type_number_t info_count = TASK_DYLD_INFO_COUNT;
+    kern_return_t kr = task_info(task, TASK_DYLD_INFO, (task_info_t)&dyld_info, &info_count);
+    if (kr != KERN_SUCCESS)
+        return kr;
+
+    memset(infos, 0, sizeof(*infos));
+    size_t infos_size = dyld_info.all_image_info_size < sizeof(*infos)
+                            ? dyld_info.all_image_info_size
+                            : sizeof(*infos);
+    return platform_read_memory(task, dyld_info.all_image_info_addr, infos, infos_size);
+}
+
+int platform_task_modules(
+    task_t task,
+    PlatformModule **modules,
+    uint32_t *count)
+{
+    struct dyld_all_image_infos infos;
+    kern_return_t kr = read_all_image_infos(task, &infos);
+    if (kr != 0)
+        return kr;
+
+    // dyld clears infoArray while it updates the list; try again later
+    if (infos.infoArray == NULL)
+        return KERN_FAILURE;
+
+    uint32_t image_count = infos.infoArrayCount;
+    struct dyld_image_info *images =
+        (struct dyld_image_info *)malloc((image_count + 1) * sizeof(struct dyld_image_info));
+    PlatformModule *list = (PlatformModule *)calloc(image_count + 1, sizeof(PlatformModule));
+    if (!images || !list)
+    {
+        free(images);
+        free(list);
+        return KERN_RESOURCE_SHORTAGE;
+    }
+
+    kr = platform_read_memory(task, (uint64_t)infos.infoArray, images,
+                              image_count * sizeof(struct dyld_image_info));
+    if (kr != 0)
+    {
+        free(images);
+        free(list);
+        return kr;
+    }
+
+    // dyld itself is not in the image list
+    images[image_count].imageLoadAddress = infos.dyldImageLoadAddress;
+    images[image_count].imageFilePath = "/usr/lib/dyld";
+    images[image_count].imageFileModDate = 0;
+
+    uint32_t found = 0;
+    for (uint32_t i = 0; i <= image_count; i++)
+    {
+        uint64_t header = (uint64_t)images[i].imageLoadAddress;
+        PlatformModule *module = &list[found];
+        if (header == 0 || !read_image_text_range(task, header, &module->start, &module->end))
+            continue;
+
+        module->base = header;
+        module->path = i == image_count
+                           ? strdup(images[i].imageFilePath)
+                           : read_remote_string(task, (uint64_t)images[i].imageFilePath);
+        if (!module->path)
+            module->path = strdup("");
+        found++;
+    }
+    free(images);
+
+    qsort(list, found, sizeof(PlatformModule), compare_modules);
+    *modules = list;
+    *count = found;
+    return 0;
+}
+
+void platform_module_list_release(PlatformModule *modules, uint32_t count)
+{
+    if (modules == NULL)
+        return;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        free((void *)modules[i].path);
+    }
+    free(modules);
+}
+
+int platform_task_regions(
+    task_t task,
+    PlatformRegion **regions,
+    uint32_t *count)
+{
+    uint32_t capacity = 256;
+    uint32_t found = 0;
+    PlatformRegion *list = (PlatformRegion *)malloc(capacity * sizeof(PlatformRegion));
+    if (!list)
+        return KERN_RESOURCE_SHORTAGE;
+
+    // Recurse into submaps (the shared cache) so every leaf mapping gets
+    // its own protection; KERN_INVALID_ADDRESS marks the end of the map
+    mach_vm_address_t address = 0;
+    natural_t depth = 0;
+    for (;;)
+    {
+        mach_vm_size_t size = 0;
+        vm_region_submap_short_info_data_64_t info;
+        mach_msg_type_number_t info_count = VM_REGION_SUBMAP_SHORT_INFO_COUNT_64;
+        kern_return_t kr = mach_vm_region_recurse(task, &address, &size, &depth,
+                                                  (vm_region_recurse_info_t)&info, &info_count);
+        if (kr != KERN_SUCCESS)
+            break;
+
+        if (info.is_submap)
+        {
+            depth++;
+            continue;
+        }
+
+        uint32_t flags = 0;
+        if (info.protection & VM_PROT_READ)
+            flags |= PLATFORM_REGION_READ;
+        if (info.protection & VM_PROT_WRITE)
+            flags |= PLATFORM_REGION_WRITE;
+        if (info.protection & VM_PROT_EXECUTE)
+            flags |= PLATFORM_REGION_EXEC;
+        if (info.user_tag == VM_MEMORY_STACK)
+            flags |= PLATFORM_REGION_STACK;
+
+        if (found > 0 && list[found - 1].end == address && list[found - 1].flags == flags)
+        {
+            list[found - 1].end = address + size;
+        }
+        else
+        {
+            if (found == capacity)
+            {
+                capacity *= 2;
+                PlatformRegion *grown = (PlatformRegion *)realloc(list, capacity * sizeof(PlatformRegion));
+                if (!grown)
+                {
+                    free(list);
+                    return KERN_RESOURCE_SHORTAGE;
+                }
+                list = grown;
+            }
+
+            list[found].start = address;
+            list[found].end = address + size;
+            list[found].flags = flags;
+            found++;
+        }
+
+        address += size;
+    }
+
+    *regions = list;
+    *count = found;
+    return 0;
+}
+
+void platform_region_list_release(PlatformRegion *regions, uint32_t count)
+{
+    (void)count;
+    free(regions);
+}
+
+int platform_task_image_generation(task_t task, uint64_t *generation)
+{
+    struct dyld_all_image_infos infos;
+    kern_return_t kr = read_all_image_infos(task, &infos);
+    if (kr != 0)
+        return kr;
+
+    // dyld stamps the list on every load and unload (version 11+); older
+    // dyld only has the count to go by
+    *generation = infos.infoArrayChangeTimestamp != 0
+                      ? infos.infoArrayChangeTimestamp
+                      : infos.infoArrayCount;
+    return 0;
+}
+
+int platform_thread_suspend(task_t task, thread_t thread)
+{
+    (void)task;
+    return thread_suspend(thread);
+}
+
+int platform_thread_resume(task_t task, thread_t thread)
+{
+    (void)task;
+    return thread_resume(thread);
+}
+
+int platform_task_suspend(
+    task_t task,
+    const thread_t *threads,
+    mach_msg_type_number_t count,
+    bool *stopped)
+{
+    (void)threads;
+
+    kern_return_t kr = task_suspend(task);
+    for (mach_msg_type_number_t i = 0; i < count; i++)
+    {
+        stopped[i] = (kr == KERN_SUCCESS);
+    }
+    return kr;
+}
+
+int platform_task_resume(
+    task_t task,
+    const thread_t *threads,
+    mach_msg_type_number_t count,
+    const bool *stopped)
+{
+    (void)threads;
+    (void)count;
+    (void)stopped;
+
+    return task_resume(task);
+}
+
+int platform_thread_get_registers(
+    task_t task,
+    thread_t thread,
+    PlatformRegisters *regs)
+{
+    (void)task;
+
+    cpu_state_t state;
+    mach_msg_type_number_t state_count = THREAD_STATE_COUNT;
+
+    kern_return_t kr = thread_get_state(
+        thread,
+        THREAD_STATE_FLAVOR,
+        (thread_state_t)&state,
+        &state_count);
+
+    if (kr != KERN_SUCCESS)
+        return kr;
+
+    regs->pc = GET_PC(state);
+    regs->fp = GET_FP(state);
+    regs->sp = GET_SP(state);
+    regs->lr = GET_LR(state);
+    return 0;
+}
+
+int platform_thread_peek_registers(
+    task_t task,
+    thread_t thread,
+    PlatformRegisters *regs)
+{
+    // thread_get_state does not need a suspended thread; for a blocked one
+    // it returns the state saved when it blocked
+    return platform_thread_get_registers(task, thread, regs);
+}
+
+int platform_thread_get_id(task_t task, thread_t thread, uint64_t *thread_id)
+{
+    (void)task;
+
+    thread_identifier_info_data_t identifier_info;
+    mach_msg_type_number_t count = THREAD_IDENTIFIER_INFO_COUNT;
+
+    kern_return_t kr = thread_info(
+        thread,
+        THREAD_IDENTIFIER_INFO,
+        (thread_info_t)&identifier_info,
+        &count);
+
+    if (kr == KERN_SUCCESS)
+    {
+        *thread_id = identifier_info.thread_id;
+        return 0;
+    }
+
+    // Fallback: use thread port as ID
+    *thread_id = thread;
+    return kr;
+}
+
+// Layout of libdispatch's queue structure, published for debuggers
+// (dispatch/queue_private.h; the struct only ever grows at the end)
+typedef struct
+{
+    uint16_t dqo_version;
+    uint16_t dqo_label;
+    uint16_t dqo_label_size;
+} DispatchQueueOffsets;
+
+// Helper: Read the label of the queue a thread is serving
+// dispatch_qaddr is the address of the thread's current-queue slot
+static void read_queue_label(task_t task, uint64_t dispatch_qaddr, char *label, size_t size)
+{
+    static const DispatchQueueOffsets *offsets =
+        (const DispatchQueueOffsets *)dlsym(RTLD_DEFAULT, "dispatch_queue_offsets");
+    if (!offsets || dispatch_qaddr == 0)
+        return;
+
+    uint64_t queue = 0;
+    uint64_t label_address = 0;
+    if (platform_read_memory(task, dispatch_qaddr, &queue, sizeof(queue)) != 0 || queue == 0 ||
+        platform_read_memory(task, queue + offsets->dqo_label, &label_address, sizeof(label_address)) != 0 ||
+        label_address == 0)
+        return;
+
+    char *string = read_remote_string(task, label_address);
+    if (string)
+    {
+        strlcpy(label, string, size);
+        free(string);
+    }
+}
+
+// Helper: Map a base priority to the QoS class that assigns it
+static uint32_t qos_for_priority(int32_t priority)
+{
+    if (priority >= 47)
+        return QOS_CLASS_USER_INTERACTIVE;
+    if (priority >= 37)
+        return QOS_CLASS_USER_INITIATED;
+    if (priority >= 31)
+        return QOS_CLASS_DEFAULT;
+    if (priority >= 20)
+        return QOS_CLASS_UTILITY;
+    if (priority > 0)
+        return QOS_CLASS_BACKGROUND;
+    return QOS_CLASS_UNSPECIFIED;
+}
+
+int platform_thread_get_metadata(
+    task_t task,
+    thread_t thread,
+    PlatformThreadMetadata *metadata)
+{
+    memset(metadata, 0, sizeof(*metadata));
+
+    thread_identifier_info_data_t identifier_info;
+    mach_msg_type_number_t count = THREAD_IDENTIFIER_INFO_COUNT;
+    kern_return_t kr = thread_info(
+        thread,
+        THREAD_IDENTIFIER_INFO,
+        (thread_info_t)&identifier_info,
+        &count);
+    if (kr != KERN_SUCCESS)
+        return kr;
+    metadata->thread_id = identifier_info.thread_id;
+
+    thread_extended_info_data_t extended_info;
+    count = THREAD_EXTENDED_INFO_COUNT;
+    if (thread_info(thread, THREAD_EXTENDED_INFO,
+                    (thread_info_t)&extended_info, &count) == KERN_SUCCESS)
+    {
+        strlcpy(metadata->name, extended_info.pth_name, sizeof(metadata->name));
+        metadata->priority = extended_info.pth_priority;
+        metadata->qos = qos_for_priority(extended_info.pth_priority);
+    }
+
+    read_queue_label(task, identifier_info.dispatch_qaddr,
+                     metadata->queue_label, sizeof(metadata->queue_label));
+    return 0;
+}
+
+static uint64_t time_value_to_ns(time_value_t value)
+{
+    return (uint64_t)value.seconds * 1000000000ULL +
+           (uint64_t)value.microseconds * 1000ULL;
+}
+
+int platform_thread_get_basic_info(
+    task_t task,
+    thread_t thread,
+    PlatformThreadBasicInfo *info)
+{
+    (void)task;
+
+    thread_basic_info_data_t basic_info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+
+    kern_return_t kr = thread_info(
+        thread,
+        THREAD_BASIC_INFO,
+        (thread_info_t)&basic_info,
+        &count);
+
+    if (kr != KERN_SUCCESS)
+        return kr;
+
+    switch (basic_info.run_state)
+    {
+    case TH_STATE_RUNNING:
+        info->run_state = PLATFORM_THREAD_RUNNING;
+        break;
+    case TH_STATE_STOPPED:
+        info->run_state = PLATFORM_THREAD_STOPPED;
+        break;
+    case TH_STATE_WAITING:
+        info->run_state = PLATFORM_THREAD_WAITING;
+        break;
+    case TH_STATE_UNINTERRUPTIBLE:
+        info->run_state = PLATFORM_THREAD_UNINTERRUPTIBLE;
+        break;
+    case TH_STATE_HALTED:
+        info->run_state = PLATFORM_THREAD_HALTED;
+        break;
+    default:
+        info->run_state = PLATFORM_THREAD_UNKNOWN;
+    }
+    info->user_time_ns = time_value_to_ns(basic_info.user_time);
+    info->system_time_ns = time_value_to_ns(basic_info.system_time);
+    info->cpu_time_ns = info->user_time_ns + info->system_time_ns;
+    info->cpu_time_precise = true; // Microseconds
+    return 0;
+}
+
+int platform_read_memory(
+    task_t task,
+    uint64_t address,
+    void *buffer,
+    size_t size)
+{
+    vm_size_t read_size = size;
+    kern_return_t kr = vm_read_overwrite(
+        task,
+        address,
+        size,
+        (vm_address_t)buffer,
+        &read_size);
+
+    if (kr == KERN_SUCCESS && read_size != size)
+        return KERN_INVALID_ADDRESS;
+    return kr;
+}
+
+size_t platform_read_memory_batch(
+    task_t task,
+    const PlatformReadRequest *requests,
+    size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    // Mach has no vectored read. Ranges that are contiguous on both sides
+    // (a stack window split into pages) are tried as one vm_read_overwrite
+    bool contiguous = true;
+    size_t total = requests[0].size;
+    for (size_t i = 1; i < count && contiguous; i++)
+    {
+        contiguous =
+            requests[i].address == requests[i - 1].address + requests[i - 1].size &&
+            (uint8_t *)requests[i].buffer == (uint8_t *)requests[i - 1].buffer + requests[i - 1].size;
+        total += requests[i].size;
+    }
+
+    if (contiguous &&
+        platform_read_memory(task, requests[0].address, requests[0].buffer, total) == 0)
+    {
+        return count;
+    }
+
+    // Otherwise (or if part of the span is unmapped) read range by range
+    for (size_t i = 0; i < count; i++)
+    {
+        if (platform_read_memory(task, requests[i].address,
+                                 requests[i].buffer, requests[i].size) != 0)
+        {
+            return i;
+        }
+    }
+    return count;
+}
+
+#endif // PLATFORM_MACH
@@ -0,0 +1,647 @@
+#include "pprof.h"
+#include "recording.h"
+#include "demangler.h"
+#include "gzip_writer.h"
+#include "stack_walker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <map>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Encoded fields are handed to the file (or compressor) in pieces this large
+#define PPROF_OUTPUT_FLUSH_SIZE (64 * 1024)
+
+// Deepest stack expanded from a recording
+#define PPROF_MAX_STACK_DEPTH 4096
+
+// profile.proto field numbers
+#define PROFILE_SAMPLE_TYPE 1
+#define PROFILE_SAMPLE 2
+#define PROFILE_MAPPING 3
+#define PROFILE_LOCATION 4
+#define PROFILE_FUNCTION 5
+#define PROFILE_STRING_TABLE 6
+#define PROFILE_TIME_NANOS 9
+#define PROFILE_DURATION_NANOS 10
+#define PROFILE_PERIOD_TYPE 11
+#define PROFILE_PERIOD 12
+
+#define VALUE_TYPE_TYPE 1
+#define VALUE_TYPE_UNIT 2
+
+#define SAMPLE_LOCATION_ID 1
+#define SAMPLE_VALUE 2
+#define SAMPLE_LABEL 3
+
+#define LABEL_KEY 1
+#define LABEL_STR 2
+#define LABEL_NUM 3
+
+#define MAPPING_ID 1
+#define MAPPING_START 2
+#define MAPPING_LIMIT 3
+#define MAPPING_FILENAME 5
+#define MAPPING_HAS_FUNCTIONS 7
+
+#define LOCATION_ID 1
+#define LOCATION_MAPPING_ID 2
+#define LOCATION_ADDRESS 3
+#define LOCATION_LINE 4
+
+#define LINE_FUNCTION_ID 1
+
+#define FUNCTION_ID 1
+#define FUNCTION_NAME 2
+#define FUNCTION_SYSTEM_NAME 3
+
+#define WIRE_VARINT 0
+#define WIRE_BYTES 2
+
+typedef struct
+{
+    uint64_t start;
+    uint64_t limit; // One past the highest address seen
+    uint64_t filename;
+    bool has_functions;
+} PprofMapping;
+
+typedef struct
+{
+    uint32_t parent;
+    uint32_t location; // Location ID
+} PprofNode;
+
+// Values of one aggregated pprof sample
+typedef struct
+{
+    uint64_t count;
+    uint64_t cpu_time_ns;
+} PprofValues;
+
+// What one aggregated pprof sample is keyed by
+typedef struct
+{
+    uint32_t node;
+    uint32_t thread_number; // 0 without thread labels
+    uint32_t run_state;     // RECORDING_RUN_STATE_UNKNOWN without state labels
+} PprofSampleKey;
+
+static inline bool operator==(const PprofSampleKey &a, const PprofSampleKey &b)
+{
+    return a.node == b.node && a.thread_number == b.thread_number && a.run_state == b.run_state;
+}
+
+static inline bool operator<(const PprofSampleKey &a, const PprofSampleKey &b)
+{
+    if (a.node != b.node)
+        return a.node < b.node;
+    if (a.thread_number != b.thread_number)
+        return a.thread_number < b.thread_number;
+    return a.run_state < b.run_state;
+}
+
+struct PprofSampleKeyHash
+{
+    size_t operator()(const PprofSampleKey &key) const
+    {
+        uint64_t packed = ((uint64_t)key.node << 32) | key.thread_number;
+        return std::hash<uint64_t>()(packed * 31 + key.run_state);
+    }
+};
+
+struct PprofExporter
+{
+    PprofOptions options;
+    FILE *file;
+    GzipWriter *gzip;
+    int error; // First failed write (0 = none)
+    std::vector<uint8_t> output;  // Top-level fields not yet written
+    std::vector<uint8_t> message; // Scratch for the message being encoded
+    Demangler *demangler;
+
+    std::unordered_map<std::string, uint64_t> strings;
+    std::unordered_map<std::string, uint64_t> functions;   // Symbol name -> function ID
+    std::unordered_map<uint64_t, uint32_t> locations;      // Address -> location ID
+    std::map<std::pair<uint64_t, std::string>, uint32_t> mapping_index; // (base, path) -> mapping ID
+    std::vector<PprofMapping> mappings;                    // By mapping ID - 1
+
+    // Stacks of the whole recording, merged across chunks (node 0 is the root)
+    std::vector<PprofNode> nodes;
+    std::unordered_map<uint64_t, uint32_t> node_index; // (parent, location) -> node
+    std::vector<PprofValues> node_values;              // Without labels
+    std::unordered_map<PprofSampleKey, PprofValues, PprofSampleKeyHash> labelled_values;
+    bool cpu_times; // Some chunk carried CPU time weights
+    std::unordered_map<uint32_t, uint64_t> thread_names;  // Thread number -> string ID
+};
+
+static void put_varint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static inline void put_key(std::vector<uint8_t> &out, uint32_t field, uint32_t wire_type)
+{
+    put_varint(out, ((uint64_t)field << 3) | wire_type);
+}
+
+// Helper: Encode an integer field (zero is the default and is left out)
+static void put_uint(std::vector<uint8_t> &out, uint32_t field, uint64_t value)
+{
+    if (value == 0)
+        return;
+    put_key(out, field, WIRE_VARINT);
+    put_varint(out, value);
+}
+
+static void put_bytes(std::vector<uint8_t> &out, uint32_t field, const void *data, size_t size)
+{
+    put_key(out, field, WIRE_BYTES);
+    put_varint(out, size);
+    const uint8_t *bytes = (const uint8_t *)data;
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+static void put_packed(std::vector<uint8_t> &out, uint32_t field, const uint64_t *values, uint32_t count)
+{
+    size_t size = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint64_t value = values[i];
+        do
+        {
+            size++;
+            value >>= 7;
+        } while (value != 0);
+    }
+
+    put_key(out, field, WIRE_BYTES);
+    put_varint(out, size);
+    for (uint32_t i = 0; i < count; i++)
+        put_varint(out, values[i]);
+}
+
+// Helper: Hand the encoded fields to the file
+static void write_output(PprofExporter *exporter)
+{
+    if (exporter->output.empty())
+        return;
+
+    if (exporter->error == 0)
+    {
+        if (exporter->gzip)
+        {
+            exporter->error = gzip_writer_write(exporter->gzip, exporter->output.data(), exporter->output.size());
+        }
+        else if (fwrite(exporter->output.data(), 1, exporter->output.size(), exporter->file) != exporter->output.size())
+        {
+            exporter->error = errno ? errno : EIO;
+        }
+    }
+    exporter->output.clear();
+}
+
+// Helper: Append the scratch message as a top-level Profile field
+static void emit_message(PprofExporter *exporter, uint32_t field)
+{
+    put_bytes(exporter->output, field, exporter->message.data(), exporter->message.size());
+    exporter->message.clear();
+    if (exporter->output.size() >= PPROF_OUTPUT_FLUSH_SIZE)
+        write_output(exporter);
+}
+
+// Helper: String table index, adding the string on first use
+static uint64_t intern_string(PprofExporter *exporter, const std::string &value)
+{
+    auto it = exporter->strings.find(value);
+    if (it != exporter->strings.end())
+        return it->second;
+
+    uint64_t id = exporter->strings.size();
+    exporter->strings.emplace(value, id);
+    put_bytes(exporter->output, PROFILE_STRING_TABLE, value.data(), value.size());
+    return id;
+}
+
+static void emit_value_type(PprofExporter *exporter, uint32_t field, const char *type, const char *unit)
+{
+    uint64_t type_id = intern_string(exporter, type);
+    uint64_t unit_id = intern_string(exporter, unit);
+    put_uint(exporter->message, VALUE_TYPE_TYPE, type_id);
+    put_uint(exporter->message, VALUE_TYPE_UNIT, unit_id);
+    emit_message(exporter, field);
+}
+
+// Helper: Function ID for a symbol, writing the function on first use
+static uint64_t function_for(PprofExporter *exporter, const char *symbol)
+{
+    auto it = exporter->functions.find(symbol);
+    if (it != exporter->functions.end())
+        return it->second;
+
+    const char *simplified = symbol;
+    if (exporter->demangler)
+        demangler_demangle(exporter->demangler, &symbol, 1, NULL, &simplified);
+
+    uint64_t id = exporter->functions.size() + 1;
+    exporter->functions.emplace(symbol, id);
+
+    uint64_t name = intern_string(exporter, simplified ? simplified : symbol);
+    uint64_t system_name = intern_string(exporter, symbol);
+    put_uint(exporter->message, FUNCTION_ID, id);
+    put_uint(exporter->message, FUNCTION_NAME, name);
+    put_uint(exporter->message, FUNCTION_SYSTEM_NAME, system_name);
+    emit_message(exporter, PROFILE_FUNCTION);
+    return id;
+}
+
+// Helper: Mapping ID for a module, growing its limit to cover an address
+static uint32_t mapping_for(PprofExporter *exporter, uint64_t base, const char *path, uint64_t address, bool symbolized)
+{
+    std::pair<uint64_t, std::string> key(base, path);
+    auto it = exporter->mapping_index.find(key);
+    uint32_t id;
+    if (it == exporter->mapping_index.end())
+    {
+        PprofMapping mapping;
+        mapping.start = base;
+        mapping.limit = base;
+        mapping.filename = intern_string(exporter, path);
+        mapping.has_functions = false;
+        exporter->mappings.push_back(mapping);
+        id = (uint32_t)exporter->mappings.size();
+        exporter->mapping_index.emplace(key, id);
+    }
+    else
+    {
+        id = it->second;
+    }
+
+    PprofMapping *mapping = &exporter->mappings[id - 1];
+    if (address >= mapping->limit)
+        mapping->limit = address + 1;
+    mapping->has_functions |= symbolized;
+    return id;
+}
+
+// Helper: Location ID for a chunk location, writing it (and its function
+// and module) on first use
+static uint32_t location_for(PprofExporter *exporter, const RecordingChunk *chunk, const RecordingLocation *location)
+{
+    auto it = exporter->locations.find(location->address);
+    if (it != exporter->locations.end())
+        return it->second;
+
+    uint32_t id = (uint32_t)exporter->locations.size() + 1;
+    exporter->locations.emplace(location->address, id);
+
+    const char *function = recording_chunk_string(chunk, location->function);
+    const char *module = recording_chunk_string(chunk, location->module);
+
+    uint32_t mapping = 0;
+    if (module)
+        mapping = mapping_for(exporter, location->module_base, module, location->address, function != NULL);
+
+    // Unsymbolized frames still get a function so every tool can show them,
+    // named after the function start when it is known
+    std::string synthesized;
+    if (!function && location->address == STACK_FRAME_ASYNC_MARKER)
+    {
+        function = "[async]";
+    }
+    else if (!function)
+    {
+        char name[64];
+        uint64_t address = location->symbol_address ? location->symbol_address : location->address;
+        if (module)
+        {
+            const char *slash = strrchr(module, '/');
+            synthesized = slash ? slash + 1 : module;
+            snprintf(name, sizeof(name), "+0x%llx", (unsigned long long)(address - location->module_base));
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "0x%llx", (unsigned long long)address);
+        }
+        synthesized += name;
+        function = synthesized.c_str();
+    }
+    uint64_t function_id = function_for(exporter, function);
+
+    put_uint(exporter->message, LOCATION_ID, id);
+    put_uint(exporter->message, LOCATION_MAPPING_ID, mapping);
+    put_uint(exporter->message, LOCATION_ADDRESS, location->address);
+    std::vector<uint8_t> line;
+    put_uint(line, LINE_FUNCTION_ID, function_id);
+    put_bytes(exporter->message, LOCATION_LINE, line.data(), line.size());
+    emit_message(exporter, PROFILE_LOCATION);
+    return id;
+}
+
+// Helper: Global node for a location under a parent node
+static uint32_t node_for(PprofExporter *exporter, uint32_t parent, uint32_t location)
+{
+    uint64_t key = ((uint64_t)parent << 32) | location;
+    auto it = exporter->node_index.find(key);
+    if (it != exporter->node_index.end())
+        return it->second;
+
+    uint32_t id = (uint32_t)exporter->nodes.size();
+    PprofNode node = {parent, location};
+    exporter->nodes.push_back(node);
+    exporter->node_index.emplace(key, id);
+    return id;
+}
+
+// Helper: Merge one chunk's stacks and samples into the global tables
+static uint64_t add_chunk(PprofExporter *exporter, const RecordingChunk *chunk)
+{
+    const RecordingChunkHeader *header = chunk->header;
+
+    if (exporter->options.thread_labels)
+    {
+        for (uint32_t i = 0; i < header->thread_count; i++)
+        {
+            const RecordingThread *thread = &chunk->threads[i];
+            if (exporter->thread_names.count(thread->thread_number))
+                continue;
+
+            const char *name = recording_chunk_string(chunk, thread->name);
+            std::string label;
+            if (name && name[0])
+            {
+                label = name;
+            }
+            else
+            {
+                char number[32];
+                snprintf(number, sizeof(number), "Thread %u", thread->thread_number);
+                label = number;
+            }
+            exporter->thread_names.emplace(thread->thread_number, intern_string(exporter, label));
+        }
+    }
+
+    // Nodes come parents first, so one pass translates the whole trie
+    std::vector<uint32_t> locations(header->location_count, 0);
+    std::vector<uint32_t> nodes(header->node_count, 0);
+    for (uint32_t i = 1; i < header->node_count; i++)
+    {
+        const RecordingNode *node = &chunk->nodes[i];
+        if (node->parent >= i || node->location >= header->location_count)
+            continue; // Malformed; its samples count as empty stacks
+
+        uint32_t location = node->location;
+        if (locations[location] == 0)
+            locations[location] = location_for(exporter, chunk, &chunk->locations[location]);
+        nodes[i] = node_for(exporter, nodes[node->parent], locations[location]);
+    }
+    if (exporter->node_values.size() < exporter->nodes.size())
+        exporter->node_values.resize(exporter->nodes.size(), PprofValues{0, 0});
+    if (header->flags & RECORDING_CHUNK_CPU_TIMES)
+        exporter->cpu_times = true;
+
+    uint64_t exported = 0;
+    RecordingCursor cursor;
+    RecordingSample sample;
+    recording_cursor_init(chunk, 0, &cursor);
+    while (recording_cursor_next(&cursor, &sample))
+    {
+        uint32_t node = nodes[sample.node];
+        if (node == 0)
+            continue;
+
+        if (exporter->options.thread_labels || exporter->options.state_labels)
+        {
+            PprofSampleKey key;
+            key.node = node;
+            key.thread_number = exporter->options.thread_labels ? sample.thread_number : 0;
+            key.run_state = exporter->options.state_labels ? sample.run_state : RECORDING_RUN_STATE_UNKNOWN;
+            PprofValues &values = exporter->labelled_values[key];
+            values.count++;
+            values.cpu_time_ns += sample.cpu_time_ns;
+        }
+        else
+        {
+            exporter->node_values[node].count++;
+            exporter->node_values[node].cpu_time_ns += sample.cpu_time_ns;
+        }
+        exported++;
+    }
+    return exported;
+}
+
+// Helper: Write one aggregated sample
+static void emit_sample(
+    PprofExporter *exporter,
+    uint32_t node,
+    const PprofValues &sample_values,
+    uint64_t period,
+    const uint32_t *thread_number,
+    uint32_t run_state,
+    std::vector<uint64_t> &stack)
+{
+    // Leaf first, as pprof expects
+    stack.clear();
+    for (; node != 0; node = exporter->nodes[node].parent)
+        stack.push_back(exporter->nodes[node].location);
+    put_packed(exporter->message, SAMPLE_LOCATION_ID, stack.data(), (uint32_t)stack.size());
+
+    uint64_t values[3] = {sample_values.count, sample_values.count * period, sample_values.cpu_time_ns};
+    put_packed(exporter->message, SAMPLE_VALUE, values, exporter->cpu_times ? 3 : 2);
+
+    if (thread_number)
+    {
+        std::vector<uint8_t> label;
+        put_uint(label, LABEL_KEY, intern_string(exporter, "thread"));
+        auto name = exporter->thread_names.find(*thread_number);
+        if (name != exporter->thread_names.end())
+            put_uint(label, LABEL_STR, name->second);
+        put_bytes(exporter->message, SAMPLE_LABEL, label.data(), label.size());
+
+        label.clear();
+        put_uint(label, LABEL_KEY, intern_string(exporter, "thread_number"));
+        put_uint(label, LABEL_NUM, *thread_number);
+        put_bytes(exporter->message, SAMPLE_LABEL, label.data(), label.size());
+    }
+
+    const char *state = recording_run_state_name(run_state);
+    if (state)
+    {
+        std::vector<uint8_t> label;
+        put_uint(label, LABEL_KEY, intern_string(exporter, "thread_state"));
+        put_uint(label, LABEL_STR, intern_string(exporter, state));
+        put_bytes(exporter->message, SAMPLE_LABEL, label.data(), label.size());
+    }
+    emit_message(exporter, PROFILE_SAMPLE);
+}
+
+// Helper: Write the aggregated samples, returning how many were written
+static uint32_t emit_samples(PprofExporter *exporter, uint64_t period)
+{
+    std::vector<uint64_t> stack;
+    stack.reserve(PPROF_MAX_STACK_DEPTH);
+
+    uint32_t written = 0;
+    if (exporter->options.thread_labels || exporter->options.state_labels)
+    {
+        // Sorted so the output does not depend on hash order
+        std::vector<std::pair<PprofSampleKey, PprofValues>> samples(exporter->labelled_values.begin(), exporter->labelled_values.end());
+        std::sort(samples.begin(), samples.end(),
+                  [](const std::pair<PprofSampleKey, PprofValues> &a, const std::pair<PprofSampleKey, PprofValues> &b)
+                  { return a.first < b.first; });
+        for (const auto &entry : samples)
+        {
+            const PprofSampleKey &key = entry.first;
+            emit_sample(exporter, key.node, entry.second, period,
+                        exporter->options.thread_labels ? &key.thread_number : NULL, key.run_state, stack);
+            written++;
+        }
+    }
+    else
+    {
+        for (uint32_t node = 1; node < exporter->node_values.size(); node++)
+        {
+            if (exporter->node_values[node].count == 0)
+                continue;
+            emit_sample(exporter, node, exporter->node_values[node], period, NULL, RECORDING_RUN_STATE_UNKNOWN, stack);
+            written++;
+        }
+    }
+    return written;
+}
+
+static void emit_mappings(PprofExporter *exporter)
+{
+    for (uint32_t i = 0; i < exporter->mappings.size(); i++)
+    {
+        const PprofMapping *mapping = &exporter->mappings[i];
+        put_uint(exporter->message, MAPPING_ID, i + 1);
+        put_uint(exporter->message, MAPPING_START, mapping->start);
+        put_uint(exporter->message, MAPPING_LIMIT, mapping->limit);
+        put_uint(exporter->message, MAPPING_FILENAME, mapping->filename);
+        put_uint(exporter->message, MAPPING_HAS_FUNCTIONS, mapping->has_functions ? 1 : 0);
+        emit_message(exporter, PROFILE_MAPPING);
+    }
+}
+
+PprofOptions pprof_default_options(void)
+{
+    PprofOptions options;
+    options.thread_labels = true;
+    options.compress = true;
+    options.state_labels = true;
+    return options;
+}
+
+int pprof_export_recording(
+    const char *recording_path,
+    const char *output_path,
+    const PprofOptions *options,
+    PprofExportStats *stats)
+{
+    RecordingReader *reader = recording_open(recording_path);
+    if (!reader)
+    {
+        fprintf(stderr, "Warning: %s is not a readable recording\n", recording_path);
+        return -1;
+    }
+
+    PprofExporter *exporter = new (std::nothrow) PprofExporter();
+    if (!exporter)
+    {
+        recording_close(reader);
+        return ENOMEM;
+    }
+
+    exporter->options = options ? *options : pprof_default_options();
+    exporter->file = fopen(output_path, "wb");
+    if (!exporter->file)
+    {
+        int error = errno;
+        delete exporter;
+        recording_close(reader);
+        return error;
+    }
+    exporter->gzip = exporter->options.compress ? gzip_writer_open(exporter->file) : NULL;
+    if (exporter->options.compress && !exporter->gzip)
+        exporter->error = ENOMEM;
+    exporter->demangler = demangler_create();
+
+    PprofNode root = {0, 0};
+    exporter->nodes.push_back(root);
+
+    // The string table must start with ""
+    intern_string(exporter, "");
+
+    const RecordingFileHeader *header = recording_header(reader);
+    uint64_t period = (uint64_t)header->sample_interval_us * 1000;
+    put_uint(exporter->output, PROFILE_TIME_NANOS, header->start_wall_ns);
+
+    uint64_t exported = 0;
+    uint64_t end_ns = header->start_ns;
+    uint32_t chunk_count = recording_chunk_count(reader);
+    for (uint32_t i = 0; i < chunk_count && exporter->error == 0; i++)
+    {
+        RecordingChunk chunk;
+        if (recording_get_chunk(reader, i, &chunk) != 0)
+            break;
+
+        exported += add_chunk(exporter, &chunk);
+        if (chunk.header->end_ns > end_ns)
+            end_ns = chunk.header->end_ns;
+    }
+    put_uint(exporter->output, PROFILE_DURATION_NANOS, end_ns - header->start_ns);
+
+    // Whether there is a CPU time value is only known once every chunk was read
+    emit_value_type(exporter, PROFILE_SAMPLE_TYPE, "samples", "count");
+    emit_value_type(exporter, PROFILE_SAMPLE_TYPE, "time", "nanoseconds");
+    if (exporter->cpu_times)
+        emit_value_type(exporter, PROFILE_SAMPLE_TYPE, "cpu", "nanoseconds");
+    emit_value_type(exporter, PROFILE_PERIOD_TYPE, "time", "nanoseconds");
+    put_uint(exporter->output, PROFILE_PERIOD, period);
+
+    uint32_t written = emit_samples(exporter, period);
+    emit_mappings(exporter);
+    write_output(exporter);
+
+    if (exporter->gzip)
+    {
+        int error = gzip_writer_close(exporter->gzip);
+        if (exporter->error == 0)
+            exporter->error = error;
+    }
+    if (fflush(exporter->file) != 0 && exporter->error == 0)
+        exporter->error = errno ? errno : EIO;
+    long bytes = ftell(exporter->file);
+    if (fclose(exporter->file) != 0 && exporter->error == 0)
+        exporter->error = errno ? errno : EIO;
+
+    if (stats)
+    {
+        stats->samples = exported;
+        stats->bytes = bytes > 0 ? (uint64_t)bytes : 0;
+        stats->stacks = written;
+        stats->locations = (uint32_t)exporter->locations.size();
+        stats->functions = (uint32_t)exporter->functions.size();
+        stats->mappings = (uint32_t)exporter->mappings.size();
+    }
+
+    int error = exporter->error;
+    if (exporter->demangler)
+        demangler_destroy(exporter->demangler);
+    delete exporter;
+    recording_close(reader);
+    return error;
+}
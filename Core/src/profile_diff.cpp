@@ -0,0 +1,581 @@
+#include "profile_diff.h"
+#include "recording.h"
+#include "call_tree.h"
+#include "demangler.h"
+#include "stack_walker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Deepest stack taken from a recording
+#define DIFF_MAX_STACK_DEPTH 4096
+
+// Flame graph geometry (pixels)
+#define FLAME_WIDTH 1200
+#define FLAME_FRAME_HEIGHT 16
+#define FLAME_PADDING 10
+#define FLAME_HEADER 24
+#define FLAME_MIN_WIDTH 0.1
+#define FLAME_CHAR_WIDTH 7.0
+
+// A node of the merged top-down tree
+typedef struct
+{
+    uint32_t parent;
+    uint32_t frame; // Index into names
+    uint32_t depth;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint64_t self[2];
+    uint64_t total[2];
+} DiffNode;
+
+struct ProfileDiff
+{
+    ProfileDiffOptions options;
+    Demangler *demangler;
+
+    // Frame keys shared by both sides: alignment key -> frame
+    std::unordered_map<std::string, uint32_t> frame_index;
+    std::vector<std::string> names; // Display name per frame
+
+    CallTree *trees[2];
+    uint64_t samples[2];
+
+    std::vector<DiffNode> nodes; // Node 0 is the root
+    std::vector<ProfileDiffFunction> functions;
+    std::vector<ProfileDiffStack> stacks;
+};
+
+// Helper: Two-proportion z score of a change from a/na to b/nb
+static double z_score(uint64_t a, uint64_t na, uint64_t b, uint64_t nb)
+{
+    if (na == 0 || nb == 0)
+        return 0;
+
+    double pa = (double)a / (double)na;
+    double pb = (double)b / (double)nb;
+    double pooled = (double)(a + b) / (double)(na + nb);
+    double se = sqrt(pooled * (1.0 - pooled) * (1.0 / (double)na + 1.0 / (double)nb));
+    return se > 0 ? (pb - pa) / se : 0;
+}
+
+// Helper: Fraction of a side's samples (0 for an empty side)
+static inline double fraction(const ProfileDiff *diff, int side, uint64_t count)
+{
+    return diff->samples[side] ? (double)count / (double)diff->samples[side] : 0;
+}
+
+// Helper: Frame for a chunk location, keyed so that runs line up
+static uint32_t frame_for(ProfileDiff *diff, const RecordingChunk *chunk, const RecordingLocation *location)
+{
+    const char *function = recording_chunk_string(chunk, location->function);
+    const char *module = recording_chunk_string(chunk, location->module);
+
+    std::string key;
+    if (function)
+    {
+        key = function;
+    }
+    else if (location->address == STACK_FRAME_ASYNC_MARKER)
+    {
+        key = "[async]";
+    }
+    else
+    {
+        char offset[32];
+        if (module)
+        {
+            const char *slash = strrchr(module, '/');
+            key = slash ? slash + 1 : module;
+            snprintf(offset, sizeof(offset), "+0x%llx", (unsigned long long)(location->address - location->module_base));
+        }
+        else
+        {
+            snprintf(offset, sizeof(offset), "0x%llx", (unsigned long long)location->address);
+        }
+        key += offset;
+    }
+
+    auto it = diff->frame_index.find(key);
+    if (it != diff->frame_index.end())
+        return it->second;
+
+    const char *simplified = NULL;
+    if (function && diff->demangler)
+    {
+        const char *name = key.c_str();
+        demangler_demangle(diff->demangler, &name, 1, NULL, &simplified);
+    }
+
+    uint32_t frame = (uint32_t)diff->names.size();
+    diff->names.push_back(simplified ? simplified : key);
+    diff->frame_index.emplace(key, frame);
+    return frame;
+}
+
+// Helper: Aggregate one recording into a side's call tree
+static bool load_side(ProfileDiff *diff, int side, const char *path)
+{
+    RecordingReader *reader = recording_open(path);
+    if (!reader)
+    {
+        fprintf(stderr, "Warning: %s is not a readable recording\n", path);
+        return false;
+    }
+
+    std::vector<uint64_t> counts;
+    std::vector<uint32_t> frames_of_location;
+    std::vector<uint32_t> locations(DIFF_MAX_STACK_DEPTH);
+    std::vector<uint64_t> frames(DIFF_MAX_STACK_DEPTH);
+
+    uint32_t chunk_count = recording_chunk_count(reader);
+    for (uint32_t c = 0; c < chunk_count; c++)
+    {
+        RecordingChunk chunk;
+        if (recording_get_chunk(reader, c, &chunk) != 0)
+            break;
+
+        // Count per stack first, so each stack is added once per chunk
+        counts.assign(chunk.header->node_count, 0);
+        RecordingCursor cursor;
+        RecordingSample sample;
+        recording_cursor_init(&chunk, 0, &cursor);
+        while (recording_cursor_next(&cursor, &sample))
+            counts[sample.node]++;
+
+        frames_of_location.assign(chunk.header->location_count, UINT32_MAX);
+        for (uint32_t node = 1; node < chunk.header->node_count; node++)
+        {
+            if (counts[node] == 0)
+                continue;
+
+            uint32_t depth = recording_chunk_stack(&chunk, node, locations.data(), DIFF_MAX_STACK_DEPTH);
+            for (uint32_t i = 0; i < depth; i++)
+            {
+                uint32_t location = locations[i];
+                if (frames_of_location[location] == UINT32_MAX)
+                    frames_of_location[location] = frame_for(diff, &chunk, &chunk.locations[location]);
+                frames[i] = frames_of_location[location];
+            }
+            if (depth > 0 && call_tree_add(diff->trees[side], frames.data(), depth, counts[node]) != 0)
+            {
+                recording_close(reader);
+                return false;
+            }
+        }
+    }
+
+    recording_close(reader);
+    diff->samples[side] = call_tree_total_weight(diff->trees[side]);
+    return true;
+}
+
+// Helper: Merge both top-down trees into diff->nodes
+static void build_merged_tree(ProfileDiff *diff)
+{
+    typedef struct
+    {
+        uint32_t node[2]; // In each side's tree (CALL_TREE_NONE if absent)
+        uint32_t parent;  // In the merged tree
+    } Pending;
+
+    const CallTreeNode *sides[2] = {
+        call_tree_nodes(diff->trees[0], CALL_TREE_TOP_DOWN),
+        call_tree_nodes(diff->trees[1], CALL_TREE_TOP_DOWN)};
+
+    std::vector<Pending> pending;
+    Pending root = {{CALL_TREE_ROOT, CALL_TREE_ROOT}, CALL_TREE_NONE};
+    pending.push_back(root);
+
+    // Depth first, so a parent always gets a lower ID than its children
+    while (!pending.empty())
+    {
+        Pending item = pending.back();
+        pending.pop_back();
+
+        DiffNode node;
+        memset(&node, 0, sizeof(node));
+        node.parent = item.parent;
+        node.first_child = CALL_TREE_NONE;
+        node.next_sibling = CALL_TREE_NONE;
+        for (int side = 0; side < 2; side++)
+        {
+            if (item.node[side] == CALL_TREE_NONE)
+                continue;
+            const CallTreeNode *source = &sides[side][item.node[side]];
+            node.frame = (uint32_t)source->frame;
+            node.self[side] = source->self;
+            node.total[side] = source->total;
+        }
+
+        uint32_t id = (uint32_t)diff->nodes.size();
+        if (item.parent != CALL_TREE_NONE)
+        {
+            DiffNode *parent = &diff->nodes[item.parent];
+            node.depth = parent->depth + 1;
+            node.next_sibling = parent->first_child;
+            parent->first_child = id;
+        }
+        diff->nodes.push_back(node);
+
+        // Children of A, paired with B's where the frame matches, then
+        // children only B has
+        uint32_t a = item.node[0], b = item.node[1];
+        if (a != CALL_TREE_NONE)
+        {
+            for (uint32_t child = sides[0][a].first_child; child != CALL_TREE_NONE; child = sides[0][child].next_sibling)
+            {
+                uint32_t match = b != CALL_TREE_NONE
+                                     ? call_tree_find_child(diff->trees[1], CALL_TREE_TOP_DOWN, b, sides[0][child].frame)
+                                     : CALL_TREE_NONE;
+                Pending next = {{child, match}, id};
+                pending.push_back(next);
+            }
+        }
+        if (b != CALL_TREE_NONE)
+        {
+            for (uint32_t child = sides[1][b].first_child; child != CALL_TREE_NONE; child = sides[1][child].next_sibling)
+            {
+                if (a != CALL_TREE_NONE &&
+                    call_tree_find_child(diff->trees[0], CALL_TREE_TOP_DOWN, a, sides[1][child].frame) != CALL_TREE_NONE)
+                    continue;
+                Pending next = {{CALL_TREE_NONE, child}, id};
+                pending.push_back(next);
+            }
+        }
+    }
+}
+
+static void build_functions(ProfileDiff *diff)
+{
+    std::unordered_map<uint32_t, uint32_t> index; // Frame -> entry
+    for (int side = 0; side < 2; side++)
+    {
+        uint32_t count = call_tree_function_count(diff->trees[side]);
+        std::vector<CallTreeFunction> functions(count);
+        count = call_tree_top_functions(diff->trees[side], functions.data(), count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t frame = (uint32_t)functions[i].frame;
+            auto it = index.find(frame);
+            if (it == index.end())
+            {
+                ProfileDiffFunction entry;
+                memset(&entry, 0, sizeof(entry));
+                entry.name = diff->names[frame].c_str();
+                it = index.emplace(frame, (uint32_t)diff->functions.size()).first;
+                diff->functions.push_back(entry);
+            }
+            ProfileDiffFunction *entry = &diff->functions[it->second];
+            entry->self[side] = functions[i].self;
+            entry->total[side] = functions[i].total;
+        }
+    }
+
+    for (ProfileDiffFunction &entry : diff->functions)
+    {
+        entry.self_delta = fraction(diff, 1, entry.self[1]) - fraction(diff, 0, entry.self[0]);
+        entry.total_delta = fraction(diff, 1, entry.total[1]) - fraction(diff, 0, entry.total[0]);
+        if (entry.self[0] || entry.self[1])
+            entry.z = z_score(entry.self[0], diff->samples[0], entry.self[1], diff->samples[1]);
+        else
+            entry.z = z_score(entry.total[0], diff->samples[0], entry.total[1], diff->samples[1]);
+        entry.significant = fabs(entry.z) >= diff->options.min_z;
+    }
+
+    std::sort(diff->functions.begin(), diff->functions.end(),
+              [](const ProfileDiffFunction &a, const ProfileDiffFunction &b)
+              {
+                  if (a.self_delta != b.self_delta)
+                      return a.self_delta > b.self_delta;
+                  if (a.total_delta != b.total_delta)
+                      return a.total_delta > b.total_delta;
+                  return strcmp(a.name, b.name) < 0;
+              });
+}
+
+static void build_stacks(ProfileDiff *diff)
+{
+    for (uint32_t id = 1; id < diff->nodes.size(); id++)
+    {
+        const DiffNode *node = &diff->nodes[id];
+        if (node->self[0] == 0 && node->self[1] == 0)
+            continue;
+
+        ProfileDiffStack stack;
+        stack.node = id;
+        stack.depth = node->depth;
+        stack.count[0] = node->self[0];
+        stack.count[1] = node->self[1];
+        stack.delta = fraction(diff, 1, node->self[1]) - fraction(diff, 0, node->self[0]);
+        stack.z = z_score(node->self[0], diff->samples[0], node->self[1], diff->samples[1]);
+        stack.significant = fabs(stack.z) >= diff->options.min_z;
+        diff->stacks.push_back(stack);
+    }
+
+    std::sort(diff->stacks.begin(), diff->stacks.end(),
+              [](const ProfileDiffStack &a, const ProfileDiffStack &b)
+              {
+                  if (a.delta != b.delta)
+                      return a.delta > b.delta;
+                  return a.node < b.node;
+              });
+}
+
+ProfileDiffOptions profile_diff_default_options(void)
+{
+    ProfileDiffOptions options;
+    options.min_z = 3.29;
+    return options;
+}
+
+ProfileDiff *profile_diff_create(
+    const char *baseline_path,
+    const char *comparison_path,
+    const ProfileDiffOptions *options)
+{
+    ProfileDiff *diff = new (std::nothrow) ProfileDiff();
+    if (!diff)
+        return NULL;
+
+    diff->options = options ? *options : profile_diff_default_options();
+    diff->demangler = demangler_create();
+    diff->trees[0] = call_tree_create();
+    diff->trees[1] = call_tree_create();
+    diff->samples[0] = diff->samples[1] = 0;
+    if (!diff->trees[0] || !diff->trees[1] ||
+        !load_side(diff, 0, baseline_path) ||
+        !load_side(diff, 1, comparison_path))
+    {
+        profile_diff_destroy(diff);
+        return NULL;
+    }
+
+    build_merged_tree(diff);
+    build_functions(diff);
+    build_stacks(diff);
+    return diff;
+}
+
+void profile_diff_destroy(ProfileDiff *diff)
+{
+    if (!diff)
+        return;
+
+    call_tree_destroy(diff->trees[0]);
+    call_tree_destroy(diff->trees[1]);
+    if (diff->demangler)
+        demangler_destroy(diff->demangler);
+    delete diff;
+}
+
+uint64_t profile_diff_sample_count(const ProfileDiff *diff, int side)
+{
+    return side == 0 || side == 1 ? diff->samples[side] : 0;
+}
+
+uint32_t profile_diff_functions(
+    const ProfileDiff *diff,
+    ProfileDiffFunction *functions,
+    uint32_t max_functions)
+{
+    uint32_t count = std::min(max_functions, (uint32_t)diff->functions.size());
+    memcpy(functions, diff->functions.data(), count * sizeof(ProfileDiffFunction));
+    return count;
+}
+
+uint32_t profile_diff_function_count(const ProfileDiff *diff)
+{
+    return (uint32_t)diff->functions.size();
+}
+
+uint32_t profile_diff_stacks(
+    const ProfileDiff *diff,
+    ProfileDiffStack *stacks,
+    uint32_t max_stacks)
+{
+    uint32_t count = std::min(max_stacks, (uint32_t)diff->stacks.size());
+    memcpy(stacks, diff->stacks.data(), count * sizeof(ProfileDiffStack));
+    return count;
+}
+
+uint32_t profile_diff_stack_count(const ProfileDiff *diff)
+{
+    return (uint32_t)diff->stacks.size();
+}
+
+uint32_t profile_diff_stack_frames(
+    const ProfileDiff *diff,
+    uint32_t node,
+    const char **names,
+    uint32_t max_names)
+{
+    uint32_t count = 0;
+    while (node != CALL_TREE_ROOT && node < diff->nodes.size() && count < max_names)
+    {
+        names[count++] = diff->names[diff->nodes[node].frame].c_str();
+        node = diff->nodes[node].parent;
+    }
+    return count;
+}
+
+// Helper: Write text with the XML special characters escaped
+static void write_escaped(FILE *file, const char *text, size_t length)
+{
+    for (size_t i = 0; i < length && text[i]; i++)
+    {
+        switch (text[i])
+        {
+        case '&':
+            fputs("&amp;", file);
+            break;
+        case '<':
+            fputs("&lt;", file);
+            break;
+        case '>':
+            fputs("&gt;", file);
+            break;
+        case '"':
+            fputs("&quot;", file);
+            break;
+        default:
+            fputc(text[i], file);
+        }
+    }
+}
+
+// Helper: Close a file, returning the first error of writing it
+static int finish_file(FILE *file)
+{
+    int error = ferror(file) ? (errno ? errno : EIO) : 0;
+    if (fclose(file) != 0 && error == 0)
+        error = errno ? errno : EIO;
+    return error;
+}
+
+int profile_diff_write_flame_graph(const ProfileDiff *diff, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+        return errno;
+
+    uint32_t max_depth = 0;
+    double max_delta = 0;
+    for (const DiffNode &node : diff->nodes)
+    {
+        max_depth = std::max(max_depth, node.depth);
+        double delta = fabs(fraction(diff, 1, node.total[1]) - fraction(diff, 0, node.total[0]));
+        max_delta = std::max(max_delta, delta);
+    }
+
+    double usable = FLAME_WIDTH - 2 * FLAME_PADDING;
+    uint32_t height = FLAME_HEADER + (max_depth + 1) * FLAME_FRAME_HEIGHT + 2 * FLAME_PADDING;
+    fprintf(file,
+            "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+            "<svg version=\"1.1\" width=\"%d\" height=\"%u\" xmlns=\"http://www.w3.org/2000/svg\" "
+            "font-family=\"Verdana, sans-serif\" font-size=\"12\">\n"
+            "<rect x=\"0\" y=\"0\" width=\"100%%\" height=\"100%%\" fill=\"#f8f8f8\"/>\n"
+            "<text x=\"%d\" y=\"%d\" font-size=\"14\">Differential flame graph: %llu -&gt; %llu samples "
+            "(width: B, red: grew, blue: shrank)</text>\n",
+            FLAME_WIDTH, height, FLAME_PADDING, FLAME_PADDING + 12,
+            (unsigned long long)diff->samples[0], (unsigned long long)diff->samples[1]);
+
+    // Children go left to right in name order, starting at the parent's x
+    std::vector<double> x(diff->nodes.size(), FLAME_PADDING);
+    std::vector<uint32_t> children;
+    for (uint32_t id = 0; id < diff->nodes.size(); id++)
+    {
+        const DiffNode *node = &diff->nodes[id];
+        double width = fraction(diff, 1, node->total[1]) * usable;
+        if (width < FLAME_MIN_WIDTH)
+            continue;
+
+        children.clear();
+        for (uint32_t child = node->first_child; child != CALL_TREE_NONE; child = diff->nodes[child].next_sibling)
+            children.push_back(child);
+        std::sort(children.begin(), children.end(), [diff](uint32_t a, uint32_t b)
+                  { return diff->names[diff->nodes[a].frame] < diff->names[diff->nodes[b].frame]; });
+        double cursor = x[id];
+        for (uint32_t child : children)
+        {
+            x[child] = cursor;
+            cursor += fraction(diff, 1, diff->nodes[child].total[1]) * usable;
+        }
+
+        double a = fraction(diff, 0, node->total[0]);
+        double b = fraction(diff, 1, node->total[1]);
+        double intensity = max_delta > 0 ? fabs(b - a) / max_delta : 0;
+        int shade = (int)(235 - 185 * intensity);
+        int red = b >= a ? 255 : shade;
+        int blue = b >= a ? shade : 255;
+
+        const char *name = id == CALL_TREE_ROOT ? "all" : diff->names[node->frame].c_str();
+        double y = height - FLAME_PADDING - (node->depth + 1) * FLAME_FRAME_HEIGHT;
+
+        fputs("<g><title>", file);
+        write_escaped(file, name, strlen(name));
+        fprintf(file, " (A: %.2f%%, B: %.2f%%, %+.2f%%)</title>", a * 100, b * 100, (b - a) * 100);
+        fprintf(file, "<rect x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%d\" fill=\"rgb(%d,%d,%d)\" rx=\"2\"/>",
+                x[id], y, width, FLAME_FRAME_HEIGHT - 1, red, shade, blue);
+
+        size_t fits = (size_t)((width - 6) / FLAME_CHAR_WIDTH);
+        if (fits >= 3)
+        {
+            size_t length = strlen(name);
+            fprintf(file, "<text x=\"%.1f\" y=\"%.1f\">", x[id] + 3, y + FLAME_FRAME_HEIGHT - 4);
+            if (length <= fits)
+            {
+                write_escaped(file, name, length);
+            }
+            else
+            {
+                write_escaped(file, name, fits - 2);
+                fputs("..", file);
+            }
+            fputs("</text>", file);
+        }
+        fputs("</g>\n", file);
+    }
+
+    fputs("</svg>\n", file);
+    return finish_file(file);
+}
+
+int profile_diff_write_folded(const ProfileDiff *diff, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+        return errno;
+
+    double scale = diff->samples[0] ? (double)diff->samples[1] / (double)diff->samples[0] : 0;
+    std::vector<uint32_t> path_nodes;
+    for (const ProfileDiffStack &stack : diff->stacks)
+    {
+        path_nodes.clear();
+        for (uint32_t node = stack.node; node != CALL_TREE_ROOT; node = diff->nodes[node].parent)
+            path_nodes.push_back(node);
+
+        // Outermost first; ';' separates frames, so it may not appear in one
+        for (size_t i = path_nodes.size(); i > 0; i--)
+        {
+            for (const char *c = diff->names[diff->nodes[path_nodes[i - 1]].frame].c_str(); *c; c++)
+                fputc(*c == ';' ? ':' : *c, file);
+            if (i > 1)
+                fputc(';', file);
+        }
+        fprintf(file, " %llu %llu\n",
+                (unsigned long long)llround((double)stack.count[0] * scale),
+                (unsigned long long)stack.count[1]);
+    }
+
+    return finish_file(file);
+}
@@ -1,15 +1,10 @@
 #include "profiler.h"
+#include "profiler_internal.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <mach/thread_info.h>
-
-// Internal data structure
-typedef struct
-{
-    ProfilerConfig config;
-    ProfilerStats stats;
-} ProfilerInternalData;
+#include <time.h>
+#include <new>
 
 ProfilerConfig profiler_default_config(void)
 {
@@ -19,9 +14,56 @@ ProfilerConfig profiler_default_config(void)
     config.track_async = false;
     config.track_threads = true;
     config.stack_strategy = STACK_WALK_FRAME_POINTER; // STACK_WALK_FRAME_POINTER
+    config.stack_window_size = STACK_WINDOW_DEFAULT_SIZE;
+    config.sample_buffer_size = 1024;
+    config.capture_workers = STACK_WALKER_DEFAULT_WORKERS;
+    config.snapshot_mode = false;
+    config.sampling_mode = PROFILER_SAMPLING_WALL_CLOCK;
+    config.optimistic_capture = false;
     return config;
 }
 
+// Helper: Get current time in nanoseconds (same clock as StackTrace)
+static uint64_t get_timestamp_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Helper: Pick the async context layout for the target's Swift runtime
+// The runtime's version comes from its path; a runtime linked into the
+// executable, or one whose path does not say, gets the newest layout. The
+// layout is looked up again only when a different runtime image appears.
+static void update_async_layout(ProfilerInternalData *internal, task_t task)
+{
+    PlatformModule *modules = NULL;
+    uint32_t count = 0;
+    if (platform_task_modules(task, &modules, &count) != 0)
+        return;
+
+    const PlatformModule *runtime = NULL;
+    for (uint32_t i = 0; i < count && !runtime; i++)
+    {
+        if (async_is_runtime_module(modules[i].path))
+            runtime = &modules[i];
+    }
+
+    uint64_t base = runtime ? runtime->base : 0;
+    if (!internal->async_layout || base != internal->async_runtime_base)
+    {
+        uint32_t version = runtime ? async_runtime_version(runtime->path) : 0;
+        internal->async_layout = async_layout_for_version(version);
+        internal->async_runtime_base = base;
+        stack_walker_set_async_layout(internal->async_layout);
+
+        if (!internal->async_layout)
+            printf("Warning: Swift runtime too old for async stacks\n");
+    }
+
+    platform_module_list_release(modules, count);
+}
+
 int profiler_attach(
     pid_t pid,
     const ProfilerConfig *config,
@@ -33,7 +75,7 @@ int profiler_attach(
     target->state = PROFILER_STATE_DETACHED;
 
     // Allocate internal data
-    ProfilerInternalData *internal = (ProfilerInternalData *)malloc(sizeof(ProfilerInternalData));
+    ProfilerInternalData *internal = new (std::nothrow) ProfilerInternalData();
     if (!internal)
     {
         return -1;
@@ -42,6 +84,34 @@ int profiler_attach(
     // Store config
     internal->config = config ? *config : profiler_default_config();
     memset(&internal->stats, 0, sizeof(ProfilerStats));
+    for (uint32_t i = 0; i < PROFILER_METRIC_COUNT; i++)
+        histogram_reset(&internal->metrics[i]);
+    pthread_mutex_init(&internal->stats_lock, NULL);
+    pthread_mutex_init(&internal->stacks_lock, NULL);
+    pthread_mutex_init(&internal->symbolizer_lock, NULL);
+    pthread_mutex_init(&internal->regions_lock, NULL);
+    pthread_mutex_init(&internal->threads_lock, NULL);
+    internal->stacks = stack_table_create();
+    internal->threads = NULL;
+    internal->thread_events.init(PROFILER_THREAD_EVENT_BUFFER_SIZE);
+    stack_frame_arena_init(&internal->arena, MAX_STACK_DEPTH * 16);
+    stack_frame_arena_init(&internal->sampler_arena, MAX_STACK_DEPTH);
+    internal->sampler_running = false;
+    internal->recording = NULL;
+    internal->recorder_running = false;
+    internal->sampler_traces = NULL;
+    internal->sampler_threads = NULL;
+    internal->sampler_indices = NULL;
+    internal->sampler_states = NULL;
+    internal->sampler_cpu_times = NULL;
+    internal->sampler_hints = NULL;
+    internal->sampler_trace_capacity = 0;
+    internal->unwind = NULL;
+    internal->async_layout = NULL;
+    internal->async_runtime_base = 0;
+    internal->regions = NULL;
+    internal->symbolizer = NULL;
+    internal->demangler = NULL;
     target->internal_data = internal;
 
     // Initialize stack walker with config
@@ -50,19 +120,37 @@ int profiler_attach(
     sw_config.max_depth = internal->config.max_stack_depth;
     sw_config.capture_timestamps = true;
     sw_config.validate_addresses = false;
+    sw_config.capture_thread_ids = false; // Cached by the thread registry
+    sw_config.stack_window_size = internal->config.stack_window_size;
+    sw_config.capture_workers = internal->config.capture_workers;
+    sw_config.track_async = internal->config.track_async;
+    sw_config.cache_suffixes = true;
+    sw_config.optimistic_capture = internal->config.optimistic_capture;
     stack_walker_init(&sw_config);
 
     // Get task port from PID
-    kern_return_t kr = task_for_pid(
-        mach_task_self(),
-        pid,
-        &target->task);
+    int kr = platform_task_attach(pid, &target->task);
 
-    if (kr != KERN_SUCCESS)
+    if (kr != 0)
     {
-        printf("Error: task_for_pid failed with code: %d\n", kr);
+        printf("Error: attach failed with code: %d\n", kr);
         printf("Hint: Try running with sudo or add task_for_pid entitlement\n");
-        free(internal);
+        stack_walker_cleanup();
+        pthread_mutex_destroy(&internal->stats_lock);
+        pthread_mutex_destroy(&internal->stacks_lock);
+        pthread_mutex_destroy(&internal->symbolizer_lock);
+        pthread_mutex_destroy(&internal->regions_lock);
+        pthread_mutex_destroy(&internal->threads_lock);
+        stack_table_destroy(internal->stacks);
+        stack_frame_arena_destroy(&internal->arena);
+        stack_frame_arena_destroy(&internal->sampler_arena);
+        free(internal->sampler_traces);
+        free(internal->sampler_threads);
+        free(internal->sampler_indices);
+        free(internal->sampler_states);
+        free(internal->sampler_cpu_times);
+        free(internal->sampler_hints);
+        delete internal;
         target->internal_data = NULL;
         return kr;
     }
@@ -70,6 +158,280 @@ int profiler_attach(
     target->state = PROFILER_STATE_ATTACHED;
     printf("Attached to process %d (task port: 0x%x)\n", pid, target->task);
 
+    // Filled by the first refresh, which reports every thread as created
+    internal->threads = thread_registry_create(target->task);
+
+    // Walks are checked against the target's memory map
+    internal->regions = region_map_create(target->task);
+    stack_walker_set_region_map(internal->regions);
+
+    // The CFI strategies unwind against rules compiled from every module
+    if (internal->config.stack_strategy != STACK_WALK_FRAME_POINTER)
+    {
+        internal->unwind = unwind_table_create(target->task);
+        stack_walker_set_unwind_table(internal->unwind);
+        if (internal->unwind)
+        {
+            printf("Unwind tables: %u module(s), %llu rules\n",
+                   unwind_table_module_count(internal->unwind),
+                   (unsigned long long)unwind_table_row_count(internal->unwind));
+        }
+    }
+
+    if (internal->config.track_async)
+        update_async_layout(internal, target->task);
+
+    return 0;
+}
+
+void profiler_intern_trace(
+    ProfilerInternalData *internal,
+    const StackFrameArena *arena,
+    StackTrace *trace)
+{
+    trace->stack_id = STACK_ID_EMPTY;
+    if (!internal->stacks)
+        return;
+
+    pthread_mutex_lock(&internal->stacks_lock);
+    trace->stack_id = stack_table_intern(
+        internal->stacks,
+        stack_trace_frames(arena, trace),
+        trace->frame_count);
+    pthread_mutex_unlock(&internal->stacks_lock);
+}
+
+uint32_t profiler_stack_depth(ProfilerInternalData *internal, uint32_t stack_id)
+{
+    if (!internal->stacks)
+        return 0;
+
+    pthread_mutex_lock(&internal->stacks_lock);
+    uint32_t depth = stack_table_depth(internal->stacks, stack_id);
+    pthread_mutex_unlock(&internal->stacks_lock);
+    return depth;
+}
+
+int profiler_capture_threads(
+    ProfilerInternalData *internal,
+    task_t task,
+    const thread_t *threads,
+    uint32_t thread_count,
+    const StackWalkOrigin *hints,
+    StackFrameArena *arena,
+    StackTrace *traces,
+    uint64_t *pause_ns,
+    uint64_t *walk_ns)
+{
+    *pause_ns = 0;
+    profiler_update_regions(internal);
+
+    uint64_t start = get_timestamp_ns();
+    int captured;
+    if (internal->config.snapshot_mode)
+    {
+        captured = stack_walker_capture_snapshot(
+            task, threads, thread_count, hints, arena, traces, pause_ns);
+    }
+    else
+    {
+        // Use batch capture for efficiency
+        captured = stack_walker_capture_batch(task, threads, thread_count, hints, arena, traces);
+    }
+    *walk_ns = get_timestamp_ns() - start;
+    return captured;
+}
+
+void profiler_update_regions(ProfilerInternalData *internal)
+{
+    if (!internal->regions)
+        return;
+
+    bool images_changed = false;
+    pthread_mutex_lock(&internal->regions_lock);
+    region_map_update(internal->regions, &images_changed);
+    pthread_mutex_unlock(&internal->regions_lock);
+
+    // Libraries loaded while sampling need their unwind rows before the walk
+    if (images_changed && internal->unwind)
+        unwind_table_refresh(internal->unwind);
+}
+
+void profiler_record_pause(ProfilerInternalData *internal, uint64_t pause_ns)
+{
+    uint32_t bucket = 0;
+    uint64_t pause_us = pause_ns / 1000;
+    while (pause_us > 0 && bucket < PROFILER_PAUSE_HISTOGRAM_BUCKETS - 1)
+    {
+        pause_us >>= 1;
+        bucket++;
+    }
+
+    internal->stats.snapshot_count++;
+    internal->stats.total_pause_ns += pause_ns;
+    if (pause_ns > internal->stats.max_pause_ns)
+        internal->stats.max_pause_ns = pause_ns;
+    internal->stats.pause_histogram[bucket]++;
+}
+
+void profiler_record_capture_modes(
+    ProfilerInternalData *internal,
+    const StackTrace *traces,
+    uint32_t trace_count)
+{
+    for (uint32_t i = 0; i < trace_count; i++)
+    {
+        const StackTrace *trace = &traces[i];
+        if (trace->pause_ns > 0)
+        {
+            internal->stats.stopped_captures++;
+            internal->stats.thread_pause_ns += trace->pause_ns;
+        }
+        if (trace->optimistic_attempts > 0)
+        {
+            internal->stats.optimistic_retries += trace->optimistic_attempts - 1;
+            if (trace->torn)
+                internal->stats.discarded_samples++;
+            else if (trace->pause_ns == 0)
+                internal->stats.optimistic_samples++;
+        }
+    }
+}
+
+void profiler_record_overhead(
+    ProfilerInternalData *internal,
+    const StackTrace *traces,
+    uint32_t trace_count,
+    uint64_t pause_ns,
+    uint64_t bookkeeping_ns)
+{
+    Histogram *metrics = internal->metrics;
+    for (uint32_t i = 0; i < trace_count; i++)
+    {
+        const StackTrace *trace = &traces[i];
+
+        // ProfilerMetric starts with the walker phases, in the same order
+        for (uint32_t phase = 0; phase < STACK_PHASE_COUNT; phase++)
+        {
+            if (trace->phase_ns[phase] > 0)
+                histogram_record(&metrics[phase], trace->phase_ns[phase]);
+        }
+        if (trace->pause_ns > 0)
+            histogram_record(&metrics[PROFILER_METRIC_PAUSE_NS], trace->pause_ns);
+        if (trace->phase_ns[STACK_PHASE_WALK] > 0)
+        {
+            histogram_record(&metrics[PROFILER_METRIC_REMOTE_READS], trace->remote_reads);
+            histogram_record(&metrics[PROFILER_METRIC_BYTES_READ], trace->bytes_read);
+        }
+    }
+
+    if (pause_ns > 0)
+        histogram_record(&metrics[PROFILER_METRIC_PAUSE_NS], pause_ns);
+    histogram_record(&metrics[PROFILER_METRIC_BOOKKEEPING_NS], bookkeeping_ns);
+}
+
+void profiler_record_batch_skew(
+    ProfilerInternalData *internal,
+    const StackTrace *traces,
+    uint32_t trace_count)
+{
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0;
+
+    for (uint32_t i = 0; i < trace_count; i++)
+    {
+        if ((traces[i].frame_count == 0 && !traces[i].unchanged) || traces[i].timestamp_ns == 0)
+            continue;
+        if (traces[i].timestamp_ns < first)
+            first = traces[i].timestamp_ns;
+        if (traces[i].timestamp_ns > last)
+            last = traces[i].timestamp_ns;
+    }
+
+    internal->stats.last_batch_skew_ns = last > first ? last - first : 0;
+    if (internal->stats.last_batch_skew_ns > internal->stats.max_batch_skew_ns)
+        internal->stats.max_batch_skew_ns = internal->stats.last_batch_skew_ns;
+}
+
+void profiler_update_table_stats(ProfilerInternalData *internal)
+{
+    if (internal->regions)
+        internal->stats.region_scans = region_map_scan_count(internal->regions);
+
+    if (!internal->stacks)
+        return;
+
+    pthread_mutex_lock(&internal->stacks_lock);
+    internal->stats.unique_addresses = stack_table_unique_addresses(internal->stacks);
+    internal->stats.unique_stacks = stack_table_stack_count(internal->stacks);
+    pthread_mutex_unlock(&internal->stacks_lock);
+}
+
+// Helper: Queue one lifecycle event for profiler_poll_thread_events
+static void queue_thread_event(const ThreadEvent *event, void *context)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)context;
+    bool queued = internal->thread_events.push(*event);
+
+    pthread_mutex_lock(&internal->stats_lock);
+    if (event->type == THREAD_EVENT_CREATED)
+        internal->stats.threads_created++;
+    else
+        internal->stats.threads_exited++;
+    if (!queued)
+        internal->stats.dropped_thread_events++;
+    pthread_mutex_unlock(&internal->stats_lock);
+}
+
+int profiler_update_threads(ProfilerInternalData *internal)
+{
+    if (!internal->threads)
+        return -1;
+
+    pthread_mutex_lock(&internal->threads_lock);
+    int result = thread_registry_refresh(
+        internal->threads,
+        internal->config.track_threads ? queue_thread_event : NULL,
+        internal);
+    pthread_mutex_unlock(&internal->threads_lock);
+    return result;
+}
+
+void profiler_label_traces(
+    ProfilerInternalData *internal,
+    StackTrace *traces,
+    const uint32_t *indices,
+    uint32_t trace_count)
+{
+    if (!internal->threads)
+        return;
+
+    const ThreadRecord *records = thread_registry_records(internal->threads);
+    uint32_t count = thread_registry_count(internal->threads);
+
+    for (uint32_t i = 0; i < trace_count; i++)
+    {
+        uint32_t index = indices ? indices[i] : i;
+        if (index >= count)
+            continue;
+        traces[i].thread_number = records[index].thread_number;
+        traces[i].thread_id = records[index].thread_id;
+    }
+}
+
+int profiler_sync_target_threads(ProfilerTarget *target)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    uint32_t count = thread_registry_count(internal->threads);
+
+    thread_act_array_t threads = (thread_act_array_t)realloc(
+        target->threads, (count ? count : 1) * sizeof(thread_t));
+    if (!threads)
+        return -1;
+
+    memcpy(threads, thread_registry_threads(internal->threads), count * sizeof(thread_t));
+    target->threads = threads;
+    target->thread_count = count;
     return 0;
 }
 
@@ -81,35 +443,47 @@ int profiler_refresh_threads(ProfilerTarget *target)
         return -1;
     }
 
-    // Free old thread list if exists
-    if (target->threads != NULL)
+    if (target->state == PROFILER_STATE_SAMPLING)
     {
-        for (mach_msg_type_number_t i = 0; i < target->thread_count; i++)
-        {
-            mach_port_deallocate(mach_task_self(), target->threads[i]);
-        }
-        vm_deallocate(
-            mach_task_self(),
-            (vm_address_t)target->threads,
-            target->thread_count * sizeof(thread_t));
-        target->threads = NULL;
-        target->thread_count = 0;
+        // The sampler thread owns the thread list
+        printf("Error: Cannot refresh threads while sampling\n");
+        return -1;
     }
 
-    // Get fresh thread list
-    kern_return_t kr = task_threads(
-        target->task,
-        &target->threads,
-        &target->thread_count);
+    // Only threads that were created or exited since the last refresh
+    // cost anything; survivors keep their handles and numbers
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    int kr = profiler_update_threads(internal);
+    if (kr == 0)
+        kr = profiler_sync_target_threads(target);
 
-    if (kr != KERN_SUCCESS)
+    if (kr != 0)
     {
         printf("Error: task_threads failed with code: %d\n", kr);
         target->state = PROFILER_STATE_ERROR;
         return kr;
     }
 
-    printf("Found %d thread(s)\n", target->thread_count);
+    // Pick up libraries loaded and stacks mapped since the last refresh
+    if (internal->unwind)
+        unwind_table_refresh(internal->unwind);
+
+    if (internal->regions)
+    {
+        pthread_mutex_lock(&internal->regions_lock);
+        region_map_refresh(internal->regions);
+        pthread_mutex_unlock(&internal->regions_lock);
+    }
+
+    if (internal->config.track_async)
+        update_async_layout(internal, target->task);
+
+    pthread_mutex_lock(&internal->symbolizer_lock);
+    if (internal->symbolizer)
+        symbolizer_refresh(internal->symbolizer);
+    internal->function_starts.clear();
+    pthread_mutex_unlock(&internal->symbolizer_lock);
+
     return 0;
 }
 
@@ -118,7 +492,8 @@ int profiler_capture_thread_stack(
     uint32_t thread_index,
     StackTrace *trace)
 {
-    if (target->state == PROFILER_STATE_DETACHED)
+    if (target->state == PROFILER_STATE_DETACHED ||
+        target->state == PROFILER_STATE_SAMPLING)
     {
         return -1;
     }
@@ -131,21 +506,46 @@ int profiler_capture_thread_stack(
     }
 
     ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    uint64_t start = get_timestamp_ns();
 
     thread_t thread = target->threads[thread_index];
-    int result = stack_walker_capture(target->task, thread, trace);
+    stack_frame_arena_reset(&internal->arena);
+    profiler_update_regions(internal);
+    uint64_t walk_start = get_timestamp_ns();
+    int result = stack_walker_capture(target->task, thread, &internal->arena, trace);
+    uint64_t walk_ns = get_timestamp_ns() - walk_start;
+    if (internal->threads && thread_index < thread_registry_count(internal->threads))
+    {
+        const ThreadRecord *record = &thread_registry_records(internal->threads)[thread_index];
+        trace->thread_number = record->thread_number;
+        trace->thread_id = record->thread_id;
+    }
+    if (result == 0)
+    {
+        profiler_intern_trace(internal, &internal->arena, trace);
+    }
 
     // Update stats
+    pthread_mutex_lock(&internal->stats_lock);
     internal->stats.total_samples++;
-    if (result == 0)
+    internal->stats.kernel_calls += trace->kernel_calls;
+    profiler_record_capture_modes(internal, trace, 1);
+    profiler_record_overhead(internal, trace, 1, 0, get_timestamp_ns() - start - walk_ns);
+    if (result == 0 && !trace->torn)
     {
         internal->stats.successful_samples++;
         internal->stats.total_frames += trace->frame_count;
+        internal->stats.cached_frames += trace->cached_frames;
+        internal->stats.remote_reads += trace->remote_reads;
+        internal->stats.failed_reads += trace->failed_reads;
+        internal->stats.rejected_reads += trace->rejected_reads;
     }
     else
     {
         internal->stats.failed_samples++;
     }
+    profiler_update_table_stats(internal);
+    pthread_mutex_unlock(&internal->stats_lock);
 
     return result;
 }
@@ -155,36 +555,308 @@ int profiler_capture_all_stacks(
     StackTrace *traces,
     uint32_t *trace_count)
 {
-    if (target->state == PROFILER_STATE_DETACHED)
+    if (target->state == PROFILER_STATE_DETACHED ||
+        target->state == PROFILER_STATE_SAMPLING)
     {
         return -1;
     }
 
     *trace_count = 0;
 
-    // Use batch capture for efficiency
-    int captured = stack_walker_capture_batch(
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    uint64_t start = get_timestamp_ns();
+    stack_frame_arena_reset(&internal->arena);
+
+    uint64_t pause_ns = 0;
+    uint64_t walk_ns = 0;
+    int captured = profiler_capture_threads(
+        internal,
         target->task,
         target->threads,
         target->thread_count,
-        traces);
+        NULL,
+        &internal->arena,
+        traces,
+        &pause_ns,
+        &walk_ns);
 
     *trace_count = captured;
+    profiler_label_traces(internal, traces, NULL, target->thread_count);
+
+    for (uint32_t i = 0; i < target->thread_count; i++)
+    {
+        profiler_intern_trace(internal, &internal->arena, &traces[i]);
+    }
 
     // Update stats
-    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    pthread_mutex_lock(&internal->stats_lock);
     internal->stats.total_samples += target->thread_count;
     internal->stats.successful_samples += captured;
     internal->stats.failed_samples += (target->thread_count - captured);
 
-    for (uint32_t i = 0; i < captured; i++)
+    // Traces stay in registry order; failed ones hold no frames
+    for (uint32_t i = 0; i < target->thread_count; i++)
     {
         internal->stats.total_frames += traces[i].frame_count;
+        internal->stats.cached_frames += traces[i].cached_frames;
+        internal->stats.remote_reads += traces[i].remote_reads;
+        internal->stats.failed_reads += traces[i].failed_reads;
+        internal->stats.rejected_reads += traces[i].rejected_reads;
+        internal->stats.kernel_calls += traces[i].kernel_calls;
     }
+    if (internal->config.snapshot_mode)
+        profiler_record_pause(internal, pause_ns);
+    profiler_record_capture_modes(internal, traces, target->thread_count);
+    profiler_record_overhead(internal, traces, target->thread_count, pause_ns,
+                             get_timestamp_ns() - start - walk_ns);
+    profiler_record_batch_skew(internal, traces, target->thread_count);
+    profiler_update_table_stats(internal);
+    pthread_mutex_unlock(&internal->stats_lock);
 
     return 0;
 }
 
+const StackFrame *profiler_trace_frames(
+    const ProfilerTarget *target,
+    const StackTrace *trace)
+{
+    const ProfilerInternalData *internal = (const ProfilerInternalData *)target->internal_data;
+    if (!internal || trace->frame_count == 0)
+    {
+        return NULL;
+    }
+
+    return stack_trace_frames(&internal->arena, trace);
+}
+
+int profiler_symbolize_addresses(
+    ProfilerInternalData *internal,
+    task_t task,
+    const uint64_t *addresses,
+    uint32_t count,
+    SymbolInfo *symbols)
+{
+    pthread_mutex_lock(&internal->symbolizer_lock);
+    if (!internal->symbolizer)
+    {
+        internal->symbolizer = symbolizer_create(task, NULL);
+    }
+    if (!internal->symbolizer)
+    {
+        pthread_mutex_unlock(&internal->symbolizer_lock);
+        return -1;
+    }
+
+    symbolizer_resolve(internal->symbolizer, addresses, count, symbols);
+    pthread_mutex_unlock(&internal->symbolizer_lock);
+    return 0;
+}
+
+int profiler_symbolize(
+    ProfilerTarget *target,
+    const uint64_t *addresses,
+    uint32_t count,
+    SymbolInfo *symbols)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (!internal || target->state == PROFILER_STATE_DETACHED)
+    {
+        return -1;
+    }
+
+    return profiler_symbolize_addresses(internal, target->task, addresses, count, symbols);
+}
+
+// Helper: Demangle names, creating the demangler on first use
+static int demangle(
+    ProfilerInternalData *internal,
+    const char *const *names,
+    uint32_t count,
+    const char **full,
+    const char **simplified)
+{
+    pthread_mutex_lock(&internal->symbolizer_lock);
+    if (!internal->demangler)
+    {
+        internal->demangler = demangler_create();
+    }
+    if (!internal->demangler)
+    {
+        pthread_mutex_unlock(&internal->symbolizer_lock);
+        return -1;
+    }
+
+    demangler_demangle(internal->demangler, names, count, full, simplified);
+    pthread_mutex_unlock(&internal->symbolizer_lock);
+    return 0;
+}
+
+int profiler_demangle(
+    ProfilerTarget *target,
+    const char *const *names,
+    uint32_t count,
+    const char **full,
+    const char **simplified)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (!internal || target->state == PROFILER_STATE_DETACHED)
+    {
+        return -1;
+    }
+
+    return demangle(internal, names, count, full, simplified);
+}
+
+int profiler_resolve_module(
+    ProfilerTarget *target,
+    uint64_t address,
+    char *path,
+    size_t path_size,
+    uint64_t *offset)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (!internal || !internal->regions || target->state == PROFILER_STATE_DETACHED)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&internal->regions_lock);
+    const PlatformModule *module = NULL;
+    bool found = region_map_find_module(internal->regions, address, &module, offset);
+    if (found && path && path_size > 0)
+    {
+        snprintf(path, path_size, "%s", module->path);
+    }
+    pthread_mutex_unlock(&internal->regions_lock);
+
+    return found ? 0 : -1;
+}
+
+int profiler_get_thread_info(
+    ProfilerTarget *target,
+    uint32_t thread_number,
+    ThreadRecord *record)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (!internal || !internal->threads || target->state == PROFILER_STATE_DETACHED)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&internal->threads_lock);
+    const ThreadRecord *found = thread_registry_find(internal->threads, thread_number);
+    if (found)
+    {
+        *record = *found;
+    }
+    pthread_mutex_unlock(&internal->threads_lock);
+
+    return found ? 0 : -1;
+}
+
+void profiler_print_trace(
+    const ProfilerTarget *target,
+    const StackTrace *trace)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (!internal)
+    {
+        return;
+    }
+
+    const StackFrame *frames = stack_trace_frames(&internal->arena, trace);
+    uint32_t count = trace->frame_count;
+    uint64_t *lookups = (uint64_t *)malloc((count ? count : 1) * sizeof(uint64_t));
+    SymbolInfo *symbols = (SymbolInfo *)malloc((count ? count : 1) * sizeof(SymbolInfo));
+
+    // Callers' frames hold return addresses, which may already be past the
+    // end of the calling function
+    for (uint32_t i = 0; lookups && i < count; i++)
+    {
+        lookups[i] = frames[i].address - (i > 0 && frames[i].address > 0 ? 1 : 0);
+    }
+
+    if (!lookups || !symbols || profiler_symbolize_addresses(internal, target->task, lookups, count, symbols) != 0)
+    {
+        free(lookups);
+        free(symbols);
+        stack_walker_print(&internal->arena, trace);
+        return;
+    }
+
+    // Show the short demangled form; the raw name if demangling is unavailable
+    const char **names = (const char **)malloc((count ? count : 1) * sizeof(const char *));
+    for (uint32_t i = 0; names && i < count; i++)
+    {
+        names[i] = symbols[i].name;
+    }
+    if (names && demangle(internal, names, count, NULL, names) != 0)
+    {
+        free(names);
+        names = NULL;
+    }
+
+    printf("[%llu] Thread %u (%d frames)\n",
+           (unsigned long long)trace->thread_id,
+           trace->thread,
+           trace->frame_count);
+
+    for (uint32_t i = 0; i < trace->frame_count; i++)
+    {
+        if (frames[i].address == STACK_FRAME_ASYNC_MARKER)
+        {
+            printf("  ---- awaited by ----\n");
+            continue;
+        }
+
+        const SymbolInfo *symbol = &symbols[i];
+        printf("  #%-3d 0x%016llx", i, (unsigned long long)frames[i].address);
+
+        if (symbol->name)
+        {
+            printf("  %s + %llu", names ? names[i] : symbol->name,
+                   (unsigned long long)(frames[i].address - symbol->symbol_address));
+        }
+        if (symbol->module)
+        {
+            const char *slash = strrchr(symbol->module, '/');
+            printf("  (%s)", slash ? slash + 1 : symbol->module);
+        }
+
+        printf("\n");
+    }
+
+    if (trace->timestamp_ns > 0)
+    {
+        printf("  Captured at: %llu ns\n", (unsigned long long)trace->timestamp_ns);
+    }
+
+    free(lookups);
+    free(symbols);
+    free(names);
+}
+
+int profiler_get_stack(
+    ProfilerTarget *target,
+    uint32_t stack_id,
+    uint64_t *addresses,
+    uint32_t max_addresses,
+    uint32_t *address_count)
+{
+    *address_count = 0;
+
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (!internal || !internal->stacks)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&internal->stacks_lock);
+    *address_count = stack_table_get(internal->stacks, stack_id, addresses, max_addresses);
+    pthread_mutex_unlock(&internal->stacks_lock);
+    return 0;
+}
+
 void profiler_get_stats(
     const ProfilerTarget *target,
     ProfilerStats *stats)
@@ -196,7 +868,43 @@ void profiler_get_stats(
     }
 
     ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    pthread_mutex_lock(&internal->stats_lock);
     *stats = internal->stats;
+    pthread_mutex_unlock(&internal->stats_lock);
+}
+
+int profiler_get_metric(
+    const ProfilerTarget *target,
+    ProfilerMetric metric,
+    HistogramSummary *summary)
+{
+    memset(summary, 0, sizeof(HistogramSummary));
+    if (!target->internal_data || (uint32_t)metric >= PROFILER_METRIC_COUNT)
+        return -1;
+
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    pthread_mutex_lock(&internal->stats_lock);
+    histogram_summarize(&internal->metrics[metric], summary);
+    pthread_mutex_unlock(&internal->stats_lock);
+    return 0;
+}
+
+int profiler_get_metric_histogram(
+    const ProfilerTarget *target,
+    ProfilerMetric metric,
+    Histogram *histogram)
+{
+    if (!target->internal_data || (uint32_t)metric >= PROFILER_METRIC_COUNT)
+    {
+        histogram_reset(histogram);
+        return -1;
+    }
+
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    pthread_mutex_lock(&internal->stats_lock);
+    *histogram = internal->metrics[metric];
+    pthread_mutex_unlock(&internal->stats_lock);
+    return 0;
 }
 
 void profiler_print_thread_info(ProfilerTarget *target)
@@ -228,42 +936,36 @@ void profiler_print_thread_info(ProfilerTarget *target)
     {
         thread_t thread = target->threads[i];
 
-        thread_basic_info_data_t basic_info;
-        mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+        PlatformThreadBasicInfo basic_info;
+        int kr = platform_thread_get_basic_info(target->task, thread, &basic_info);
 
-        kern_return_t kr = thread_info(
-            thread,
-            THREAD_BASIC_INFO,
-            (thread_info_t)&basic_info,
-            &count);
-
-        if (kr == KERN_SUCCESS)
+        if (kr == 0)
         {
             printf("  Thread %d (port: 0x%x)\n", i, thread);
             printf("    State: ");
             switch (basic_info.run_state)
             {
-            case TH_STATE_RUNNING:
+            case PLATFORM_THREAD_RUNNING:
                 printf("RUNNING\n");
                 break;
-            case TH_STATE_STOPPED:
+            case PLATFORM_THREAD_STOPPED:
                 printf("STOPPED\n");
                 break;
-            case TH_STATE_WAITING:
+            case PLATFORM_THREAD_WAITING:
                 printf("WAITING\n");
                 break;
-            case TH_STATE_UNINTERRUPTIBLE:
+            case PLATFORM_THREAD_UNINTERRUPTIBLE:
                 printf("UNINTERRUPTIBLE\n");
                 break;
-            case TH_STATE_HALTED:
+            case PLATFORM_THREAD_HALTED:
                 printf("HALTED\n");
                 break;
             default:
                 printf("UNKNOWN\n");
             }
-            printf("    CPU time: %d.%06d seconds\n",
-                   basic_info.user_time.seconds,
-                   basic_info.user_time.microseconds);
+            printf("    CPU time: %llu.%06llu seconds\n",
+                   (unsigned long long)(basic_info.user_time_ns / 1000000000ULL),
+                   (unsigned long long)(basic_info.user_time_ns % 1000000000ULL / 1000ULL));
         }
         else
         {
@@ -280,32 +982,50 @@ void profiler_detach(ProfilerTarget *target)
         return;
     }
 
-    // Free threads
-    if (target->threads != NULL)
-    {
-        for (mach_msg_type_number_t i = 0; i < target->thread_count; i++)
-        {
-            mach_port_deallocate(mach_task_self(), target->threads[i]);
-        }
-        vm_deallocate(
-            mach_task_self(),
-            (vm_address_t)target->threads,
-            target->thread_count * sizeof(thread_t));
-        target->threads = NULL;
-        target->thread_count = 0;
-    }
+    // The sampler must be gone before the thread list goes away, and the
+    // recording writer drains what it left behind
+    profiler_sampler_shutdown(target);
+    profiler_recorder_shutdown(target);
+
+    // Free threads (the registry holds the references; this is a copy)
+    free(target->threads);
+    target->threads = NULL;
+    target->thread_count = 0;
 
     // Deallocate task port
     if (target->task != 0)
     {
-        mach_port_deallocate(mach_task_self(), target->task);
+        platform_task_release(target->task);
         target->task = 0;
     }
 
     // Free internal data
     if (target->internal_data)
     {
-        free(target->internal_data);
+        ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+        stack_walker_set_unwind_table(NULL);
+        stack_walker_set_region_map(NULL);
+        stack_walker_set_async_layout(NULL);
+        unwind_table_destroy(internal->unwind);
+        region_map_destroy(internal->regions);
+        thread_registry_destroy(internal->threads);
+        symbolizer_destroy(internal->symbolizer);
+        demangler_destroy(internal->demangler);
+        pthread_mutex_destroy(&internal->stats_lock);
+        pthread_mutex_destroy(&internal->stacks_lock);
+        pthread_mutex_destroy(&internal->symbolizer_lock);
+        pthread_mutex_destroy(&internal->regions_lock);
+        pthread_mutex_destroy(&internal->threads_lock);
+        stack_table_destroy(internal->stacks);
+        stack_frame_arena_destroy(&internal->arena);
+        stack_frame_arena_destroy(&internal->sampler_arena);
+        free(internal->sampler_traces);
+        free(internal->sampler_threads);
+        free(internal->sampler_indices);
+        free(internal->sampler_states);
+        free(internal->sampler_cpu_times);
+        free(internal->sampler_hints);
+        delete internal;
         target->internal_data = NULL;
     }
 
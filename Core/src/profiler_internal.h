@@ -0,0 +1,236 @@
+#ifndef PROFILER_INTERNAL_H
+#define PROFILER_INTERNAL_H
+
+#include "profiler.h"
+#include "spsc_ring.h"
+#include "recording.h"
+#include <pthread.h>
+#include <atomic>
+#include <unordered_map>
+
+// Internal data structure shared by the Core translation units
+typedef struct ProfilerInternalData
+{
+    ProfilerConfig config;
+
+    // Updated by the capturing thread (the sampler while sampling), read
+    // by profiler_get_stats from any thread
+    ProfilerStats stats;
+    pthread_mutex_t stats_lock;
+
+    // Overhead histograms (ProfilerMetric), under stats_lock like stats
+    Histogram metrics[PROFILER_METRIC_COUNT];
+
+    // Interned stacks of every capture; written by the capturing thread,
+    // read by profiler_get_stack from any thread
+    StackTable *stacks;
+    pthread_mutex_t stacks_lock;
+
+    // Live threads of the target with their stable numbers. Refreshed by
+    // profiler_refresh_threads, and by the sampler thread while sampling;
+    // ProfilerTarget.threads is a copy of its list. Lifecycle events go to
+    // thread_events (producer: whoever refreshes; consumer:
+    // profiler_poll_thread_events). Each record caches the thread's ID,
+    // name and queue label, so captures make no per-sample lookups.
+    // Refreshes hold threads_lock so profiler_get_thread_info can read the
+    // records from any thread (lock order: threads_lock, then stats_lock);
+    // the refreshing thread itself reads them without it.
+    ThreadRegistry *threads;
+    pthread_mutex_t threads_lock;
+    SpscRing<ThreadEvent> thread_events;
+
+    // Frames of the one-shot captures, reset at the start of each one
+    StackFrameArena arena;
+
+    // Compiled unwind rules (CFI strategies only; NULL otherwise)
+    UnwindTable *unwind;
+
+    // Async context layout handed to the walker (config.track_async only),
+    // picked for the Swift runtime loaded at async_runtime_base (0 if the
+    // runtime is not a separate image) and kept until that image changes
+    const AsyncContextLayout *async_layout;
+    uint64_t async_runtime_base;
+
+    // Mapped regions and modules of the target, for walk validation;
+    // rescanned by the capturing thread before each capture, under
+    // regions_lock so profiler_resolve_module can query it from any thread
+    RegionMap *regions;
+    pthread_mutex_t regions_lock;
+
+    // Address -> symbol resolver and name demangler, created on first use;
+    // used from the caller's threads and the recording writer, serialized
+    // by symbolizer_lock.
+    // The demangler's memo outlives thread refreshes, so rendering a
+    // profile again does no repeated demangling.
+    Symbolizer *symbolizer;
+    Demangler *demangler;
+    pthread_mutex_t symbolizer_lock;
+
+    // Lookup address -> start of its function, for function-level call
+    // trees; under symbolizer_lock, cleared whenever the symbolizer is
+    // refreshed
+    std::unordered_map<uint64_t, uint64_t> function_starts;
+
+    // Continuous sampling (sampler.cpp)
+    // The sampler works from its own copy of the task and from the thread
+    // registry so it never touches the caller-owned ProfilerTarget from
+    // another thread.
+    pthread_t sampler_thread;
+    std::atomic<bool> sampler_running;
+    task_t sampler_task;
+    StackTrace *sampler_traces;     // Walk scratch, interned right away
+    thread_t *sampler_threads;      // Threads picked for the current tick...
+    uint32_t *sampler_indices;      // ...their positions in the registry...
+    uint32_t *sampler_states;       // ...their run states (PlatformRunState)...
+    uint64_t *sampler_cpu_times;    // ...CPU time since their previous sample...
+    StackWalkOrigin *sampler_hints; // ...and registers of their previous walk
+    uint64_t sampler_start_ns;      // When sampling started (see select_threads)
+    uint32_t sampler_trace_capacity;
+    StackFrameArena sampler_arena;
+    SpscRing<ProfilerSample> samples;
+
+    // Recording (recorder.cpp): while set, the writer thread is the
+    // consumer of samples and encodes them into the file
+    RecordingWriter *recording;
+    pthread_t recorder_thread;
+    std::atomic<bool> recorder_running;
+} ProfilerInternalData;
+
+/**
+ * Intern a captured trace and set trace->stack_id
+ */
+void profiler_intern_trace(
+    ProfilerInternalData *internal,
+    const StackFrameArena *arena,
+    StackTrace *trace);
+
+/**
+ * Depth of an interned stack (0 if nothing is interned)
+ */
+uint32_t profiler_stack_depth(ProfilerInternalData *internal, uint32_t stack_id);
+
+/**
+ * Refresh the thread registry, queueing lifecycle events when
+ * config.track_threads is set
+ *
+ * @return 0 on success, error code otherwise
+ */
+int profiler_update_threads(ProfilerInternalData *internal);
+
+/**
+ * Point target->threads at a copy of the registry's list
+ * The copy stays valid while the sampler refreshes the registry; it holds
+ * no references of its own.
+ */
+int profiler_sync_target_threads(ProfilerTarget *target);
+
+/**
+ * Resolve addresses, creating the symbolizer on first use (any thread;
+ * serialized by symbolizer_lock)
+ *
+ * @return 0 on success, -1 if no symbolizer could be created
+ */
+int profiler_symbolize_addresses(
+    ProfilerInternalData *internal,
+    task_t task,
+    const uint64_t *addresses,
+    uint32_t count,
+    SymbolInfo *symbols);
+
+/**
+ * Copy stable thread numbers and cached thread IDs into traces
+ *
+ * @param indices Registry position of each trace's thread (NULL if the
+ *        traces were captured in registry order)
+ */
+void profiler_label_traces(
+    ProfilerInternalData *internal,
+    StackTrace *traces,
+    const uint32_t *indices,
+    uint32_t trace_count);
+
+/**
+ * Capture every listed thread, as one whole-task snapshot when
+ * config.snapshot_mode is set and as a parallel batch otherwise
+ *
+ * @param hints Registers of each thread's previous walk, to skip threads
+ *        that have not moved (NULL to walk every thread)
+ * @param pause_ns Output: how long the snapshot stopped the target (0 for a batch)
+ * @param walk_ns Output: time spent in the walker
+ * @return Number of successful captures
+ */
+int profiler_capture_threads(
+    ProfilerInternalData *internal,
+    task_t task,
+    const thread_t *threads,
+    uint32_t thread_count,
+    const StackWalkOrigin *hints,
+    StackFrameArena *arena,
+    StackTrace *traces,
+    uint64_t *pause_ns,
+    uint64_t *walk_ns);
+
+/**
+ * Rescan the region map if the target's images changed or a walk ran into
+ * unmapped memory, and refresh the unwind table when the modules were
+ * rescanned; call before walking
+ */
+void profiler_update_regions(ProfilerInternalData *internal);
+
+/**
+ * Add a snapshot pause to the stats (caller holds stats_lock)
+ */
+void profiler_record_pause(ProfilerInternalData *internal, uint64_t pause_ns);
+
+/**
+ * Add how each trace was taken (stopped or optimistic) to the stats
+ * (caller holds stats_lock)
+ */
+void profiler_record_capture_modes(
+    ProfilerInternalData *internal,
+    const StackTrace *traces,
+    uint32_t trace_count);
+
+/**
+ * Add the phase timings and reads of each trace, a snapshot's pause and
+ * the profiler's own time around the walker to the overhead histograms
+ * (caller holds stats_lock)
+ *
+ * @param pause_ns The snapshot's pause (0 if the traces were not a snapshot)
+ */
+void profiler_record_overhead(
+    ProfilerInternalData *internal,
+    const StackTrace *traces,
+    uint32_t trace_count,
+    uint64_t pause_ns,
+    uint64_t bookkeeping_ns);
+
+/**
+ * Record the timestamp spread of an all-thread capture (caller holds stats_lock)
+ */
+void profiler_record_batch_skew(
+    ProfilerInternalData *internal,
+    const StackTrace *traces,
+    uint32_t trace_count);
+
+/**
+ * Copy the stack table and region map counters into stats (caller holds
+ * stats_lock; lock order is always stats_lock, then stacks_lock). Only the
+ * capturing thread may call this.
+ */
+void profiler_update_table_stats(ProfilerInternalData *internal);
+
+/**
+ * Stop the sampler thread if it is running (used by profiler_detach)
+ */
+void profiler_sampler_shutdown(ProfilerTarget *target);
+
+/**
+ * Stop the recording writer if it is running and close its file (used by
+ * profiler_detach; stop the sampler first)
+ *
+ * @return 0 on success, otherwise the first write error
+ */
+int profiler_recorder_shutdown(ProfilerTarget *target);
+
+#endif // PROFILER_INTERNAL_H
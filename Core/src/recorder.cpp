@@ -0,0 +1,217 @@
+#include "profiler.h"
+#include "profiler_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+// Samples taken from the buffer at a time
+#define RECORDER_BATCH_SIZE 1024
+
+// How long the writer sleeps when the buffer is empty
+#define RECORDER_IDLE_NS (5ULL * 1000000ULL)
+
+// Helper: Resolve a chunk's locations with the profiler's symbolizer
+static void symbolize_locations(
+    const uint64_t *addresses,
+    uint32_t count,
+    RecordingSymbol *symbols,
+    void *context)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)context;
+
+    SymbolInfo *infos = (SymbolInfo *)calloc(count, sizeof(SymbolInfo));
+    if (!infos)
+        return;
+
+    // The symbolizer is not refreshed while sampling, so the names stay
+    // valid until the chunk has copied them
+    if (profiler_symbolize_addresses(internal, internal->sampler_task, addresses, count, infos) == 0)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            symbols[i].function = infos[i].name;
+            symbols[i].module = infos[i].module;
+            symbols[i].symbol_address = infos[i].symbol_address;
+            symbols[i].module_base = infos[i].module_base;
+        }
+    }
+    free(infos);
+}
+
+// Helper: Encode one sample, defining its thread and stack on first use
+static int record_sample(
+    ProfilerInternalData *internal,
+    const ProfilerSample *sample,
+    uint64_t *addresses)
+{
+    RecordingWriter *writer = internal->recording;
+
+    if (!recording_writer_has_thread(writer, sample->thread_number))
+    {
+        // The name is looked up once; a thread that already exited has none
+        char name[PLATFORM_THREAD_NAME_MAX] = "";
+        pthread_mutex_lock(&internal->threads_lock);
+        const ThreadRecord *record = internal->threads
+                                         ? thread_registry_find(internal->threads, sample->thread_number)
+                                         : NULL;
+        if (record)
+            memcpy(name, record->name, sizeof(name));
+        pthread_mutex_unlock(&internal->threads_lock);
+
+        recording_writer_define_thread(writer, sample->thread_number, sample->thread_id, name);
+    }
+
+    if (!recording_writer_has_stack(writer, sample->stack_id))
+    {
+        pthread_mutex_lock(&internal->stacks_lock);
+        uint32_t count = stack_table_get(internal->stacks, sample->stack_id, addresses, MAX_STACK_DEPTH);
+        pthread_mutex_unlock(&internal->stacks_lock);
+
+        int result = recording_writer_define_stack(writer, sample->stack_id, addresses, count);
+        if (result != 0)
+            return result;
+    }
+
+    return recording_writer_add_sample(writer, sample->timestamp_ns, sample->thread_number, sample->stack_id,
+                                       sample->run_state, sample->cpu_time_ns);
+}
+
+static void *recorder_main(void *arg)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)arg;
+
+    ProfilerSample *batch = (ProfilerSample *)malloc(RECORDER_BATCH_SIZE * sizeof(ProfilerSample));
+    uint64_t *addresses = (uint64_t *)malloc(MAX_STACK_DEPTH * sizeof(uint64_t));
+    if (!batch || !addresses)
+    {
+        fprintf(stderr, "Warning: could not allocate recorder buffers\n");
+        free(batch);
+        free(addresses);
+        return NULL;
+    }
+
+    for (;;)
+    {
+        // Read the flag first: once it is clear the sampler has stopped, so
+        // an empty buffer after that means everything was written
+        bool running = internal->recorder_running.load(std::memory_order_acquire);
+        uint32_t count = internal->samples.pop(batch, RECORDER_BATCH_SIZE);
+
+        uint32_t recorded = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (record_sample(internal, &batch[i], addresses) == 0)
+                recorded++;
+        }
+
+        if (count > 0)
+        {
+            pthread_mutex_lock(&internal->stats_lock);
+            internal->stats.recorded_samples += recorded;
+            internal->stats.recorded_bytes = recording_writer_bytes(internal->recording);
+            pthread_mutex_unlock(&internal->stats_lock);
+            continue;
+        }
+
+        if (!running)
+            break;
+
+        struct timespec ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = (long)RECORDER_IDLE_NS;
+        nanosleep(&ts, NULL);
+    }
+
+    free(batch);
+    free(addresses);
+    return NULL;
+}
+
+int profiler_start_recording(ProfilerTarget *target, const char *path)
+{
+    if (target->state != PROFILER_STATE_ATTACHED)
+    {
+        printf("Error: Target must be attached and idle to start recording\n");
+        return -1;
+    }
+
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+
+    RecordingWriter *writer = recording_writer_create(
+        path,
+        target->pid,
+        internal->config.sample_interval_ms * 1000,
+        symbolize_locations,
+        internal);
+    if (!writer)
+    {
+        int error = errno;
+        printf("Error: Could not create %s: %s\n", path, strerror(error));
+        return error;
+    }
+
+    // A chunk write takes a while; the buffer must cover it
+    if (internal->config.sample_buffer_size < PROFILER_RECORDING_BUFFER_SIZE)
+        internal->config.sample_buffer_size = PROFILER_RECORDING_BUFFER_SIZE;
+
+    internal->recording = writer;
+    int kr = profiler_start_sampling(target);
+    if (kr != 0)
+    {
+        recording_writer_close(writer);
+        internal->recording = NULL;
+        return kr;
+    }
+
+    internal->recorder_running.store(true, std::memory_order_release);
+    kr = pthread_create(&internal->recorder_thread, NULL, recorder_main, internal);
+    if (kr != 0)
+    {
+        printf("Error: Could not start recorder thread: %d\n", kr);
+        internal->recorder_running.store(false, std::memory_order_release);
+        profiler_stop_sampling(target);
+        return kr;
+    }
+
+    return 0;
+}
+
+int profiler_stop_recording(ProfilerTarget *target)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (!internal || !internal->recording)
+    {
+        return -1;
+    }
+
+    // Stopping the sampler also drains the buffer into the file
+    return profiler_stop_sampling(target);
+}
+
+int profiler_recorder_shutdown(ProfilerTarget *target)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (!internal || !internal->recording)
+        return 0;
+
+    if (internal->recorder_running.load(std::memory_order_acquire))
+    {
+        internal->recorder_running.store(false, std::memory_order_release);
+        pthread_join(internal->recorder_thread, NULL);
+    }
+
+    recording_writer_flush(internal->recording);
+    pthread_mutex_lock(&internal->stats_lock);
+    internal->stats.recorded_bytes = recording_writer_bytes(internal->recording);
+    pthread_mutex_unlock(&internal->stats_lock);
+
+    int result = recording_writer_close(internal->recording);
+    internal->recording = NULL;
+    if (result != 0)
+    {
+        fprintf(stderr, "Warning: recording write failed: %s\n", strerror(result));
+    }
+    return result;
+}
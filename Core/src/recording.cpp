@@ -0,0 +1,721 @@
+#include "recording.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+static_assert(sizeof(RecordingFileHeader) % 8 == 0, "chunks must stay 8-byte aligned");
+static_assert(sizeof(RecordingChunkHeader) % 8 == 0, "sections must stay 8-byte aligned");
+static_assert(sizeof(RecordingLocation) % 8 == 0, "sections must stay 8-byte aligned");
+static_assert(RECORDING_RUN_STATE_UNKNOWN == PLATFORM_THREAD_UNKNOWN, "run states are stored as PlatformRunState");
+
+// Oldest file version the reader understands
+#define RECORDING_MIN_VERSION 1
+
+typedef struct
+{
+    uint64_t thread_id;
+    std::string name;
+} ThreadName;
+
+struct RecordingWriter
+{
+    FILE *file;
+    int error; // First failed write (0 = none)
+    uint64_t bytes;
+    RecordingSymbolizeCallback symbolize;
+    void *context;
+    std::unordered_map<uint32_t, ThreadName> threads;
+
+    // The open chunk
+    std::unordered_map<uint32_t, uint32_t> stacks;     // Caller's stack ID -> node
+    std::vector<RecordingNode> nodes;
+    std::unordered_map<uint64_t, uint32_t> node_index; // (parent, location) -> node
+    std::vector<uint64_t> addresses;                   // Per location
+    std::vector<uint32_t> location_flags;
+    std::unordered_map<uint64_t, uint32_t> location_index;
+    std::unordered_set<uint32_t> sampled_threads;
+    std::vector<RecordingIndexEntry> index;
+    std::vector<uint8_t> samples;
+    uint32_t sample_count;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t previous_ns;
+    uint32_t previous_thread;
+};
+
+struct RecordingReader
+{
+    uint8_t *data;
+    size_t size;
+    std::vector<uint64_t> chunks; // Offsets of the complete chunks
+    uint64_t sample_count;
+};
+
+// Helper: Round up to the section alignment
+static inline uint64_t align8(uint64_t value)
+{
+    return (value + 7) & ~(uint64_t)7;
+}
+
+static inline uint64_t zigzag_encode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static void put_varint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static bool get_varint(const uint8_t **position, const uint8_t *end, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64 && *position < end; shift += 7)
+    {
+        uint8_t byte = *(*position)++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Helper: Write bytes, remembering the first failure
+static void write_bytes(RecordingWriter *writer, const void *data, size_t size)
+{
+    if (writer->error != 0)
+        return;
+
+    if (fwrite(data, 1, size, writer->file) != size || fflush(writer->file) != 0)
+    {
+        writer->error = errno ? errno : EIO;
+        return;
+    }
+    writer->bytes += size;
+}
+
+// Helper: Forget the open chunk's dictionaries and samples
+static void reset_chunk(RecordingWriter *writer)
+{
+    writer->stacks.clear();
+    writer->nodes.clear();
+    writer->node_index.clear();
+    writer->addresses.clear();
+    writer->location_flags.clear();
+    writer->location_index.clear();
+    writer->sampled_threads.clear();
+    writer->index.clear();
+    writer->samples.clear();
+    writer->sample_count = 0;
+    writer->start_ns = UINT64_MAX;
+    writer->end_ns = 0;
+
+    // Node 0 is the root (the empty stack)
+    RecordingNode root = {0, 0};
+    writer->nodes.push_back(root);
+}
+
+RecordingWriter *recording_writer_create(
+    const char *path,
+    int32_t pid,
+    uint32_t sample_interval_us,
+    RecordingSymbolizeCallback symbolize,
+    void *context)
+{
+    RecordingWriter *writer = new (std::nothrow) RecordingWriter();
+    if (!writer)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    writer->file = fopen(path, "wb");
+    if (!writer->file)
+    {
+        delete writer;
+        return NULL;
+    }
+
+    writer->error = 0;
+    writer->bytes = 0;
+    writer->symbolize = symbolize;
+    writer->context = context;
+    reset_chunk(writer);
+
+    RecordingFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    header.version = RECORDING_VERSION;
+    header.header_size = sizeof(header);
+    header.pid = pid;
+    header.sample_interval_us = sample_interval_us;
+    header.start_ns = clock_ns(CLOCK_MONOTONIC_RAW);
+    header.start_wall_ns = clock_ns(CLOCK_REALTIME);
+    write_bytes(writer, &header, sizeof(header));
+
+    if (writer->error != 0)
+    {
+        int error = writer->error;
+        fclose(writer->file);
+        delete writer;
+        errno = error;
+        return NULL;
+    }
+    return writer;
+}
+
+int recording_writer_close(RecordingWriter *writer)
+{
+    if (!writer)
+        return 0;
+
+    recording_writer_flush(writer);
+    if (fclose(writer->file) != 0 && writer->error == 0)
+        writer->error = errno ? errno : EIO;
+
+    int error = writer->error;
+    delete writer;
+    return error;
+}
+
+bool recording_writer_has_stack(const RecordingWriter *writer, uint32_t stack_id)
+{
+    return writer->stacks.count(stack_id) != 0;
+}
+
+// Helper: Location index of an address in the open chunk
+static uint32_t location_for(RecordingWriter *writer, uint64_t address, uint32_t flags)
+{
+    auto found = writer->location_index.find(address);
+    if (found != writer->location_index.end())
+    {
+        writer->location_flags[found->second] |= flags;
+        return found->second;
+    }
+
+    uint32_t location = (uint32_t)writer->addresses.size();
+    writer->addresses.push_back(address);
+    writer->location_flags.push_back(flags);
+    writer->location_index.emplace(address, location);
+    return location;
+}
+
+int recording_writer_define_stack(
+    RecordingWriter *writer,
+    uint32_t stack_id,
+    const uint64_t *addresses,
+    uint32_t count)
+{
+    // Insert from the outermost frame so shared callers share nodes
+    uint32_t parent = 0;
+    for (uint32_t i = count; i-- > 0;)
+    {
+        uint32_t location = location_for(writer, addresses[i], i > 0 ? RECORDING_LOCATION_CALLER : 0);
+        uint64_t key = ((uint64_t)parent << 32) | location;
+
+        auto found = writer->node_index.find(key);
+        if (found != writer->node_index.end())
+        {
+            parent = found->second;
+            continue;
+        }
+
+        RecordingNode node = {parent, location};
+        parent = (uint32_t)writer->nodes.size();
+        writer->nodes.push_back(node);
+        writer->node_index.emplace(key, parent);
+    }
+
+    writer->stacks[stack_id] = parent;
+    return 0;
+}
+
+int recording_writer_define_thread(
+    RecordingWriter *writer,
+    uint32_t thread_number,
+    uint64_t thread_id,
+    const char *name)
+{
+    ThreadName &entry = writer->threads[thread_number];
+    entry.thread_id = thread_id;
+    entry.name = name ? name : "";
+    return 0;
+}
+
+bool recording_writer_has_thread(const RecordingWriter *writer, uint32_t thread_number)
+{
+    return writer->threads.count(thread_number) != 0;
+}
+
+int recording_writer_add_sample(
+    RecordingWriter *writer,
+    uint64_t timestamp_ns,
+    uint32_t thread_number,
+    uint32_t stack_id,
+    uint32_t run_state,
+    uint64_t cpu_time_ns)
+{
+    auto stack = writer->stacks.find(stack_id);
+    if (stack == writer->stacks.end())
+        return EINVAL;
+
+    // Every RECORDING_INDEX_INTERVAL samples, restart the deltas
+    if (writer->sample_count % RECORDING_INDEX_INTERVAL == 0)
+    {
+        RecordingIndexEntry entry;
+        entry.timestamp_ns = timestamp_ns;
+        entry.sample = writer->sample_count;
+        entry.offset = (uint32_t)writer->samples.size();
+        writer->index.push_back(entry);
+        writer->previous_ns = timestamp_ns;
+        writer->previous_thread = 0;
+    }
+
+    put_varint(writer->samples, zigzag_encode((int64_t)(timestamp_ns - writer->previous_ns)));
+    put_varint(writer->samples, zigzag_encode((int64_t)thread_number - (int64_t)writer->previous_thread));
+    put_varint(writer->samples, stack->second);
+    put_varint(writer->samples, run_state);
+    put_varint(writer->samples, cpu_time_ns);
+    writer->previous_ns = timestamp_ns;
+    writer->previous_thread = thread_number;
+
+    writer->sampled_threads.insert(thread_number);
+    writer->sample_count++;
+    if (timestamp_ns < writer->start_ns)
+        writer->start_ns = timestamp_ns;
+    if (timestamp_ns > writer->end_ns)
+        writer->end_ns = timestamp_ns;
+
+    if (writer->sample_count >= RECORDING_CHUNK_MAX_SAMPLES ||
+        writer->end_ns - writer->start_ns >= RECORDING_CHUNK_MAX_NS)
+    {
+        return recording_writer_flush(writer);
+    }
+    return writer->error;
+}
+
+// Helper: Offset of a string in the chunk's table, adding it on first use
+static uint32_t intern_string(
+    std::string &strings,
+    std::unordered_map<std::string, uint32_t> &offsets,
+    const char *string)
+{
+    if (!string)
+        return RECORDING_NO_STRING;
+
+    auto found = offsets.find(string);
+    if (found != offsets.end())
+        return found->second;
+
+    uint32_t offset = (uint32_t)strings.size();
+    strings.append(string);
+    strings.push_back('\0');
+    offsets.emplace(string, offset);
+    return offset;
+}
+
+int recording_writer_flush(RecordingWriter *writer)
+{
+    if (writer->sample_count == 0)
+        return writer->error;
+
+    uint32_t location_count = (uint32_t)writer->addresses.size();
+
+    // Symbolize the whole chunk in one batch; return addresses are looked
+    // up inside the call instruction
+    std::vector<uint64_t> lookups(writer->addresses);
+    std::vector<RecordingSymbol> symbols(location_count);
+    memset(symbols.data(), 0, location_count * sizeof(RecordingSymbol));
+    for (uint32_t i = 0; i < location_count; i++)
+    {
+        if ((writer->location_flags[i] & RECORDING_LOCATION_CALLER) && lookups[i] > 0)
+            lookups[i]--;
+    }
+    if (writer->symbolize && location_count > 0)
+        writer->symbolize(lookups.data(), location_count, symbols.data(), writer->context);
+
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> string_offsets;
+
+    std::vector<RecordingLocation> locations(location_count);
+    for (uint32_t i = 0; i < location_count; i++)
+    {
+        RecordingLocation *location = &locations[i];
+        memset(location, 0, sizeof(*location));
+        location->address = writer->addresses[i];
+        location->module_base = symbols[i].module_base;
+        location->symbol_address = symbols[i].symbol_address;
+        location->function = intern_string(strings, string_offsets, symbols[i].function);
+        location->module = intern_string(strings, string_offsets, symbols[i].module);
+        location->flags = writer->location_flags[i];
+    }
+
+    std::vector<uint32_t> numbers(writer->sampled_threads.begin(), writer->sampled_threads.end());
+    std::sort(numbers.begin(), numbers.end());
+    std::vector<RecordingThread> threads(numbers.size());
+    for (size_t i = 0; i < numbers.size(); i++)
+    {
+        auto found = writer->threads.find(numbers[i]);
+        threads[i].thread_number = numbers[i];
+        threads[i].thread_id = found != writer->threads.end() ? found->second.thread_id : 0;
+        threads[i].name = found != writer->threads.end()
+                              ? intern_string(strings, string_offsets, found->second.name.c_str())
+                              : RECORDING_NO_STRING;
+    }
+
+    RecordingChunkHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RECORDING_CHUNK_MAGIC;
+    header.header_size = sizeof(header);
+    header.start_ns = writer->start_ns;
+    header.end_ns = writer->end_ns;
+    header.sample_count = writer->sample_count;
+    header.thread_count = (uint32_t)threads.size();
+    header.location_count = location_count;
+    header.node_count = (uint32_t)writer->nodes.size();
+    header.index_count = (uint32_t)writer->index.size();
+    header.flags = RECORDING_CHUNK_RUN_STATES | RECORDING_CHUNK_CPU_TIMES;
+    header.strings_offset = sizeof(header);
+    header.strings_size = strings.size();
+    header.threads_offset = align8(header.strings_offset + header.strings_size);
+    header.locations_offset = header.threads_offset + threads.size() * sizeof(RecordingThread);
+    header.nodes_offset = header.locations_offset + location_count * sizeof(RecordingLocation);
+    header.index_offset = header.nodes_offset + writer->nodes.size() * sizeof(RecordingNode);
+    header.samples_offset = header.index_offset + writer->index.size() * sizeof(RecordingIndexEntry);
+    header.samples_size = writer->samples.size();
+    header.chunk_size = align8(header.samples_offset + header.samples_size);
+
+    uint8_t *chunk = (uint8_t *)calloc(1, header.chunk_size);
+    if (!chunk)
+    {
+        if (writer->error == 0)
+            writer->error = ENOMEM;
+        reset_chunk(writer);
+        return writer->error;
+    }
+
+    memcpy(chunk, &header, sizeof(header));
+    memcpy(chunk + header.strings_offset, strings.data(), strings.size());
+    memcpy(chunk + header.threads_offset, threads.data(), threads.size() * sizeof(RecordingThread));
+    memcpy(chunk + header.locations_offset, locations.data(), location_count * sizeof(RecordingLocation));
+    memcpy(chunk + header.nodes_offset, writer->nodes.data(), writer->nodes.size() * sizeof(RecordingNode));
+    memcpy(chunk + header.index_offset, writer->index.data(), writer->index.size() * sizeof(RecordingIndexEntry));
+    memcpy(chunk + header.samples_offset, writer->samples.data(), writer->samples.size());
+
+    write_bytes(writer, chunk, header.chunk_size);
+    free(chunk);
+
+    reset_chunk(writer);
+    return writer->error;
+}
+
+uint64_t recording_writer_bytes(const RecordingWriter *writer)
+{
+    return writer->bytes;
+}
+
+// Helper: Whether a section of count elements fits in the chunk
+static bool section_fits(const RecordingChunkHeader *header, uint64_t offset, uint64_t count, uint64_t size)
+{
+    return offset >= sizeof(RecordingChunkHeader) && offset % 8 == 0 &&
+           offset <= header->chunk_size &&
+           count <= (header->chunk_size - offset) / (size ? size : 1);
+}
+
+// Helper: Check that a chunk's sections lie inside it
+static bool chunk_is_valid(const RecordingChunkHeader *header, uint64_t available)
+{
+    if (header->magic != RECORDING_CHUNK_MAGIC ||
+        header->header_size != sizeof(RecordingChunkHeader) ||
+        header->chunk_size < sizeof(RecordingChunkHeader) ||
+        header->chunk_size > available)
+        return false;
+
+    const char *strings = (const char *)header + header->strings_offset;
+    return section_fits(header, header->strings_offset, header->strings_size, 1) &&
+           (header->strings_size == 0 || strings[header->strings_size - 1] == '\0') &&
+           section_fits(header, header->threads_offset, header->thread_count, sizeof(RecordingThread)) &&
+           section_fits(header, header->locations_offset, header->location_count, sizeof(RecordingLocation)) &&
+           section_fits(header, header->nodes_offset, header->node_count, sizeof(RecordingNode)) &&
+           header->node_count > 0 &&
+           section_fits(header, header->index_offset, header->index_count, sizeof(RecordingIndexEntry)) &&
+           header->samples_offset <= header->chunk_size &&
+           header->samples_size <= header->chunk_size - header->samples_offset &&
+           header->index_count == (header->sample_count + RECORDING_INDEX_INTERVAL - 1) / RECORDING_INDEX_INTERVAL;
+}
+
+RecordingReader *recording_open(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(RecordingFileHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)info.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    const RecordingFileHeader *header = (const RecordingFileHeader *)data;
+    RecordingReader *reader = NULL;
+    if (memcmp(header->magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) == 0 &&
+        header->version >= RECORDING_MIN_VERSION && header->version <= RECORDING_VERSION &&
+        header->header_size == sizeof(RecordingFileHeader))
+    {
+        reader = new (std::nothrow) RecordingReader();
+    }
+    if (!reader)
+    {
+        munmap(data, size);
+        return NULL;
+    }
+
+    reader->data = (uint8_t *)data;
+    reader->size = size;
+    reader->sample_count = 0;
+
+    // Only the chunk headers are touched here
+    uint64_t offset = header->header_size;
+    while (offset + sizeof(RecordingChunkHeader) <= size)
+    {
+        const RecordingChunkHeader *chunk = (const RecordingChunkHeader *)(reader->data + offset);
+        if (!chunk_is_valid(chunk, size - offset))
+            break;
+
+        reader->chunks.push_back(offset);
+        reader->sample_count += chunk->sample_count;
+        offset += chunk->chunk_size;
+    }
+
+    return reader;
+}
+
+void recording_close(RecordingReader *reader)
+{
+    if (!reader)
+        return;
+
+    munmap(reader->data, reader->size);
+    delete reader;
+}
+
+const RecordingFileHeader *recording_header(const RecordingReader *reader)
+{
+    return (const RecordingFileHeader *)reader->data;
+}
+
+uint32_t recording_chunk_count(const RecordingReader *reader)
+{
+    return (uint32_t)reader->chunks.size();
+}
+
+uint64_t recording_sample_count(const RecordingReader *reader)
+{
+    return reader->sample_count;
+}
+
+int recording_get_chunk(const RecordingReader *reader, uint32_t index, RecordingChunk *chunk)
+{
+    if (index >= reader->chunks.size())
+        return -1;
+
+    const uint8_t *base = reader->data + reader->chunks[index];
+    const RecordingChunkHeader *header = (const RecordingChunkHeader *)base;
+    chunk->header = header;
+    chunk->strings = (const char *)(base + header->strings_offset);
+    chunk->threads = (const RecordingThread *)(base + header->threads_offset);
+    chunk->locations = (const RecordingLocation *)(base + header->locations_offset);
+    chunk->nodes = (const RecordingNode *)(base + header->nodes_offset);
+    chunk->index = (const RecordingIndexEntry *)(base + header->index_offset);
+    chunk->samples = base + header->samples_offset;
+    return 0;
+}
+
+const char *recording_chunk_string(const RecordingChunk *chunk, uint32_t offset)
+{
+    if (offset == RECORDING_NO_STRING || offset >= chunk->header->strings_size)
+        return NULL;
+    return chunk->strings + offset;
+}
+
+const char *recording_run_state_name(uint32_t run_state)
+{
+    switch (run_state)
+    {
+    case PLATFORM_THREAD_RUNNING:
+        return "running";
+    case PLATFORM_THREAD_STOPPED:
+        return "stopped";
+    case PLATFORM_THREAD_WAITING:
+        return "waiting";
+    case PLATFORM_THREAD_UNINTERRUPTIBLE:
+        return "uninterruptible";
+    case PLATFORM_THREAD_HALTED:
+        return "halted";
+    default:
+        return NULL;
+    }
+}
+
+uint32_t recording_chunk_stack(
+    const RecordingChunk *chunk,
+    uint32_t node,
+    uint32_t *locations,
+    uint32_t max_locations)
+{
+    // Parents always precede their children, which also bounds the walk
+    uint32_t count = 0;
+    while (node != 0 && node < chunk->header->node_count && count < max_locations)
+    {
+        const RecordingNode *entry = &chunk->nodes[node];
+        if (entry->parent >= node || entry->location >= chunk->header->location_count)
+            break;
+
+        locations[count++] = entry->location;
+        node = entry->parent;
+    }
+    return count;
+}
+
+void recording_cursor_init(
+    const RecordingChunk *chunk,
+    uint64_t from_ns,
+    RecordingCursor *cursor)
+{
+    const RecordingChunkHeader *header = chunk->header;
+    cursor->position = chunk->samples;
+    cursor->end = chunk->samples + header->samples_size;
+    cursor->index = chunk->index;
+    cursor->index_count = header->index_count;
+    cursor->sample = 0;
+    cursor->sample_count = header->sample_count;
+    cursor->node_count = header->node_count;
+    cursor->flags = header->flags;
+    cursor->thread_number = 0;
+    cursor->timestamp_ns = 0;
+
+    if (from_ns <= header->start_ns || header->index_count == 0)
+        return;
+
+    // Last index entry at or before from_ns
+    const RecordingIndexEntry *entry = std::upper_bound(
+        chunk->index, chunk->index + header->index_count, from_ns,
+        [](uint64_t time, const RecordingIndexEntry &item)
+        { return time < item.timestamp_ns; });
+    if (entry != chunk->index)
+        entry--;
+
+    if (entry->offset > header->samples_size)
+    {
+        cursor->sample = cursor->sample_count;
+        return;
+    }
+    cursor->position = chunk->samples + entry->offset;
+    cursor->sample = entry->sample;
+
+    // Decode up to the first sample at or after from_ns
+    for (;;)
+    {
+        RecordingCursor saved = *cursor;
+        RecordingSample sample;
+        if (!recording_cursor_next(cursor, &sample))
+            return;
+        if (sample.timestamp_ns >= from_ns)
+        {
+            *cursor = saved;
+            return;
+        }
+    }
+}
+
+bool recording_cursor_next(RecordingCursor *cursor, RecordingSample *sample)
+{
+    if (cursor->sample >= cursor->sample_count)
+        return false;
+
+    if (cursor->sample % RECORDING_INDEX_INTERVAL == 0)
+    {
+        uint32_t entry = cursor->sample / RECORDING_INDEX_INTERVAL;
+        if (entry >= cursor->index_count)
+            return false;
+        cursor->timestamp_ns = cursor->index[entry].timestamp_ns;
+        cursor->thread_number = 0;
+    }
+
+    uint64_t time_delta, thread_delta, node;
+    if (!get_varint(&cursor->position, cursor->end, &time_delta) ||
+        !get_varint(&cursor->position, cursor->end, &thread_delta) ||
+        !get_varint(&cursor->position, cursor->end, &node) ||
+        node >= cursor->node_count)
+    {
+        cursor->sample = cursor->sample_count;
+        return false;
+    }
+
+    uint64_t run_state = RECORDING_RUN_STATE_UNKNOWN;
+    if ((cursor->flags & RECORDING_CHUNK_RUN_STATES) &&
+        !get_varint(&cursor->position, cursor->end, &run_state))
+    {
+        cursor->sample = cursor->sample_count;
+        return false;
+    }
+
+    uint64_t cpu_time_ns = 0;
+    if ((cursor->flags & RECORDING_CHUNK_CPU_TIMES) &&
+        !get_varint(&cursor->position, cursor->end, &cpu_time_ns))
+    {
+        cursor->sample = cursor->sample_count;
+        return false;
+    }
+
+    cursor->timestamp_ns += (uint64_t)zigzag_decode(time_delta);
+    cursor->thread_number = (uint32_t)((int64_t)cursor->thread_number + zigzag_decode(thread_delta));
+    cursor->sample++;
+
+    sample->timestamp_ns = cursor->timestamp_ns;
+    sample->thread_number = cursor->thread_number;
+    sample->node = (uint32_t)node;
+    sample->run_state = run_state <= RECORDING_RUN_STATE_UNKNOWN ? (uint32_t)run_state : RECORDING_RUN_STATE_UNKNOWN;
+    sample->cpu_time_ns = cpu_time_ns;
+    return true;
+}
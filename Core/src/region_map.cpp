@@ -0,0 +1,191 @@
+#include "region_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <new>
+
+// Minimum time between rescans triggered by unknown addresses, so a walk
+// into garbage cannot make every sample rescan the whole address space
+#define REGION_MAP_RESCAN_INTERVAL_NS (100ULL * 1000 * 1000)
+
+struct RegionMap
+{
+    task_t task;
+    PlatformRegion *regions; // Sorted by start
+    uint32_t region_count;
+    PlatformModule *modules; // Sorted by start
+    uint32_t module_count;
+    bool has_generation;     // Whether generation holds the image list stamp of the modules
+    uint64_t generation;
+    uint64_t last_scan_ns;
+    uint64_t scan_count;
+    mutable std::atomic<bool> stale;
+};
+
+// Helper: Get current time in nanoseconds
+static uint64_t get_timestamp_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Helper: Rescan the regions, and the modules too when images_changed
+static int rescan(RegionMap *map, bool images_changed)
+{
+    PlatformRegion *regions = NULL;
+    uint32_t region_count = 0;
+    int kr = platform_task_regions(map->task, &regions, &region_count);
+    if (kr != 0)
+        return kr;
+
+    platform_region_list_release(map->regions, map->region_count);
+    map->regions = regions;
+    map->region_count = region_count;
+    map->last_scan_ns = get_timestamp_ns();
+    map->scan_count++;
+    map->stale.store(false, std::memory_order_relaxed);
+
+    if (!images_changed)
+        return 0;
+
+    // Read the stamp first: a load that races the module scan then shows
+    // up as another change on the next update
+    uint64_t generation = 0;
+    bool has_generation = platform_task_image_generation(map->task, &generation) == 0;
+
+    PlatformModule *modules = NULL;
+    uint32_t module_count = 0;
+    kr = platform_task_modules(map->task, &modules, &module_count);
+    if (kr != 0)
+    {
+        // Keep the old modules; the stamp stays old so update tries again
+        return kr;
+    }
+
+    platform_module_list_release(map->modules, map->module_count);
+    map->modules = modules;
+    map->module_count = module_count;
+    map->has_generation = has_generation;
+    map->generation = generation;
+    return 0;
+}
+
+RegionMap *region_map_create(task_t task)
+{
+    RegionMap *map = new (std::nothrow) RegionMap();
+    if (!map)
+        return NULL;
+
+    map->task = task;
+    int kr = region_map_refresh(map);
+    if (kr != 0)
+    {
+        fprintf(stderr, "Warning: could not list regions of the target: %d\n", kr);
+    }
+    return map;
+}
+
+void region_map_destroy(RegionMap *map)
+{
+    if (!map)
+        return;
+
+    platform_region_list_release(map->regions, map->region_count);
+    platform_module_list_release(map->modules, map->module_count);
+    delete map;
+}
+
+int region_map_refresh(RegionMap *map)
+{
+    return rescan(map, true);
+}
+
+bool region_map_update(RegionMap *map, bool *images_changed)
+{
+    *images_changed = false;
+
+    uint64_t generation = 0;
+    bool has_generation = platform_task_image_generation(map->task, &generation) == 0;
+    if (has_generation && (!map->has_generation || generation != map->generation))
+    {
+        *images_changed = rescan(map, true) == 0;
+        return *images_changed;
+    }
+
+    if (!map->stale.load(std::memory_order_relaxed) ||
+        get_timestamp_ns() - map->last_scan_ns < REGION_MAP_RESCAN_INTERVAL_NS)
+        return false;
+
+    // Without an image stamp (Linux) an unknown address may just as well be
+    // a newly loaded library
+    bool rescanned = rescan(map, !has_generation) == 0;
+    *images_changed = rescanned && !has_generation;
+    return rescanned;
+}
+
+const PlatformRegion *region_map_find(const RegionMap *map, uint64_t address)
+{
+    // Last region starting at or below address
+    uint32_t low = 0;
+    uint32_t high = map->region_count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (map->regions[mid].start <= address)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == 0 || address >= map->regions[low - 1].end)
+        return NULL;
+    return &map->regions[low - 1];
+}
+
+bool region_map_find_module(
+    const RegionMap *map,
+    uint64_t address,
+    const PlatformModule **module,
+    uint64_t *offset)
+{
+    uint32_t low = 0;
+    uint32_t high = map->module_count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (map->modules[mid].start <= address)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == 0 || address >= map->modules[low - 1].end)
+        return false;
+
+    *module = &map->modules[low - 1];
+    if (offset)
+        *offset = address - (*module)->base;
+    return true;
+}
+
+void region_map_note_unknown(const RegionMap *map)
+{
+    map->stale.store(true, std::memory_order_relaxed);
+}
+
+uint32_t region_map_region_count(const RegionMap *map)
+{
+    return map->region_count;
+}
+
+uint32_t region_map_module_count(const RegionMap *map)
+{
+    return map->module_count;
+}
+
+uint64_t region_map_scan_count(const RegionMap *map)
+{
+    return map->scan_count;
+}
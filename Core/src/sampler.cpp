@@ -0,0 +1,440 @@
+#include "profiler.h"
+#include "profiler_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// How often the sampler picks up new and exited threads
+#define THREAD_REFRESH_INTERVAL_NS (100ULL * 1000000ULL)
+
+// Helper: Get current time in nanoseconds (same clock as StackTrace)
+static uint64_t get_timestamp_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Helper: Sleep until an absolute get_timestamp_ns() deadline
+static void sleep_until_ns(uint64_t deadline)
+{
+    for (;;)
+    {
+        uint64_t now = get_timestamp_ns();
+        if (now >= deadline)
+            return;
+
+        uint64_t remaining = deadline - now;
+        struct timespec ts;
+        ts.tv_sec = (time_t)(remaining / 1000000000ULL);
+        ts.tv_nsec = (long)(remaining % 1000000000ULL);
+        nanosleep(&ts, NULL);
+    }
+}
+
+// Helper: Make room for one trace per thread
+static bool grow_sampler_traces(ProfilerInternalData *internal, uint32_t count)
+{
+    StackTrace *traces = (StackTrace *)realloc(
+        internal->sampler_traces, count * sizeof(StackTrace));
+    if (traces)
+        internal->sampler_traces = traces;
+
+    thread_t *threads = (thread_t *)realloc(internal->sampler_threads, count * sizeof(thread_t));
+    if (threads)
+        internal->sampler_threads = threads;
+
+    uint32_t *indices = (uint32_t *)realloc(internal->sampler_indices, count * sizeof(uint32_t));
+    if (indices)
+        internal->sampler_indices = indices;
+
+    uint32_t *states = (uint32_t *)realloc(internal->sampler_states, count * sizeof(uint32_t));
+    if (states)
+        internal->sampler_states = states;
+
+    uint64_t *cpu_times = (uint64_t *)realloc(internal->sampler_cpu_times, count * sizeof(uint64_t));
+    if (cpu_times)
+        internal->sampler_cpu_times = cpu_times;
+
+    StackWalkOrigin *hints = (StackWalkOrigin *)realloc(internal->sampler_hints, count * sizeof(StackWalkOrigin));
+    if (hints)
+        internal->sampler_hints = hints;
+
+    if (!traces || !threads || !indices || !states || !cpu_times || !hints)
+        return false;
+
+    internal->sampler_trace_capacity = count;
+    return true;
+}
+
+// Helper: CPU time a thread used since its previous sample, moving its
+// baseline forward
+// The baseline left by a walk that stopped the thread was taken after the
+// stop (see rebaseline_after_stop), so the stop's runtime is not counted.
+static uint64_t take_cpu_time(
+    ProfilerInternalData *internal,
+    const ThreadRecord *record,
+    ThreadSampleState *state,
+    uint64_t cpu_time_ns)
+{
+    uint64_t previous = state->cpu_time_ns;
+    state->cpu_time_ns = cpu_time_ns;
+
+    // Before its first sample, a thread's CPU time is only known to be
+    // recent if the thread appeared after sampling started
+    if (previous == THREAD_REGISTRY_NO_CPU_TIME)
+        previous = record->created_ns > internal->sampler_start_ns ? 0 : cpu_time_ns;
+
+    return cpu_time_ns > previous ? cpu_time_ns - previous : 0;
+}
+
+// Helper: Move a parked thread's CPU time baseline past the stop of its walk
+// Stopping a thread makes it run (ptrace interrupts it on Linux), which
+// adds to its runtime. Left in the baseline, that runtime would show up as
+// CPU time on the thread's next sample and keep it from ever looking idle.
+// A thread that was running when picked keeps its baseline: the CPU time
+// it used around the walk is its own.
+static void rebaseline_after_stop(
+    ProfilerInternalData *internal,
+    uint32_t selected,
+    ThreadSampleState *state,
+    uint64_t *kernel_calls)
+{
+    uint32_t run_state = internal->sampler_states[selected];
+    if (run_state == PLATFORM_THREAD_RUNNING || run_state == PLATFORM_THREAD_UNKNOWN)
+        return;
+
+    PlatformThreadBasicInfo info;
+    if (platform_thread_get_basic_info(internal->sampler_task, internal->sampler_threads[selected], &info) == 0)
+        state->cpu_time_ns = info.cpu_time_ns;
+    (*kernel_calls)++;
+}
+
+// Helper: Pick the threads to walk this tick, with their run states, CPU
+// time weights and walk hints
+// Wall-clock mode takes every thread. CPU mode leaves out threads known
+// not to be running or runnable, so idle pool threads cost one state
+// lookup instead of a suspend and a walk; a thread whose state cannot be
+// read is walked anyway. A skipped thread keeps its baseline, so CPU time
+// it used between walks lands on its next sample; a thread stopped for its
+// walk gets a new one once it runs again (see rebaseline_after_stop).
+// A thread that used no CPU time since its previous walk gets that walk's
+// registers as its hint: if they still match, the walker skips it and its
+// previous stack is reused (see StackTrace.unchanged). Only a precise CPU
+// clock can tell that: in clock ticks, a thread that ran briefly and
+// blocked again at the same registers would look unchanged.
+static uint32_t select_threads(
+    ProfilerInternalData *internal,
+    uint32_t thread_count,
+    uint64_t *kernel_calls,
+    uint64_t *skipped)
+{
+    const thread_t *threads = thread_registry_threads(internal->threads);
+    const ThreadRecord *records = thread_registry_records(internal->threads);
+    ThreadSampleState *states = thread_registry_sample_states(internal->threads);
+    bool cpu_only = internal->config.sampling_mode == PROFILER_SAMPLING_CPU;
+    uint32_t selected = 0;
+
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        PlatformThreadBasicInfo info;
+        uint32_t state = PLATFORM_THREAD_UNKNOWN;
+        bool known = platform_thread_get_basic_info(internal->sampler_task, threads[i], &info) == 0;
+        if (known)
+            state = info.run_state;
+        (*kernel_calls)++;
+
+        if (cpu_only && state != PLATFORM_THREAD_RUNNING && state != PLATFORM_THREAD_UNKNOWN)
+        {
+            (*skipped)++;
+            continue;
+        }
+
+        internal->sampler_threads[selected] = threads[i];
+        internal->sampler_indices[selected] = i;
+        internal->sampler_states[selected] = state;
+        uint64_t previous_cpu_time = states[i].cpu_time_ns;
+        internal->sampler_cpu_times[selected] = known
+                                                    ? take_cpu_time(internal, &records[i], &states[i],
+                                                                    info.cpu_time_ns)
+                                                    : 0;
+
+        StackWalkOrigin *hint = &internal->sampler_hints[selected];
+        bool idle = known && info.cpu_time_precise && previous_cpu_time == states[i].cpu_time_ns &&
+                    states[i].stack_id != 0;
+        hint->pc = idle ? states[i].pc : 0;
+        hint->sp = idle ? states[i].sp : 0;
+        hint->fp = idle ? states[i].fp : 0;
+        selected++;
+    }
+    return selected;
+}
+
+static void *sampler_main(void *arg)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)arg;
+
+    uint64_t interval_ns = (uint64_t)internal->config.sample_interval_ms * 1000000ULL;
+    uint64_t deadline = get_timestamp_ns() + interval_ns;
+    uint64_t next_refresh = deadline + THREAD_REFRESH_INTERVAL_NS;
+
+    while (internal->sampler_running.load(std::memory_order_acquire))
+    {
+        sleep_until_ns(deadline);
+        uint64_t now = get_timestamp_ns();
+        uint64_t walk_ns = 0;
+
+        // Deadlines stay on a fixed grid. If the previous tick overran by
+        // whole intervals, skip those ticks instead of bursting to catch up.
+        uint64_t missed = 0;
+        if (now - deadline >= interval_ns)
+        {
+            missed = (now - deadline) / interval_ns;
+            deadline += missed * interval_ns;
+        }
+
+        if (internal->config.track_threads && now >= next_refresh)
+        {
+            profiler_update_threads(internal);
+            next_refresh = now + THREAD_REFRESH_INTERVAL_NS;
+        }
+
+        uint64_t successful = 0;
+        uint64_t failed = 0;
+        uint64_t dropped = 0;
+        uint64_t frames = 0;
+        uint64_t cached_frames = 0;
+        uint64_t remote_reads = 0;
+        uint64_t failed_reads = 0;
+        uint64_t rejected_reads = 0;
+        uint64_t kernel_calls = 0;
+        uint64_t skipped = 0;
+        uint64_t cpu_time = 0;
+        uint64_t unchanged = 0;
+
+        uint32_t thread_count = thread_registry_count(internal->threads);
+        if (thread_count > internal->sampler_trace_capacity &&
+            !grow_sampler_traces(internal, thread_count))
+        {
+            thread_count = internal->sampler_trace_capacity;
+        }
+
+        // Walk the picked threads (one snapshot, or in parallel when the
+        // walker has a pool); frames only need to live until they are interned
+        thread_count = select_threads(internal, thread_count, &kernel_calls, &skipped);
+        StackTrace *traces = internal->sampler_traces;
+        stack_frame_arena_reset(&internal->sampler_arena);
+        uint64_t pause_ns = 0;
+        if (thread_count > 0)
+        {
+            profiler_capture_threads(
+                internal,
+                internal->sampler_task,
+                internal->sampler_threads,
+                thread_count,
+                internal->sampler_hints,
+                &internal->sampler_arena,
+                traces,
+                &pause_ns,
+                &walk_ns);
+        }
+        profiler_label_traces(internal, traces, internal->sampler_indices, thread_count);
+
+        ThreadSampleState *states = thread_registry_sample_states(internal->threads);
+        for (uint32_t i = 0; i < thread_count; i++)
+        {
+            StackTrace *trace = &traces[i];
+            ThreadSampleState *state = &states[internal->sampler_indices[i]];
+            if (!trace->unchanged && (trace->pause_ns > 0 || internal->config.snapshot_mode))
+                rebaseline_after_stop(internal, i, state, &kernel_calls);
+            failed_reads += trace->failed_reads;
+            rejected_reads += trace->rejected_reads;
+            kernel_calls += trace->kernel_calls;
+            uint32_t depth = trace->frame_count;
+            if (trace->unchanged)
+            {
+                trace->stack_id = state->stack_id;
+                depth = profiler_stack_depth(internal, state->stack_id);
+                unchanged++;
+            }
+            else if (trace->frame_count == 0)
+            {
+                state->stack_id = 0;
+                failed++;
+                continue;
+            }
+            else
+            {
+                profiler_intern_trace(internal, &internal->sampler_arena, trace);
+                state->pc = trace->origin.pc;
+                state->sp = trace->origin.sp;
+                state->fp = trace->origin.fp;
+                state->stack_id = trace->stack_id;
+            }
+
+            successful++;
+            frames += depth;
+            cached_frames += trace->cached_frames;
+            remote_reads += trace->remote_reads;
+            cpu_time += internal->sampler_cpu_times[i];
+
+            // A full ring means the consumer is behind; drop the sample
+            ProfilerSample *slot = internal->samples.reserve();
+            if (!slot)
+            {
+                dropped++;
+                continue;
+            }
+
+            slot->stack_id = trace->stack_id;
+            slot->thread_number = trace->thread_number;
+            slot->thread_id = trace->thread_id;
+            slot->timestamp_ns = trace->timestamp_ns;
+            slot->run_state = internal->sampler_states[i];
+            slot->cpu_time_ns = internal->sampler_cpu_times[i];
+            internal->samples.commit();
+        }
+
+        pthread_mutex_lock(&internal->stats_lock);
+        internal->stats.total_samples += successful + failed;
+        internal->stats.successful_samples += successful;
+        internal->stats.failed_samples += failed;
+        internal->stats.total_frames += frames;
+        internal->stats.cached_frames += cached_frames;
+        internal->stats.remote_reads += remote_reads;
+        internal->stats.failed_reads += failed_reads;
+        internal->stats.rejected_reads += rejected_reads;
+        internal->stats.kernel_calls += kernel_calls;
+        internal->stats.missed_deadlines += missed;
+        internal->stats.dropped_samples += dropped;
+        internal->stats.skipped_idle_threads += skipped;
+        internal->stats.sampled_cpu_time_ns += cpu_time;
+        internal->stats.unchanged_samples += unchanged;
+        if (internal->config.snapshot_mode && thread_count > 0)
+            profiler_record_pause(internal, pause_ns);
+        profiler_record_capture_modes(internal, traces, thread_count);
+        profiler_record_overhead(internal, traces, thread_count, pause_ns,
+                                 get_timestamp_ns() - now - walk_ns);
+        profiler_record_batch_skew(internal, traces, thread_count);
+        profiler_update_table_stats(internal);
+        pthread_mutex_unlock(&internal->stats_lock);
+
+        deadline += interval_ns;
+    }
+
+    return NULL;
+}
+
+int profiler_start_sampling(ProfilerTarget *target)
+{
+    if (target->state != PROFILER_STATE_ATTACHED)
+    {
+        printf("Error: Target must be attached and idle to start sampling\n");
+        return -1;
+    }
+
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+
+    if (internal->config.sample_interval_ms == 0)
+        internal->config.sample_interval_ms = 1;
+
+    if (!internal->samples.init(internal->config.sample_buffer_size))
+    {
+        printf("Error: Could not allocate sample buffer (%u samples)\n",
+               internal->config.sample_buffer_size);
+        return -1;
+    }
+
+    internal->sampler_task = target->task;
+    int kr = profiler_update_threads(internal);
+    if (kr != 0)
+    {
+        printf("Error: task_threads failed with code: %d\n", kr);
+        return kr;
+    }
+
+    // CPU time weights start over; time used while not sampling counts for nothing
+    thread_registry_reset_sample_states(internal->threads);
+    internal->sampler_start_ns = get_timestamp_ns();
+
+    internal->sampler_running.store(true, std::memory_order_release);
+    kr = pthread_create(&internal->sampler_thread, NULL, sampler_main, internal);
+    if (kr != 0)
+    {
+        printf("Error: Could not start sampler thread: %d\n", kr);
+        internal->sampler_running.store(false, std::memory_order_release);
+        return kr;
+    }
+
+    target->state = PROFILER_STATE_SAMPLING;
+    return 0;
+}
+
+int profiler_poll_samples(
+    ProfilerTarget *target,
+    ProfilerSample *samples,
+    uint32_t max_samples,
+    uint32_t *sample_count)
+{
+    *sample_count = 0;
+
+    if (target->state == PROFILER_STATE_DETACHED || !target->internal_data)
+    {
+        return -1;
+    }
+
+    // While recording, the writer thread is the buffer's only consumer
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (internal->recording)
+    {
+        return -1;
+    }
+
+    *sample_count = internal->samples.pop(samples, max_samples);
+    return 0;
+}
+
+int profiler_poll_thread_events(
+    ProfilerTarget *target,
+    ThreadEvent *events,
+    uint32_t max_events,
+    uint32_t *event_count)
+{
+    *event_count = 0;
+
+    if (target->state == PROFILER_STATE_DETACHED || !target->internal_data)
+    {
+        return -1;
+    }
+
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    *event_count = internal->thread_events.pop(events, max_events);
+    return 0;
+}
+
+void profiler_sampler_shutdown(ProfilerTarget *target)
+{
+    ProfilerInternalData *internal = (ProfilerInternalData *)target->internal_data;
+    if (!internal || !internal->sampler_running.load(std::memory_order_acquire))
+        return;
+
+    internal->sampler_running.store(false, std::memory_order_release);
+    pthread_join(internal->sampler_thread, NULL);
+}
+
+int profiler_stop_sampling(ProfilerTarget *target)
+{
+    if (target->state != PROFILER_STATE_SAMPLING)
+    {
+        return -1;
+    }
+
+    profiler_sampler_shutdown(target);
+    int recorded = profiler_recorder_shutdown(target);
+    target->state = PROFILER_STATE_ATTACHED;
+
+    // Catch the caller's list up with the threads the sampler saw come and go
+    int kr = profiler_sync_target_threads(target);
+    return recorded != 0 ? recorded : kr;
+}
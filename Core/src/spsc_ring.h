@@ -0,0 +1,110 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+
+// Bounded lock-free single-producer / single-consumer ring buffer
+//
+// The producer fills slots in place (reserve + commit) so large elements are
+// never copied twice; the consumer drains them in FIFO order with pop().
+// head and tail live on separate cache lines so the two sides do not
+// false-share.
+template <typename T>
+class SpscRing
+{
+public:
+    SpscRing() : slots_(NULL), mask_(0), head_(0), tail_(0) {}
+    ~SpscRing() { destroy(); }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    // Allocate storage; capacity is rounded up to a power of two
+    bool init(uint32_t capacity)
+    {
+        destroy();
+
+        uint32_t size = 1;
+        while (size < capacity && size < (1u << 31))
+            size <<= 1;
+
+        slots_ = (T *)calloc(size, sizeof(T));
+        if (!slots_)
+            return false;
+
+        mask_ = size - 1;
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    void destroy()
+    {
+        free(slots_);
+        slots_ = NULL;
+        mask_ = 0;
+    }
+
+    uint32_t capacity() const { return slots_ ? mask_ + 1 : 0; }
+
+    // Producer: slot to fill, or NULL when the ring is full
+    T *reserve()
+    {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        if (!slots_ || tail - head > mask_)
+            return NULL;
+        return &slots_[tail & mask_];
+    }
+
+    // Producer: publish the slot returned by reserve()
+    void commit()
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Producer: copy one element in; false when the ring is full
+    bool push(const T &value)
+    {
+        T *slot = reserve();
+        if (!slot)
+            return false;
+        *slot = value;
+        commit();
+        return true;
+    }
+
+    // Consumer: move up to max_count elements into out
+    uint32_t pop(T *out, uint32_t max_count)
+    {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+
+        uint32_t count = 0;
+        while (head != tail && count < max_count)
+        {
+            out[count++] = slots_[head & mask_];
+            head++;
+        }
+
+        head_.store(head, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer: number of elements ready to pop
+    uint32_t size() const
+    {
+        return (uint32_t)(tail_.load(std::memory_order_acquire) -
+                          head_.load(std::memory_order_acquire));
+    }
+
+private:
+    T *slots_;
+    uint32_t mask_;
+    alignas(64) std::atomic<uint64_t> head_; // Next slot to read (consumer)
+    alignas(64) std::atomic<uint64_t> tail_; // Next slot to write (producer)
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,268 @@
+#include "stack_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Trie node: one frame under a given caller path
+typedef struct
+{
+    uint64_t address;
+    uint32_t parent;  // Node of the caller frame (0 = root)
+    uint32_t depth;   // Frames from the root down to this node
+    bool is_stack;    // Some interned stack ends here
+} StackNode;
+
+struct StackTable
+{
+    // Node 0 is the root (the empty stack)
+    StackNode *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+
+    // Open-addressed index (parent, address) -> node; 0 marks a free slot
+    uint32_t *index;
+    uint32_t index_mask;
+
+    // Open-addressed set of distinct frame addresses; 0 marks a free slot
+    uint64_t *addresses;
+    uint64_t address_mask;
+    uint64_t address_count;
+
+    uint64_t stack_count;
+};
+
+#define INITIAL_NODE_CAPACITY 1024
+#define INITIAL_INDEX_SIZE 2048
+#define INITIAL_ADDRESS_SET_SIZE 2048
+
+// Helper: 64-bit finalizer (splitmix64)
+static inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint64_t node_hash(uint32_t parent, uint64_t address)
+{
+    return mix64(address ^ ((uint64_t)parent * 0x9e3779b97f4a7c15ULL));
+}
+
+// Helper: Double the node index and re-insert every node
+static bool grow_index(StackTable *table)
+{
+    uint32_t new_size = (table->index_mask + 1) * 2;
+    uint32_t *index = (uint32_t *)calloc(new_size, sizeof(uint32_t));
+    if (!index)
+        return false;
+
+    uint32_t mask = new_size - 1;
+    for (uint32_t id = 1; id < table->node_count; id++)
+    {
+        const StackNode *node = &table->nodes[id];
+        uint32_t slot = (uint32_t)node_hash(node->parent, node->address) & mask;
+        while (index[slot] != 0)
+            slot = (slot + 1) & mask;
+        index[slot] = id;
+    }
+
+    free(table->index);
+    table->index = index;
+    table->index_mask = mask;
+    return true;
+}
+
+// Helper: Record a frame address in the distinct-address set
+static void note_address(StackTable *table, uint64_t address)
+{
+    if (address == 0)
+        return;
+
+    if ((table->address_count + 1) * 2 > table->address_mask + 1)
+    {
+        uint64_t new_size = (table->address_mask + 1) * 2;
+        uint64_t *set = (uint64_t *)calloc(new_size, sizeof(uint64_t));
+        if (!set)
+            return;
+
+        uint64_t mask = new_size - 1;
+        for (uint64_t i = 0; i <= table->address_mask; i++)
+        {
+            uint64_t value = table->addresses[i];
+            if (value == 0)
+                continue;
+            uint64_t slot = mix64(value) & mask;
+            while (set[slot] != 0)
+                slot = (slot + 1) & mask;
+            set[slot] = value;
+        }
+
+        free(table->addresses);
+        table->addresses = set;
+        table->address_mask = mask;
+    }
+
+    uint64_t slot = mix64(address) & table->address_mask;
+    while (table->addresses[slot] != 0)
+    {
+        if (table->addresses[slot] == address)
+            return;
+        slot = (slot + 1) & table->address_mask;
+    }
+    table->addresses[slot] = address;
+    table->address_count++;
+}
+
+// Helper: Find or create the child of parent for address
+static uint32_t intern_node(StackTable *table, uint32_t parent, uint64_t address)
+{
+    uint32_t slot = (uint32_t)node_hash(parent, address) & table->index_mask;
+    while (table->index[slot] != 0)
+    {
+        const StackNode *node = &table->nodes[table->index[slot]];
+        if (node->parent == parent && node->address == address)
+            return table->index[slot];
+        slot = (slot + 1) & table->index_mask;
+    }
+
+    // New node
+    if (table->node_count == UINT32_MAX)
+        return STACK_ID_EMPTY;
+
+    if (table->node_count == table->node_capacity)
+    {
+        uint32_t capacity = table->node_capacity * 2;
+        StackNode *nodes = (StackNode *)realloc(table->nodes, capacity * sizeof(StackNode));
+        if (!nodes)
+            return STACK_ID_EMPTY;
+        table->nodes = nodes;
+        table->node_capacity = capacity;
+    }
+
+    uint32_t id = table->node_count++;
+    StackNode *node = &table->nodes[id];
+    node->address = address;
+    node->parent = parent;
+    node->depth = table->nodes[parent].depth + 1;
+    node->is_stack = false;
+    table->index[slot] = id;
+
+    note_address(table, address);
+
+    // Keep the index at most half full
+    if ((uint64_t)table->node_count * 2 > (uint64_t)table->index_mask + 1)
+    {
+        grow_index(table);
+    }
+
+    return id;
+}
+
+StackTable *stack_table_create(void)
+{
+    StackTable *table = (StackTable *)calloc(1, sizeof(StackTable));
+    if (!table)
+        return NULL;
+
+    table->nodes = (StackNode *)malloc(INITIAL_NODE_CAPACITY * sizeof(StackNode));
+    table->index = (uint32_t *)calloc(INITIAL_INDEX_SIZE, sizeof(uint32_t));
+    table->addresses = (uint64_t *)calloc(INITIAL_ADDRESS_SET_SIZE, sizeof(uint64_t));
+
+    if (!table->nodes || !table->index || !table->addresses)
+    {
+        stack_table_destroy(table);
+        return NULL;
+    }
+
+    table->node_capacity = INITIAL_NODE_CAPACITY;
+    table->index_mask = INITIAL_INDEX_SIZE - 1;
+    table->address_mask = INITIAL_ADDRESS_SET_SIZE - 1;
+
+    // Root node
+    memset(&table->nodes[0], 0, sizeof(StackNode));
+    table->node_count = 1;
+
+    return table;
+}
+
+void stack_table_destroy(StackTable *table)
+{
+    if (!table)
+        return;
+
+    free(table->nodes);
+    free(table->index);
+    free(table->addresses);
+    free(table);
+}
+
+uint32_t stack_table_intern(
+    StackTable *table,
+    const StackFrame *frames,
+    uint32_t frame_count)
+{
+    // Walk from the outermost frame down so callers become shared prefixes
+    uint32_t node = STACK_ID_EMPTY;
+    for (uint32_t i = frame_count; i > 0; i--)
+    {
+        node = intern_node(table, node, frames[i - 1].address);
+        if (node == STACK_ID_EMPTY)
+            return STACK_ID_EMPTY;
+    }
+
+    if (node != STACK_ID_EMPTY && !table->nodes[node].is_stack)
+    {
+        table->nodes[node].is_stack = true;
+        table->stack_count++;
+    }
+
+    return node;
+}
+
+uint32_t stack_table_depth(const StackTable *table, uint32_t stack_id)
+{
+    if (stack_id >= table->node_count)
+        return 0;
+    return table->nodes[stack_id].depth;
+}
+
+uint32_t stack_table_get(
+    const StackTable *table,
+    uint32_t stack_id,
+    uint64_t *addresses,
+    uint32_t max_addresses)
+{
+    if (stack_id >= table->node_count)
+        return 0;
+
+    // Parent links run from the innermost frame outward, which is already
+    // the order the walker produced
+    uint32_t count = 0;
+    uint32_t node = stack_id;
+    while (node != STACK_ID_EMPTY && count < max_addresses)
+    {
+        addresses[count++] = table->nodes[node].address;
+        node = table->nodes[node].parent;
+    }
+    return count;
+}
+
+uint64_t stack_table_stack_count(const StackTable *table)
+{
+    return table->stack_count;
+}
+
+uint64_t stack_table_unique_addresses(const StackTable *table)
+{
+    return table->address_count;
+}
+
+uint64_t stack_table_memory_usage(const StackTable *table)
+{
+    return sizeof(StackTable) +
+           (uint64_t)table->node_capacity * sizeof(StackNode) +
+           ((uint64_t)table->index_mask + 1) * sizeof(uint32_t) +
+           (table->address_mask + 1) * sizeof(uint64_t);
+}
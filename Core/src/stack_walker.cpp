@@ -1,166 +1,1399 @@
 #include "stack_walker.h"
 #include <stdio.h>
 #include <string.h>
-#include <mach/mach.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include <time.h>
+#include <atomic>
+#include <unordered_map>
 
-// Architecture detection
-#if defined(__x86_64__)
-#include <mach/i386/thread_status.h>
-#define THREAD_STATE_FLAVOR x86_THREAD_STATE64
-#define THREAD_STATE_COUNT x86_THREAD_STATE64_COUNT
-typedef x86_thread_state64_t cpu_state_t;
-#define GET_PC(state) ((state).__rip)
-#define GET_FP(state) ((state).__rbp)
-#define GET_SP(state) ((state).__rsp)
-#elif defined(__arm64__) || defined(__aarch64__)
-#include <mach/arm/thread_status.h>
-#define THREAD_STATE_FLAVOR ARM_THREAD_STATE64
-#define THREAD_STATE_COUNT ARM_THREAD_STATE64_COUNT
-typedef arm_thread_state64_t cpu_state_t;
-#define GET_PC(state) ((state).__pc)
-#define GET_FP(state) ((state).__fp)
-#define GET_SP(state) ((state).__sp)
-#else
-#error "Unsupported architecture"
+// Global configuration
+static StackWalkerConfig g_config;
+static bool g_initialized = false;
+static const UnwindTable *g_unwind_table = NULL;
+static const RegionMap *g_region_map = NULL;
+static const AsyncContextLayout *g_async_layout = NULL;
+
+// The platform layer, unless a caller installed other target calls
+static const StackWalkerTargetOps g_platform_ops = {
+    platform_thread_suspend,
+    platform_thread_resume,
+    platform_task_suspend,
+    platform_task_resume,
+    platform_thread_get_registers,
+    platform_thread_peek_registers,
+    platform_read_memory,
+    platform_read_memory_batch,
+};
+static const StackWalkerTargetOps *g_ops = &g_platform_ops;
+
+// Per-thread walk scratch. Slot 0 belongs to the calling thread (single
+// captures and its share of a batch); slot N to batch worker N.
+typedef struct
+{
+    uint8_t *window;        // Local copy of the stack window being walked
+    StackFrameArena arena;  // Frames walked by this worker in the current batch
+} WalkerScratch;
+
+static WalkerScratch g_scratch[STACK_WALKER_MAX_WORKERS];
+
+// Batch capture worker pool (g_config.capture_workers - 1 background
+// threads; the calling thread is the remaining worker)
+typedef struct
+{
+    task_t task;
+    const thread_t *threads;
+    const StackWalkOrigin *hints;   // NULL if every thread is walked
+    StackTrace *traces;
+    uint32_t thread_count;
+    uint8_t *owner;                 // Worker that captured each trace
+    std::atomic<uint32_t> next;     // Next thread index to hand out
+} BatchJob;
+
+static BatchJob g_job;
+static uint32_t g_owner_capacity = 0;
+static pthread_t g_workers[STACK_WALKER_MAX_WORKERS];
+static uint32_t g_worker_count = 0;
+static pthread_mutex_t g_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_pool_done = PTHREAD_COND_INITIALIZER;
+static uint64_t g_pool_generation = 0;      // Bumped once per parallel batch
+static uint64_t g_pool_base_generation = 0; // Generation when the pool started
+static uint32_t g_pool_active = 0;
+static bool g_pool_shutdown = false;
+
+// Whole-task snapshot storage, grown to the largest thread count seen
+static uint8_t *g_snapshot_windows = NULL;   // stack_window_size bytes per thread
+static PlatformRegisters *g_snapshot_regs = NULL;
+static uint64_t *g_snapshot_window_sizes = NULL;
+static bool *g_snapshot_stopped = NULL;
+static bool *g_snapshot_has_regs = NULL;
+static thread_t *g_snapshot_pending = NULL;        // Threads that must be stopped
+static uint32_t *g_snapshot_pending_index = NULL;  // Their index in the request
+static uint32_t g_snapshot_capacity = 0;
+
+// Outer frames of each thread's previous frame pointer walk
+// A frame record that still holds the same saved FP and return address at
+// the same address belongs to a frame that has not returned, so every frame
+// outward of it is unchanged as well and is copied rather than read again.
+typedef struct
+{
+    StackFrame *frames;  // Frame record frames of the walk, innermost first
+    uint32_t count;
+    uint32_t capacity;
+    bool complete;       // The walk ended at the end of the chain, not at max_depth
+    uint64_t last_used;  // g_suffix_generation of the thread's last walk
+} SuffixCacheEntry;
+
+static std::unordered_map<thread_t, SuffixCacheEntry> g_suffix_cache;
+static pthread_mutex_t g_suffix_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t g_suffix_generation = 0; // Bumped once per capture call
+
+// Captures after which the entry of a thread that was not walked is dropped
+#define SUFFIX_CACHE_IDLE_GENERATIONS 64
+
+// Granularity of window reads; pages past the end of the stack are unmapped
+#define WINDOW_CHUNK_SIZE 4096
+
+// Unstopped walks of a thread before its sample is discarded as torn
+#define OPTIMISTIC_MAX_ATTEMPTS 3
+
+// Bytes above SP searched for a frame record when FP could not be read
+#define FP_SCAN_LIMIT 1024
+
+// Per-walk state: the copied window and the read counters
+typedef struct
+{
+    task_t task;
+    uint64_t window_base;  // Target address of window_data[0]
+    uint64_t window_size;  // Bytes of the window that were actually copied
+    const uint8_t *window_data;
+    const PlatformRegion *stack_region; // Mapped stack holding SP (NULL without a region map, or if unknown)
+    uint32_t remote_reads;
+    uint32_t failed_reads;
+    uint32_t rejected_reads;
+    uint64_t read_ns;      // Time spent in remote reads
+    uint64_t bytes_read;   // Bytes they copied
+    bool window_only;      // Target is running again; never read it live
+    uint64_t async_context; // Context of the innermost async frame (0 if none yet)
+    uint32_t async_frame;   // Frames up to and including that frame
+    SuffixCacheEntry *suffix; // Previous walk of the thread (NULL if not cached)
+} WalkContext;
+
+// Helper: Reset the per-walk state
+static void init_walk_context(WalkContext *ctx, task_t task, bool window_only)
+{
+    ctx->task = task;
+    ctx->window_base = 0;
+    ctx->window_size = 0;
+    ctx->window_data = NULL;
+    ctx->stack_region = NULL;
+    ctx->remote_reads = 0;
+    ctx->failed_reads = 0;
+    ctx->rejected_reads = 0;
+    ctx->read_ns = 0;
+    ctx->bytes_read = 0;
+    ctx->window_only = window_only;
+    ctx->async_context = 0;
+    ctx->async_frame = 0;
+    ctx->suffix = NULL;
+}
+
+// Helper: Get current time in nanoseconds
+static uint64_t get_timestamp_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Helper: Check if an address looks valid
+static bool is_valid_address(uint64_t addr)
+{
+    // Basic sanity checks for user space addresses
+    if (addr == 0)
+        return false;
+
+    // User space:
+    // - x86_64: typically 0x100000000 - 0x7FFFFFFFF000
+    // - ARM64 (macOS): typically 0x100000000 - 0x200000000
+    // - ARM64 (Linux): 48-bit address space
+    // Allow a wider range to be safe
+    if (addr < 0x100000) // Below typical executable base
+        return false;
+
+    if (addr >= PLATFORM_USER_ADDRESS_MAX) // Kernel space / above user space
+        return false;
+
+#if defined(__arm64__) || defined(__aarch64__)
+    // Instructions are 4-byte aligned on ARM64 (x86_64 has no alignment)
+    if (addr & 0x3)
+        return false;
 #endif
 
-// Global configuration
-static StackWalkerConfig g_config;
-static bool g_initialized = false;
+    return true;
+}
+
+// Helper: Whether a region can hold stack memory (frames, or Swift async
+// contexts on the heap): readable and writable, never executable
+static bool is_stack_memory(const PlatformRegion *region)
+{
+    return (region->flags & (PLATFORM_REGION_READ | PLATFORM_REGION_WRITE | PLATFORM_REGION_EXEC)) ==
+           (PLATFORM_REGION_READ | PLATFORM_REGION_WRITE);
+}
+
+// Helper: Whether addr is inside the stack SP is on
+// Frames there may be as large as the stack itself.
+static bool in_stack_region(const WalkContext *ctx, uint64_t addr)
+{
+    return ctx->stack_region != NULL &&
+           addr >= ctx->stack_region->start && addr < ctx->stack_region->end;
+}
+
+// Helper: Check that addr can be a PC or return address
+// With a region map it must be in executable memory. Addresses the map
+// does not cover (code mapped since the last scan) pass and trigger a rescan.
+static bool is_code_address(WalkContext *ctx, uint64_t addr)
+{
+    if (!is_valid_address(addr))
+        return false;
+
+    if (g_region_map == NULL)
+        return true;
+
+    const PlatformRegion *region = region_map_find(g_region_map, addr);
+    if (region == NULL)
+    {
+        region_map_note_unknown(g_region_map);
+        return true;
+    }
+
+    if (region->flags & PLATFORM_REGION_EXEC)
+        return true;
+
+    ctx->rejected_reads++;
+    return false;
+}
+
+// Helper: Decide whether a live read of [address, address + size) is worth a syscall
+// Only walks whose SP the map knows trust it: for them the map is current
+// for this thread, and a miss means a corrupt frame, not a stale map.
+static bool stack_read_allowed(WalkContext *ctx, uint64_t address, size_t size)
+{
+    if (g_region_map == NULL || ctx->stack_region == NULL)
+        return true;
+
+    const PlatformRegion *region = region_map_find(g_region_map, address);
+    if (region != NULL && is_stack_memory(region) && size <= region->end - address)
+        return true;
+
+    ctx->rejected_reads++;
+    return false;
+}
+
+// Copy [sp, sp + stack_window_size) into window
+// The range is split at page boundaries and issued as one batch, so a window
+// that runs past the end of the stack still yields its readable prefix. With
+// a region map the window stops at the end of the stack instead.
+static void copy_stack_window(WalkContext *ctx, uint64_t sp, uint8_t *window)
+{
+    ctx->window_base = sp;
+    ctx->window_size = 0;
+    ctx->window_data = window;
+
+    if (window == NULL || g_config.stack_window_size == 0)
+        return;
+
+    if (!is_valid_address(sp))
+        return;
+
+    uint64_t end = sp + g_config.stack_window_size;
+
+    if (g_region_map != NULL)
+    {
+        const PlatformRegion *region = region_map_find(g_region_map, sp);
+        if (region == NULL)
+        {
+            // A thread started since the last scan; walk it the old way
+            region_map_note_unknown(g_region_map);
+        }
+        else if (!is_stack_memory(region))
+        {
+            ctx->rejected_reads++;
+            return;
+        }
+        else
+        {
+            ctx->stack_region = region;
+            if (end > region->end)
+                end = region->end;
+        }
+    }
+
+    PlatformReadRequest requests[STACK_WINDOW_MAX_SIZE / WINDOW_CHUNK_SIZE + 1];
+    size_t request_count = 0;
+    uint64_t address = sp;
+
+    while (address < end)
+    {
+        uint64_t chunk_end = (address & ~(uint64_t)(WINDOW_CHUNK_SIZE - 1)) + WINDOW_CHUNK_SIZE;
+        if (chunk_end > end)
+            chunk_end = end;
+
+        requests[request_count].address = address;
+        requests[request_count].buffer = window + (address - sp);
+        requests[request_count].size = chunk_end - address;
+        request_count++;
+        address = chunk_end;
+    }
+
+    uint64_t start = get_timestamp_ns();
+    size_t completed = g_ops->read_memory_batch(ctx->task, requests, request_count);
+    ctx->read_ns += get_timestamp_ns() - start;
+    ctx->remote_reads++;
+    if (completed < request_count)
+        ctx->failed_reads++;
+
+    for (size_t i = 0; i < completed; i++)
+    {
+        ctx->window_size += requests[i].size;
+    }
+    ctx->bytes_read += ctx->window_size;
+}
+
+// Helper: Read target memory live, counting and timing the read
+static bool read_remote(WalkContext *ctx, uint64_t address, void *buffer, size_t size)
+{
+    uint64_t start = get_timestamp_ns();
+    int kr = g_ops->read_memory(ctx->task, address, buffer, size);
+    ctx->read_ns += get_timestamp_ns() - start;
+    ctx->remote_reads++;
+    if (kr != 0)
+    {
+        ctx->failed_reads++;
+        return false;
+    }
+    ctx->bytes_read += size;
+    return true;
+}
+
+// Read stack memory, from the window when possible
+static bool read_stack(WalkContext *ctx, uint64_t address, void *buffer, size_t size)
+{
+    if (address >= ctx->window_base &&
+        address - ctx->window_base + size <= ctx->window_size)
+    {
+        memcpy(buffer, ctx->window_data + (address - ctx->window_base), size);
+        return true;
+    }
+
+    // Outside the window: fall back to a targeted read, unless the walk runs
+    // on a snapshot, where live memory no longer matches the registers
+    if (ctx->window_only)
+        return false;
+
+    if (!stack_read_allowed(ctx, address, size))
+        return false;
+
+    return read_remote(ctx, address, buffer, size);
+}
+
+// AsyncMemoryReader for the context slot of an async frame (stack memory)
+static bool read_stack_memory(void *context, uint64_t address, void *buffer, size_t size)
+{
+    return read_stack((WalkContext *)context, address, buffer, size);
+}
+
+// AsyncMemoryReader for async contexts, which live on the heap
+// Once linked into a chain a context's Parent and ResumeParent never
+// change, so they are read live even when the walk runs on a snapshot;
+// a context freed in the meantime fails the code address checks.
+static bool read_async_memory(void *context, uint64_t address, void *buffer, size_t size)
+{
+    WalkContext *ctx = (WalkContext *)context;
+
+    if (read_stack(ctx, address, buffer, size))
+        return true;
+    if (!ctx->window_only)
+        return false; // read_stack already tried live memory
+
+    if (!stack_read_allowed(ctx, address, size))
+        return false;
+
+    return read_remote(ctx, address, buffer, size);
+}
+
+// Helper: Clear the async flag of a saved frame pointer
+// The flag marks the frame that saved it (the innermost frame walked so
+// far, which owns owner_fp) as a Swift async function. The first such
+// frame's context is kept for splice_async_chain; later ones are dropped,
+// since the await chain already covers them.
+static uint64_t note_async_frame(
+    WalkContext *ctx,
+    uint64_t saved_fp,
+    uint64_t owner_fp,
+    StackTrace *trace)
+{
+    if (!g_config.track_async || g_async_layout == NULL || !(saved_fp & g_async_layout->frame_flag))
+        return saved_fp;
+
+    if (trace->frame_count > 0)
+    {
+        if (ctx->async_context == 0)
+        {
+            ctx->async_context = async_frame_context(g_async_layout, read_stack_memory, ctx, owner_fp);
+            ctx->async_frame = trace->frame_count;
+        }
+        else
+        {
+            trace->frame_count--;
+        }
+    }
+
+    return saved_fp & ~g_async_layout->frame_flag;
+}
+
+// Helper: Splice the await chain of the innermost async frame into a walk
+// The trace becomes: the physical frames down to that frame, the marker,
+// the awaiting callers, then the rest of the physical frames (the executor
+// running the job). Physical frames past max_depth are dropped first.
+static void splice_async_chain(WalkContext *ctx, StackFrame *frames, StackTrace *trace)
+{
+    if (ctx->async_context == 0 || ctx->async_frame + 1 >= g_config.max_depth)
+        return;
+
+    uint64_t chain[MAX_STACK_DEPTH];
+    uint32_t count = async_unwind_chain(g_async_layout, read_async_memory, ctx, ctx->async_context,
+                                        chain, g_config.max_depth - ctx->async_frame - 1);
+
+    // Keep the chain up to the first entry that is not code
+    uint32_t valid = 0;
+    while (valid < count && is_code_address(ctx, chain[valid] - 1))
+        valid++;
+    if (valid == 0)
+        return;
+
+    uint32_t insert = 1 + valid;
+    uint32_t tail = trace->frame_count - ctx->async_frame;
+    if (ctx->async_frame + insert + tail > g_config.max_depth)
+        tail = g_config.max_depth - ctx->async_frame - insert;
+
+    StackFrame *spliced = frames + ctx->async_frame;
+    memmove(spliced + insert, spliced, tail * sizeof(StackFrame));
+    spliced[0].address = STACK_FRAME_ASYNC_MARKER;
+    spliced[0].frame_pointer = 0;
+    for (uint32_t i = 0; i < valid; i++)
+    {
+        spliced[1 + i].address = chain[i];
+        spliced[1 + i].frame_pointer = 0;
+    }
+    trace->frame_count = ctx->async_frame + insert + tail;
+}
+
+// Read the [fp, fp + 16) frame record
+static bool read_frame_record(WalkContext *ctx, uint64_t fp, uint64_t frame_data[2])
+{
+    return read_stack(ctx, fp, frame_data, 2 * sizeof(uint64_t));
+}
+
+// Helper: Whether walks keep a per-thread suffix cache
+// Only frame pointer walks do; the await chains of async frames are found
+// while reading the outer frames, so those are always read when tracked.
+static bool suffix_cache_enabled(void)
+{
+    if (!g_config.cache_suffixes || (g_config.track_async && g_async_layout != NULL))
+        return false;
+
+    return g_config.strategy == STACK_WALK_FRAME_POINTER ||
+           (g_config.strategy == STACK_WALK_LIBUNWIND && g_unwind_table == NULL);
+}
+
+// Helper: Start a capture call; every few calls, drop the entries of
+// threads that were not walked for a while (exited, or parked unchanged)
+static void begin_suffix_generation(void)
+{
+    if (!suffix_cache_enabled())
+        return;
+
+    pthread_mutex_lock(&g_suffix_lock);
+    g_suffix_generation++;
+    if (g_suffix_generation % SUFFIX_CACHE_IDLE_GENERATIONS == 0)
+    {
+        for (auto it = g_suffix_cache.begin(); it != g_suffix_cache.end();)
+        {
+            if (g_suffix_generation - it->second.last_used >= SUFFIX_CACHE_IDLE_GENERATIONS)
+            {
+                free(it->second.frames);
+                it = g_suffix_cache.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_suffix_lock);
+}
+
+// Helper: The cache entry of a thread about to be walked (created if new)
+// The entry stays valid until the next begin_suffix_generation; only the
+// walk of its thread touches it, so batch workers need the lock only here.
+static SuffixCacheEntry *acquire_suffix(thread_t thread)
+{
+    if (!suffix_cache_enabled())
+        return NULL;
+
+    pthread_mutex_lock(&g_suffix_lock);
+    SuffixCacheEntry *entry = &g_suffix_cache[thread];
+    entry->last_used = g_suffix_generation;
+    pthread_mutex_unlock(&g_suffix_lock);
+    return entry;
+}
+
+// Helper: Drop every cached suffix
+static void free_suffix_cache(void)
+{
+    pthread_mutex_lock(&g_suffix_lock);
+    for (auto &it : g_suffix_cache)
+        free(it.second.frames);
+    g_suffix_cache.clear();
+    pthread_mutex_unlock(&g_suffix_lock);
+}
+
+// Helper: Copy the frame record at address out of the window, if it lies there
+static bool window_frame_record(const WalkContext *ctx, uint64_t address, uint64_t record[2])
+{
+    if (address < ctx->window_base || address - ctx->window_base + 2 * sizeof(uint64_t) > ctx->window_size)
+        return false;
+
+    memcpy(record, ctx->window_data + (address - ctx->window_base), 2 * sizeof(uint64_t));
+    return true;
+}
+
+// Helper: Whether a frame record still holds what the previous walk found
+// in the record of its frame index (the saved FP of the outermost frame is
+// not known, so only its return address is compared)
+static bool suffix_record_matches(const SuffixCacheEntry *suffix, uint32_t index, const uint64_t record[2])
+{
+    if (suffix->frames[index].address != record[1])
+        return false;
+    return index + 1 >= suffix->count || suffix->frames[index + 1].frame_pointer == record[0];
+}
+
+// Helper: Finish a walk from the thread's previous walk if the frame record
+// just read at fp is one that walk passed through with the same contents
+// cursor tracks the position in the previous walk; both walks visit frame
+// pointers in increasing order. One record can repeat byte for byte under
+// a different caller (main->A->C->D, then main->B->C->D), so every later
+// record the copied window holds is compared as well, and at least the
+// caller's record is; only the records past that are taken on trust.
+static bool splice_suffix(
+    WalkContext *ctx,
+    uint32_t *cursor,
+    uint64_t fp,
+    const uint64_t frame_data[2],
+    StackFrame *frames,
+    StackTrace *trace)
+{
+    const SuffixCacheEntry *suffix = ctx->suffix;
+    if (!suffix || !suffix->complete)
+        return false;
+
+    while (*cursor < suffix->count && suffix->frames[*cursor].frame_pointer < fp)
+        (*cursor)++;
+
+    // The saved FP must lead to the frame the previous walk went on to
+    uint32_t match = *cursor;
+    if (match + 1 >= suffix->count ||
+        suffix->frames[match].frame_pointer != fp ||
+        !suffix_record_matches(suffix, match, frame_data))
+    {
+        return false;
+    }
+
+    // Records in the window cost nothing to compare; they are in
+    // increasing order, so the first one outside ends the window
+    uint32_t verified = match + 1;
+    uint64_t record[2];
+    while (verified < suffix->count &&
+           window_frame_record(ctx, suffix->frames[verified].frame_pointer, record))
+    {
+        if (!suffix_record_matches(suffix, verified, record))
+            return false;
+        verified++;
+    }
+
+    // Outside the window, still read the caller's record
+    if (verified == match + 1)
+    {
+        if (!read_frame_record(ctx, suffix->frames[verified].frame_pointer, record) ||
+            !suffix_record_matches(suffix, verified, record))
+        {
+            return false;
+        }
+        verified++;
+    }
+
+    uint32_t count = suffix->count - match;
+    if (trace->frame_count + count > g_config.max_depth)
+        count = g_config.max_depth - trace->frame_count;
+
+    memcpy(frames + trace->frame_count, suffix->frames + match, count * sizeof(StackFrame));
+    trace->frame_count += count;
+    if (count > verified - match)
+        trace->cached_frames += count - (verified - match);
+    return true;
+}
+
+// Helper: Keep a walk's frame record frames for the thread's next walk
+static void remember_suffix(WalkContext *ctx, const StackFrame *frames, uint32_t count, bool complete)
+{
+    SuffixCacheEntry *suffix = ctx->suffix;
+    if (!suffix)
+        return;
+
+    if (count > suffix->capacity)
+    {
+        StackFrame *grown = (StackFrame *)realloc(suffix->frames, count * sizeof(StackFrame));
+        if (!grown)
+        {
+            suffix->count = 0;
+            return;
+        }
+        suffix->frames = grown;
+        suffix->capacity = count;
+    }
+
+    memcpy(suffix->frames, frames, count * sizeof(StackFrame));
+    suffix->count = count;
+    suffix->complete = complete;
+}
+
+// Frame pointer based stack walking
+static int walk_stack_frame_pointer(
+    WalkContext *ctx,
+    const PlatformRegisters *regs,
+    StackFrame *frames,
+    StackTrace *trace)
+{
+    uint64_t pc = regs->pc;
+    uint64_t fp = regs->fp;
+
+    trace->frame_count = 0;
+
+    // Debug: Print initial values
+    // fprintf(stderr, "DEBUG: PC=0x%llx FP=0x%llx\n", pc, fp);
+
+    // First frame is current PC
+    if (is_code_address(ctx, pc))
+    {
+        frames[trace->frame_count].address = pc;
+        frames[trace->frame_count].frame_pointer = fp;
+        trace->frame_count++;
+    }
+    else
+    {
+        // PC is not valid - thread might be in syscall or optimized code
+        // fprintf(stderr, "DEBUG: Invalid PC=0x%llx\n", pc);
+
+        // Try to continue with frame pointer if it's valid
+        if (!is_valid_address(fp))
+        {
+            return 0; // No frames captured, but not an error
+        }
+    }
+
+    // Walk the frame pointer chain
+    uint32_t first_record = trace->frame_count;
+    uint32_t cursor = 0;
+    uint64_t prev_fp = 0;
+    while (trace->frame_count < g_config.max_depth)
+    {
+        // Safety check: ensure FP is valid and increasing
+        if (!is_valid_address(fp))
+            break;
+
+        if (fp <= prev_fp)
+            break; // Stack should grow toward higher addresses
+
+        if (prev_fp != 0 && fp - prev_fp > 0x100000 && !in_stack_region(ctx, fp))
+            break; // Unreasonably large frame
+
+        // Read the frame:
+        // [fp]     = previous frame pointer
+        // [fp + 8] = return address
+        uint64_t frame_data[2];
+        if (!read_frame_record(ctx, fp, frame_data))
+            break;
+
+        // The rest of the chain is where the previous walk left it
+        if (splice_suffix(ctx, &cursor, fp, frame_data, frames, trace))
+            break;
+
+        uint64_t next_fp = note_async_frame(ctx, frame_data[0], fp, trace);
+        uint64_t return_addr = frame_data[1];
+
+        // Validate return address
+        if (!is_code_address(ctx, return_addr))
+            break;
+
+        // Add frame
+        frames[trace->frame_count].address = return_addr;
+        frames[trace->frame_count].frame_pointer = fp;
+        trace->frame_count++;
+
+        // Move to next frame
+        prev_fp = fp;
+        fp = next_fp;
+
+        // Stop if we hit the bottom
+        if (fp == 0)
+            break;
+    }
+
+    remember_suffix(ctx, frames + first_record, trace->frame_count - first_record,
+                    trace->frame_count < g_config.max_depth);
+    return 0;
+}
+
+// CFI based stack walking against the unwind table
+// With fp_fallback, PCs the table has no rule for are stepped over with the
+// frame record instead (STACK_WALK_HYBRID); without it the walk stops there.
+static int walk_stack_cfi(
+    WalkContext *ctx,
+    const PlatformRegisters *regs,
+    StackFrame *frames,
+    StackTrace *trace,
+    bool fp_fallback)
+{
+    uint64_t pc = regs->pc;
+    uint64_t sp = regs->sp;
+    uint64_t fp = regs->fp;
+    uint64_t lr = regs->lr;
+
+    trace->frame_count = 0;
+
+    if (!is_code_address(ctx, pc))
+        return fp_fallback ? walk_stack_frame_pointer(ctx, regs, frames, trace) : 0;
+
+    frames[trace->frame_count].address = pc;
+    frames[trace->frame_count].frame_pointer = fp;
+    trace->frame_count++;
+
+    while (trace->frame_count < g_config.max_depth)
+    {
+        // A return address points after the call, possibly into the next
+        // function; look up the call itself
+        uint64_t lookup_pc = trace->frame_count == 1 ? pc : pc - 1;
+        bool leaf = trace->frame_count == 1;
+
+        UnwindRow row;
+        bool have_row = g_unwind_table != NULL &&
+                        unwind_table_find(g_unwind_table, lookup_pc, &row) &&
+                        row.cfa_base != UNWIND_CFA_UNDEFINED;
+
+        uint64_t cfa;
+        uint64_t return_addr;
+        uint64_t next_fp = fp;
+
+        if (have_row)
+        {
+            cfa = (row.cfa_base == UNWIND_CFA_SP ? sp : fp) + (int64_t)row.cfa_offset;
+
+            if (row.ra_rule == UNWIND_REG_AT_CFA)
+            {
+                if (!read_stack(ctx, cfa + (int64_t)row.ra_offset, &return_addr, sizeof(return_addr)))
+                    break;
+            }
+            else if (row.ra_rule == UNWIND_REG_SAME && lr != 0)
+            {
+                // Still in the link register; only meaningful for the
+                // frame that was interrupted
+                if (!leaf)
+                    break;
+                return_addr = lr;
+            }
+            else
+            {
+                break; // Outermost frame
+            }
+
+            if (row.fp_rule == UNWIND_REG_AT_CFA)
+            {
+                if (!read_stack(ctx, cfa + (int64_t)row.fp_offset, &next_fp, sizeof(next_fp)))
+                    break;
+            }
+            else if (row.fp_rule == UNWIND_REG_UNDEFINED)
+            {
+                next_fp = 0;
+            }
+        }
+        else if (fp_fallback)
+        {
+            if (!is_valid_address(fp) || fp < sp || (fp - sp > 0x100000 && !in_stack_region(ctx, fp)))
+                break;
+
+            uint64_t frame_data[2];
+            if (!read_frame_record(ctx, fp, frame_data))
+                break;
+
+            cfa = fp + 2 * sizeof(uint64_t);
+            next_fp = frame_data[0];
+            return_addr = frame_data[1];
+        }
+        else
+        {
+            break;
+        }
+
+        next_fp = note_async_frame(ctx, next_fp, fp, trace);
+
+        // The stack must unwind toward higher addresses; only a leaf that
+        // has not touched the stack may leave SP where it is
+        if (cfa < sp || (cfa == sp && !leaf) || (cfa - sp > 0x100000 && !in_stack_region(ctx, cfa)))
+            break;
+
+        if (!is_code_address(ctx, return_addr))
+            break;
+
+        frames[trace->frame_count].address = return_addr;
+        frames[trace->frame_count].frame_pointer = next_fp;
+        trace->frame_count++;
+
+        pc = return_addr;
+        sp = cfa;
+        fp = next_fp;
+        lr = 0;
+    }
+
+    return 0;
+}
+
+int stack_frame_arena_init(StackFrameArena *arena, uint32_t initial_capacity)
+{
+    arena->used = 0;
+    arena->capacity = 0;
+    arena->frames = (StackFrame *)malloc((size_t)initial_capacity * sizeof(StackFrame));
+    if (!arena->frames)
+        return -1;
+
+    arena->capacity = initial_capacity;
+    return 0;
+}
+
+void stack_frame_arena_reset(StackFrameArena *arena)
+{
+    arena->used = 0;
+}
+
+void stack_frame_arena_destroy(StackFrameArena *arena)
+{
+    free(arena->frames);
+    arena->frames = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
+
+const StackFrame *stack_trace_frames(
+    const StackFrameArena *arena,
+    const StackTrace *trace)
+{
+    return arena->frames + trace->frame_offset;
+}
+
+// Helper: Make room for count more frames; NULL if the arena cannot grow
+static StackFrame *arena_reserve(StackFrameArena *arena, uint32_t count)
+{
+    if (arena->capacity - arena->used < count)
+    {
+        uint64_t capacity = arena->capacity ? arena->capacity : MAX_STACK_DEPTH;
+        while (capacity - arena->used < count)
+            capacity *= 2;
+        if (capacity > UINT32_MAX)
+            return NULL;
+
+        StackFrame *frames = (StackFrame *)realloc(arena->frames, capacity * sizeof(StackFrame));
+        if (!frames)
+            return NULL;
+
+        arena->frames = frames;
+        arena->capacity = (uint32_t)capacity;
+    }
+    return arena->frames + arena->used;
+}
+
+// Helper: Read registers, timed as STACK_PHASE_REGISTERS
+static int timed_registers(task_t task, thread_t thread, bool peek, PlatformRegisters *regs, StackTrace *trace)
+{
+    uint64_t start = get_timestamp_ns();
+    int kr = peek ? g_ops->thread_peek_registers(task, thread, regs)
+                  : g_ops->thread_get_registers(task, thread, regs);
+    trace->phase_ns[STACK_PHASE_REGISTERS] += get_timestamp_ns() - start;
+    trace->kernel_calls++;
+    return kr;
+}
+
+// Helper: Whether a thread's registers are where its previous walk started
+// A peek may not see FP; equal PC and SP of a thread that has not run are
+// enough then.
+static bool origin_matches(const StackWalkOrigin *hint, const PlatformRegisters *regs)
+{
+    return hint && hint->pc != 0 && hint->pc == regs->pc && hint->sp == regs->sp &&
+           (regs->fp == 0 || hint->fp == regs->fp);
+}
+
+// Helper: Remember where a walk starts; true if that is where the
+// previous walk started too
+static bool note_origin(StackTrace *trace, const PlatformRegisters *regs, const StackWalkOrigin *hint)
+{
+    trace->origin.pc = regs->pc;
+    trace->origin.sp = regs->sp;
+    trace->origin.fp = regs->fp;
+    trace->unchanged = origin_matches(hint, regs);
+    return trace->unchanged;
+}
+
+// Helper: Check a hinted thread without stopping it; true (and the trace
+// marked unchanged) if it is still where its previous walk started
+static bool peek_unchanged(task_t task, thread_t thread, const StackWalkOrigin *hint, StackTrace *trace)
+{
+    if (!hint || hint->pc == 0)
+        return false;
+
+    PlatformRegisters regs;
+    if (timed_registers(task, thread, true, &regs, trace) != 0 || !origin_matches(hint, &regs))
+        return false;
+
+    trace->origin = *hint;
+    trace->unchanged = true;
+    return true;
+}
+
+// Helper: Reset a trace header before capturing into it
+static void init_trace(StackTrace *trace, thread_t thread, uint32_t frame_offset)
+{
+    trace->frame_offset = frame_offset;
+    trace->frame_count = 0;
+    trace->thread = thread;
+    trace->thread_number = 0;
+    trace->thread_id = 0;
+    trace->timestamp_ns = 0;
+    trace->remote_reads = 0;
+    trace->failed_reads = 0;
+    trace->rejected_reads = 0;
+    trace->kernel_calls = 0;
+    trace->stack_id = 0;
+    trace->origin.pc = 0;
+    trace->origin.sp = 0;
+    trace->origin.fp = 0;
+    trace->unchanged = false;
+    trace->cached_frames = 0;
+    trace->pause_ns = 0;
+    trace->optimistic_attempts = 0;
+    trace->torn = false;
+    for (uint32_t phase = 0; phase < STACK_PHASE_COUNT; phase++)
+        trace->phase_ns[phase] = 0;
+    trace->bytes_read = 0;
+}
+
+// Helper: Add a finished walk's reads to its trace
+static void add_walk_counters(StackTrace *trace, const WalkContext *ctx)
+{
+    trace->remote_reads += ctx->remote_reads;
+    trace->failed_reads += ctx->failed_reads;
+    trace->rejected_reads += ctx->rejected_reads;
+    trace->kernel_calls += ctx->remote_reads;
+    trace->phase_ns[STACK_PHASE_READ] += ctx->read_ns;
+    trace->bytes_read += ctx->bytes_read;
+}
+
+// Helper: Walk with the configured strategy
+// The walk's own time goes to STACK_PHASE_WALK; its reads stay in ctx for
+// add_walk_counters.
+static int walk_stack(
+    WalkContext *ctx,
+    const PlatformRegisters *regs,
+    StackFrame *frames,
+    StackTrace *trace)
+{
+    uint64_t start = get_timestamp_ns();
+    uint64_t read_ns = ctx->read_ns;
+    int result = 0;
+    switch (g_config.strategy)
+    {
+    case STACK_WALK_FRAME_POINTER:
+        result = walk_stack_frame_pointer(ctx, regs, frames, trace);
+        break;
+
+    case STACK_WALK_LIBUNWIND:
+        // Without a table there is nothing to unwind with but frame pointers
+        if (g_unwind_table == NULL)
+            result = walk_stack_frame_pointer(ctx, regs, frames, trace);
+        else
+            result = walk_stack_cfi(ctx, regs, frames, trace, false);
+        break;
+
+    case STACK_WALK_HYBRID:
+        result = walk_stack_cfi(ctx, regs, frames, trace, true);
+        break;
+    }
+
+    splice_async_chain(ctx, frames, trace);
+    trace->phase_ns[STACK_PHASE_WALK] += get_timestamp_ns() - start - (ctx->read_ns - read_ns);
+    return result;
+}
+
+// Helper: Frame records chained from the one at address within the window
+// A record is a saved FP followed by a return address into code; the chain
+// follows saved FPs up the stack until one is 0 or leaves the window.
+// Records within FP_SCAN_LIMIT above start are marked in visited.
+static uint32_t window_chain_length(WalkContext *ctx, uint64_t address, uint64_t start, uint64_t *visited)
+{
+    uint32_t length = 0;
+    while (length < g_config.max_depth && address >= ctx->window_base &&
+           address - ctx->window_base + 16 <= ctx->window_size)
+    {
+        uint64_t record[2];
+        memcpy(record, ctx->window_data + (address - ctx->window_base), sizeof(record));
+        if (!is_code_address(ctx, record[1]))
+            break;
+
+        uint64_t offset = address - start;
+        if (address >= start && offset < FP_SCAN_LIMIT && offset % 8 == 0)
+            visited[offset / 8 / 64] |= 1ULL << (offset / 8 % 64);
+
+        length++;
+        if (record[0] <= address || record[0] - address > 0x100000)
+            break;
+        address = record[0];
+    }
+    return length;
+}
+
+// Helper: Where the record FP points at can start, when FP could not be read
+// With an unwind table, the frames whose CFA is SP-based are stepped over
+// first; a record-like pair inside them is a saved register, not the
+// record. If one of them saved FP, the CFI walk restores it from the stack
+// and never uses the current FP, so nothing needs to be found (returns 0).
+static uint64_t frame_record_search_start(WalkContext *ctx, const PlatformRegisters *regs)
+{
+    uint64_t pc = regs->pc;
+    uint64_t sp = regs->sp;
+    if (g_unwind_table == NULL)
+        return sp;
+
+    for (uint32_t depth = 0; depth < g_config.max_depth; depth++)
+    {
+        UnwindRow row;
+        if (!unwind_table_find(g_unwind_table, depth == 0 ? pc : pc - 1, &row) ||
+            row.cfa_base != UNWIND_CFA_SP || row.ra_rule != UNWIND_REG_AT_CFA)
+        {
+            return sp;
+        }
+        if (row.fp_rule == UNWIND_REG_AT_CFA)
+            return 0;
+
+        uint64_t cfa = sp + (int64_t)row.cfa_offset;
+        uint64_t return_addr;
+        if (cfa < sp || !read_stack(ctx, cfa + (int64_t)row.ra_offset, &return_addr, sizeof(return_addr)))
+            return sp;
+
+        pc = return_addr;
+        sp = cfa;
+    }
+    return sp;
+}
+
+// Helper: Find the frame record FP points at when FP could not be read
+// Saved registers and locals can look like a frame record too, so of the
+// candidates from start up the one that starts the longest chain in the
+// copied window is taken (the innermost on a tie). Frameless code between
+// PC and that record can make the walk differ from one with the real FP,
+// as with any frame pointer walk.
+static uint64_t recover_frame_pointer(WalkContext *ctx, uint64_t start)
+{
+    // A record on an earlier candidate's chain starts a shorter one
+    uint64_t visited[FP_SCAN_LIMIT / 8 / 64] = {0};
+
+    uint64_t best = 0;
+    uint32_t best_length = 0;
+    for (uint64_t offset = 0; offset < FP_SCAN_LIMIT; offset += 8)
+    {
+        if (visited[offset / 8 / 64] & (1ULL << (offset / 8 % 64)))
+            continue;
+
+        uint32_t length = window_chain_length(ctx, start + offset, start, visited);
+        if (length > best_length)
+        {
+            best = start + offset;
+            best_length = length;
+        }
+    }
+    return best;
+}
+
+// Helper: Walk a thread without stopping it (optimistic_capture)
+// The thread keeps running, so a walk may mix two states of its stack. The
+// walk itself only follows increasing FPs and return addresses into code;
+// on top of that it is kept only if the thread's PC and SP are the same
+// after it as before. Otherwise it is retried, and after
+// OPTIMISTIC_MAX_ATTEMPTS the trace is marked torn and left empty.
+// Returns false if the registers cannot be read without a stop (the thread
+// is running, or FP is unknown and there is no window to find it in); the
+// caller then stops the thread.
+static bool capture_optimistic(
+    task_t task,
+    thread_t thread,
+    const StackWalkOrigin *hint,
+    uint8_t *window,
+    StackFrame *frames,
+    StackTrace *trace)
+{
+    for (uint32_t attempt = 0; attempt < OPTIMISTIC_MAX_ATTEMPTS; attempt++)
+    {
+        PlatformRegisters regs;
+        if (timed_registers(task, thread, true, &regs, trace) != 0)
+            return false;
+        if (regs.fp == 0 && !window)
+            return false;
+
+        if (note_origin(trace, &regs, hint))
+            return true;
+
+        WalkContext ctx;
+        init_walk_context(&ctx, task, false);
+        ctx.suffix = acquire_suffix(thread);
+        copy_stack_window(&ctx, regs.sp, window);
+
+        uint64_t peeked_fp = regs.fp;
+        if (regs.fp == 0)
+        {
+            uint64_t start = frame_record_search_start(&ctx, &regs);
+            if (start != 0)
+                regs.fp = recover_frame_pointer(&ctx, start);
+        }
+
+        trace->optimistic_attempts++;
+        walk_stack(&ctx, &regs, frames, trace);
+        add_walk_counters(trace, &ctx);
+
+        PlatformRegisters after;
+        if (timed_registers(task, thread, true, &after, trace) == 0 &&
+            after.pc == regs.pc && after.sp == regs.sp && after.fp == peeked_fp)
+        {
+            return true;
+        }
+
+        // Torn; the suffix cache must not keep what this walk saw either
+        trace->frame_count = 0;
+        if (ctx.suffix)
+            ctx.suffix->count = 0;
+    }
+
+    trace->torn = true;
+    return true;
+}
+
+// Helper: Resume a thread stopped at stop_start and time its pause
+static void resume_thread(task_t task, thread_t thread, uint64_t stop_start, StackTrace *trace)
+{
+    uint64_t start = get_timestamp_ns();
+    g_ops->thread_resume(task, thread);
+    uint64_t end = get_timestamp_ns();
+    trace->phase_ns[STACK_PHASE_RESUME] = end - start;
+    trace->pause_ns = end - stop_start;
+    trace->kernel_calls++;
+}
+
+// Helper: Suspend, read registers, copy the window, walk, resume
+// Everything mutable lives in window/arena/trace, so batch workers can run
+// this concurrently with their own scratch.
+static int capture_thread(
+    task_t task,
+    thread_t thread,
+    const StackWalkOrigin *hint,
+    uint8_t *window,
+    StackFrameArena *arena,
+    StackTrace *trace)
+{
+    // Initialize trace (header only; frames go straight into the arena)
+    init_trace(trace, thread, arena->used);
+
+    StackFrame *frames = arena_reserve(arena, g_config.max_depth);
+    if (!frames)
+    {
+        fprintf(stderr, "Warning: could not grow frame arena\n");
+        return -1;
+    }
+
+    // Get thread ID (callers with a thread registry fill it from their cache)
+    if (g_config.capture_thread_ids)
+    {
+        stack_walker_get_thread_id(thread, &trace->thread_id);
+        trace->kernel_calls++;
+    }
+
+    // Capture timestamp if enabled
+    if (g_config.capture_timestamps)
+    {
+        trace->timestamp_ns = get_timestamp_ns();
+    }
+
+    if (g_config.optimistic_capture)
+    {
+        if (capture_optimistic(task, thread, hint, window, frames, trace))
+        {
+            arena->used += trace->frame_count;
+            return 0;
+        }
+    }
+    else if (peek_unchanged(task, thread, hint, trace))
+    {
+        // A thread parked where it was last time needs neither a stop nor a walk
+        return 0;
+    }
+
+    // Suspend the thread
+    uint64_t stop_start = get_timestamp_ns();
+    int kr = g_ops->thread_suspend(task, thread);
+    trace->phase_ns[STACK_PHASE_SUSPEND] = get_timestamp_ns() - stop_start;
+    trace->kernel_calls++;
+    if (kr != 0)
+    {
+        fprintf(stderr, "Warning: thread_suspend failed: %d\n", kr);
+        return kr;
+    }
 
-// Helper: Get current time in nanoseconds
-static uint64_t get_timestamp_ns(void)
+    // Get thread state (registers)
+    PlatformRegisters regs;
+    kr = timed_registers(task, thread, false, &regs, trace);
+
+    if (kr != 0)
+    {
+        fprintf(stderr, "Warning: thread_get_state failed: %d\n", kr);
+        resume_thread(task, thread, stop_start, trace);
+        return kr;
+    }
+
+    // Debug: Uncomment to see register values
+    // fprintf(stderr, "Thread %u: PC=0x%llx FP=0x%llx SP=0x%llx\n",
+    //         thread, regs.pc, regs.fp, regs.sp);
+
+    // The peek may have been unavailable; the stopped registers decide
+    if (note_origin(trace, &regs, hint))
+    {
+        resume_thread(task, thread, stop_start, trace);
+        return 0;
+    }
+
+    // Copy the top of the stack while the thread is stopped
+    WalkContext ctx;
+    init_walk_context(&ctx, task, false);
+    ctx.suffix = acquire_suffix(thread);
+    copy_stack_window(&ctx, regs.sp, window);
+
+    // Walk the stack based on strategy
+    int result = walk_stack(&ctx, &regs, frames, trace);
+
+    // Resume the thread
+    resume_thread(task, thread, stop_start, trace);
+    add_walk_counters(trace, &ctx);
+
+    // Keep only the frames that were actually walked
+    arena->used += trace->frame_count;
+
+    return result;
+}
+
+static void free_scratch(void)
 {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    for (uint32_t i = 0; i < STACK_WALKER_MAX_WORKERS; i++)
+    {
+        free(g_scratch[i].window);
+        g_scratch[i].window = NULL;
+        stack_frame_arena_destroy(&g_scratch[i].arena);
+    }
 }
 
-// Helper: Check if an address looks valid
-static bool is_valid_address(uint64_t addr)
+// Helper: Make room for a snapshot of thread_count threads
+static bool grow_snapshot(uint32_t thread_count)
 {
-    // Basic sanity checks for macOS user space addresses
-    if (addr == 0)
-        return false;
+    if (thread_count <= g_snapshot_capacity)
+        return true;
 
-    // User space on macOS:
-    // - x86_64: typically 0x100000000 - 0x7FFFFFFFF000
-    // - ARM64: typically 0x100000000 - 0x200000000
-    // Allow a wider range to be safe
-    if (addr < 0x100000) // Below typical executable base
-        return false;
+    size_t window_bytes = (size_t)thread_count * g_config.stack_window_size;
+    uint8_t *windows = (uint8_t *)realloc(g_snapshot_windows, window_bytes ? window_bytes : 1);
+    if (windows)
+        g_snapshot_windows = windows;
 
-#if defined(__x86_64__)
-    if (addr >= 0x800000000000ULL) // Kernel space
-        return false;
-#elif defined(__arm64__) || defined(__aarch64__)
-    if (addr >= 0x1000000000ULL) // Above typical user space on ARM64
-        return false;
-#endif
+    PlatformRegisters *regs = (PlatformRegisters *)realloc(
+        g_snapshot_regs, thread_count * sizeof(PlatformRegisters));
+    if (regs)
+        g_snapshot_regs = regs;
+
+    uint64_t *sizes = (uint64_t *)realloc(
+        g_snapshot_window_sizes, thread_count * sizeof(uint64_t));
+    if (sizes)
+        g_snapshot_window_sizes = sizes;
+
+    bool *stopped = (bool *)realloc(g_snapshot_stopped, thread_count * sizeof(bool));
+    if (stopped)
+        g_snapshot_stopped = stopped;
 
-    // Should be at least 2-byte aligned for instructions
-    if (addr & 0x1)
+    bool *has_regs = (bool *)realloc(g_snapshot_has_regs, thread_count * sizeof(bool));
+    if (has_regs)
+        g_snapshot_has_regs = has_regs;
+
+    thread_t *pending = (thread_t *)realloc(g_snapshot_pending, thread_count * sizeof(thread_t));
+    if (pending)
+        g_snapshot_pending = pending;
+
+    uint32_t *pending_index = (uint32_t *)realloc(g_snapshot_pending_index, thread_count * sizeof(uint32_t));
+    if (pending_index)
+        g_snapshot_pending_index = pending_index;
+
+    if (!windows || !regs || !sizes || !stopped || !has_regs || !pending || !pending_index)
         return false;
 
+    g_snapshot_capacity = thread_count;
     return true;
 }
 
-// Helper: Read memory from target process
-static kern_return_t read_memory(
-    task_t task,
-    uint64_t address,
-    void *data,
-    size_t size)
+static void free_snapshot(void)
 {
-    vm_size_t read_size = size;
-    return vm_read_overwrite(
-        task,
-        address,
-        size,
-        (vm_address_t)data,
-        &read_size);
+    free(g_snapshot_windows);
+    free(g_snapshot_regs);
+    free(g_snapshot_window_sizes);
+    free(g_snapshot_stopped);
+    free(g_snapshot_has_regs);
+    free(g_snapshot_pending);
+    free(g_snapshot_pending_index);
+    g_snapshot_windows = NULL;
+    g_snapshot_regs = NULL;
+    g_snapshot_window_sizes = NULL;
+    g_snapshot_stopped = NULL;
+    g_snapshot_has_regs = NULL;
+    g_snapshot_pending = NULL;
+    g_snapshot_pending_index = NULL;
+    g_snapshot_capacity = 0;
 }
 
-// Frame pointer based stack walking
-static int walk_stack_frame_pointer(
-    task_t task,
-    cpu_state_t *state,
-    StackTrace *trace)
+// Helper: Capture the batch entries handed out to this worker
+static void run_batch_job(uint32_t worker)
 {
-    uint64_t pc = GET_PC(*state);
-    uint64_t fp = GET_FP(*state);
+    WalkerScratch *scratch = &g_scratch[worker];
 
-    trace->frame_count = 0;
-
-    // Debug: Print initial values
-    // fprintf(stderr, "DEBUG: PC=0x%llx FP=0x%llx\n", pc, fp);
-
-    // First frame is current PC
-    if (is_valid_address(pc))
-    {
-        trace->frames[trace->frame_count].address = pc;
-        trace->frames[trace->frame_count].frame_pointer = fp;
-        trace->frame_count++;
-    }
-    else
+    for (;;)
     {
-        // PC is not valid - thread might be in syscall or optimized code
-        // fprintf(stderr, "DEBUG: Invalid PC=0x%llx\n", pc);
+        uint32_t i = g_job.next.fetch_add(1, std::memory_order_relaxed);
+        if (i >= g_job.thread_count)
+            break;
 
-        // Try to continue with frame pointer if it's valid
-        if (!is_valid_address(fp))
-        {
-            return 0; // No frames captured, but not an error
-        }
+        capture_thread(g_job.task, g_job.threads[i], g_job.hints ? &g_job.hints[i] : NULL,
+                       scratch->window, &scratch->arena, &g_job.traces[i]);
+        g_job.owner[i] = (uint8_t)worker;
     }
+}
 
-    // Walk the frame pointer chain
-    uint64_t prev_fp = 0;
-    while (trace->frame_count < g_config.max_depth)
+static void *worker_main(void *arg)
+{
+    uint32_t worker = (uint32_t)(uintptr_t)arg;
+    uint64_t seen_generation = g_pool_base_generation;
+
+    pthread_mutex_lock(&g_pool_lock);
+    for (;;)
     {
-        // Safety check: ensure FP is valid and increasing
-        if (!is_valid_address(fp))
+        while (g_pool_generation == seen_generation && !g_pool_shutdown)
+            pthread_cond_wait(&g_pool_start, &g_pool_lock);
+
+        if (g_pool_shutdown)
             break;
 
-        if (fp <= prev_fp)
-            break; // Stack should grow toward higher addresses
+        seen_generation = g_pool_generation;
+        pthread_mutex_unlock(&g_pool_lock);
 
-        if (fp - prev_fp > 0x100000)
-            break; // Unreasonably large frame
+        run_batch_job(worker);
 
-        // Read the frame:
-        // [fp]     = previous frame pointer
-        // [fp + 8] = return address
-        uint64_t frame_data[2];
-        kern_return_t kr = read_memory(task, fp, frame_data, sizeof(frame_data));
+        pthread_mutex_lock(&g_pool_lock);
+        if (--g_pool_active == 0)
+            pthread_cond_signal(&g_pool_done);
+    }
+    pthread_mutex_unlock(&g_pool_lock);
 
-        if (kr != KERN_SUCCESS)
-            break;
+    return NULL;
+}
 
-        uint64_t next_fp = frame_data[0];
-        uint64_t return_addr = frame_data[1];
+static void start_worker_pool(uint32_t background_workers)
+{
+    g_pool_shutdown = false;
+    g_pool_base_generation = g_pool_generation;
+    g_worker_count = 0;
 
-        // Validate return address
-        if (!is_valid_address(return_addr))
+    for (uint32_t i = 0; i < background_workers; i++)
+    {
+        // Worker N uses scratch slot N + 1; slot 0 is the caller's
+        uintptr_t worker = i + 1;
+        if (pthread_create(&g_workers[i], NULL, worker_main, (void *)worker) != 0)
             break;
+        g_worker_count++;
+    }
+}
 
-        // Add frame
-        trace->frames[trace->frame_count].address = return_addr;
-        trace->frames[trace->frame_count].frame_pointer = fp;
-        trace->frame_count++;
+static void stop_worker_pool(void)
+{
+    if (g_worker_count == 0)
+        return;
 
-        // Move to next frame
-        prev_fp = fp;
-        fp = next_fp;
+    pthread_mutex_lock(&g_pool_lock);
+    g_pool_shutdown = true;
+    pthread_cond_broadcast(&g_pool_start);
+    pthread_mutex_unlock(&g_pool_lock);
 
-        // Stop if we hit the bottom
-        if (fp == 0)
-            break;
+    for (uint32_t i = 0; i < g_worker_count; i++)
+    {
+        pthread_join(g_workers[i], NULL);
     }
-
-    return 0;
+    g_worker_count = 0;
 }
 
 // Main capture function
@@ -177,19 +1410,62 @@ void stack_walker_init(const StackWalkerConfig *config)
         g_config.max_depth = MAX_STACK_DEPTH;
         g_config.capture_timestamps = true;
         g_config.validate_addresses = false;
+        g_config.capture_thread_ids = true;
+        g_config.stack_window_size = STACK_WINDOW_DEFAULT_SIZE;
+        g_config.capture_workers = STACK_WALKER_DEFAULT_WORKERS;
+        g_config.track_async = false;
+        g_config.cache_suffixes = true;
+        g_config.optimistic_capture = false;
     }
 
     // Cap max depth
     if (g_config.max_depth > MAX_STACK_DEPTH)
         g_config.max_depth = MAX_STACK_DEPTH;
 
+    // Cap window size
+    if (g_config.stack_window_size > STACK_WINDOW_MAX_SIZE)
+        g_config.stack_window_size = STACK_WINDOW_MAX_SIZE;
+
+    // Cap worker count
+    if (g_config.capture_workers == 0)
+        g_config.capture_workers = 1;
+    if (g_config.capture_workers > STACK_WALKER_MAX_WORKERS)
+        g_config.capture_workers = STACK_WALKER_MAX_WORKERS;
+
+    // Re-initialization replaces the previous pool and scratch buffers
+    stop_worker_pool();
+    free_scratch();
+    free_snapshot();
+    free_suffix_cache();
+
+    bool scratch_ok = true;
+    for (uint32_t i = 0; i < g_config.capture_workers; i++)
+    {
+        if (g_config.stack_window_size > 0)
+        {
+            g_scratch[i].window = (uint8_t *)malloc(g_config.stack_window_size);
+            scratch_ok = scratch_ok && g_scratch[i].window != NULL;
+        }
+        if (g_config.capture_workers > 1)
+        {
+            scratch_ok = scratch_ok &&
+                         stack_frame_arena_init(&g_scratch[i].arena, MAX_STACK_DEPTH * 4) == 0;
+        }
+    }
+
+    if (!scratch_ok)
+    {
+        fprintf(stderr, "Warning: could not allocate walker scratch, capturing serially\n");
+        g_config.capture_workers = 1;
+    }
+
+    start_worker_pool(g_config.capture_workers - 1);
+
     g_initialized = true;
 }
 
-int stack_walker_capture(
-    task_t task,
-    thread_t thread,
-    StackTrace *trace)
+// Helper: Make sure the walker is initialized
+static void ensure_initialized(void)
 {
     if (!g_initialized)
     {
@@ -198,113 +1474,294 @@ int stack_walker_capture(
         default_config.max_depth = MAX_STACK_DEPTH;
         default_config.capture_timestamps = true;
         default_config.validate_addresses = false;
+        default_config.capture_thread_ids = true;
+        default_config.stack_window_size = STACK_WINDOW_DEFAULT_SIZE;
+        default_config.capture_workers = STACK_WALKER_DEFAULT_WORKERS;
+        default_config.track_async = false;
+        default_config.cache_suffixes = true;
+        default_config.optimistic_capture = false;
         stack_walker_init(&default_config);
     }
+}
 
-    // Initialize trace
-    memset(trace, 0, sizeof(StackTrace));
-    trace->thread = thread;
+int stack_walker_capture(
+    task_t task,
+    thread_t thread,
+    StackFrameArena *arena,
+    StackTrace *trace)
+{
+    ensure_initialized();
+    begin_suffix_generation();
+    return capture_thread(task, thread, NULL, g_scratch[0].window, arena, trace);
+}
 
-    // Get thread ID
-    stack_walker_get_thread_id(thread, &trace->thread_id);
+int stack_walker_capture_batch(
+    task_t task,
+    const thread_t *threads,
+    uint32_t thread_count,
+    const StackWalkOrigin *hints,
+    StackFrameArena *arena,
+    StackTrace *traces)
+{
+    ensure_initialized();
+    begin_suffix_generation();
 
-    // Capture timestamp if enabled
-    if (g_config.capture_timestamps)
+    int successful = 0;
+
+    if (g_worker_count == 0 || thread_count < 2)
     {
-        trace->timestamp_ns = get_timestamp_ns();
+        for (uint32_t i = 0; i < thread_count; i++)
+        {
+            int result = capture_thread(task, threads[i], hints ? &hints[i] : NULL,
+                                        g_scratch[0].window, arena, &traces[i]);
+            if (result == 0 && (traces[i].frame_count > 0 || traces[i].unchanged))
+            {
+                successful++;
+            }
+        }
+        return successful;
     }
 
-    // Suspend the thread
-    kern_return_t kr = thread_suspend(thread);
-    if (kr != KERN_SUCCESS)
+    if (thread_count > g_owner_capacity)
     {
-        fprintf(stderr, "Warning: thread_suspend failed: %d\n", kr);
-        return kr;
+        uint8_t *owner = (uint8_t *)realloc(g_job.owner, thread_count);
+        if (!owner)
+            return 0;
+        g_job.owner = owner;
+        g_owner_capacity = thread_count;
     }
 
-    // Get thread state (registers)
-    cpu_state_t state;
-    mach_msg_type_number_t state_count = THREAD_STATE_COUNT;
-
-    kr = thread_get_state(
-        thread,
-        THREAD_STATE_FLAVOR,
-        (thread_state_t)&state,
-        &state_count);
-
-    if (kr != KERN_SUCCESS)
+    // Hand the threads out to the pool; the calling thread works too,
+    // walking into slot 0 with its own arena like everyone else
+    for (uint32_t i = 0; i <= g_worker_count; i++)
     {
-        fprintf(stderr, "Warning: thread_get_state failed: %d\n", kr);
-        thread_resume(thread);
-        return kr;
+        stack_frame_arena_reset(&g_scratch[i].arena);
     }
 
-    // Debug: Uncomment to see register values
-    // fprintf(stderr, "Thread %u: PC=0x%llx FP=0x%llx SP=0x%llx\n",
-    //         thread, GET_PC(state), GET_FP(state), GET_SP(state));
+    g_job.task = task;
+    g_job.threads = threads;
+    g_job.hints = hints;
+    g_job.traces = traces;
+    g_job.thread_count = thread_count;
+    g_job.next.store(0, std::memory_order_relaxed);
 
-    // Walk the stack based on strategy
-    int result = 0;
-    switch (g_config.strategy)
+    pthread_mutex_lock(&g_pool_lock);
+    g_pool_active = g_worker_count;
+    g_pool_generation++;
+    pthread_cond_broadcast(&g_pool_start);
+    pthread_mutex_unlock(&g_pool_lock);
+
+    run_batch_job(0);
+
+    pthread_mutex_lock(&g_pool_lock);
+    while (g_pool_active > 0)
+        pthread_cond_wait(&g_pool_done, &g_pool_lock);
+    pthread_mutex_unlock(&g_pool_lock);
+
+    // Gather frames into the caller's arena in thread order, so the result
+    // is laid out exactly as a serial capture would have left it
+    for (uint32_t i = 0; i < thread_count; i++)
     {
-    case STACK_WALK_FRAME_POINTER:
-        result = walk_stack_frame_pointer(task, &state, trace);
-        break;
+        StackTrace *trace = &traces[i];
+        const StackFrame *source =
+            g_scratch[g_job.owner[i]].arena.frames + trace->frame_offset;
 
-    case STACK_WALK_LIBUNWIND:
-        // TODO: Implement libunwind fallback
-        printf("Warning: libunwind not yet implemented, using frame pointer\n");
-        result = walk_stack_frame_pointer(task, &state, trace);
-        break;
+        StackFrame *dest = arena_reserve(arena, trace->frame_count);
+        if (!dest)
+        {
+            trace->frame_count = 0;
+            trace->frame_offset = arena->used;
+            continue;
+        }
 
-    case STACK_WALK_HYBRID:
-        // Try frame pointer first
-        result = walk_stack_frame_pointer(task, &state, trace);
-        // TODO: If failed or too few frames, try libunwind
-        break;
-    }
+        memcpy(dest, source, trace->frame_count * sizeof(StackFrame));
+        trace->frame_offset = arena->used;
+        arena->used += trace->frame_count;
 
-    // Resume the thread
-    thread_resume(thread);
+        if (trace->frame_count > 0 || trace->unchanged)
+        {
+            successful++;
+        }
+    }
 
-    return result;
+    return successful;
 }
 
-int stack_walker_capture_batch(
+// Helper: Capture the threads a snapshot could not stop one at a time
+// The threads found unchanged keep their traces. Returns the successful
+// traces of the whole snapshot.
+static int capture_pending_serially(
     task_t task,
-    thread_t *threads,
     uint32_t thread_count,
+    uint32_t pending_count,
+    StackFrameArena *arena,
     StackTrace *traces)
 {
-    int successful = 0;
+    int successful = (int)(thread_count - pending_count);
+    for (uint32_t p = 0; p < pending_count; p++)
+    {
+        // Already found to have moved; no hint, so it is not peeked again
+        StackTrace *trace = &traces[g_snapshot_pending_index[p]];
+        int result = capture_thread(task, g_snapshot_pending[p], NULL, g_scratch[0].window, arena, trace);
+        if (result == 0 && trace->frame_count > 0)
+            successful++;
+    }
+    return successful;
+}
+
+int stack_walker_capture_snapshot(
+    task_t task,
+    const thread_t *threads,
+    uint32_t thread_count,
+    const StackWalkOrigin *hints,
+    StackFrameArena *arena,
+    StackTrace *traces,
+    uint64_t *pause_ns)
+{
+    ensure_initialized();
+    begin_suffix_generation();
+    *pause_ns = 0;
+
+    if (thread_count == 0)
+        return 0;
+
+    if (!grow_snapshot(thread_count))
+    {
+        fprintf(stderr, "Warning: could not allocate snapshot storage\n");
+        return 0;
+    }
 
+    // Everything that needs no stopped target happens before the pause,
+    // including spotting threads still parked where they were last time
+    uint32_t pending_count = 0;
     for (uint32_t i = 0; i < thread_count; i++)
     {
-        int result = stack_walker_capture(task, threads[i], &traces[i]);
-        if (result == 0 && traces[i].frame_count > 0)
+        StackTrace *trace = &traces[i];
+        init_trace(trace, threads[i], arena->used);
+        if (g_config.capture_thread_ids)
+        {
+            stack_walker_get_thread_id(threads[i], &trace->thread_id);
+            trace->kernel_calls++;
+        }
+        g_snapshot_has_regs[i] = false;
+        g_snapshot_window_sizes[i] = 0;
+
+        if (peek_unchanged(task, threads[i], hints ? &hints[i] : NULL, trace))
+            continue;
+        g_snapshot_pending[pending_count] = threads[i];
+        g_snapshot_pending_index[pending_count] = i;
+        pending_count++;
+    }
+
+    // Pause: registers and top-of-stack copies only
+    uint64_t pause_start = get_timestamp_ns();
+    if (pending_count > 0)
+    {
+        int kr = g_ops->task_suspend(task, g_snapshot_pending, pending_count, g_snapshot_stopped);
+        if (kr != 0)
         {
+            fprintf(stderr, "Warning: task suspend failed: %d\n", kr);
+            return capture_pending_serially(task, thread_count, pending_count, arena, traces);
+        }
+
+        // The whole-task stop and restart are charged to the first trace
+        StackTrace *first = &traces[g_snapshot_pending_index[0]];
+        first->phase_ns[STACK_PHASE_SUSPEND] = get_timestamp_ns() - pause_start;
+        first->kernel_calls += 2;
+    }
+
+    for (uint32_t p = 0; p < pending_count; p++)
+    {
+        if (!g_snapshot_stopped[p])
+            continue;
+
+        uint32_t i = g_snapshot_pending_index[p];
+        if (timed_registers(task, threads[i], false, &g_snapshot_regs[i], &traces[i]) != 0)
+            continue;
+        g_snapshot_has_regs[i] = true;
+        if (note_origin(&traces[i], &g_snapshot_regs[i], hints ? &hints[i] : NULL))
+            continue;
+
+        WalkContext ctx;
+        init_walk_context(&ctx, task, true);
+        copy_stack_window(&ctx, g_snapshot_regs[i].sp,
+                          g_snapshot_windows + (size_t)i * g_config.stack_window_size);
+        g_snapshot_window_sizes[i] = ctx.window_size;
+        add_walk_counters(&traces[i], &ctx);
+    }
+
+    if (pending_count > 0)
+    {
+        uint64_t resume_start = get_timestamp_ns();
+        g_ops->task_resume(task, g_snapshot_pending, pending_count, g_snapshot_stopped);
+        *pause_ns = get_timestamp_ns() - pause_start;
+        traces[g_snapshot_pending_index[0]].phase_ns[STACK_PHASE_RESUME] = pause_start + *pause_ns - resume_start;
+    }
+
+    // The target is running again; unwind from the copies
+    int successful = 0;
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        StackTrace *trace = &traces[i];
+        trace->frame_offset = arena->used;
+
+        // Every thread was stopped (or found parked) at the same instant
+        if (g_config.capture_timestamps && (g_snapshot_has_regs[i] || trace->unchanged))
+            trace->timestamp_ns = pause_start;
+
+        if (trace->unchanged)
             successful++;
+        if (!g_snapshot_has_regs[i] || trace->unchanged)
+            continue;
+
+        StackFrame *frames = arena_reserve(arena, g_config.max_depth);
+        if (!frames)
+        {
+            fprintf(stderr, "Warning: could not grow frame arena\n");
+            break;
         }
+
+        WalkContext ctx;
+        init_walk_context(&ctx, task, true);
+        ctx.suffix = acquire_suffix(threads[i]);
+        ctx.window_base = g_snapshot_regs[i].sp;
+        ctx.window_size = g_snapshot_window_sizes[i];
+        ctx.window_data = g_snapshot_windows + (size_t)i * g_config.stack_window_size;
+
+        walk_stack(&ctx, &g_snapshot_regs[i], frames, trace);
+        add_walk_counters(trace, &ctx);
+        arena->used += trace->frame_count;
+
+        if (trace->frame_count > 0)
+            successful++;
     }
 
     return successful;
 }
 
-void stack_walker_print(const StackTrace *trace)
+void stack_walker_print(const StackFrameArena *arena, const StackTrace *trace)
 {
+    const StackFrame *frames = stack_trace_frames(arena, trace);
+
     printf("[%llu] Thread %u (%d frames)\n",
-           trace->thread_id,
+           (unsigned long long)trace->thread_id,
            trace->thread,
            trace->frame_count);
 
     for (uint32_t i = 0; i < trace->frame_count; i++)
     {
-        printf("  #%-3d 0x%016llx", i, trace->frames[i].address);
+        if (frames[i].address == STACK_FRAME_ASYNC_MARKER)
+        {
+            printf("  ---- awaited by ----\n");
+            continue;
+        }
+
+        printf("  #%-3d 0x%016llx", i, (unsigned long long)frames[i].address);
 
         // Optionally show frame pointer for debugging
-        if (trace->frames[i].frame_pointer != 0)
+        if (frames[i].frame_pointer != 0)
         {
-            printf("  (fp: 0x%llx)", trace->frames[i].frame_pointer);
+            printf("  (fp: 0x%llx)", (unsigned long long)frames[i].frame_pointer);
         }
 
         printf("\n");
@@ -312,35 +1769,46 @@ void stack_walker_print(const StackTrace *trace)
 
     if (trace->timestamp_ns > 0)
     {
-        printf("  Captured at: %llu ns\n", trace->timestamp_ns);
+        printf("  Captured at: %llu ns\n", (unsigned long long)trace->timestamp_ns);
     }
 }
 
-int stack_walker_get_thread_id(thread_t thread, uint64_t *thread_id)
+void stack_walker_set_unwind_table(const UnwindTable *table)
 {
-    thread_identifier_info_data_t identifier_info;
-    mach_msg_type_number_t count = THREAD_IDENTIFIER_INFO_COUNT;
+    g_unwind_table = table;
+}
 
-    kern_return_t kr = thread_info(
-        thread,
-        THREAD_IDENTIFIER_INFO,
-        (thread_info_t)&identifier_info,
-        &count);
+void stack_walker_set_region_map(const RegionMap *map)
+{
+    g_region_map = map;
+}
 
-    if (kr == KERN_SUCCESS)
-    {
-        *thread_id = identifier_info.thread_id;
-        return 0;
-    }
+void stack_walker_set_async_layout(const AsyncContextLayout *layout)
+{
+    g_async_layout = layout;
+}
 
-    // Fallback: use thread port as ID
-    *thread_id = thread;
-    return kr;
+void stack_walker_set_target_ops(const StackWalkerTargetOps *ops)
+{
+    g_ops = ops ? ops : &g_platform_ops;
+}
+
+int stack_walker_get_thread_id(thread_t thread, uint64_t *thread_id)
+{
+    return platform_thread_get_id(0, thread, thread_id);
 }
 
 void stack_walker_cleanup(void)
 {
-    // Currently nothing to clean up
-    // This is here for future use (e.g., libunwind cleanup)
+    stop_worker_pool();
+    free_scratch();
+    free_snapshot();
+    free_suffix_cache();
+    free(g_job.owner);
+    g_job.owner = NULL;
+    g_owner_capacity = 0;
+    g_unwind_table = NULL;
+    g_async_layout = NULL;
+    g_ops = &g_platform_ops;
     g_initialized = false;
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef SYMBOL_INTERNAL_H
+#define SYMBOL_INTERNAL_H
+
+#include "symbolizer.h"
+#include <stddef.h>
+
+// Longest build ID we key the cache by (ELF uses 20 bytes, Mach-O 16)
+#define SYMBOL_BUILD_ID_MAX 32
+
+// A symbol collected while a module is parsed
+typedef struct
+{
+    uint64_t start; // Relative to the module base
+    uint64_t size;  // 0 if the binary does not record it
+    uint32_t name;  // Offset into the builder's string pool
+} SymbolEntry;
+
+// Symbols of one module plus an interned pool of their names
+typedef struct
+{
+    SymbolEntry *symbols;
+    size_t count;
+    size_t capacity;
+
+    char *strings; // NUL-terminated names back to back
+    size_t string_size;
+    size_t string_capacity;
+
+    // Open-addressed set of pool offsets + 1; 0 marks a free slot
+    uint32_t *string_index;
+    uint32_t string_mask;
+    uint32_t string_count;
+} SymbolBuilder;
+
+/**
+ * Append a symbol, interning its name; false on allocation failure
+ */
+bool symbol_builder_add(
+    SymbolBuilder *builder,
+    uint64_t start,
+    uint64_t size,
+    const char *name,
+    size_t name_length);
+
+void symbol_builder_free(SymbolBuilder *builder);
+
+/**
+ * Read a module's build ID without parsing its symbols
+ * (symbols_elf.cpp on Linux, symbols_macho.cpp on macOS)
+ *
+ * @return Size of the build ID, 0 if the module has none
+ */
+size_t symbol_read_build_id(
+    task_t task,
+    const PlatformModule *module,
+    uint8_t *id);
+
+/**
+ * Collect the function symbols of one loaded module
+ *
+ * @return 0 on success, error code otherwise
+ */
+int symbol_load_module(
+    task_t task,
+    const PlatformModule *module,
+    SymbolBuilder *out);
+
+#endif // SYMBOL_INTERNAL_H
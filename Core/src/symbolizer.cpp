@@ -0,0 +1,775 @@
+#include "symbolizer.h"
+#include "symbol_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+// Cache file layout (native endianness; the file is only read on the host
+// that wrote it):
+//   SymbolCacheHeader
+//   uint64_t keys[symbol_count + 1]   symbol starts in Eytzinger order, slot 0 unused
+//   uint32_t ranks[symbol_count + 1]  Eytzinger slot -> position in records
+//   SymbolRecord records[symbol_count] sorted by start
+//   char strings[string_size]         interned, NUL-terminated names
+#define SYMBOL_CACHE_MAGIC "SAPSYMS"
+#define SYMBOL_CACHE_VERSION 1
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t symbol_count;
+    uint64_t string_size;
+    uint64_t keys_offset;
+    uint64_t ranks_offset;
+    uint64_t records_offset;
+    uint64_t strings_offset;
+    uint64_t total_size;
+    uint32_t build_id_size;
+    uint32_t reserved;
+    uint8_t build_id[SYMBOL_BUILD_ID_MAX];
+} SymbolCacheHeader;
+
+typedef struct
+{
+    uint64_t start; // Relative to the module base
+    uint32_t size;
+    uint32_t name; // Offset into strings
+} SymbolRecord;
+
+static_assert(sizeof(SymbolCacheHeader) % 8 == 0, "cache sections must stay 8-byte aligned");
+
+// A module's index, backed by a cache file mapping or a heap blob
+typedef struct
+{
+    const uint64_t *keys;
+    const uint32_t *ranks;
+    const SymbolRecord *records;
+    const char *strings;
+    uint32_t count;
+    uint64_t string_size;
+    void *blob;
+    size_t blob_size;
+    bool mapped;
+} SymbolIndex;
+
+typedef enum
+{
+    SYMBOL_MODULE_PENDING, // Not needed yet
+    SYMBOL_MODULE_READY,
+    SYMBOL_MODULE_FAILED // No symbols; not retried until it is reloaded
+} SymbolModuleState;
+
+// One loaded module and (once an address in it was resolved) its index
+typedef struct
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t base;
+    char *path;
+    SymbolModuleState state;
+    SymbolIndex index;
+} SymbolModule;
+
+struct Symbolizer
+{
+    task_t task;
+    char cache_dir[PATH_MAX]; // Empty when caching is off
+    SymbolModule *modules;    // Sorted by start
+    uint32_t module_count;
+    uint32_t cache_hits;
+    uint32_t modules_parsed;
+};
+
+// Searches run in lockstep over this many addresses so their cache misses overlap
+#define RESOLVE_LANES 16
+
+// Longest cache file path: directory, hex build ID, suffix
+#define CACHE_PATH_MAX (PATH_MAX + 2 * SYMBOL_BUILD_ID_MAX + 8)
+
+#define INITIAL_SYMBOL_CAPACITY 1024
+#define INITIAL_STRING_CAPACITY (16 * 1024)
+#define INITIAL_STRING_INDEX_SIZE 1024
+
+// Helper: FNV-1a over a name
+static inline uint32_t hash_name(const char *name, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Helper: Double the string index and re-insert every name
+static bool grow_string_index(SymbolBuilder *builder)
+{
+    uint32_t new_size = builder->string_index ? (builder->string_mask + 1) * 2 : INITIAL_STRING_INDEX_SIZE;
+    uint32_t *index = (uint32_t *)calloc(new_size, sizeof(uint32_t));
+    if (!index)
+        return false;
+
+    uint32_t mask = new_size - 1;
+    if (builder->string_index)
+    {
+        for (uint32_t i = 0; i <= builder->string_mask; i++)
+        {
+            uint32_t entry = builder->string_index[i];
+            if (entry == 0)
+                continue;
+
+            const char *name = builder->strings + entry - 1;
+            uint32_t slot = hash_name(name, strlen(name)) & mask;
+            while (index[slot] != 0)
+                slot = (slot + 1) & mask;
+            index[slot] = entry;
+        }
+    }
+
+    free(builder->string_index);
+    builder->string_index = index;
+    builder->string_mask = mask;
+    return true;
+}
+
+// Helper: Pool offset of a name, adding it if it is new
+static bool intern_name(SymbolBuilder *builder, const char *name, size_t length, uint32_t *offset)
+{
+    if (!builder->string_index || (builder->string_count + 1) * 2 > builder->string_mask + 1)
+    {
+        if (!grow_string_index(builder))
+            return false;
+    }
+
+    uint32_t slot = hash_name(name, length) & builder->string_mask;
+    while (builder->string_index[slot] != 0)
+    {
+        const char *existing = builder->strings + builder->string_index[slot] - 1;
+        if (strncmp(existing, name, length) == 0 && existing[length] == '\0')
+        {
+            *offset = builder->string_index[slot] - 1;
+            return true;
+        }
+        slot = (slot + 1) & builder->string_mask;
+    }
+
+    if (builder->string_size + length + 1 > UINT32_MAX - 1)
+        return false;
+
+    if (builder->string_size + length + 1 > builder->string_capacity)
+    {
+        size_t capacity = builder->string_capacity ? builder->string_capacity : INITIAL_STRING_CAPACITY;
+        while (capacity < builder->string_size + length + 1)
+            capacity *= 2;
+        char *strings = (char *)realloc(builder->strings, capacity);
+        if (!strings)
+            return false;
+        builder->strings = strings;
+        builder->string_capacity = capacity;
+    }
+
+    *offset = (uint32_t)builder->string_size;
+    memcpy(builder->strings + builder->string_size, name, length);
+    builder->strings[builder->string_size + length] = '\0';
+    builder->string_size += length + 1;
+
+    builder->string_index[slot] = *offset + 1;
+    builder->string_count++;
+    return true;
+}
+
+bool symbol_builder_add(
+    SymbolBuilder *builder,
+    uint64_t start,
+    uint64_t size,
+    const char *name,
+    size_t name_length)
+{
+    if (builder->count == builder->capacity)
+    {
+        size_t capacity = builder->capacity ? builder->capacity * 2 : INITIAL_SYMBOL_CAPACITY;
+        SymbolEntry *symbols = (SymbolEntry *)realloc(builder->symbols, capacity * sizeof(SymbolEntry));
+        if (!symbols)
+            return false;
+        builder->symbols = symbols;
+        builder->capacity = capacity;
+    }
+
+    uint32_t offset;
+    if (!intern_name(builder, name, name_length, &offset))
+        return false;
+
+    SymbolEntry *entry = &builder->symbols[builder->count++];
+    entry->start = start;
+    entry->size = size;
+    entry->name = offset;
+    return true;
+}
+
+void symbol_builder_free(SymbolBuilder *builder)
+{
+    free(builder->symbols);
+    free(builder->strings);
+    free(builder->string_index);
+    memset(builder, 0, sizeof(*builder));
+}
+
+// Helper: Lay out the sorted records in Eytzinger order (in-order walk of the implicit tree)
+static void fill_eytzinger(
+    uint64_t *keys,
+    uint32_t *ranks,
+    const SymbolRecord *records,
+    uint32_t count,
+    uint32_t *next,
+    uint32_t slot)
+{
+    if (slot > count)
+        return;
+
+    fill_eytzinger(keys, ranks, records, count, next, 2 * slot);
+    keys[slot] = records[*next].start;
+    ranks[slot] = *next;
+    (*next)++;
+    fill_eytzinger(keys, ranks, records, count, next, 2 * slot + 1);
+}
+
+static inline uint64_t align8(uint64_t value)
+{
+    return (value + 7) & ~7ULL;
+}
+
+// Helper: Point an index at the sections of a cache blob; false if the blob is malformed
+static bool bind_index(SymbolIndex *index, void *blob, size_t blob_size)
+{
+    const SymbolCacheHeader *header = (const SymbolCacheHeader *)blob;
+    if (blob_size < sizeof(*header) ||
+        memcmp(header->magic, SYMBOL_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SYMBOL_CACHE_VERSION ||
+        header->total_size != blob_size)
+        return false;
+
+    uint64_t count = header->symbol_count;
+    if (header->keys_offset + (count + 1) * sizeof(uint64_t) > blob_size ||
+        header->ranks_offset + (count + 1) * sizeof(uint32_t) > blob_size ||
+        header->records_offset + count * sizeof(SymbolRecord) > blob_size ||
+        header->strings_offset + header->string_size > blob_size ||
+        header->string_size == 0)
+        return false;
+
+    const uint8_t *bytes = (const uint8_t *)blob;
+    index->keys = (const uint64_t *)(bytes + header->keys_offset);
+    index->ranks = (const uint32_t *)(bytes + header->ranks_offset);
+    index->records = (const SymbolRecord *)(bytes + header->records_offset);
+    index->strings = (const char *)(bytes + header->strings_offset);
+    index->count = header->symbol_count;
+    index->string_size = header->string_size;
+    index->blob = blob;
+    index->blob_size = blob_size;
+
+    // Every name is NUL-terminated as long as the pool is
+    return index->strings[index->string_size - 1] == '\0';
+}
+
+// Helper: Build the cache blob for a module from its parsed symbols
+static void *build_blob(
+    SymbolBuilder *builder,
+    uint64_t text_end,
+    const uint8_t *build_id,
+    size_t build_id_size,
+    size_t *blob_size)
+{
+    // Sort by start, sized symbols first, and keep one symbol per address
+    std::sort(
+        builder->symbols, builder->symbols + builder->count,
+        [](const SymbolEntry &a, const SymbolEntry &b)
+        {
+            if (a.start != b.start)
+                return a.start < b.start;
+            return a.size > b.size;
+        });
+
+    size_t count = 0;
+    for (size_t i = 0; i < builder->count; i++)
+    {
+        if (count == 0 || builder->symbols[count - 1].start != builder->symbols[i].start)
+            builder->symbols[count++] = builder->symbols[i];
+    }
+    if (count == 0 || count >= UINT32_MAX || builder->string_size == 0)
+        return NULL;
+
+    SymbolCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SYMBOL_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SYMBOL_CACHE_VERSION;
+    header.symbol_count = (uint32_t)count;
+    header.string_size = builder->string_size;
+    header.keys_offset = sizeof(header);
+    header.ranks_offset = header.keys_offset + (count + 1) * sizeof(uint64_t);
+    header.records_offset = align8(header.ranks_offset + (count + 1) * sizeof(uint32_t));
+    header.strings_offset = header.records_offset + count * sizeof(SymbolRecord);
+    header.total_size = header.strings_offset + builder->string_size;
+    header.build_id_size = (uint32_t)build_id_size;
+    memcpy(header.build_id, build_id, build_id_size);
+
+    uint8_t *blob = (uint8_t *)calloc(1, header.total_size);
+    if (!blob)
+        return NULL;
+
+    memcpy(blob, &header, sizeof(header));
+    uint64_t *keys = (uint64_t *)(blob + header.keys_offset);
+    uint32_t *ranks = (uint32_t *)(blob + header.ranks_offset);
+    SymbolRecord *records = (SymbolRecord *)(blob + header.records_offset);
+    memcpy(blob + header.strings_offset, builder->strings, builder->string_size);
+
+    // Symbols without a recorded size (Mach-O, hand-written assembly)
+    // extend to the next symbol, or to the end of the module's code
+    for (size_t i = 0; i < count; i++)
+    {
+        const SymbolEntry *entry = &builder->symbols[i];
+        uint64_t size = entry->size;
+        if (size == 0)
+        {
+            uint64_t end = i + 1 < count ? builder->symbols[i + 1].start : text_end;
+            size = end > entry->start ? end - entry->start : 0;
+        }
+
+        records[i].start = entry->start;
+        records[i].size = size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+        records[i].name = entry->name;
+    }
+
+    uint32_t next = 0;
+    fill_eytzinger(keys, ranks, records, (uint32_t)count, &next, 1);
+
+    *blob_size = header.total_size;
+    return blob;
+}
+
+// Helper: Create a directory and its parents
+static bool make_directories(const char *path)
+{
+    char partial[PATH_MAX];
+    size_t length = strlen(path);
+    if (length == 0 || length >= sizeof(partial))
+        return false;
+
+    memcpy(partial, path, length + 1);
+    for (size_t i = 1; i <= length; i++)
+    {
+        if (partial[i] != '/' && partial[i] != '\0')
+            continue;
+
+        char saved = partial[i];
+        partial[i] = '\0';
+        if (mkdir(partial, 0755) != 0 && errno != EEXIST)
+            return false;
+        partial[i] = saved;
+    }
+    return true;
+}
+
+// Helper: Default cache directory (the environment override, then the
+// platform's per-user cache location)
+static void default_cache_dir(char *path, size_t size)
+{
+    path[0] = '\0';
+
+    const char *override_dir = getenv(SYMBOLIZER_CACHE_ENV);
+    if (override_dir)
+    {
+        snprintf(path, size, "%s", override_dir);
+        return;
+    }
+
+    const char *home = getenv("HOME");
+#if defined(PLATFORM_MACH)
+    if (home && home[0])
+        snprintf(path, size, "%s/Library/Caches/SwiftAsyncProfiler/symbols", home);
+#else
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && xdg[0])
+        snprintf(path, size, "%s/swift-async-profiler/symbols", xdg);
+    else if (home && home[0])
+        snprintf(path, size, "%s/.cache/swift-async-profiler/symbols", home);
+#endif
+}
+
+// Helper: Cache file path for a build ID
+static void cache_file_path(
+    const Symbolizer *symbolizer,
+    const uint8_t *build_id,
+    size_t build_id_size,
+    char *path,
+    size_t size)
+{
+    int length = snprintf(path, size, "%s/", symbolizer->cache_dir);
+    for (size_t i = 0; i < build_id_size && length > 0 && (size_t)length < size; i++)
+    {
+        length += snprintf(path + length, size - length, "%02x", build_id[i]);
+    }
+    if (length > 0 && (size_t)length < size)
+        snprintf(path + length, size - length, ".sym");
+}
+
+// Helper: Map a cache file; false if it is missing, stale or malformed
+static bool map_cache_file(
+    const char *path,
+    const uint8_t *build_id,
+    size_t build_id_size,
+    SymbolIndex *index)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SymbolCacheHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)info.st_size;
+    void *blob = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (blob == MAP_FAILED)
+        return false;
+
+    const SymbolCacheHeader *header = (const SymbolCacheHeader *)blob;
+    if (!bind_index(index, blob, size) ||
+        header->build_id_size != build_id_size ||
+        memcmp(header->build_id, build_id, build_id_size) != 0)
+    {
+        munmap(blob, size);
+        memset(index, 0, sizeof(*index));
+        return false;
+    }
+
+    index->mapped = true;
+    return true;
+}
+
+// Helper: Write a cache file atomically (readers never see a partial file)
+static void write_cache_file(const Symbolizer *symbolizer, const char *path, const void *blob, size_t size)
+{
+    if (!make_directories(symbolizer->cache_dir))
+        return;
+
+    char temporary[CACHE_PATH_MAX + 32];
+    snprintf(temporary, sizeof(temporary), "%s.%d.tmp", path, (int)getpid());
+
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return;
+
+    const uint8_t *bytes = (const uint8_t *)blob;
+    size_t written = 0;
+    while (written < size)
+    {
+        ssize_t result = write(fd, bytes + written, size - written);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            break;
+        written += (size_t)result;
+    }
+    close(fd);
+
+    if (written != size || rename(temporary, path) != 0)
+        unlink(temporary);
+}
+
+// Helper: Load a module's index from the cache, or parse the module and cache it
+static void load_module(Symbolizer *symbolizer, SymbolModule *module)
+{
+    module->state = SYMBOL_MODULE_FAILED;
+
+    PlatformModule loaded = {module->base, module->start, module->end, module->path};
+    uint8_t build_id[SYMBOL_BUILD_ID_MAX];
+    size_t build_id_size = symbol_read_build_id(symbolizer->task, &loaded, build_id);
+
+    // Without a build ID there is nothing safe to key the cache by
+    bool cacheable = build_id_size > 0 && symbolizer->cache_dir[0] != '\0';
+    char path[CACHE_PATH_MAX];
+    if (cacheable)
+    {
+        cache_file_path(symbolizer, build_id, build_id_size, path, sizeof(path));
+        if (map_cache_file(path, build_id, build_id_size, &module->index))
+        {
+            module->state = SYMBOL_MODULE_READY;
+            symbolizer->cache_hits++;
+            return;
+        }
+    }
+
+    SymbolBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    if (symbol_load_module(symbolizer->task, &loaded, &builder) != 0)
+    {
+        symbol_builder_free(&builder);
+        return;
+    }
+
+    size_t blob_size = 0;
+    void *blob = build_blob(&builder, module->end - module->base, build_id, build_id_size, &blob_size);
+    symbol_builder_free(&builder);
+    if (!blob)
+        return;
+
+    if (!bind_index(&module->index, blob, blob_size))
+    {
+        free(blob);
+        memset(&module->index, 0, sizeof(module->index));
+        return;
+    }
+
+    module->state = SYMBOL_MODULE_READY;
+    symbolizer->modules_parsed++;
+    if (cacheable)
+        write_cache_file(symbolizer, path, blob, blob_size);
+}
+
+static void free_module(SymbolModule *module)
+{
+    SymbolIndex *index = &module->index;
+    if (index->blob)
+    {
+        if (index->mapped)
+            munmap(index->blob, index->blob_size);
+        else
+            free(index->blob);
+    }
+    memset(index, 0, sizeof(*index));
+    free(module->path);
+    module->path = NULL;
+}
+
+// Helper: Find a module by start address (modules are sorted by start)
+static SymbolModule *find_module_by_start(SymbolModule *modules, uint32_t count, uint64_t start)
+{
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (modules[mid].start < start)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return (low < count && modules[low].start == start) ? &modules[low] : NULL;
+}
+
+// Helper: Module containing an address, or NULL
+static SymbolModule *find_module(const Symbolizer *symbolizer, uint64_t address)
+{
+    uint32_t low = 0;
+    uint32_t high = symbolizer->module_count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (symbolizer->modules[mid].start <= address)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == 0)
+        return NULL;
+
+    SymbolModule *module = &symbolizer->modules[low - 1];
+    return address < module->end ? module : NULL;
+}
+
+Symbolizer *symbolizer_create(task_t task, const char *cache_dir)
+{
+    Symbolizer *symbolizer = (Symbolizer *)calloc(1, sizeof(Symbolizer));
+    if (!symbolizer)
+        return NULL;
+
+    symbolizer->task = task;
+    if (cache_dir)
+        snprintf(symbolizer->cache_dir, sizeof(symbolizer->cache_dir), "%s", cache_dir);
+    else
+        default_cache_dir(symbolizer->cache_dir, sizeof(symbolizer->cache_dir));
+
+    int kr = symbolizer_refresh(symbolizer);
+    if (kr != 0)
+    {
+        fprintf(stderr, "Warning: could not list modules for symbolization: %d\n", kr);
+    }
+    return symbolizer;
+}
+
+int symbolizer_refresh(Symbolizer *symbolizer)
+{
+    PlatformModule *list = NULL;
+    uint32_t count = 0;
+    int kr = platform_task_modules(symbolizer->task, &list, &count);
+    if (kr != 0)
+        return kr;
+
+    SymbolModule *modules = (SymbolModule *)calloc(count ? count : 1, sizeof(SymbolModule));
+    if (!modules)
+    {
+        platform_module_list_release(list, count);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const PlatformModule *loaded = &list[i];
+        SymbolModule *module = &modules[i];
+
+        // Keep the index of modules that are still loaded
+        SymbolModule *previous = find_module_by_start(symbolizer->modules, symbolizer->module_count, loaded->start);
+        if (previous && previous->path && previous->end == loaded->end &&
+            previous->base == loaded->base && strcmp(previous->path, loaded->path) == 0)
+        {
+            *module = *previous;
+            memset(&previous->index, 0, sizeof(previous->index));
+            previous->path = NULL;
+            continue;
+        }
+
+        module->start = loaded->start;
+        module->end = loaded->end;
+        module->base = loaded->base;
+        module->path = strdup(loaded->path);
+        module->state = module->path ? SYMBOL_MODULE_PENDING : SYMBOL_MODULE_FAILED;
+    }
+
+    for (uint32_t i = 0; i < symbolizer->module_count; i++)
+    {
+        free_module(&symbolizer->modules[i]);
+    }
+    free(symbolizer->modules);
+
+    symbolizer->modules = modules;
+    symbolizer->module_count = count;
+    platform_module_list_release(list, count);
+    return 0;
+}
+
+void symbolizer_destroy(Symbolizer *symbolizer)
+{
+    if (!symbolizer)
+        return;
+
+    for (uint32_t i = 0; i < symbolizer->module_count; i++)
+    {
+        free_module(&symbolizer->modules[i]);
+    }
+    free(symbolizer->modules);
+    free(symbolizer);
+}
+
+uint32_t symbolizer_resolve(
+    Symbolizer *symbolizer,
+    const uint64_t *addresses,
+    uint32_t count,
+    SymbolInfo *symbols)
+{
+    uint32_t resolved = 0;
+    SymbolModule *last = NULL;
+
+    for (uint32_t first = 0; first < count; first += RESOLVE_LANES)
+    {
+        uint32_t lanes = count - first < RESOLVE_LANES ? count - first : RESOLVE_LANES;
+        const SymbolIndex *indexes[RESOLVE_LANES];
+        uint64_t keys[RESOLVE_LANES];
+        uint32_t slots[RESOLVE_LANES];
+
+        // Find each address's module (stacks mostly stay in one or two, so
+        // try the previous one first) and load its index on first use
+        for (uint32_t lane = 0; lane < lanes; lane++)
+        {
+            uint64_t address = addresses[first + lane];
+            SymbolInfo *info = &symbols[first + lane];
+            memset(info, 0, sizeof(*info));
+            indexes[lane] = NULL;
+            slots[lane] = 1;
+
+            SymbolModule *module = (last && address >= last->start && address < last->end)
+                                       ? last
+                                       : find_module(symbolizer, address);
+            if (!module)
+                continue;
+
+            last = module;
+            info->module = module->path;
+            info->module_base = module->base;
+
+            if (module->state == SYMBOL_MODULE_PENDING)
+                load_module(symbolizer, module);
+            if (module->state == SYMBOL_MODULE_READY)
+            {
+                indexes[lane] = &module->index;
+                keys[lane] = address - module->base;
+            }
+        }
+
+        // Descend every lane's tree one level per pass. In Eytzinger order
+        // the 8 descendants three levels down share a cache line, so it is
+        // prefetched while the other lanes take their steps.
+        bool active = true;
+        while (active)
+        {
+            active = false;
+            for (uint32_t lane = 0; lane < lanes; lane++)
+            {
+                const SymbolIndex *index = indexes[lane];
+                uint32_t slot = slots[lane];
+                if (!index || slot > index->count)
+                    continue;
+
+                __builtin_prefetch(index->keys + 8 * (uint64_t)slot);
+                slots[lane] = 2 * slot + (index->keys[slot] <= keys[lane]);
+                active = true;
+            }
+        }
+
+        for (uint32_t lane = 0; lane < lanes; lane++)
+        {
+            const SymbolIndex *index = indexes[lane];
+            if (!index)
+                continue;
+
+            // Undo the trailing right turns to reach the first key above
+            // the address (slot 0: none); the symbol is the one before it
+            uint32_t slot = slots[lane] >> __builtin_ffs(~slots[lane]);
+            uint32_t rank = slot == 0 ? index->count : index->ranks[slot];
+            if (rank == 0)
+                continue;
+
+            const SymbolRecord *record = &index->records[rank - 1];
+            if (keys[lane] - record->start >= record->size || record->name >= index->string_size)
+                continue;
+
+            SymbolInfo *info = &symbols[first + lane];
+            info->name = index->strings + record->name;
+            info->symbol_address = info->module_base + record->start;
+            resolved++;
+        }
+    }
+
+    return resolved;
+}
+
+uint32_t symbolizer_cache_hits(const Symbolizer *symbolizer)
+{
+    return symbolizer->cache_hits;
+}
+
+uint32_t symbolizer_modules_parsed(const Symbolizer *symbolizer)
+{
+    return symbolizer->modules_parsed;
+}
@@ -0,0 +1,117 @@
+#include "symbol_internal.h"
+
+#if defined(PLATFORM_LINUX)
+
+#include "elf_image.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+size_t symbol_read_build_id(
+    task_t task,
+    const PlatformModule *module,
+    uint8_t *id)
+{
+    ElfImage image;
+    if (elf_image_open(task, module->path, &image) != 0)
+        return 0;
+
+    size_t size = elf_image_build_id(&image, id, SYMBOL_BUILD_ID_MAX);
+    elf_image_close(&image);
+    return size;
+}
+
+// Helper: Add the function symbols of one symbol table
+static void add_symbols(
+    const ElfImage *image,
+    const Elf64_Shdr *table,
+    uint64_t link_base,
+    SymbolBuilder *out)
+{
+    if (table->sh_entsize != sizeof(Elf64_Sym) || table->sh_link >= image->ehdr->e_shnum)
+        return;
+
+    const Elf64_Shdr *names = &image->shdrs[table->sh_link];
+    if (names->sh_offset > image->size || names->sh_size > image->size - names->sh_offset)
+        return;
+
+    const Elf64_Sym *symbols = (const Elf64_Sym *)(image->data + table->sh_offset);
+    const char *strings = (const char *)image->data + names->sh_offset;
+    size_t count = table->sh_size / sizeof(Elf64_Sym);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const Elf64_Sym *symbol = &symbols[i];
+        unsigned type = ELF64_ST_TYPE(symbol->st_info);
+        if ((type != STT_FUNC && type != STT_GNU_IFUNC) ||
+            symbol->st_shndx == SHN_UNDEF ||
+            symbol->st_value < link_base ||
+            symbol->st_name == 0 || symbol->st_name >= names->sh_size)
+            continue;
+
+        const char *name = strings + symbol->st_name;
+        size_t length = strnlen(name, names->sh_size - symbol->st_name);
+        if (!symbol_builder_add(out, symbol->st_value - link_base, symbol->st_size, name, length))
+            return;
+    }
+}
+
+// Helper: Open the separate debug file installed for a build ID, if any
+static int open_debug_file(task_t task, const uint8_t *id, size_t id_size, ElfImage *image)
+{
+    char path[64 + 2 * SYMBOL_BUILD_ID_MAX];
+    int length = snprintf(path, sizeof(path), "/usr/lib/debug/.build-id/%02x/", id[0]);
+    for (size_t i = 1; i < id_size; i++)
+    {
+        length += snprintf(path + length, sizeof(path) - length, "%02x", id[i]);
+    }
+    snprintf(path + length, sizeof(path) - length, ".debug");
+
+    return elf_image_open(task, path, image);
+}
+
+int symbol_load_module(
+    task_t task,
+    const PlatformModule *module,
+    SymbolBuilder *out)
+{
+    ElfImage image;
+    int result = elf_image_open(task, module->path, &image);
+    if (result != 0)
+        return result;
+
+    // .dynsym only has exported functions; .symtab (if not stripped, or in
+    // the debug file) has the rest. Duplicates are dropped when the index
+    // is built.
+    const Elf64_Shdr *dynsym = elf_image_section(&image, ".dynsym", SHT_DYNSYM);
+    const Elf64_Shdr *symtab = elf_image_section(&image, ".symtab", SHT_SYMTAB);
+
+    if (dynsym)
+        add_symbols(&image, dynsym, image.link_base, out);
+
+    if (symtab)
+    {
+        add_symbols(&image, symtab, image.link_base, out);
+    }
+    else
+    {
+        uint8_t id[SYMBOL_BUILD_ID_MAX];
+        size_t id_size = elf_image_build_id(&image, id, sizeof(id));
+
+        ElfImage debug;
+        if (id_size > 0 && open_debug_file(task, id, id_size, &debug) == 0)
+        {
+            // Debug files keep the program headers, so addresses line up
+            symtab = elf_image_section(&debug, ".symtab", SHT_SYMTAB);
+            if (symtab)
+                add_symbols(&debug, symtab, image.link_base, out);
+            elf_image_close(&debug);
+        }
+    }
+
+    result = (dynsym || symtab) ? 0 : ENOENT;
+    elf_image_close(&image);
+    return result;
+}
+
+#endif // PLATFORM_LINUX
@@ -0,0 +1,182 @@
+#include "symbol_internal.h"
+
+#if defined(PLATFORM_MACH)
+
+#include <stdlib.h>
+#include <string.h>
+#include <mach/mach.h>
+#include <mach-o/loader.h>
+#include <mach-o/nlist.h>
+
+// Load commands of an image, copied out of the target
+typedef struct
+{
+    struct mach_header_64 header;
+    uint8_t *commands;
+} MachImage;
+
+// Helper: Copy the header and load commands of the image at base
+static int read_image(task_t task, uint64_t base, MachImage *image)
+{
+    image->commands = NULL;
+
+    int kr = platform_read_memory(task, base, &image->header, sizeof(image->header));
+    if (kr != 0)
+        return kr;
+    if (image->header.magic != MH_MAGIC_64)
+        return KERN_INVALID_ARGUMENT;
+
+    image->commands = (uint8_t *)malloc(image->header.sizeofcmds);
+    if (!image->commands)
+        return KERN_RESOURCE_SHORTAGE;
+
+    kr = platform_read_memory(task, base + sizeof(image->header),
+                              image->commands, image->header.sizeofcmds);
+    if (kr != 0)
+    {
+        free(image->commands);
+        image->commands = NULL;
+    }
+    return kr;
+}
+
+// Helper: Find the first load command of a type (and segment name, for segments)
+static const struct load_command *find_command(
+    const MachImage *image,
+    uint32_t cmd,
+    const char *segment_name)
+{
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < image->header.ncmds &&
+                         offset + sizeof(struct load_command) <= image->header.sizeofcmds;
+         i++)
+    {
+        const struct load_command *command = (const struct load_command *)(image->commands + offset);
+        if (command->cmdsize == 0 || offset + command->cmdsize > image->header.sizeofcmds)
+            break;
+
+        if (command->cmd == cmd)
+        {
+            if (!segment_name)
+                return command;
+
+            const struct segment_command_64 *segment = (const struct segment_command_64 *)command;
+            if (strncmp(segment->segname, segment_name, sizeof(segment->segname)) == 0)
+                return command;
+        }
+        offset += command->cmdsize;
+    }
+    return NULL;
+}
+
+size_t symbol_read_build_id(
+    task_t task,
+    const PlatformModule *module,
+    uint8_t *id)
+{
+    MachImage image;
+    if (read_image(task, module->base, &image) != 0)
+        return 0;
+
+    size_t size = 0;
+    const struct uuid_command *uuid = (const struct uuid_command *)find_command(&image, LC_UUID, NULL);
+    if (uuid && uuid->cmdsize >= sizeof(*uuid))
+    {
+        memcpy(id, uuid->uuid, sizeof(uuid->uuid));
+        size = sizeof(uuid->uuid);
+    }
+
+    free(image.commands);
+    return size;
+}
+
+// Helper: Copy a range of __LINKEDIT out of the target
+static void *read_linkedit(task_t task, uint64_t address, uint64_t size)
+{
+    if (size == 0 || size > 256 * 1024 * 1024)
+        return NULL;
+
+    void *data = malloc(size);
+    if (data && platform_read_memory(task, address, data, size) != 0)
+    {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+int symbol_load_module(
+    task_t task,
+    const PlatformModule *module,
+    SymbolBuilder *out)
+{
+    MachImage image;
+    int kr = read_image(task, module->base, &image);
+    if (kr != 0)
+        return kr;
+
+    const struct segment_command_64 *text =
+        (const struct segment_command_64 *)find_command(&image, LC_SEGMENT_64, SEG_TEXT);
+    const struct segment_command_64 *linkedit =
+        (const struct segment_command_64 *)find_command(&image, LC_SEGMENT_64, SEG_LINKEDIT);
+    const struct symtab_command *symtab =
+        (const struct symtab_command *)find_command(&image, LC_SYMTAB, NULL);
+
+    if (!text || !linkedit || !symtab || symtab->nsyms == 0 ||
+        symtab->symoff < linkedit->fileoff || symtab->stroff < linkedit->fileoff)
+    {
+        free(image.commands);
+        return KERN_INVALID_ARGUMENT;
+    }
+
+    // __LINKEDIT is mapped (slid) like every other segment; for images in
+    // the shared cache the string table is shared by the whole cache
+    int64_t slide = (int64_t)(module->base - text->vmaddr);
+    uint64_t linkedit_address = linkedit->vmaddr + slide;
+    uint64_t text_start = text->vmaddr;
+    uint64_t text_end = text->vmaddr + text->vmsize;
+
+    const struct nlist_64 *symbols = (const struct nlist_64 *)read_linkedit(
+        task, linkedit_address + (symtab->symoff - linkedit->fileoff),
+        (uint64_t)symtab->nsyms * sizeof(struct nlist_64));
+    const char *strings = (const char *)read_linkedit(
+        task, linkedit_address + (symtab->stroff - linkedit->fileoff), symtab->strsize);
+    uint32_t count = symtab->nsyms;
+    uint32_t strings_size = symtab->strsize;
+    free(image.commands);
+
+    if (!symbols || !strings)
+    {
+        free((void *)symbols);
+        free((void *)strings);
+        return KERN_RESOURCE_SHORTAGE;
+    }
+
+    // nlist has no sizes; the index ends each symbol at the next one
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const struct nlist_64 *symbol = &symbols[i];
+        if ((symbol->n_type & N_STAB) != 0 || (symbol->n_type & N_TYPE) != N_SECT ||
+            symbol->n_value < text_start || symbol->n_value >= text_end ||
+            symbol->n_un.n_strx == 0 || symbol->n_un.n_strx >= strings_size)
+            continue;
+
+        // C and Swift symbols carry a leading underscore in the symbol table
+        const char *name = strings + symbol->n_un.n_strx;
+        size_t length = strnlen(name, strings_size - symbol->n_un.n_strx);
+        if (length > 1 && name[0] == '_')
+        {
+            name++;
+            length--;
+        }
+
+        if (!symbol_builder_add(out, symbol->n_value - text_start, 0, name, length))
+            break;
+    }
+
+    free((void *)symbols);
+    free((void *)strings);
+    return 0;
+}
+
+#endif // PLATFORM_MACH
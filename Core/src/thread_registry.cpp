@@ -0,0 +1,220 @@
+#include "thread_registry.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+struct ThreadRegistry
+{
+    task_t task;
+    thread_t *threads;     // Live handles, parallel to records
+    ThreadRecord *records;
+    ThreadSampleState *sample_states; // Parallel to records
+    uint32_t count;
+    uint32_t next_number;  // Number of the next new thread
+};
+
+// Helper: Get current time in nanoseconds (same clock as StackTrace)
+static uint64_t get_timestamp_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Helper: Whether a sorted handle array contains thread
+static bool contains(const thread_t *sorted, uint32_t count, thread_t thread)
+{
+    return std::binary_search(sorted, sorted + count, thread);
+}
+
+// Helper: Report one event
+static void emit(
+    ThreadEventCallback callback,
+    void *context,
+    ThreadEventType type,
+    const ThreadRecord *record,
+    uint64_t now)
+{
+    if (!callback)
+        return;
+
+    ThreadEvent event;
+    event.type = type;
+    event.thread_number = record->thread_number;
+    event.thread_id = record->thread_id;
+    event.timestamp_ns = now;
+    callback(&event, context);
+}
+
+// Helper: State of a thread the sampler has not seen
+static void reset_sample_state(ThreadSampleState *state)
+{
+    memset(state, 0, sizeof(*state));
+    state->cpu_time_ns = THREAD_REGISTRY_NO_CPU_TIME;
+}
+
+ThreadRegistry *thread_registry_create(task_t task)
+{
+    ThreadRegistry *registry = (ThreadRegistry *)calloc(1, sizeof(ThreadRegistry));
+    if (!registry)
+        return NULL;
+
+    registry->task = task;
+    registry->next_number = 1;
+    return registry;
+}
+
+void thread_registry_destroy(ThreadRegistry *registry)
+{
+    if (!registry)
+        return;
+
+    for (uint32_t i = 0; i < registry->count; i++)
+    {
+        platform_thread_release(registry->threads[i]);
+    }
+    free(registry->threads);
+    free(registry->records);
+    free(registry->sample_states);
+    free(registry);
+}
+
+int thread_registry_refresh(
+    ThreadRegistry *registry,
+    ThreadEventCallback callback,
+    void *context)
+{
+    thread_act_array_t list = NULL;
+    mach_msg_type_number_t list_count = 0;
+    int kr = platform_task_threads(registry->task, &list, &list_count);
+    if (kr != 0)
+        return kr;
+
+    // Sorted copies of both lists answer "still there?" / "seen before?"
+    size_t slots = (size_t)list_count + registry->count + 1;
+    thread_t *sorted_new = (thread_t *)malloc(slots * sizeof(thread_t));
+    thread_t *threads = (thread_t *)malloc((list_count + 1) * sizeof(thread_t));
+    ThreadRecord *records = (ThreadRecord *)malloc((list_count + 1) * sizeof(ThreadRecord));
+    ThreadSampleState *sample_states = (ThreadSampleState *)malloc((list_count + 1) * sizeof(ThreadSampleState));
+    if (!sorted_new || !threads || !records || !sample_states)
+    {
+        free(sorted_new);
+        free(threads);
+        free(records);
+        free(sample_states);
+        platform_thread_list_release(list, list_count);
+        return -1;
+    }
+    thread_t *sorted_old = sorted_new + list_count;
+
+    memcpy(sorted_new, list, list_count * sizeof(thread_t));
+    std::sort(sorted_new, sorted_new + list_count);
+    memcpy(sorted_old, registry->threads, registry->count * sizeof(thread_t));
+    std::sort(sorted_old, sorted_old + registry->count);
+
+    uint64_t now = get_timestamp_ns();
+    uint32_t count = 0;
+
+    // Survivors keep their handle, record and relative order
+    for (uint32_t i = 0; i < registry->count; i++)
+    {
+        const ThreadRecord *record = &registry->records[i];
+        if (contains(sorted_new, list_count, record->thread))
+        {
+            threads[count] = record->thread;
+            records[count] = *record;
+            sample_states[count] = registry->sample_states[i];
+            count++;
+        }
+        else
+        {
+            emit(callback, context, THREAD_EVENT_EXITED, record, now);
+            platform_thread_release(record->thread);
+        }
+    }
+
+    // New threads go at the end, in the order the platform listed them
+    for (mach_msg_type_number_t i = 0; i < list_count; i++)
+    {
+        thread_t thread = list[i];
+        if (contains(sorted_old, registry->count, thread))
+            continue;
+
+        // A thread that exits right now is simply not picked up
+        if (platform_thread_retain(thread) != 0)
+            continue;
+
+        PlatformThreadMetadata metadata;
+        if (platform_thread_get_metadata(registry->task, thread, &metadata) != 0)
+            metadata.thread_id = thread;
+
+        ThreadRecord *record = &records[count];
+        record->thread = thread;
+        record->thread_number = registry->next_number++;
+        record->thread_id = metadata.thread_id;
+        record->created_ns = now;
+        record->qos = metadata.qos;
+        record->priority = metadata.priority;
+        memcpy(record->name, metadata.name, sizeof(record->name));
+        memcpy(record->queue_label, metadata.queue_label, sizeof(record->queue_label));
+        threads[count] = thread;
+        reset_sample_state(&sample_states[count]);
+        count++;
+
+        emit(callback, context, THREAD_EVENT_CREATED, record, now);
+    }
+
+    // The registry holds its own reference to every thread it keeps
+    platform_thread_list_release(list, list_count);
+    free(sorted_new);
+
+    free(registry->threads);
+    free(registry->records);
+    free(registry->sample_states);
+    registry->threads = threads;
+    registry->records = records;
+    registry->sample_states = sample_states;
+    registry->count = count;
+    return 0;
+}
+
+uint32_t thread_registry_count(const ThreadRegistry *registry)
+{
+    return registry->count;
+}
+
+const thread_t *thread_registry_threads(const ThreadRegistry *registry)
+{
+    return registry->threads;
+}
+
+const ThreadRecord *thread_registry_records(const ThreadRegistry *registry)
+{
+    return registry->records;
+}
+
+ThreadSampleState *thread_registry_sample_states(ThreadRegistry *registry)
+{
+    return registry->sample_states;
+}
+
+void thread_registry_reset_sample_states(ThreadRegistry *registry)
+{
+    for (uint32_t i = 0; i < registry->count; i++)
+        reset_sample_state(&registry->sample_states[i]);
+}
+
+const ThreadRecord *thread_registry_find(const ThreadRegistry *registry, uint32_t thread_number)
+{
+    // Survivors keep their order and new threads are appended with the
+    // next number, so records stay sorted by number
+    const ThreadRecord *begin = registry->records;
+    const ThreadRecord *end = registry->records + registry->count;
+    const ThreadRecord *record = std::lower_bound(
+        begin, end, thread_number,
+        [](const ThreadRecord &left, uint32_t number)
+        { return left.thread_number < number; });
+
+    return (record != end && record->thread_number == thread_number) ? record : NULL;
+}
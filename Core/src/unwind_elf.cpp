@@ -0,0 +1,80 @@
+#include "unwind_internal.h"
+
+#if defined(PLATFORM_LINUX)
+
+#include "elf_image.h"
+#include <string.h>
+#include <errno.h>
+
+int unwind_load_module(
+    task_t task,
+    const PlatformModule *module,
+    UnwindRowBuffer *out)
+{
+    ElfImage image;
+    int result = elf_image_open(task, module->path, &image);
+    if (result != 0)
+        return result;
+
+    int64_t bias = (int64_t)(module->base - image.link_base);
+
+    // Prefer the section header; stripped files may only have the
+    // PT_GNU_EH_FRAME program header pointing at .eh_frame_hdr
+    uint64_t eh_frame_offset = 0;
+    uint64_t eh_frame_size = 0;
+    uint64_t eh_frame_address = 0;
+
+    const Elf64_Shdr *section = elf_image_section(&image, ".eh_frame", SHT_PROGBITS);
+    if (section)
+    {
+        eh_frame_offset = section->sh_offset;
+        eh_frame_size = section->sh_size;
+        eh_frame_address = section->sh_addr;
+    }
+
+    const Elf64_Phdr *eh_frame_hdr = NULL;
+    for (uint16_t i = 0; i < image.ehdr->e_phnum; i++)
+    {
+        if (image.phdrs[i].p_type == PT_GNU_EH_FRAME)
+            eh_frame_hdr = &image.phdrs[i];
+    }
+
+    if (eh_frame_size == 0 && eh_frame_hdr != NULL &&
+        eh_frame_hdr->p_offset + 8 <= image.size)
+    {
+        // .eh_frame_hdr: version, eh_frame_ptr encoding, ..., eh_frame_ptr
+        const uint8_t *hdr = image.data + eh_frame_hdr->p_offset;
+        const uint8_t pcrel_sdata4 = 0x1b;
+        if (hdr[0] == 1 && hdr[1] == pcrel_sdata4)
+        {
+            int32_t relative;
+            memcpy(&relative, hdr + 4, sizeof(relative));
+            eh_frame_address = eh_frame_hdr->p_vaddr + 4 + relative;
+
+            // The section ends with a zero terminator, so the rest of the
+            // segment is a safe upper bound for its size
+            uint64_t available;
+            if (elf_image_vaddr_to_offset(&image, eh_frame_address,
+                                          &eh_frame_offset, &available) &&
+                eh_frame_offset <= image.size)
+            {
+                eh_frame_size = available < image.size - eh_frame_offset
+                                    ? available
+                                    : image.size - eh_frame_offset;
+            }
+        }
+    }
+
+    result = EINVAL;
+    if (eh_frame_size > 0)
+    {
+        dwarf_cfi_parse_eh_frame(image.data + eh_frame_offset, eh_frame_size,
+                                 eh_frame_address, bias, out);
+        result = 0;
+    }
+
+    elf_image_close(&image);
+    return result;
+}
+
+#endif // PLATFORM_LINUX
@@ -0,0 +1,67 @@
+#ifndef UNWIND_INTERNAL_H
+#define UNWIND_INTERNAL_H
+
+#include "unwind_table.h"
+#include <stddef.h>
+
+// A rule at an absolute runtime PC, collected while a module is compiled
+typedef struct
+{
+    uint64_t pc;
+    UnwindRow row;       // row.offset is filled in when the module is compiled
+    bool terminator;     // End of a function's range rather than a rule
+} UnwindRawRow;
+
+// Growable list of raw rows
+typedef struct
+{
+    UnwindRawRow *rows;
+    size_t count;
+    size_t capacity;
+} UnwindRowBuffer;
+
+/**
+ * Append a row; false on allocation failure
+ */
+bool unwind_row_buffer_push(
+    UnwindRowBuffer *buffer,
+    uint64_t pc,
+    const UnwindRow *row,
+    bool terminator);
+
+void unwind_row_buffer_free(UnwindRowBuffer *buffer);
+
+/**
+ * Sort rows by PC; at equal PCs terminators come first, then push order
+ */
+void unwind_row_buffer_sort(UnwindRowBuffer *buffer);
+
+/**
+ * Compile a .eh_frame section into rows (dwarf_cfi.cpp)
+ *
+ * @param data Section contents
+ * @param size Section size in bytes
+ * @param section_address Link-time address of data[0] (for PC-relative pointers)
+ * @param bias Added to link-time addresses to get runtime addresses
+ * @param out Receives one row per CFA change plus a terminator per function
+ * @return Number of FDEs compiled
+ */
+size_t dwarf_cfi_parse_eh_frame(
+    const uint8_t *data,
+    size_t size,
+    uint64_t section_address,
+    int64_t bias,
+    UnwindRowBuffer *out);
+
+/**
+ * Compile the unwind sections of one loaded module into rows
+ * (unwind_elf.cpp on Linux, unwind_macho.cpp on macOS)
+ *
+ * @return 0 on success, error code otherwise
+ */
+int unwind_load_module(
+    task_t task,
+    const PlatformModule *module,
+    UnwindRowBuffer *out);
+
+#endif // UNWIND_INTERNAL_H
@@ -0,0 +1,425 @@
+#include "unwind_internal.h"
+
+#if defined(PLATFORM_MACH)
+
+#include <stdlib.h>
+#include <string.h>
+#include <mach/mach.h>
+#include <mach-o/loader.h>
+#include <mach-o/compact_unwind_encoding.h>
+
+#ifndef EXTRACT_BITS
+#define EXTRACT_BITS(value, mask) \
+    (((value) >> __builtin_ctz(mask)) & ((1u << __builtin_popcount(mask)) - 1))
+#endif
+
+// A compact unwind entry: the encoding that holds from pc on
+typedef struct
+{
+    uint64_t pc;
+    uint32_t encoding;
+} CompactEntry;
+
+// Helper: Copy a section of the image out of the target
+static uint8_t *read_section(task_t task, uint64_t address, uint64_t size)
+{
+    if (size == 0 || size > 64 * 1024 * 1024)
+        return NULL;
+
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (data && platform_read_memory(task, address, data, size) != 0)
+    {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+#if defined(__x86_64__)
+// Helper: Where a frameless x86_64 function saved rbp, if it did
+// The saved registers sit just below the return address, in the order
+// given by the permutation (as decoded by libunwind's CompactUnwinder).
+static bool frameless_rbp_slot(uint32_t encoding, int16_t *offset)
+{
+    uint32_t count = EXTRACT_BITS(encoding, UNWIND_X86_64_FRAMELESS_STACK_REG_COUNT);
+    uint32_t permutation = EXTRACT_BITS(encoding, UNWIND_X86_64_FRAMELESS_STACK_REG_PERMUTATION);
+    if (count == 0 || count > 6)
+        return false;
+
+    uint32_t unpermuted[6] = {0, 0, 0, 0, 0, 0};
+    static const uint32_t radix[6][6] = {
+        {1, 0, 0, 0, 0, 0},
+        {5, 1, 0, 0, 0, 0},
+        {20, 4, 1, 0, 0, 0},
+        {60, 12, 3, 1, 0, 0},
+        {120, 24, 6, 2, 1, 0},
+        {120, 24, 6, 2, 1, 1},
+    };
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t divisor = radix[count - 1][i];
+        if (divisor == 0)
+            break;
+        unpermuted[i] = permutation / divisor;
+        permutation -= unpermuted[i] * divisor;
+    }
+
+    bool used[7] = {false, false, false, false, false, false, false};
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t renumbered = 0;
+        for (uint32_t reg = 1; reg < 7; reg++)
+        {
+            if (used[reg])
+                continue;
+            if (renumbered == unpermuted[i])
+            {
+                used[reg] = true;
+                if (reg == UNWIND_X86_64_REG_RBP)
+                {
+                    *offset = (int16_t)(-8 - 8 * (int32_t)(count - i));
+                    return true;
+                }
+                break;
+            }
+            renumbered++;
+        }
+    }
+    return false;
+}
+#endif
+
+// Helper: Translate a compact encoding; false when the function defers to
+// DWARF (or uses a form we cannot express) and .eh_frame should be used
+static bool compact_to_row(uint32_t encoding, UnwindRow *row)
+{
+    memset(row, 0, sizeof(*row));
+    row->cfa_base = UNWIND_CFA_UNDEFINED;
+
+#if defined(__arm64__) || defined(__aarch64__)
+    switch (encoding & UNWIND_ARM64_MODE_MASK)
+    {
+    case UNWIND_ARM64_MODE_FRAME:
+        row->cfa_base = UNWIND_CFA_FP;
+        row->cfa_offset = 16;
+        row->ra_rule = UNWIND_REG_AT_CFA;
+        row->ra_offset = -8;
+        row->fp_rule = UNWIND_REG_AT_CFA;
+        row->fp_offset = -16;
+        return true;
+
+    case UNWIND_ARM64_MODE_FRAMELESS:
+        row->cfa_base = UNWIND_CFA_SP;
+        row->cfa_offset = (int32_t)(16 * EXTRACT_BITS(encoding, UNWIND_ARM64_FRAMELESS_STACK_SIZE_MASK));
+        row->ra_rule = UNWIND_REG_SAME; // Still in LR
+        row->fp_rule = UNWIND_REG_SAME;
+        return true;
+
+    case UNWIND_ARM64_MODE_DWARF:
+        return false;
+
+    default:
+        return encoding != 0; // No info: leave undefined unless DWARF has some
+    }
+#elif defined(__x86_64__)
+    switch (encoding & UNWIND_X86_64_MODE_MASK)
+    {
+    case UNWIND_X86_64_MODE_RBP_FRAME:
+        row->cfa_base = UNWIND_CFA_FP;
+        row->cfa_offset = 16;
+        row->ra_rule = UNWIND_REG_AT_CFA;
+        row->ra_offset = -8;
+        row->fp_rule = UNWIND_REG_AT_CFA;
+        row->fp_offset = -16;
+        return true;
+
+    case UNWIND_X86_64_MODE_STACK_IMMD:
+        row->cfa_base = UNWIND_CFA_SP;
+        row->cfa_offset = (int32_t)(8 * EXTRACT_BITS(encoding, UNWIND_X86_64_FRAMELESS_STACK_SIZE));
+        row->ra_rule = UNWIND_REG_AT_CFA;
+        row->ra_offset = -8;
+        row->fp_rule = frameless_rbp_slot(encoding, &row->fp_offset)
+                           ? UNWIND_REG_AT_CFA
+                           : UNWIND_REG_SAME;
+        return true;
+
+    case UNWIND_X86_64_MODE_STACK_IND:
+        // The stack size is encoded in the function's own sub instruction
+        return true;
+
+    case UNWIND_X86_64_MODE_DWARF:
+        return false;
+
+    default:
+        return encoding != 0;
+    }
+#else
+#error "Unsupported architecture"
+#endif
+}
+
+// Helper: Append a compact entry; frees the list on allocation failure
+static bool push_entry(
+    CompactEntry **list,
+    size_t *count,
+    size_t *capacity,
+    uint64_t pc,
+    uint32_t encoding)
+{
+    if (*count == *capacity)
+    {
+        size_t grown_capacity = *capacity * 2;
+        CompactEntry *grown = (CompactEntry *)realloc(*list, grown_capacity * sizeof(CompactEntry));
+        if (!grown)
+        {
+            free(*list);
+            *list = NULL;
+            return false;
+        }
+        *list = grown;
+        *capacity = grown_capacity;
+    }
+
+    (*list)[*count].pc = pc;
+    (*list)[*count].encoding = encoding;
+    (*count)++;
+    return true;
+}
+
+// Helper: Collect the entries of a __unwind_info section
+static bool parse_unwind_info(
+    const uint8_t *data,
+    uint64_t size,
+    uint64_t base,
+    CompactEntry **entries,
+    size_t *entry_count)
+{
+    *entries = NULL;
+    *entry_count = 0;
+    if (size < sizeof(struct unwind_info_section_header))
+        return false;
+
+    const struct unwind_info_section_header *header =
+        (const struct unwind_info_section_header *)data;
+    if (header->version != UNWIND_SECTION_VERSION ||
+        header->indexSectionOffset > size ||
+        (size - header->indexSectionOffset) / sizeof(struct unwind_info_section_header_index_entry) <
+            header->indexCount ||
+        header->commonEncodingsArraySectionOffset > size ||
+        (size - header->commonEncodingsArraySectionOffset) / sizeof(uint32_t) <
+            header->commonEncodingsArrayCount)
+        return false;
+
+    const struct unwind_info_section_header_index_entry *index =
+        (const struct unwind_info_section_header_index_entry *)(data + header->indexSectionOffset);
+    const uint32_t *common =
+        (const uint32_t *)(data + header->commonEncodingsArraySectionOffset);
+
+    size_t capacity = 1024;
+    size_t count = 0;
+    CompactEntry *list = (CompactEntry *)malloc(capacity * sizeof(CompactEntry));
+    if (!list)
+        return false;
+
+
+    // The last index entry is a sentinel holding the end of the text
+    for (uint32_t i = 0; i + 1 < header->indexCount; i++)
+    {
+        uint32_t page_offset = index[i].secondLevelPagesSectionOffset;
+        if (page_offset == 0 || page_offset + 2 * sizeof(uint32_t) > size)
+            continue;
+
+        uint32_t kind = *(const uint32_t *)(data + page_offset);
+        if (kind == UNWIND_SECOND_LEVEL_REGULAR)
+        {
+            const struct unwind_info_regular_second_level_page_header *page =
+                (const struct unwind_info_regular_second_level_page_header *)(data + page_offset);
+            uint64_t entries_at = page_offset + page->entryPageOffset;
+            if (entries_at + (uint64_t)page->entryCount * sizeof(struct unwind_info_regular_second_level_entry) > size)
+                continue;
+
+            const struct unwind_info_regular_second_level_entry *regular =
+                (const struct unwind_info_regular_second_level_entry *)(data + entries_at);
+            for (uint16_t j = 0; j < page->entryCount; j++)
+            {
+                if (!push_entry(&list, &count, &capacity,
+                                base + regular[j].functionOffset, regular[j].encoding))
+                    return false;
+            }
+        }
+        else if (kind == UNWIND_SECOND_LEVEL_COMPRESSED)
+        {
+            const struct unwind_info_compressed_second_level_page_header *page =
+                (const struct unwind_info_compressed_second_level_page_header *)(data + page_offset);
+            uint64_t entries_at = page_offset + page->entryPageOffset;
+            uint64_t encodings_at = page_offset + page->encodingsPageOffset;
+            if (entries_at + (uint64_t)page->entryCount * sizeof(uint32_t) > size ||
+                encodings_at + (uint64_t)page->encodingsCount * sizeof(uint32_t) > size)
+                continue;
+
+            const uint32_t *compressed = (const uint32_t *)(data + entries_at);
+            const uint32_t *local = (const uint32_t *)(data + encodings_at);
+            for (uint16_t j = 0; j < page->entryCount; j++)
+            {
+                uint32_t function = index[i].functionOffset +
+                                    UNWIND_INFO_COMPRESSED_ENTRY_FUNC_OFFSET(compressed[j]);
+                uint32_t which = UNWIND_INFO_COMPRESSED_ENTRY_ENCODING_INDEX(compressed[j]);
+
+                uint32_t encoding = 0;
+                if (which < header->commonEncodingsArrayCount)
+                    encoding = common[which];
+                else if (which - header->commonEncodingsArrayCount < page->encodingsCount)
+                    encoding = local[which - header->commonEncodingsArrayCount];
+
+                if (!push_entry(&list, &count, &capacity, base + function, encoding))
+                    return false;
+            }
+        }
+    }
+
+    // Sentinel: end of the covered text, as an entry with no information
+    if (header->indexCount > 0 &&
+        !push_entry(&list, &count, &capacity,
+                    base + index[header->indexCount - 1].functionOffset, 0))
+        return false;
+
+    *entries = list;
+    *entry_count = count;
+    return true;
+}
+
+int unwind_load_module(
+    task_t task,
+    const PlatformModule *module,
+    UnwindRowBuffer *out)
+{
+    struct mach_header_64 header;
+    int kr = platform_read_memory(task, module->base, &header, sizeof(header));
+    if (kr != 0)
+        return kr;
+    if (header.magic != MH_MAGIC_64)
+        return KERN_INVALID_ARGUMENT;
+
+    uint8_t *commands = (uint8_t *)malloc(header.sizeofcmds);
+    if (!commands)
+        return KERN_RESOURCE_SHORTAGE;
+
+    kr = platform_read_memory(task, module->base + sizeof(header), commands, header.sizeofcmds);
+    if (kr != 0)
+    {
+        free(commands);
+        return kr;
+    }
+
+    // Find __TEXT (for the slide) and its unwind sections
+    int64_t slide = 0;
+    bool have_text = false;
+    const struct section_64 *eh_frame = NULL;
+    const struct section_64 *unwind_info = NULL;
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < header.ncmds && offset + sizeof(struct load_command) <= header.sizeofcmds; i++)
+    {
+        const struct load_command *command = (const struct load_command *)(commands + offset);
+        if (command->cmdsize == 0 || offset + command->cmdsize > header.sizeofcmds)
+            break;
+
+        if (command->cmd == LC_SEGMENT_64)
+        {
+            const struct segment_command_64 *segment = (const struct segment_command_64 *)command;
+            if (strncmp(segment->segname, SEG_TEXT, sizeof(segment->segname)) == 0 &&
+                sizeof(*segment) + (uint64_t)segment->nsects * sizeof(struct section_64) <= command->cmdsize)
+            {
+                slide = (int64_t)(module->base - segment->vmaddr);
+                have_text = true;
+
+                const struct section_64 *sections = (const struct section_64 *)(segment + 1);
+                for (uint32_t j = 0; j < segment->nsects; j++)
+                {
+                    if (strncmp(sections[j].sectname, "__eh_frame", sizeof(sections[j].sectname)) == 0)
+                        eh_frame = &sections[j];
+                    else if (strncmp(sections[j].sectname, "__unwind_info", sizeof(sections[j].sectname)) == 0)
+                        unwind_info = &sections[j];
+                }
+            }
+        }
+        offset += command->cmdsize;
+    }
+
+    if (!have_text || (!eh_frame && !unwind_info))
+    {
+        free(commands);
+        return KERN_INVALID_ARGUMENT;
+    }
+
+    // DWARF rows: used directly without __unwind_info, and for the
+    // functions whose compact encoding defers to DWARF otherwise
+    UnwindRowBuffer dwarf = {NULL, 0, 0};
+    if (eh_frame)
+    {
+        uint8_t *data = read_section(task, eh_frame->addr + slide, eh_frame->size);
+        if (data)
+        {
+            dwarf_cfi_parse_eh_frame(data, eh_frame->size, eh_frame->addr, slide, &dwarf);
+            free(data);
+        }
+    }
+
+    CompactEntry *entries = NULL;
+    size_t entry_count = 0;
+    if (unwind_info)
+    {
+        uint8_t *data = read_section(task, unwind_info->addr + slide, unwind_info->size);
+        if (data)
+        {
+            parse_unwind_info(data, unwind_info->size, module->base, &entries, &entry_count);
+            free(data);
+        }
+    }
+    free(commands);
+
+    if (entry_count == 0)
+    {
+        // DWARF only
+        for (size_t i = 0; i < dwarf.count; i++)
+        {
+            unwind_row_buffer_push(out, dwarf.rows[i].pc, &dwarf.rows[i].row, dwarf.rows[i].terminator);
+        }
+        unwind_row_buffer_free(&dwarf);
+        return 0;
+    }
+
+    // Merge: each compact range either has its own row or takes the DWARF
+    // rows that fall inside it
+    unwind_row_buffer_sort(&dwarf);
+    size_t next_dwarf = 0;
+    for (size_t i = 0; i < entry_count; i++)
+    {
+        uint64_t start = entries[i].pc;
+        uint64_t end = i + 1 < entry_count ? entries[i + 1].pc : UINT64_MAX;
+
+        while (next_dwarf < dwarf.count && dwarf.rows[next_dwarf].pc < start)
+            next_dwarf++;
+
+        UnwindRow row;
+        if (compact_to_row(entries[i].encoding, &row))
+        {
+            unwind_row_buffer_push(out, start, &row, false);
+            continue;
+        }
+
+        // Closes the previous range even if DWARF has nothing here
+        unwind_row_buffer_push(out, start, &row, true);
+        while (next_dwarf < dwarf.count && dwarf.rows[next_dwarf].pc < end)
+        {
+            const UnwindRawRow *raw = &dwarf.rows[next_dwarf++];
+            unwind_row_buffer_push(out, raw->pc, &raw->row, raw->terminator);
+        }
+    }
+
+    free(entries);
+    unwind_row_buffer_free(&dwarf);
+    return 0;
+}
+
+#endif // PLATFORM_MACH
@@ -0,0 +1,312 @@
+#include "unwind_table.h"
+#include "unwind_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+// One loaded module and its compiled rows
+typedef struct
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t base;
+    char *path;
+    UnwindRow *rows; // Sorted by offset
+    uint32_t row_count;
+} UnwindModule;
+
+struct UnwindTable
+{
+    task_t task;
+    UnwindModule *modules; // Sorted by start
+    uint32_t module_count;
+};
+
+bool unwind_row_buffer_push(
+    UnwindRowBuffer *buffer,
+    uint64_t pc,
+    const UnwindRow *row,
+    bool terminator)
+{
+    if (buffer->count == buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 1024;
+        UnwindRawRow *rows = (UnwindRawRow *)realloc(buffer->rows, capacity * sizeof(UnwindRawRow));
+        if (!rows)
+            return false;
+        buffer->rows = rows;
+        buffer->capacity = capacity;
+    }
+
+    UnwindRawRow *raw = &buffer->rows[buffer->count++];
+    raw->pc = pc;
+    raw->row = *row;
+    raw->terminator = terminator;
+    return true;
+}
+
+void unwind_row_buffer_free(UnwindRowBuffer *buffer)
+{
+    free(buffer->rows);
+    buffer->rows = NULL;
+    buffer->count = 0;
+    buffer->capacity = 0;
+}
+
+void unwind_row_buffer_sort(UnwindRowBuffer *buffer)
+{
+    // A function's terminator sorts before rules of a function starting at
+    // the same address, and rows at the same address keep their order, so
+    // the last one pushed wins when the table is compiled
+    std::stable_sort(
+        buffer->rows, buffer->rows + buffer->count,
+        [](const UnwindRawRow &a, const UnwindRawRow &b)
+        {
+            if (a.pc != b.pc)
+                return a.pc < b.pc;
+            return a.terminator && !b.terminator;
+        });
+}
+
+static bool same_rule(const UnwindRow *a, const UnwindRow *b)
+{
+    return a->cfa_base == b->cfa_base &&
+           a->cfa_offset == b->cfa_offset &&
+           a->ra_rule == b->ra_rule &&
+           a->ra_offset == b->ra_offset &&
+           a->fp_rule == b->fp_rule &&
+           a->fp_offset == b->fp_offset;
+}
+
+// Helper: Turn raw rows into the module's sorted, deduplicated row array
+static void compile_module(UnwindModule *module, UnwindRowBuffer *buffer)
+{
+    module->rows = NULL;
+    module->row_count = 0;
+    if (buffer->count == 0 || module->end - module->start > UINT32_MAX)
+        return;
+
+    unwind_row_buffer_sort(buffer);
+
+    UnwindRow *rows = (UnwindRow *)malloc(buffer->count * sizeof(UnwindRow));
+    if (!rows)
+        return;
+
+    uint32_t count = 0;
+    for (size_t i = 0; i < buffer->count; i++)
+    {
+        const UnwindRawRow *raw = &buffer->rows[i];
+        if (raw->pc < module->start || raw->pc >= module->end)
+            continue;
+
+        UnwindRow row;
+        if (raw->terminator)
+        {
+            memset(&row, 0, sizeof(row));
+            row.cfa_base = UNWIND_CFA_UNDEFINED;
+        }
+        else
+        {
+            row = raw->row;
+        }
+        row.offset = (uint32_t)(raw->pc - module->start);
+        row.reserved = 0;
+
+        if (count > 0 && rows[count - 1].offset == row.offset)
+            rows[count - 1] = row;
+        else if (count == 0 || !same_rule(&rows[count - 1], &row))
+            rows[count++] = row;
+    }
+
+    if (count == 0)
+    {
+        free(rows);
+        return;
+    }
+
+    UnwindRow *shrunk = (UnwindRow *)realloc(rows, count * sizeof(UnwindRow));
+    module->rows = shrunk ? shrunk : rows;
+    module->row_count = count;
+}
+
+static void free_module(UnwindModule *module)
+{
+    free(module->path);
+    free(module->rows);
+    module->path = NULL;
+    module->rows = NULL;
+    module->row_count = 0;
+}
+
+// Helper: Find a module by start address (modules are sorted by start)
+static UnwindModule *find_module(UnwindModule *modules, uint32_t count, uint64_t start)
+{
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (modules[mid].start < start)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return (low < count && modules[low].start == start) ? &modules[low] : NULL;
+}
+
+UnwindTable *unwind_table_create(task_t task)
+{
+    UnwindTable *table = (UnwindTable *)calloc(1, sizeof(UnwindTable));
+    if (!table)
+        return NULL;
+
+    table->task = task;
+    int kr = unwind_table_refresh(table);
+    if (kr != 0)
+    {
+        fprintf(stderr, "Warning: could not list modules for unwinding: %d\n", kr);
+    }
+    return table;
+}
+
+int unwind_table_refresh(UnwindTable *table)
+{
+    PlatformModule *list = NULL;
+    uint32_t count = 0;
+    int kr = platform_task_modules(table->task, &list, &count);
+    if (kr != 0)
+        return kr;
+
+    UnwindModule *modules = (UnwindModule *)calloc(count ? count : 1, sizeof(UnwindModule));
+    if (!modules)
+    {
+        platform_module_list_release(list, count);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const PlatformModule *loaded = &list[i];
+        UnwindModule *module = &modules[i];
+
+        // Keep the compiled rows of modules that are still loaded
+        UnwindModule *previous = find_module(table->modules, table->module_count, loaded->start);
+        if (previous && previous->path && previous->end == loaded->end &&
+            previous->base == loaded->base && strcmp(previous->path, loaded->path) == 0)
+        {
+            *module = *previous;
+            previous->path = NULL;
+            previous->rows = NULL;
+            continue;
+        }
+
+        module->start = loaded->start;
+        module->end = loaded->end;
+        module->base = loaded->base;
+        module->path = strdup(loaded->path);
+
+        // Modules without unwind info stay in the list with no rows, so
+        // they are not parsed again on every refresh
+        UnwindRowBuffer buffer = {NULL, 0, 0};
+        if (unwind_load_module(table->task, loaded, &buffer) == 0)
+            compile_module(module, &buffer);
+        unwind_row_buffer_free(&buffer);
+    }
+
+    for (uint32_t i = 0; i < table->module_count; i++)
+    {
+        free_module(&table->modules[i]);
+    }
+    free(table->modules);
+
+    table->modules = modules;
+    table->module_count = count;
+    platform_module_list_release(list, count);
+    return 0;
+}
+
+void unwind_table_destroy(UnwindTable *table)
+{
+    if (!table)
+        return;
+
+    for (uint32_t i = 0; i < table->module_count; i++)
+    {
+        free_module(&table->modules[i]);
+    }
+    free(table->modules);
+    free(table);
+}
+
+bool unwind_table_find(const UnwindTable *table, uint64_t pc, UnwindRow *row)
+{
+    // Last module starting at or below pc
+    uint32_t low = 0;
+    uint32_t high = table->module_count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (table->modules[mid].start <= pc)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == 0)
+        return false;
+
+    const UnwindModule *module = &table->modules[low - 1];
+    if (pc >= module->end || module->row_count == 0)
+        return false;
+
+    // Last row starting at or below the offset
+    uint32_t offset = (uint32_t)(pc - module->start);
+    low = 0;
+    high = module->row_count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (module->rows[mid].offset <= offset)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == 0)
+        return false;
+
+    *row = module->rows[low - 1];
+    return true;
+}
+
+uint32_t unwind_table_module_count(const UnwindTable *table)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < table->module_count; i++)
+    {
+        if (table->modules[i].row_count > 0)
+            count++;
+    }
+    return count;
+}
+
+uint64_t unwind_table_row_count(const UnwindTable *table)
+{
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < table->module_count; i++)
+    {
+        count += table->modules[i].row_count;
+    }
+    return count;
+}
+
+uint64_t unwind_table_memory_usage(const UnwindTable *table)
+{
+    uint64_t bytes = sizeof(UnwindTable) + (uint64_t)table->module_count * sizeof(UnwindModule);
+    for (uint32_t i = 0; i < table->module_count; i++)
+    {
+        bytes += (uint64_t)table->modules[i].row_count * sizeof(UnwindRow);
+        if (table->modules[i].path)
+            bytes += strlen(table->modules[i].path) + 1;
+    }
+    return bytes;
+}
@@ -17,6 +17,11 @@ let package = Package(
             name: "test-target",
             targets: ["TestTarget"]
         ),
+        // Stack walker and capture benchmarks
+        .executable(
+            name: "profiler-bench",
+            targets: ["Benchmarks"]
+        ),
         // Library for integration
         .library(
             name: "SwiftAsyncProfiler",
@@ -31,15 +36,41 @@ let package = Package(
             exclude: [],
             sources: [
                 "src/profiler.cpp",
-                "src/stack_walker.cpp"
+                "src/stack_walker.cpp",
+                "src/async_unwind.cpp",
+                "src/sampler.cpp",
+                "src/stack_table.cpp",
+                "src/call_tree.cpp",
+                "src/histogram.cpp",
+                "src/aggregate.cpp",
+                "src/region_map.cpp",
+                "src/thread_registry.cpp",
+                "src/recording.cpp",
+                "src/recorder.cpp",
+                "src/pprof.cpp",
+                "src/profile_diff.cpp",
+                "src/gzip_writer.cpp",
+                "src/unwind_table.cpp",
+                "src/dwarf_cfi.cpp",
+                "src/unwind_elf.cpp",
+                "src/unwind_macho.cpp",
+                "src/elf_image.cpp",
+                "src/symbolizer.cpp",
+                "src/symbols_elf.cpp",
+                "src/symbols_macho.cpp",
+                "src/demangler.cpp",
+                "src/platform_mach.cpp",
+                "src/platform_linux.cpp"
             ],
             publicHeadersPath: "include",
             cxxSettings: [
                 .headerSearchPath("include"),
-                .define("_DARWIN_C_SOURCE"),
+                .define("_DARWIN_C_SOURCE", .when(platforms: [.macOS])),
+                .define("_GNU_SOURCE", .when(platforms: [.linux])),
             ],
             linkerSettings: [
-                .linkedFramework("Foundation"),
+                .linkedFramework("Foundation", .when(platforms: [.macOS])),
+                .linkedLibrary("dl", .when(platforms: [.linux])),
             ]
         ),
         
@@ -68,6 +99,17 @@ let package = Package(
             path: "Tests/Fixtures",
             sources: ["test_target.swift"]
         ),
+
+        // Benchmarks
+        .executableTarget(
+            name: "Benchmarks",
+            dependencies: ["Core"],
+            path: "Benchmarks",
+            sources: ["main.cpp", "memory_target.cpp"],
+            cxxSettings: [
+                .define("_GNU_SOURCE", .when(platforms: [.linux])),
+            ]
+        ),
     ],
     cxxLanguageStandard: .cxx17
 )
\ No newline at end of file
@@ -3,6 +3,15 @@ import Foundation
 // MARK: - C Structure Mirrors
 // These must match the C structures exactly
 
+#if os(Linux)
+// Linux has no Mach ports; platform.h aliases these to the target pid and
+// kernel thread IDs so the structures below keep the same layout.
+public typealias mach_port_t = UInt32
+public typealias thread_t = mach_port_t
+public typealias thread_act_array_t = UnsafeMutablePointer<thread_t>
+public typealias mach_msg_type_number_t = UInt32
+#endif
+
 // Profiler State
 public enum ProfilerState: UInt32 {
     case detached = 0
@@ -25,53 +34,149 @@ public struct StackFrame {
         self.address = address
         self.frame_pointer = framePointer
     }
+    
+    /// Address of the frame separating a physical stack from its await
+    /// chain (STACK_FRAME_ASYNC_MARKER)
+    public static let asyncMarker: UInt64 = 1
+    
+    public var isAsyncMarker: Bool {
+        return address == StackFrame.asyncMarker
+    }
 }
 
-// Stack Trace (64 frames to keep struct size reasonable)
+// Registers a walk started from
+public struct StackWalkOrigin {
+    public var pc: UInt64
+    public var sp: UInt64
+    public var fp: UInt64
+    
+    public init() {
+        self.pc = 0
+        self.sp = 0
+        self.fp = 0
+    }
+}
+
+// Stack Trace header; frames live in the profiler's frame arena
+// (see Profiler.frames(of:))
 public struct StackTrace {
-    public var frames: (
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 0-4
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 5-9
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 10-14
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 15-19
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 20-24
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 25-29
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 30-34
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 35-39
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 40-44
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 45-49
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 50-54
-        StackFrame, StackFrame, StackFrame, StackFrame, StackFrame, // 55-59
-        StackFrame, StackFrame, StackFrame, StackFrame              // 60-63
-    )
+    public var frame_offset: UInt32
     public var frame_count: UInt32
     public var thread: thread_t
+    public var thread_number: UInt32
     public var thread_id: UInt64
     public var timestamp_ns: UInt64
+    public var remote_reads: UInt32
+    public var failed_reads: UInt32
+    public var rejected_reads: UInt32
+    public var kernel_calls: UInt32
+    public var stack_id: UInt32
+    public var origin: StackWalkOrigin
+    public var unchanged: Bool
+    public var cached_frames: UInt32
+    public var pause_ns: UInt64
+    public var optimistic_attempts: UInt32
+    public var torn: Bool
+    // STACK_PHASE_COUNT (5) entries, indexed by StackWalkPhase
+    public var phase_ns: (UInt64, UInt64, UInt64, UInt64, UInt64)
+    public var bytes_read: UInt64
     
     public init() {
-        self.frames = (
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame(), StackFrame(),
-            StackFrame(), StackFrame(), StackFrame(), StackFrame()
-        )
+        self.frame_offset = 0
         self.frame_count = 0
         self.thread = 0
+        self.thread_number = 0
+        self.thread_id = 0
+        self.timestamp_ns = 0
+        self.remote_reads = 0
+        self.failed_reads = 0
+        self.rejected_reads = 0
+        self.kernel_calls = 0
+        self.stack_id = 0
+        self.origin = StackWalkOrigin()
+        self.unchanged = false
+        self.cached_frames = 0
+        self.pause_ns = 0
+        self.optimistic_attempts = 0
+        self.torn = false
+        self.phase_ns = (0, 0, 0, 0, 0)
+        self.bytes_read = 0
+    }
+}
+
+// Sample from the continuous sampler (frames are interned by stack_id)
+public struct ProfilerSample {
+    public var stack_id: UInt32
+    public var thread_number: UInt32
+    public var thread_id: UInt64
+    public var timestamp_ns: UInt64
+    public var run_state: UInt32
+    public var cpu_time_ns: UInt64
+    
+    public init() {
+        self.stack_id = 0
+        self.thread_number = 0
+        self.thread_id = 0
+        self.timestamp_ns = 0
+        self.run_state = 5
+        self.cpu_time_ns = 0
+    }
+}
+
+// Thread lifecycle event (type: 0 = created, 1 = exited)
+public struct ThreadEvent {
+    public var type: UInt32
+    public var thread_number: UInt32
+    public var thread_id: UInt64
+    public var timestamp_ns: UInt64
+    
+    public init() {
+        self.type = 0
+        self.thread_number = 0
         self.thread_id = 0
         self.timestamp_ns = 0
     }
 }
 
+// Cached metadata of a live thread (name and queue_label: char[64] each;
+// see Profiler.threadInfo(number:))
+public struct ThreadRecord {
+    public var thread: thread_t
+    public var thread_number: UInt32
+    public var thread_id: UInt64
+    public var created_ns: UInt64
+    public var qos: UInt32
+    public var priority: Int32
+    public var name: (UInt64, UInt64, UInt64, UInt64, UInt64, UInt64, UInt64, UInt64)
+    public var queue_label: (UInt64, UInt64, UInt64, UInt64, UInt64, UInt64, UInt64, UInt64)
+    
+    public init() {
+        self.thread = 0
+        self.thread_number = 0
+        self.thread_id = 0
+        self.created_ns = 0
+        self.qos = 0
+        self.priority = 0
+        self.name = (0, 0, 0, 0, 0, 0, 0, 0)
+        self.queue_label = (0, 0, 0, 0, 0, 0, 0, 0)
+    }
+}
+
+// Symbol of one address (strings are owned by the profiler)
+public struct SymbolInfo {
+    public var name: UnsafePointer<CChar>?
+    public var module: UnsafePointer<CChar>?
+    public var symbol_address: UInt64
+    public var module_base: UInt64
+    
+    public init() {
+        self.name = nil
+        self.module = nil
+        self.symbol_address = 0
+        self.module_base = 0
+    }
+}
+
 // Profiler Target
 public struct ProfilerTarget {
     public var pid: pid_t
@@ -98,6 +203,12 @@ public struct ProfilerConfig {
     public var track_async: Bool
     public var track_threads: Bool
     public var stack_strategy: UInt32
+    public var stack_window_size: UInt32
+    public var sample_buffer_size: UInt32
+    public var capture_workers: UInt32
+    public var snapshot_mode: Bool
+    public var sampling_mode: UInt32
+    public var optimistic_capture: Bool
     
     public init() {
         self.sample_interval_ms = 10
@@ -105,6 +216,12 @@ public struct ProfilerConfig {
         self.track_async = false
         self.track_threads = true
         self.stack_strategy = 0
+        self.stack_window_size = 32 * 1024
+        self.sample_buffer_size = 1024
+        self.capture_workers = 4
+        self.snapshot_mode = false
+        self.sampling_mode = 0
+        self.optimistic_capture = false
     }
     
     public init(
@@ -112,13 +229,25 @@ public struct ProfilerConfig {
         max_stack_depth: UInt32,
         track_async: Bool,
         track_threads: Bool,
-        stack_strategy: UInt32
+        stack_strategy: UInt32,
+        stack_window_size: UInt32,
+        sample_buffer_size: UInt32,
+        capture_workers: UInt32,
+        snapshot_mode: Bool,
+        sampling_mode: UInt32 = 0,
+        optimistic_capture: Bool = false
     ) {
         self.sample_interval_ms = sample_interval_ms
         self.max_stack_depth = max_stack_depth
         self.track_async = track_async
         self.track_threads = track_threads
         self.stack_strategy = stack_strategy
+        self.stack_window_size = stack_window_size
+        self.sample_buffer_size = sample_buffer_size
+        self.capture_workers = capture_workers
+        self.snapshot_mode = snapshot_mode
+        self.sampling_mode = sampling_mode
+        self.optimistic_capture = optimistic_capture
     }
 }
 
@@ -129,6 +258,36 @@ public struct ProfilerStats {
     public var failed_samples: UInt64
     public var total_frames: UInt64
     public var unique_addresses: UInt64
+    public var unique_stacks: UInt64
+    public var remote_reads: UInt64
+    public var failed_reads: UInt64
+    public var rejected_reads: UInt64
+    public var region_scans: UInt64
+    public var kernel_calls: UInt64
+    public var threads_created: UInt64
+    public var threads_exited: UInt64
+    public var dropped_thread_events: UInt64
+    public var missed_deadlines: UInt64
+    public var dropped_samples: UInt64
+    public var recorded_samples: UInt64
+    public var recorded_bytes: UInt64
+    public var last_batch_skew_ns: UInt64
+    public var max_batch_skew_ns: UInt64
+    public var snapshot_count: UInt64
+    public var total_pause_ns: UInt64
+    public var max_pause_ns: UInt64
+    // PROFILER_PAUSE_HISTOGRAM_BUCKETS (16) entries
+    public var pause_histogram: (UInt64, UInt64, UInt64, UInt64, UInt64, UInt64, UInt64, UInt64,
+                                 UInt64, UInt64, UInt64, UInt64, UInt64, UInt64, UInt64, UInt64)
+    public var skipped_idle_threads: UInt64
+    public var sampled_cpu_time_ns: UInt64
+    public var unchanged_samples: UInt64
+    public var cached_frames: UInt64
+    public var stopped_captures: UInt64
+    public var thread_pause_ns: UInt64
+    public var optimistic_samples: UInt64
+    public var optimistic_retries: UInt64
+    public var discarded_samples: UInt64
     
     public init() {
         self.total_samples = 0
@@ -136,6 +295,57 @@ public struct ProfilerStats {
         self.failed_samples = 0
         self.total_frames = 0
         self.unique_addresses = 0
+        self.unique_stacks = 0
+        self.remote_reads = 0
+        self.failed_reads = 0
+        self.rejected_reads = 0
+        self.region_scans = 0
+        self.kernel_calls = 0
+        self.threads_created = 0
+        self.threads_exited = 0
+        self.dropped_thread_events = 0
+        self.missed_deadlines = 0
+        self.dropped_samples = 0
+        self.recorded_samples = 0
+        self.recorded_bytes = 0
+        self.last_batch_skew_ns = 0
+        self.max_batch_skew_ns = 0
+        self.snapshot_count = 0
+        self.total_pause_ns = 0
+        self.max_pause_ns = 0
+        self.pause_histogram = (0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)
+        self.skipped_idle_threads = 0
+        self.sampled_cpu_time_ns = 0
+        self.unchanged_samples = 0
+        self.cached_frames = 0
+        self.stopped_captures = 0
+        self.thread_pause_ns = 0
+        self.optimistic_samples = 0
+        self.optimistic_retries = 0
+        self.discarded_samples = 0
+    }
+}
+
+// Histogram digest (see histogram.h)
+public struct HistogramSummary {
+    public var count: UInt64
+    public var total: UInt64
+    public var min: UInt64
+    public var max: UInt64
+    public var p50: UInt64
+    public var p90: UInt64
+    public var p99: UInt64
+    public var p999: UInt64
+    
+    public init() {
+        self.count = 0
+        self.total = 0
+        self.min = 0
+        self.max = 0
+        self.p50 = 0
+        self.p90 = 0
+        self.p99 = 0
+        self.p999 = 0
     }
 }
 
@@ -145,11 +355,138 @@ public struct StackWalkerConfig {
     public var max_depth: UInt32
     public var capture_timestamps: Bool
     public var validate_addresses: Bool
+    public var capture_thread_ids: Bool
+    public var stack_window_size: UInt32
+    public var capture_workers: UInt32
+    public var track_async: Bool
+    public var cache_suffixes: Bool
+    public var optimistic_capture: Bool
     
     public init() {
         self.strategy = 0
         self.max_depth = 512
         self.capture_timestamps = true
         self.validate_addresses = false
+        self.capture_thread_ids = true
+        self.stack_window_size = 32 * 1024
+        self.capture_workers = 4
+        self.track_async = false
+        self.cache_suffixes = true
+        self.optimistic_capture = false
+    }
+}
+
+// pprof Export Options
+public struct PprofOptions {
+    public var thread_labels: Bool
+    public var compress: Bool
+    public var state_labels: Bool
+    
+    public init() {
+        self.thread_labels = true
+        self.compress = true
+        self.state_labels = true
+    }
+}
+
+// pprof Export Statistics
+public struct PprofExportStats {
+    public var samples: UInt64
+    public var bytes: UInt64
+    public var stacks: UInt32
+    public var locations: UInt32
+    public var functions: UInt32
+    public var mappings: UInt32
+    
+    public init() {
+        self.samples = 0
+        self.bytes = 0
+        self.stacks = 0
+        self.locations = 0
+        self.functions = 0
+        self.mappings = 0
+    }
+}
+
+// Call Tree Node (self_weight mirrors the C field "self")
+public struct CallTreeNode {
+    public var frame: UInt64
+    public var self_weight: UInt64
+    public var total: UInt64
+    public var parent: UInt32
+    public var depth: UInt32
+    public var first_child: UInt32
+    public var next_sibling: UInt32
+    
+    public init() {
+        self.frame = 0
+        self.self_weight = 0
+        self.total = 0
+        self.parent = 0
+        self.depth = 0
+        self.first_child = 0
+        self.next_sibling = 0
     }
-}
\ No newline at end of file
+}
+
+// Call Tree Function (self_weight mirrors the C field "self")
+public struct CallTreeFunction {
+    public var frame: UInt64
+    public var self_weight: UInt64
+    public var total: UInt64
+    
+    public init() {
+        self.frame = 0
+        self.self_weight = 0
+        self.total = 0
+    }
+}
+
+// Profile Diff Options
+public struct ProfileDiffOptions {
+    public var min_z: Double
+    
+    public init() {
+        self.min_z = 3.29
+    }
+}
+
+// Profile Diff Function (self_counts mirrors the C field "self"; index 0 = A, 1 = B)
+public struct ProfileDiffFunction {
+    public var name: UnsafePointer<CChar>?
+    public var self_counts: (UInt64, UInt64)
+    public var total: (UInt64, UInt64)
+    public var self_delta: Double
+    public var total_delta: Double
+    public var z: Double
+    public var significant: Bool
+    
+    public init() {
+        self.name = nil
+        self.self_counts = (0, 0)
+        self.total = (0, 0)
+        self.self_delta = 0
+        self.total_delta = 0
+        self.z = 0
+        self.significant = false
+    }
+}
+
+// Profile Diff Stack (index 0 = A, 1 = B)
+public struct ProfileDiffStack {
+    public var node: UInt32
+    public var depth: UInt32
+    public var count: (UInt64, UInt64)
+    public var delta: Double
+    public var z: Double
+    public var significant: Bool
+    
+    public init() {
+        self.node = 0
+        self.depth = 0
+        self.count = (0, 0)
+        self.delta = 0
+        self.z = 0
+        self.significant = false
+    }
+}
@@ -29,21 +29,228 @@ func profiler_capture_all_stacks(
     _ traceCount: UnsafeMutablePointer<UInt32>
 ) -> Int32
 
+@_silgen_name("profiler_start_sampling")
+func profiler_start_sampling(_ target: UnsafeMutablePointer<ProfilerTarget>) -> Int32
+
+@_silgen_name("profiler_poll_samples")
+func profiler_poll_samples(
+    _ target: UnsafeMutablePointer<ProfilerTarget>,
+    _ samples: UnsafeMutablePointer<ProfilerSample>,
+    _ maxSamples: UInt32,
+    _ sampleCount: UnsafeMutablePointer<UInt32>
+) -> Int32
+
+@_silgen_name("profiler_poll_thread_events")
+func profiler_poll_thread_events(
+    _ target: UnsafeMutablePointer<ProfilerTarget>,
+    _ events: UnsafeMutablePointer<ThreadEvent>,
+    _ maxEvents: UInt32,
+    _ eventCount: UnsafeMutablePointer<UInt32>
+) -> Int32
+
+@_silgen_name("profiler_get_thread_info")
+func profiler_get_thread_info(
+    _ target: UnsafeMutablePointer<ProfilerTarget>,
+    _ threadNumber: UInt32,
+    _ record: UnsafeMutablePointer<ThreadRecord>
+) -> Int32
+
+@_silgen_name("profiler_get_stack")
+func profiler_get_stack(
+    _ target: UnsafeMutablePointer<ProfilerTarget>,
+    _ stackId: UInt32,
+    _ addresses: UnsafeMutablePointer<UInt64>,
+    _ maxAddresses: UInt32,
+    _ addressCount: UnsafeMutablePointer<UInt32>
+) -> Int32
+
+@_silgen_name("profiler_stop_sampling")
+func profiler_stop_sampling(_ target: UnsafeMutablePointer<ProfilerTarget>) -> Int32
+
+@_silgen_name("profiler_start_recording")
+func profiler_start_recording(
+    _ target: UnsafeMutablePointer<ProfilerTarget>,
+    _ path: UnsafePointer<CChar>
+) -> Int32
+
+@_silgen_name("profiler_stop_recording")
+func profiler_stop_recording(_ target: UnsafeMutablePointer<ProfilerTarget>) -> Int32
+
 @_silgen_name("profiler_get_stats")
 func profiler_get_stats(
     _ target: UnsafePointer<ProfilerTarget>,
     _ stats: UnsafeMutablePointer<ProfilerStats>
 )
 
+@_silgen_name("profiler_get_metric")
+func profiler_get_metric(
+    _ target: UnsafePointer<ProfilerTarget>,
+    _ metric: UInt32,
+    _ summary: UnsafeMutablePointer<HistogramSummary>
+) -> Int32
+
 @_silgen_name("profiler_print_thread_info")
 func profiler_print_thread_info(_ target: UnsafeMutablePointer<ProfilerTarget>)
 
-@_silgen_name("stack_walker_print")
-func stack_walker_print(_ trace: UnsafePointer<StackTrace>)
+@_silgen_name("profiler_trace_frames")
+func profiler_trace_frames(
+    _ target: UnsafePointer<ProfilerTarget>,
+    _ trace: UnsafePointer<StackTrace>
+) -> UnsafePointer<StackFrame>?
+
+@_silgen_name("profiler_symbolize")
+func profiler_symbolize(
+    _ target: UnsafeMutablePointer<ProfilerTarget>,
+    _ addresses: UnsafePointer<UInt64>,
+    _ count: UInt32,
+    _ symbols: UnsafeMutablePointer<SymbolInfo>
+) -> Int32
+
+@_silgen_name("profiler_demangle")
+func profiler_demangle(
+    _ target: UnsafeMutablePointer<ProfilerTarget>,
+    _ names: UnsafePointer<UnsafePointer<CChar>?>,
+    _ count: UInt32,
+    _ full: UnsafeMutablePointer<UnsafePointer<CChar>?>?,
+    _ simplified: UnsafeMutablePointer<UnsafePointer<CChar>?>?
+) -> Int32
+
+@_silgen_name("profiler_resolve_module")
+func profiler_resolve_module(
+    _ target: UnsafeMutablePointer<ProfilerTarget>,
+    _ address: UInt64,
+    _ path: UnsafeMutablePointer<CChar>?,
+    _ pathSize: Int,
+    _ offset: UnsafeMutablePointer<UInt64>?
+) -> Int32
+
+@_silgen_name("profiler_print_trace")
+func profiler_print_trace(
+    _ target: UnsafePointer<ProfilerTarget>,
+    _ trace: UnsafePointer<StackTrace>
+)
 
 @_silgen_name("profiler_detach")
 func profiler_detach(_ target: UnsafeMutablePointer<ProfilerTarget>)
 
+@_silgen_name("profiler_aggregate_samples")
+func profiler_aggregate_samples(
+    _ target: UnsafeMutablePointer<ProfilerTarget>,
+    _ samples: UnsafePointer<ProfilerSample>,
+    _ sampleCount: UInt32,
+    _ tree: OpaquePointer,
+    _ byFunction: Bool,
+    _ weight: UInt32
+) -> Int32
+
+@_silgen_name("call_tree_create")
+func call_tree_create() -> OpaquePointer?
+
+@_silgen_name("call_tree_destroy")
+func call_tree_destroy(_ tree: OpaquePointer)
+
+@_silgen_name("call_tree_clear")
+func call_tree_clear(_ tree: OpaquePointer)
+
+@_silgen_name("call_tree_add")
+func call_tree_add(
+    _ tree: OpaquePointer,
+    _ frames: UnsafePointer<UInt64>,
+    _ frameCount: UInt32,
+    _ weight: UInt64
+) -> Int32
+
+@_silgen_name("call_tree_merge")
+func call_tree_merge(_ tree: OpaquePointer, _ other: OpaquePointer) -> Int32
+
+@_silgen_name("call_tree_prune")
+func call_tree_prune(_ tree: OpaquePointer, _ minTotal: UInt64) -> UInt32
+
+@_silgen_name("call_tree_nodes")
+func call_tree_nodes(_ tree: OpaquePointer, _ view: UInt32) -> UnsafePointer<CallTreeNode>
+
+@_silgen_name("call_tree_node_count")
+func call_tree_node_count(_ tree: OpaquePointer, _ view: UInt32) -> UInt32
+
+@_silgen_name("call_tree_find_child")
+func call_tree_find_child(
+    _ tree: OpaquePointer,
+    _ view: UInt32,
+    _ parent: UInt32,
+    _ frame: UInt64
+) -> UInt32
+
+@_silgen_name("call_tree_top_functions")
+func call_tree_top_functions(
+    _ tree: OpaquePointer,
+    _ functions: UnsafeMutablePointer<CallTreeFunction>,
+    _ maxFunctions: UInt32
+) -> UInt32
+
+@_silgen_name("call_tree_total_weight")
+func call_tree_total_weight(_ tree: OpaquePointer) -> UInt64
+
+@_silgen_name("call_tree_function_count")
+func call_tree_function_count(_ tree: OpaquePointer) -> UInt32
+
+@_silgen_name("call_tree_memory_usage")
+func call_tree_memory_usage(_ tree: OpaquePointer) -> UInt64
+
+@_silgen_name("profile_diff_create")
+func profile_diff_create(
+    _ baselinePath: UnsafePointer<CChar>,
+    _ comparisonPath: UnsafePointer<CChar>,
+    _ options: UnsafePointer<ProfileDiffOptions>?
+) -> OpaquePointer?
+
+@_silgen_name("profile_diff_destroy")
+func profile_diff_destroy(_ diff: OpaquePointer)
+
+@_silgen_name("profile_diff_sample_count")
+func profile_diff_sample_count(_ diff: OpaquePointer, _ side: Int32) -> UInt64
+
+@_silgen_name("profile_diff_function_count")
+func profile_diff_function_count(_ diff: OpaquePointer) -> UInt32
+
+@_silgen_name("profile_diff_functions")
+func profile_diff_functions(
+    _ diff: OpaquePointer,
+    _ functions: UnsafeMutablePointer<ProfileDiffFunction>,
+    _ maxFunctions: UInt32
+) -> UInt32
+
+@_silgen_name("profile_diff_stack_count")
+func profile_diff_stack_count(_ diff: OpaquePointer) -> UInt32
+
+@_silgen_name("profile_diff_stacks")
+func profile_diff_stacks(
+    _ diff: OpaquePointer,
+    _ stacks: UnsafeMutablePointer<ProfileDiffStack>,
+    _ maxStacks: UInt32
+) -> UInt32
+
+@_silgen_name("profile_diff_stack_frames")
+func profile_diff_stack_frames(
+    _ diff: OpaquePointer,
+    _ node: UInt32,
+    _ names: UnsafeMutablePointer<UnsafePointer<CChar>?>,
+    _ maxNames: UInt32
+) -> UInt32
+
+@_silgen_name("profile_diff_write_flame_graph")
+func profile_diff_write_flame_graph(_ diff: OpaquePointer, _ path: UnsafePointer<CChar>) -> Int32
+
+@_silgen_name("profile_diff_write_folded")
+func profile_diff_write_folded(_ diff: OpaquePointer, _ path: UnsafePointer<CChar>) -> Int32
+
+@_silgen_name("pprof_export_recording")
+func pprof_export_recording(
+    _ recordingPath: UnsafePointer<CChar>,
+    _ outputPath: UnsafePointer<CChar>,
+    _ options: UnsafePointer<PprofOptions>?,
+    _ stats: UnsafeMutablePointer<PprofExportStats>?
+) -> Int32
+
 // MARK: - Swift Wrapper Class
 
 /// High-level Swift interface to the profiler
@@ -130,13 +337,231 @@ public class Profiler {
         return Array(traces.prefix(Int(traceCount)))
     }
     
+    /// Frames of a trace from the last capture call, without copying
+    /// Only valid until the next capture call or detach.
+    public func frames(of trace: StackTrace) -> UnsafeBufferPointer<StackFrame> {
+        let start = withUnsafePointer(to: trace) { tracePtr in
+            profiler_trace_frames(&target, tracePtr)
+        }
+        return UnsafeBufferPointer(start: start, count: start == nil ? 0 : Int(trace.frame_count))
+    }
+    
+    /// Frame addresses of a trace from the last capture call (copied)
+    public func frameAddresses(of trace: StackTrace) -> [UInt64] {
+        return frames(of: trace).map { $0.address }
+    }
+    
+    /// Start continuous sampling at the configured interval on a background thread
+    public func startSampling() throws {
+        guard isAttached else {
+            throw ProfilerError.notAttached
+        }
+        
+        let result = profiler_start_sampling(&target)
+        guard result == 0 else {
+            throw ProfilerError.samplingFailed(code: result)
+        }
+    }
+    
+    /// Drain up to `maxSamples` samples captured by the sampler
+    public func pollSamples(maxSamples: Int = 256) throws -> [ProfilerSample] {
+        guard isAttached else {
+            throw ProfilerError.notAttached
+        }
+        
+        var samples = [ProfilerSample](repeating: ProfilerSample(), count: maxSamples)
+        var sampleCount: UInt32 = 0
+        
+        let result = samples.withUnsafeMutableBufferPointer { buffer in
+            profiler_poll_samples(&target, buffer.baseAddress!, UInt32(maxSamples), &sampleCount)
+        }
+        
+        guard result == 0 else {
+            throw ProfilerError.samplingFailed(code: result)
+        }
+        
+        return Array(samples.prefix(Int(sampleCount)))
+    }
+    
+    /// Drain up to `maxEvents` thread created / exited events
+    /// Reported by every thread refresh when `trackThreads` is set.
+    public func pollThreadEvents(maxEvents: Int = 256) throws -> [ThreadEvent] {
+        guard isAttached else {
+            throw ProfilerError.notAttached
+        }
+        
+        var events = [ThreadEvent](repeating: ThreadEvent(), count: maxEvents)
+        var eventCount: UInt32 = 0
+        
+        let result = events.withUnsafeMutableBufferPointer { buffer in
+            profiler_poll_thread_events(&target, buffer.baseAddress!, UInt32(maxEvents), &eventCount)
+        }
+        
+        guard result == 0 else {
+            throw ProfilerError.samplingFailed(code: result)
+        }
+        
+        return Array(events.prefix(Int(eventCount)))
+    }
+    
+    /// Cached ID, name, queue label and priority of a live thread
+    /// Looked up once when the thread is first seen; nil once it has exited.
+    public func threadInfo(number: UInt32) -> ThreadInfo? {
+        guard isAttached else { return nil }
+        
+        var record = ThreadRecord()
+        guard profiler_get_thread_info(&target, number, &record) == 0 else { return nil }
+        
+        return ThreadInfo(from: record)
+    }
+    
+    /// Add polled samples to a call tree
+    /// Samples sharing a stack are added once with their count, or with
+    /// their summed CPU time in nanoseconds for `weight: .cpuTime`. With
+    /// `byFunction`, frames are keyed by the start address of their
+    /// function, so `CallTree.topFunctions` ranks functions rather than
+    /// individual instructions.
+    public func aggregate(
+        _ samples: [ProfilerSample],
+        into tree: CallTree,
+        byFunction: Bool = true,
+        weight: SampleWeight = .samples
+    ) throws {
+        guard isAttached else {
+            throw ProfilerError.notAttached
+        }
+        guard !samples.isEmpty else { return }
+        
+        let result = samples.withUnsafeBufferPointer { buffer in
+            profiler_aggregate_samples(&target, buffer.baseAddress!, UInt32(buffer.count), tree.handle, byFunction, weight.rawValue)
+        }
+        guard result == 0 else {
+            throw ProfilerError.aggregationFailed(code: result)
+        }
+    }
+    
+    /// Frame addresses (innermost first) of an interned stack
+    public func stackAddresses(for stackId: UInt32, maxDepth: Int = 512) -> [UInt64] {
+        guard isAttached, maxDepth > 0 else { return [] }
+        
+        var addresses = [UInt64](repeating: 0, count: maxDepth)
+        var count: UInt32 = 0
+        let result = addresses.withUnsafeMutableBufferPointer { buffer in
+            profiler_get_stack(&target, stackId, buffer.baseAddress!, UInt32(maxDepth), &count)
+        }
+        guard result == 0 else { return [] }
+        
+        return Array(addresses.prefix(Int(count)))
+    }
+    
+    /// Resolve frame addresses to symbols
+    /// Frames after the first hold return addresses; pass
+    /// `returnAddresses: true` to look those up at address - 1 so calls at
+    /// the very end of a function resolve to the caller.
+    public func symbolize(_ addresses: [UInt64], returnAddresses: Bool = false) -> [Symbol] {
+        guard isAttached, !addresses.isEmpty else { return [] }
+        
+        let lookups = returnAddresses
+            ? addresses.enumerated().map { $0.offset > 0 && $0.element > 0 ? $0.element - 1 : $0.element }
+            : addresses
+        var infos = [SymbolInfo](repeating: SymbolInfo(), count: addresses.count)
+        let result = lookups.withUnsafeBufferPointer { lookupBuffer in
+            infos.withUnsafeMutableBufferPointer { infoBuffer in
+                profiler_symbolize(&target, lookupBuffer.baseAddress!, UInt32(addresses.count), infoBuffer.baseAddress!)
+            }
+        }
+        guard result == 0 else {
+            return addresses.map { Symbol(address: $0, name: nil, module: nil, offset: 0) }
+        }
+        
+        // Demangle the batch in one call; the Core memoizes every name
+        let names = infos.map { $0.name }
+        var full = [UnsafePointer<CChar>?](repeating: nil, count: names.count)
+        var simplified = [UnsafePointer<CChar>?](repeating: nil, count: names.count)
+        let demangled = names.withUnsafeBufferPointer { nameBuffer in
+            full.withUnsafeMutableBufferPointer { fullBuffer in
+                simplified.withUnsafeMutableBufferPointer { simplifiedBuffer in
+                    profiler_demangle(&target, nameBuffer.baseAddress!, UInt32(names.count),
+                                      fullBuffer.baseAddress, simplifiedBuffer.baseAddress)
+                }
+            }
+        }
+        
+        return addresses.indices.map { index in
+            Symbol(from: infos[index], address: addresses[index],
+                   demangled: demangled == 0 ? full[index] : nil,
+                   simplified: demangled == 0 ? simplified[index] : nil)
+        }
+    }
+    
+    /// Module containing a code address, and the address relative to its load address
+    public func module(containing address: UInt64) -> (path: String, offset: UInt64)? {
+        guard isAttached else { return nil }
+        
+        var path = [CChar](repeating: 0, count: Int(PATH_MAX))
+        var offset: UInt64 = 0
+        let result = path.withUnsafeMutableBufferPointer { buffer in
+            profiler_resolve_module(&target, address, buffer.baseAddress, buffer.count, &offset)
+        }
+        guard result == 0 else { return nil }
+        
+        return (String(cString: path), offset)
+    }
+    
+    /// Stop continuous sampling (buffered samples can still be polled)
+    public func stopSampling() throws {
+        guard isAttached else {
+            throw ProfilerError.notAttached
+        }
+        
+        let result = profiler_stop_sampling(&target)
+        guard result == 0 else {
+            throw ProfilerError.samplingFailed(code: result)
+        }
+    }
+    
+    /// Sample into a binary recording file until `stopRecording()`
+    /// A Core writer thread consumes the samples, so `pollSamples()` is
+    /// unavailable meanwhile.
+    public func startRecording(to path: String) throws {
+        guard isAttached else {
+            throw ProfilerError.notAttached
+        }
+        
+        let result = path.withCString { profiler_start_recording(&target, $0) }
+        guard result == 0 else {
+            throw ProfilerError.recordingFailed(code: result)
+        }
+    }
+    
+    /// Stop sampling and finish the recording file
+    public func stopRecording() throws {
+        guard isAttached else {
+            throw ProfilerError.notAttached
+        }
+        
+        let result = profiler_stop_recording(&target)
+        guard result == 0 else {
+            throw ProfilerError.recordingFailed(code: result)
+        }
+    }
+    
     /// Get profiler statistics
     public func getStats() -> Stats {
         var cStats = ProfilerStats()
         withUnsafePointer(to: target) { targetPtr in
             profiler_get_stats(targetPtr, &cStats)
         }
-        return Stats(from: cStats)
+        return Stats(from: cStats, overhead: getMetric)
+    }
+    
+    /// Distribution of one overhead metric since attach
+    public func getMetric(_ metric: Metric) -> Distribution {
+        var summary = HistogramSummary()
+        withUnsafePointer(to: target) { targetPtr in
+            _ = profiler_get_metric(targetPtr, metric.rawValue, &summary)
+        }
+        return Distribution(from: summary)
     }
     
     /// Print thread information (for debugging)
@@ -150,8 +575,9 @@ public class Profiler {
     
     /// Print a stack trace (for debugging)
     public func printStackTrace(_ trace: StackTrace) {
-        var mutableTrace = trace
-        stack_walker_print(&mutableTrace)
+        withUnsafePointer(to: trace) { tracePtr in
+            profiler_print_trace(&target, tracePtr)
+        }
     }
     
     /// Detach from the process
@@ -177,19 +603,44 @@ extension Profiler {
         public var trackAsync: Bool
         public var trackThreads: Bool
         public var stackStrategy: StackWalkStrategy
+        /// Bytes of stack copied from SP in one read (0 = one read per frame)
+        public var stackWindowSize: UInt32
+        /// Samples buffered between pollSamples calls while sampling
+        public var sampleBufferSize: UInt32
+        /// Threads walking stacks in parallel during an all-thread capture
+        public var captureWorkers: UInt32
+        /// Stop the whole target once per capture and unwind from copies
+        public var snapshotMode: Bool
+        /// Which threads the continuous sampler walks
+        public var samplingMode: SamplingMode
+        /// Walk threads without stopping them where possible, discarding
+        /// walks that raced the thread (ignored in snapshot mode)
+        public var optimisticCapture: Bool
         
         public init(
             sampleIntervalMs: UInt32 = 10,
             maxStackDepth: UInt32 = 512,
             trackAsync: Bool = false,
             trackThreads: Bool = true,
-            stackStrategy: StackWalkStrategy = .framePointer
+            stackStrategy: StackWalkStrategy = .framePointer,
+            stackWindowSize: UInt32 = 32 * 1024,
+            sampleBufferSize: UInt32 = 1024,
+            captureWorkers: UInt32 = 4,
+            snapshotMode: Bool = false,
+            samplingMode: SamplingMode = .wallClock,
+            optimisticCapture: Bool = false
         ) {
             self.sampleIntervalMs = sampleIntervalMs
             self.maxStackDepth = maxStackDepth
             self.trackAsync = trackAsync
             self.trackThreads = trackThreads
             self.stackStrategy = stackStrategy
+            self.stackWindowSize = stackWindowSize
+            self.sampleBufferSize = sampleBufferSize
+            self.captureWorkers = captureWorkers
+            self.snapshotMode = snapshotMode
+            self.samplingMode = samplingMode
+            self.optimisticCapture = optimisticCapture
         }
         
         func toCStruct() -> ProfilerConfig {
@@ -198,7 +649,13 @@ extension Profiler {
                 max_stack_depth: maxStackDepth,
                 track_async: trackAsync,
                 track_threads: trackThreads,
-                stack_strategy: stackStrategy.rawValue
+                stack_strategy: stackStrategy.rawValue,
+                stack_window_size: stackWindowSize,
+                sample_buffer_size: sampleBufferSize,
+                capture_workers: captureWorkers,
+                snapshot_mode: snapshotMode,
+                sampling_mode: samplingMode.rawValue,
+                optimistic_capture: optimisticCapture
             )
         }
     }
@@ -208,17 +665,165 @@ extension Profiler {
         case libunwind = 1
         case hybrid = 2
     }
+    
+    public enum SamplingMode: UInt32 {
+        /// Every thread, each sample tagged with the thread's run state
+        case wallClock = 0
+        /// Only threads that are running or runnable
+        case cpu = 1
+    }
+    
+    public enum SampleWeight: UInt32 {
+        /// 1 per sample
+        case samples = 0
+        /// CPU time the thread used since its previous sample
+        case cpuTime = 1
+    }
+    
+    /// Overhead measured on every capture (ProfilerMetric)
+    public enum Metric: UInt32, CaseIterable {
+        /// Stopping a thread, or a snapshot's whole task (ns)
+        case suspendTime = 0
+        /// Reading or peeking a thread's registers (ns)
+        case registerTime = 1
+        /// Reads of target memory per walked sample (ns)
+        case readTime = 2
+        /// Unwinding without its reads per walked sample (ns)
+        case walkTime = 3
+        /// Restarting a stopped thread or task (ns)
+        case resumeTime = 4
+        /// How long a stop kept threads from running (ns)
+        case threadPause = 5
+        /// Profiler work around the walker per capture call or tick (ns)
+        case bookkeepingTime = 6
+        /// Reads issued per walked sample
+        case remoteReadsPerSample = 7
+        /// Bytes copied from the target per walked sample
+        case bytesPerSample = 8
+    }
+    
+    /// Scheduler state of a sampled thread (PlatformRunState)
+    public enum RunState: UInt32, CustomStringConvertible {
+        case running = 0
+        case stopped = 1
+        case waiting = 2
+        case uninterruptible = 3
+        case halted = 4
+        case unknown = 5
+        
+        public var description: String {
+            switch self {
+            case .running: return "running"
+            case .stopped: return "stopped"
+            case .waiting: return "waiting"
+            case .uninterruptible: return "uninterruptible"
+            case .halted: return "halted"
+            case .unknown: return "unknown"
+            }
+        }
+    }
+}
+
+extension ProfilerSample {
+    public var runState: Profiler.RunState {
+        return Profiler.RunState(rawValue: run_state) ?? .unknown
+    }
 }
 
 // MARK: - Swift Statistics
 
 extension Profiler {
+    /// Distribution of an overhead metric; percentiles are within 6.25%
+    public struct Distribution {
+        public let count: UInt64
+        public let total: UInt64
+        public let min: UInt64
+        public let max: UInt64
+        public let p50: UInt64
+        public let p90: UInt64
+        public let p99: UInt64
+        public let p999: UInt64
+        
+        public var mean: Double {
+            guard count > 0 else { return 0.0 }
+            return Double(total) / Double(count)
+        }
+        
+        init(from summary: HistogramSummary) {
+            self.count = summary.count
+            self.total = summary.total
+            self.min = summary.min
+            self.max = summary.max
+            self.p50 = summary.p50
+            self.p90 = summary.p90
+            self.p99 = summary.p99
+            self.p999 = summary.p999
+        }
+    }
+    
     public struct Stats {
         public let totalSamples: UInt64
         public let successfulSamples: UInt64
         public let failedSamples: UInt64
         public let totalFrames: UInt64
         public let uniqueAddresses: UInt64
+        public let uniqueStacks: UInt64
+        public let remoteReads: UInt64
+        /// Remote reads that came back short or faulted
+        public let failedReads: UInt64
+        /// Reads and addresses the region map ruled out without a syscall
+        public let rejectedReads: UInt64
+        public let regionScans: UInt64
+        /// Kernel calls made by captures (suspend, registers, reads, resume)
+        public let kernelCalls: UInt64
+        public let threadsCreated: UInt64
+        public let threadsExited: UInt64
+        public let droppedThreadEvents: UInt64
+        public let missedDeadlines: UInt64
+        public let droppedSamples: UInt64
+        public let recordedSamples: UInt64
+        public let recordedBytes: UInt64
+        public let lastBatchSkewNs: UInt64
+        public let maxBatchSkewNs: UInt64
+        public let snapshotCount: UInt64
+        public let totalPauseNs: UInt64
+        public let maxPauseNs: UInt64
+        /// Snapshot pauses per bucket: [0] < 1us, [i] in [2^(i-1), 2^i) us
+        public let pauseHistogram: [UInt64]
+        /// Threads CPU-mode ticks did not walk because they were idle
+        public let skippedIdleThreads: UInt64
+        /// CPU time the successful samples stand for
+        public let sampledCpuTimeNs: UInt64
+        /// Samples that reused the stack of a thread that had not moved
+        public let unchangedSamples: UInt64
+        /// Frames copied from a thread's previous walk instead of read
+        public let cachedFrames: UInt64
+        /// Captures that stopped a single thread, and for how long in total
+        public let stoppedCaptures: UInt64
+        public let threadPauseNs: UInt64
+        /// Samples walked without stopping the thread
+        public let optimisticSamples: UInt64
+        /// Unstopped walks repeated because the thread moved during the walk
+        public let optimisticRetries: UInt64
+        /// Samples dropped because every unstopped walk was torn
+        public let discardedSamples: UInt64
+        /// Time per capture phase
+        public let suspendTime: Distribution
+        public let registerTime: Distribution
+        public let readTime: Distribution
+        public let walkTime: Distribution
+        public let resumeTime: Distribution
+        /// How long each stop kept threads from running
+        public let threadPause: Distribution
+        /// Profiler work around the walker per capture call or tick
+        public let bookkeepingTime: Distribution
+        public let remoteReadsPerSample: Distribution
+        public let bytesPerSample: Distribution
+        
+        public var averagePauseNs: Double {
+            guard snapshotCount > 0 else { return 0.0 }
+            return Double(totalPauseNs) / Double(snapshotCount)
+        }
         
         public var successRate: Double {
             guard totalSamples > 0 else { return 0.0 }
@@ -230,16 +835,472 @@ extension Profiler {
             return Double(totalFrames) / Double(successfulSamples)
         }
         
-        init(from cStats: ProfilerStats) {
+        /// Share of successful samples that needed no walk
+        public var unchangedRate: Double {
+            guard successfulSamples > 0 else { return 0.0 }
+            return Double(unchangedSamples) / Double(successfulSamples)
+        }
+        
+        /// Share of sampled frames copied from a thread's previous walk
+        /// (stacks reused whole by unchanged samples count as not copied)
+        public var cachedFrameRate: Double {
+            guard totalFrames > 0 else { return 0.0 }
+            return Double(cachedFrames) / Double(totalFrames)
+        }
+        
+        /// Share of unstopped samples that were discarded
+        public var discardRate: Double {
+            let attempted = optimisticSamples + discardedSamples
+            guard attempted > 0 else { return 0.0 }
+            return Double(discardedSamples) / Double(attempted)
+        }
+        
+        /// Stop time the unstopped samples avoided, at the average stop of
+        /// the threads that were stopped (0 if none was)
+        public var estimatedPauseSavedNs: Double {
+            guard stoppedCaptures > 0 else { return 0.0 }
+            return Double(optimisticSamples) * Double(threadPauseNs) / Double(stoppedCaptures)
+        }
+        
+        public var averageRemoteReadsPerSample: Double {
+            guard successfulSamples > 0 else { return 0.0 }
+            return Double(remoteReads) / Double(successfulSamples)
+        }
+        
+        public var averageKernelCallsPerSample: Double {
+            guard totalSamples > 0 else { return 0.0 }
+            return Double(kernelCalls) / Double(totalSamples)
+        }
+        
+        init(from cStats: ProfilerStats, overhead: (Metric) -> Distribution) {
             self.totalSamples = cStats.total_samples
             self.successfulSamples = cStats.successful_samples
             self.failedSamples = cStats.failed_samples
             self.totalFrames = cStats.total_frames
             self.uniqueAddresses = cStats.unique_addresses
+            self.uniqueStacks = cStats.unique_stacks
+            self.remoteReads = cStats.remote_reads
+            self.failedReads = cStats.failed_reads
+            self.rejectedReads = cStats.rejected_reads
+            self.regionScans = cStats.region_scans
+            self.kernelCalls = cStats.kernel_calls
+            self.threadsCreated = cStats.threads_created
+            self.threadsExited = cStats.threads_exited
+            self.droppedThreadEvents = cStats.dropped_thread_events
+            self.missedDeadlines = cStats.missed_deadlines
+            self.droppedSamples = cStats.dropped_samples
+            self.recordedSamples = cStats.recorded_samples
+            self.recordedBytes = cStats.recorded_bytes
+            self.lastBatchSkewNs = cStats.last_batch_skew_ns
+            self.maxBatchSkewNs = cStats.max_batch_skew_ns
+            self.snapshotCount = cStats.snapshot_count
+            self.totalPauseNs = cStats.total_pause_ns
+            self.maxPauseNs = cStats.max_pause_ns
+            self.pauseHistogram = withUnsafeBytes(of: cStats.pause_histogram) {
+                Array($0.bindMemory(to: UInt64.self))
+            }
+            self.skippedIdleThreads = cStats.skipped_idle_threads
+            self.sampledCpuTimeNs = cStats.sampled_cpu_time_ns
+            self.unchangedSamples = cStats.unchanged_samples
+            self.cachedFrames = cStats.cached_frames
+            self.stoppedCaptures = cStats.stopped_captures
+            self.threadPauseNs = cStats.thread_pause_ns
+            self.optimisticSamples = cStats.optimistic_samples
+            self.optimisticRetries = cStats.optimistic_retries
+            self.discardedSamples = cStats.discarded_samples
+            self.suspendTime = overhead(.suspendTime)
+            self.registerTime = overhead(.registerTime)
+            self.readTime = overhead(.readTime)
+            self.walkTime = overhead(.walkTime)
+            self.resumeTime = overhead(.resumeTime)
+            self.threadPause = overhead(.threadPause)
+            self.bookkeepingTime = overhead(.bookkeepingTime)
+            self.remoteReadsPerSample = overhead(.remoteReadsPerSample)
+            self.bytesPerSample = overhead(.bytesPerSample)
+        }
+    }
+}
+
+// MARK: - Swift Thread Info
+
+extension Profiler {
+    public struct ThreadInfo {
+        public let number: UInt32
+        public let threadId: UInt64
+        /// Thread name ("" if unnamed)
+        public let name: String
+        /// Dispatch queue the thread was serving when first seen ("" if none)
+        public let queueLabel: String
+        /// QOS_CLASS_* value (0 when unknown)
+        public let qos: UInt32
+        public let priority: Int32
+        
+        init(from record: ThreadRecord) {
+            self.number = record.thread_number
+            self.threadId = record.thread_id
+            self.name = withUnsafeBytes(of: record.name) { String(cString: $0.bindMemory(to: CChar.self).baseAddress!) }
+            self.queueLabel = withUnsafeBytes(of: record.queue_label) { String(cString: $0.bindMemory(to: CChar.self).baseAddress!) }
+            self.qos = record.qos
+            self.priority = record.priority
+        }
+    }
+}
+
+// MARK: - Swift Symbols
+
+extension Profiler {
+    public struct Symbol: CustomStringConvertible {
+        public let address: UInt64
+        /// Symbol name as stored in the binary (nil if unknown)
+        public let name: String?
+        /// Path of the containing module (nil if outside every module)
+        public let module: String?
+        /// Distance from the start of the symbol (or of the module when name is nil)
+        public let offset: UInt64
+        /// Full demangled name (same as name when it is not mangled)
+        public let demangledName: String?
+        /// Short "Module.Type.method" form of the demangled name
+        public let simplifiedName: String?
+        
+        public init(address: UInt64, name: String?, module: String?, offset: UInt64,
+                    demangledName: String? = nil, simplifiedName: String? = nil) {
+            self.address = address
+            self.name = name
+            self.module = module
+            self.offset = offset
+            self.demangledName = demangledName ?? name
+            self.simplifiedName = simplifiedName ?? name
+        }
+        
+        init(from info: SymbolInfo, address: UInt64,
+             demangled: UnsafePointer<CChar>?, simplified: UnsafePointer<CChar>?) {
+            self.address = address
+            self.name = info.name.map { String(cString: $0) }
+            self.module = info.module.map { String(cString: $0) }
+            self.demangledName = demangled.map { String(cString: $0) } ?? self.name
+            self.simplifiedName = simplified.map { String(cString: $0) } ?? self.name
+            if info.name != nil {
+                self.offset = address &- info.symbol_address
+            } else {
+                self.offset = info.module != nil ? address &- info.module_base : 0
+            }
+        }
+        
+        public var description: String {
+            let moduleName = module.map { ($0 as NSString).lastPathComponent }
+            if let name = simplifiedName ?? name {
+                return "\(name) + \(offset)" + (moduleName.map { " (\($0))" } ?? "")
+            }
+            if let moduleName = moduleName {
+                return "\(moduleName) + 0x\(String(offset, radix: 16))"
+            }
+            return "0x\(String(address, radix: 16))"
+        }
+    }
+}
+
+// MARK: - Swift Call Trees
+
+/// Top-down, bottom-up and flat aggregation of stacks, updated as they
+/// arrive (see call_tree.h). Not thread-safe.
+public final class CallTree {
+    public enum View: UInt32 {
+        /// Rooted at the outermost frame
+        case topDown = 0
+        /// Rooted at the innermost frame, running out towards the callers
+        case bottomUp = 1
+    }
+    
+    /// Node ID of the root of both views
+    public static let root: UInt32 = 0
+    
+    public struct Node {
+        public let id: UInt32
+        public let frame: UInt64
+        /// Weight of stacks that end at this node
+        public let selfWeight: UInt64
+        /// Weight of stacks that pass through it
+        public let totalWeight: UInt64
+        public let parent: UInt32
+        public let depth: UInt32
+    }
+    
+    public struct Function {
+        public let frame: UInt64
+        /// Weight of stacks with this frame innermost
+        public let selfWeight: UInt64
+        /// Weight of stacks containing it (once per stack, even if recursive)
+        public let totalWeight: UInt64
+    }
+    
+    let handle: OpaquePointer
+    
+    public init?() {
+        guard let handle = call_tree_create() else { return nil }
+        self.handle = handle
+    }
+    
+    deinit {
+        call_tree_destroy(handle)
+    }
+    
+    /// Add a stack (frames innermost first)
+    @discardableResult
+    public func add(_ frames: [UInt64], weight: UInt64 = 1) -> Bool {
+        guard !frames.isEmpty else { return true }
+        return frames.withUnsafeBufferPointer { buffer in
+            call_tree_add(handle, buffer.baseAddress!, UInt32(buffer.count), weight)
+        } == 0
+    }
+    
+    /// Add every stack of another tree
+    @discardableResult
+    public func merge(_ other: CallTree) -> Bool {
+        return call_tree_merge(handle, other.handle) == 0
+    }
+    
+    /// Drop nodes and functions whose total weight is below `minTotal`
+    /// Node IDs are renumbered.
+    /// - Returns: Number of nodes removed
+    @discardableResult
+    public func prune(minTotal: UInt64) -> Int {
+        return Int(call_tree_prune(handle, minTotal))
+    }
+    
+    /// Remove every stack
+    public func clear() {
+        call_tree_clear(handle)
+    }
+    
+    /// Weight of every stack added
+    public var totalWeight: UInt64 {
+        return call_tree_total_weight(handle)
+    }
+    
+    /// Distinct frames
+    public var functionCount: Int {
+        return Int(call_tree_function_count(handle))
+    }
+    
+    public var memoryUsage: UInt64 {
+        return call_tree_memory_usage(handle)
+    }
+    
+    public func nodeCount(view: View) -> Int {
+        return Int(call_tree_node_count(handle, view.rawValue))
+    }
+    
+    /// The heaviest frames by self weight, heaviest first
+    public func topFunctions(_ count: Int) -> [Function] {
+        guard count > 0 else { return [] }
+        
+        var functions = [CallTreeFunction](repeating: CallTreeFunction(), count: count)
+        let written = functions.withUnsafeMutableBufferPointer { buffer in
+            call_tree_top_functions(handle, buffer.baseAddress!, UInt32(count))
+        }
+        return functions.prefix(Int(written)).map {
+            Function(frame: $0.frame, selfWeight: $0.self_weight, totalWeight: $0.total)
+        }
+    }
+    
+    /// A node by ID (nil if out of range)
+    public func node(_ id: UInt32, view: View) -> Node? {
+        guard id < call_tree_node_count(handle, view.rawValue) else { return nil }
+        let node = call_tree_nodes(handle, view.rawValue)[Int(id)]
+        return Node(id: id, frame: node.frame, selfWeight: node.self_weight,
+                    totalWeight: node.total, parent: node.parent, depth: node.depth)
+    }
+    
+    /// Children of a node, heaviest first
+    public func children(of id: UInt32 = CallTree.root, view: View) -> [Node] {
+        let count = call_tree_node_count(handle, view.rawValue)
+        guard id < count else { return [] }
+        
+        let nodes = call_tree_nodes(handle, view.rawValue)
+        var result: [Node] = []
+        var child = nodes[Int(id)].first_child
+        while child < count {
+            let node = nodes[Int(child)]
+            result.append(Node(id: child, frame: node.frame, selfWeight: node.self_weight,
+                               totalWeight: node.total, parent: node.parent, depth: node.depth))
+            child = node.next_sibling
+        }
+        return result.sorted { $0.totalWeight > $1.totalWeight }
+    }
+    
+    /// Child of a node for a frame
+    public func child(of id: UInt32 = CallTree.root, frame: UInt64, view: View) -> Node? {
+        return node(call_tree_find_child(handle, view.rawValue, id, frame), view: view)
+    }
+}
+
+// MARK: - Swift Profile Comparison
+
+/// Two recordings compared frame by frame, aligned by symbol name (see
+/// profile_diff.h). Fractions are of each side's samples; deltas are
+/// comparison minus baseline, so positive means more time.
+public final class ProfileComparison {
+    public struct FunctionDelta {
+        public let name: String
+        public let baselineSelf: UInt64
+        public let comparisonSelf: UInt64
+        public let baselineTotal: UInt64
+        public let comparisonTotal: UInt64
+        public let selfDelta: Double
+        public let totalDelta: Double
+        public let z: Double
+        public let significant: Bool
+    }
+    
+    public struct StackDelta {
+        /// Innermost first
+        public let frames: [String]
+        public let baselineCount: UInt64
+        public let comparisonCount: UInt64
+        public let delta: Double
+        public let z: Double
+        public let significant: Bool
+    }
+    
+    let handle: OpaquePointer
+    
+    /// Load and compare two recordings
+    /// - Parameter minZ: |z| at which a change counts as significant
+    public init(baseline: String, comparison: String, minZ: Double = 3.29) throws {
+        var options = ProfileDiffOptions()
+        options.min_z = minZ
+        let handle = baseline.withCString { baselinePtr in
+            comparison.withCString { comparisonPtr in
+                profile_diff_create(baselinePtr, comparisonPtr, &options)
+            }
+        }
+        guard let handle = handle else {
+            throw ProfilerError.diffFailed(code: -1)
+        }
+        self.handle = handle
+    }
+    
+    deinit {
+        profile_diff_destroy(handle)
+    }
+    
+    public var baselineSamples: UInt64 {
+        return profile_diff_sample_count(handle, 0)
+    }
+    
+    public var comparisonSamples: UInt64 {
+        return profile_diff_sample_count(handle, 1)
+    }
+    
+    /// Every function, from the largest regression to the largest improvement
+    public func functions() -> [FunctionDelta] {
+        let count = Int(profile_diff_function_count(handle))
+        guard count > 0 else { return [] }
+        
+        var entries = [ProfileDiffFunction](repeating: ProfileDiffFunction(), count: count)
+        let written = entries.withUnsafeMutableBufferPointer { buffer in
+            profile_diff_functions(handle, buffer.baseAddress!, UInt32(count))
+        }
+        return entries.prefix(Int(written)).map {
+            FunctionDelta(name: $0.name.map { String(cString: $0) } ?? "?",
+                          baselineSelf: $0.self_counts.0, comparisonSelf: $0.self_counts.1,
+                          baselineTotal: $0.total.0, comparisonTotal: $0.total.1,
+                          selfDelta: $0.self_delta, totalDelta: $0.total_delta,
+                          z: $0.z, significant: $0.significant)
+        }
+    }
+    
+    /// Every distinct stack, ordered like `functions()`
+    public func stacks(maxDepth: Int = 64) -> [StackDelta] {
+        let count = Int(profile_diff_stack_count(handle))
+        guard count > 0, maxDepth > 0 else { return [] }
+        
+        var entries = [ProfileDiffStack](repeating: ProfileDiffStack(), count: count)
+        let written = entries.withUnsafeMutableBufferPointer { buffer in
+            profile_diff_stacks(handle, buffer.baseAddress!, UInt32(count))
+        }
+        
+        var names = [UnsafePointer<CChar>?](repeating: nil, count: maxDepth)
+        return entries.prefix(Int(written)).map { entry in
+            let depth = names.withUnsafeMutableBufferPointer { buffer in
+                profile_diff_stack_frames(handle, entry.node, buffer.baseAddress!, UInt32(maxDepth))
+            }
+            let frames = names.prefix(Int(depth)).map { $0.map { String(cString: $0) } ?? "?" }
+            return StackDelta(frames: frames, baselineCount: entry.count.0, comparisonCount: entry.count.1,
+                              delta: entry.delta, z: entry.z, significant: entry.significant)
+        }
+    }
+    
+    /// Write a differential flame graph (SVG)
+    public func writeFlameGraph(to path: String) throws {
+        let result = path.withCString { profile_diff_write_flame_graph(handle, $0) }
+        guard result == 0 else {
+            throw ProfilerError.diffFailed(code: result)
+        }
+    }
+    
+    /// Write the stacks as two-column folded text for flamegraph.pl
+    public func writeFolded(to path: String) throws {
+        let result = path.withCString { profile_diff_write_folded(handle, $0) }
+        guard result == 0 else {
+            throw ProfilerError.diffFailed(code: result)
         }
     }
 }
 
+// MARK: - Swift Export
+
+extension Profiler {
+    /// What a pprof export wrote
+    public struct ExportStats {
+        public let samples: UInt64
+        public let bytes: UInt64
+        /// Distinct pprof samples (stack, and thread if labelled)
+        public let stacks: UInt32
+        public let locations: UInt32
+        public let functions: UInt32
+        public let mappings: UInt32
+        
+        init(from stats: PprofExportStats) {
+            self.samples = stats.samples
+            self.bytes = stats.bytes
+            self.stacks = stats.stacks
+            self.locations = stats.locations
+            self.functions = stats.functions
+            self.mappings = stats.mappings
+        }
+    }
+    
+    /// Convert a recording into a pprof profile (no attached process needed)
+    /// - Parameters:
+    ///   - threadLabels: Keep threads apart with "thread" labels
+    ///   - compress: gzip the output, as pprof tools expect
+    ///   - stateLabels: Keep run states apart with "thread_state" labels
+    public static func exportPprof(
+        recording: String,
+        to path: String,
+        threadLabels: Bool = true,
+        compress: Bool = true,
+        stateLabels: Bool = true
+    ) throws -> ExportStats {
+        var options = PprofOptions()
+        options.thread_labels = threadLabels
+        options.compress = compress
+        options.state_labels = stateLabels
+        
+        var stats = PprofExportStats()
+        let result = recording.withCString { recordingPtr in
+            path.withCString { pathPtr in
+                pprof_export_recording(recordingPtr, pathPtr, &options, &stats)
+            }
+        }
+        guard result == 0 else {
+            throw ProfilerError.exportFailed(code: result)
+        }
+        return ExportStats(from: stats)
+    }
+}
+
 // MARK: - Errors
 
 public enum ProfilerError: Error, CustomStringConvertible {
@@ -247,6 +1308,11 @@ public enum ProfilerError: Error, CustomStringConvertible {
     case notAttached
     case threadRefreshFailed(code: Int32)
     case stackCaptureFailed(code: Int32)
+    case samplingFailed(code: Int32)
+    case recordingFailed(code: Int32)
+    case exportFailed(code: Int32)
+    case aggregationFailed(code: Int32)
+    case diffFailed(code: Int32)
     case invalidThreadIndex(index: Int, max: Int)
     
     public var description: String {
@@ -259,6 +1325,16 @@ public enum ProfilerError: Error, CustomStringConvertible {
             return "Failed to refresh threads (error code: \(code))"
         case .stackCaptureFailed(let code):
             return "Failed to capture stack trace (error code: \(code))"
+        case .samplingFailed(let code):
+            return "Sampling failed (error code: \(code))"
+        case .recordingFailed(let code):
+            return "Recording failed (error code: \(code))"
+        case .exportFailed(let code):
+            return "Export failed (error code: \(code))"
+        case .aggregationFailed(let code):
+            return "Aggregation failed (error code: \(code))"
+        case .diffFailed(let code):
+            return "Comparison failed (error code: \(code))"
         case .invalidThreadIndex(let index, let max):
             return "Invalid thread index \(index) (valid range: 0-\(max))"
         }
@@ -268,19 +1344,12 @@ public enum ProfilerError: Error, CustomStringConvertible {
 // MARK: - Helper Extensions
 
 extension StackTrace {
-    /// Get all frame addresses as an array
-    public var frameAddresses: [UInt64] {
-        let mirror = Mirror(reflecting: frames)
-        let allFrames = mirror.children.map { $0.value as! StackFrame }
-        return allFrames.prefix(Int(frame_count)).map { $0.address }
-    }
-    
     /// Get a readable description
     public var description: String {
-        var result = "Thread \(thread_id) (\(frame_count) frames)"
+        var result = "Thread #\(thread_number) [\(thread_id)] (\(frame_count) frames)"
         if timestamp_ns > 0 {
             result += " @ \(timestamp_ns)ns"
         }
         return result
     }
-}
\ No newline at end of file
+}
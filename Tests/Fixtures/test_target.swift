@@ -2,6 +2,15 @@ import Foundation
 
 // Test program with interesting stack traces
 
+/// Thread identifier as the profiler reports it (Mach port or Linux tid)
+func currentThreadID() -> UInt32 {
+    #if os(Linux)
+    return UInt32(gettid())
+    #else
+    return pthread_mach_thread_np(pthread_self())
+    #endif
+}
+
 class Worker {
     let id: Int
     
@@ -34,7 +43,7 @@ class Worker {
     }
     
     func run() {
-        print("Worker \(id) started on thread \(pthread_mach_thread_np(pthread_self()))")
+        print("Worker \(id) started on thread \(currentThreadID())")
         while true {
             level1()
         }
@@ -42,7 +51,7 @@ class Worker {
 }
 
 func computeTask() {
-    print("Compute task started on thread \(pthread_mach_thread_np(pthread_self()))")
+    print("Compute task started on thread \(currentThreadID())")
     while true {
         // Different stack depth
         var result = 0.0
@@ -61,7 +70,7 @@ struct TestTarget {
         print("╚══════════════════════════════════════════════════════╝")
         print("")
         print("PID: \(getpid())")
-        print("Main thread: \(pthread_mach_thread_np(pthread_self()))")
+        print("Main thread: \(currentThreadID())")
         print("")
         print("This program will:")
         print("  - Run 3 worker threads with deep call stacks")